@@ -110,6 +110,7 @@
 #include <86box/acpi.h>
 #include <86box/nv/vid_nv_rivatimer.h>
 #include <86box/vfio.h>
+#include <86box/snapshot.h>
 
 // Disable c99-designator to avoid the warnings about int ng
 #ifdef __clang__
@@ -179,6 +180,7 @@ int      force_43                               = 0;              /* (C) video *
 int      video_filter_method                    = 1;              /* (C) video */
 int      video_vsync                            = 0;              /* (C) video */
 int      video_framerate                        = -1;             /* (C) video */
+int      video_dirty_scanout                    = 0;              /* (C) video */
 bool     serial_passthrough_enabled[SERIAL_MAX - 1] = { 0, 0, 0, 0, 0, 0, 0 }; /* (C) activation and kind of
                                                                                   pass-through for serial ports */
 int      bugger_enabled                         = 0;              /* (C) enable ISAbugger */
@@ -200,6 +202,10 @@ uint32_t mem_size                               = 0;              /* (C) memory
                                                                          system board)*/
 uint32_t isa_mem_size                           = 0;              /* (C) memory size (ISA Memory Cards) */
 int      cpu_use_dynarec                        = 0;              /* (C) cpu uses/needs Dyna */
+int      mmu_tlb_size                           = 1024;           /* (C) software TLB entries */
+int      dynarec_cache_size                     = 0;              /* (C) dynarec code cache size in MB, 0 = automatic */
+int      dynarec_compile_threshold              = 1;              /* (C) interpreted runs before a block is compiled */
+int      dynarec_compile_budget                 = 0;              /* (C) blocks compiled per millisecond, 0 = unlimited */
 int      cpu                                    = 0;              /* (C) cpu type */
 int      fpu_type                               = 0;              /* (C) fpu type */
 int      fpu_softfloat                          = 0;              /* (C) fpu uses softfloat */
@@ -712,6 +718,7 @@ pc_show_usage(void)
 #ifdef USE_INSTRUMENT
             "-J or --instrument name\t- set 'name' to be the profiling instrument\n"
 #endif
+            "-K or --snapshot path\t\t- load the snapshot 'path' on startup\n"
             "-L or --logfile path\t\t- set 'path' to be the logfile\n"
             "-M or --missing\t\t- dump missing machines and video cards\n"
             "-N or --noconfirm\t\t- do not ask for confirmation on quit\n"
@@ -975,6 +982,11 @@ usage:
             // The return value of 0 only means that the code is invalid,
             //   not related to that translation is exists or not for the
             //  selected language.
+        } else if (!strcasecmp(argv[c], "--snapshot") || !strcasecmp(argv[c], "-K")) {
+            if ((c + 1) == argc)
+                goto usage;
+
+            snapshot_request(1, argv[++c]);
         } else if (!strcasecmp(argv[c], "--test") || !strcasecmp(argv[c], "-T")) {
             /* some (undocumented) test function here.. */
 
@@ -1919,10 +1931,16 @@ pc_close(UNUSED(thread_t *ptr))
         dumpregs(0);
 #endif
 
+#if defined(USE_DYNAREC) && defined(USE_NEW_DYNAREC) && defined(USE_CODEGEN_PROFILE)
+    codegen_profile_report();
+#endif
+
     video_close();
 
     device_close_all();
 
+    rom_cache_close();
+
     scsi_device_close_all();
 
     midi_out_close();
@@ -1976,6 +1994,9 @@ pc_run(void)
         pc_reset_hard_init();
     }
 
+    /* Save or load a snapshot if one has been requested. */
+    snapshot_process();
+
     /* Update the guest-CPU independent timer for devices with independent clock speed */
     rivatimer_update_all();
 
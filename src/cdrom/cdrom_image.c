@@ -37,6 +37,7 @@
 #include <86box/nvr.h>
 #include <86box/path.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/cdrom.h>
 #include <86box/cdrom_image.h>
 #include <86box/cdrom_image_viso.h>
@@ -118,6 +119,44 @@ typedef struct
 
 #define dstruct_t mds_disc_struct_t
 
+/*
+   Sector cache: the sectors read from the track files, most recently used
+   first, looked up by LBA. Sequential reads are followed by a thread that
+   keeps the next sectors in the cache, reading them several at a time.
+ */
+#define CACHE_SECTOR_SIZE 2448
+#define CACHE_BATCH       32  /* sectors read ahead with a single read */
+#define CACHE_WINDOW      256 /* sectors read ahead of a sequential reader */
+
+typedef struct cache_entry_t {
+    uint32_t lba;
+    int32_t  hash_next;
+    int32_t  prev;
+    int32_t  next;
+} cache_entry_t;
+
+typedef struct image_cache_t {
+    mutex_t       *lock; /* Also serializes reads from the track files. */
+    thread_t      *thread;
+    event_t       *wake;
+    volatile int   run;
+
+    uint32_t       entries;
+    uint32_t       used;
+    uint32_t       window;
+    uint32_t       hash_mask;
+    int32_t       *hash;
+    int32_t        head; /* Most recently used. */
+    int32_t        tail;
+    cache_entry_t *entry;
+    uint8_t       *data;
+    uint8_t       *batch;
+
+    uint32_t       last_lba;
+    uint32_t       ra_next;
+    uint32_t       ra_end;
+} image_cache_t;
+
 typedef struct cd_image_t {
     cdrom_t      *dev;
     void         *log;
@@ -129,6 +168,7 @@ typedef struct cd_image_t {
     track_t      *tracks;
     uint32_t     *bad_sectors;
     dstruct_t     dstruct;
+    image_cache_t *cache;
 } cd_image_t;
 
 typedef enum
@@ -2602,6 +2642,266 @@ image_load_mds(cd_image_t *img, const char *mdsfile)
     return success;
 }
 
+/* Sector cache functions. */
+static int32_t
+cache_find(const image_cache_t *cache, const uint32_t lba)
+{
+    int32_t i = cache->hash[lba & cache->hash_mask];
+
+    while ((i >= 0) && (cache->entry[i].lba != lba))
+        i = cache->entry[i].hash_next;
+
+    return i;
+}
+
+static void
+cache_unlink(image_cache_t *cache, const int32_t i)
+{
+    cache_entry_t *e = &(cache->entry[i]);
+
+    if (e->prev >= 0)
+        cache->entry[e->prev].next = e->next;
+    else
+        cache->head = e->next;
+
+    if (e->next >= 0)
+        cache->entry[e->next].prev = e->prev;
+    else
+        cache->tail = e->prev;
+}
+
+static void
+cache_make_head(image_cache_t *cache, const int32_t i)
+{
+    cache_entry_t *e = &(cache->entry[i]);
+
+    e->prev = -1;
+    e->next = cache->head;
+    if (cache->head >= 0)
+        cache->entry[cache->head].prev = i;
+    else
+        cache->tail = i;
+    cache->head = i;
+}
+
+static void
+cache_store(image_cache_t *cache, const uint32_t lba, const uint8_t *buffer, const size_t count)
+{
+    int32_t  i = cache_find(cache, lba);
+    int32_t *p;
+
+    if (i >= 0) {
+        cache_unlink(cache, i);
+        cache_make_head(cache, i);
+        return;
+    }
+
+    if (cache->used < cache->entries)
+        i = cache->used++;
+    else {
+        /* Evict the least recently used sector. */
+        i = cache->tail;
+        cache_unlink(cache, i);
+
+        p = &(cache->hash[cache->entry[i].lba & cache->hash_mask]);
+        while (*p != i)
+            p = &(cache->entry[*p].hash_next);
+        *p = cache->entry[i].hash_next;
+    }
+
+    cache->entry[i].lba       = lba;
+    cache->entry[i].hash_next = cache->hash[lba & cache->hash_mask];
+    cache->hash[lba & cache->hash_mask] = i;
+    memcpy(&(cache->data[(size_t) i * CACHE_SECTOR_SIZE]), buffer, count);
+    cache_make_head(cache, i);
+}
+
+/* Reads ahead from the given sector, returns the number of sectors done. */
+static uint32_t
+cache_fill(const cd_image_t *img, const uint32_t lba, uint32_t count)
+{
+    image_cache_t *cache = img->cache;
+    int            track;
+    int            index;
+
+    if (cache_find(cache, lba) >= 0)
+        return 1;
+
+    image_get_track_and_index(img, lba, &track, &index);
+
+    if (track < 0) {
+        /* Past the end of the disc. */
+        cache->ra_end = lba;
+        return 0;
+    }
+
+    const track_t       *trk  = &(img->tracks[track]);
+    const track_index_t *idx  = &(trk->idx[index]);
+    const uint64_t       end  = idx->start + idx->length - 150;
+    const uint64_t       seek = ((lba + 150 - idx->start + idx->file_start) * trk->sector_size) + trk->skip;
+
+    /* Sectors not in the file are generated without reading anything. */
+    if ((idx->type < INDEX_NORMAL) || (trk->sector_size > CACHE_SECTOR_SIZE))
+        return 1;
+
+    if (count > CACHE_BATCH)
+        count = CACHE_BATCH;
+    if (count > (end - lba))
+        count = end - lba;
+    for (uint32_t i = 1; i < count; i++) {
+        if (cache_find(cache, lba + i) >= 0) {
+            count = i;
+            break;
+        }
+    }
+
+    if (idx->file->read(idx->file, cache->batch, seek, count * trk->sector_size) <= 0) {
+        image_log(img->log, "Sector cache: Read-ahead of %i sectors from %08X failed\n", count, lba);
+        cache->ra_end = lba;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        cache_store(cache, lba + i, &(cache->batch[i * trk->sector_size]), trk->sector_size);
+
+    return count;
+}
+
+static void
+cache_thread(void *priv)
+{
+    const cd_image_t *img   = (const cd_image_t *) priv;
+    image_cache_t    *cache = img->cache;
+
+    while (1) {
+        thread_wait_event(cache->wake, -1);
+        thread_reset_event(cache->wake);
+
+        if (!cache->run)
+            break;
+
+        thread_wait_mutex(cache->lock);
+        while (cache->run && (cache->ra_next < cache->ra_end)) {
+            cache->ra_next += cache_fill(img, cache->ra_next, cache->ra_end - cache->ra_next);
+
+            /* Let the reader in between batches. */
+            thread_release_mutex(cache->lock);
+            thread_wait_mutex(cache->lock);
+        }
+        thread_release_mutex(cache->lock);
+    }
+}
+
+/* Reads a sector from a track file, through the cache if there is one. */
+static int
+image_read_file(const cd_image_t *img, track_file_t *file, uint8_t *buffer,
+                const uint64_t seek, const size_t count, const uint32_t lba)
+{
+    image_cache_t *cache = img->cache;
+    int            wake  = 0;
+    int32_t        i;
+    int            ret;
+
+    if ((cache == NULL) || (count > CACHE_SECTOR_SIZE))
+        return file->read(file, buffer, seek, count);
+
+    thread_wait_mutex(cache->lock);
+
+    i = cache_find(cache, lba);
+    if (i >= 0) {
+        memcpy(buffer, &(cache->data[(size_t) i * CACHE_SECTOR_SIZE]), count);
+        cache_unlink(cache, i);
+        cache_make_head(cache, i);
+        ret = 1;
+    } else {
+        ret = file->read(file, buffer, seek, count);
+        if (ret > 0)
+            cache_store(cache, lba, buffer, count);
+    }
+
+    if (lba == (cache->last_lba + 1)) {
+        /* Sequential, keep the window ahead of the reader filled. */
+        if ((cache->ra_next <= lba) || (cache->ra_next > (lba + cache->window)))
+            cache->ra_next = lba + 1;
+        cache->ra_end = lba + 1 + cache->window;
+        wake          = (cache->ra_next - lba) <= (cache->window / 2);
+    }
+    cache->last_lba = lba;
+
+    thread_release_mutex(cache->lock);
+
+    if (wake)
+        thread_set_event(cache->wake);
+
+    return ret;
+}
+
+static void
+image_cache_init(cd_image_t *img, const uint32_t size)
+{
+    image_cache_t *cache   = (image_cache_t *) calloc(1, sizeof(image_cache_t));
+    uint32_t       entries = (uint32_t) (((uint64_t) size << 20) / CACHE_SECTOR_SIZE);
+    uint32_t       hash    = 1;
+
+    if (entries > (1 << 20))
+        entries = 1 << 20;
+    while (hash < entries)
+        hash <<= 1;
+
+    cache->entries   = entries;
+    cache->window    = MIN(CACHE_WINDOW, entries / 2);
+    cache->hash_mask = hash - 1;
+    cache->hash      = (int32_t *) malloc(hash * sizeof(int32_t));
+    cache->entry     = (cache_entry_t *) calloc(entries, sizeof(cache_entry_t));
+    cache->data      = (uint8_t *) malloc((size_t) entries * CACHE_SECTOR_SIZE);
+    cache->batch     = (uint8_t *) malloc(CACHE_BATCH * CACHE_SECTOR_SIZE);
+    if ((cache->hash == NULL) || (cache->entry == NULL) || (cache->data == NULL) || (cache->batch == NULL)) {
+        log_warning(img->log, "Unable to allocate a %i MB sector cache\n", size);
+        free(cache->hash);
+        free(cache->entry);
+        free(cache->data);
+        free(cache->batch);
+        free(cache);
+        return;
+    }
+
+    memset(cache->hash, 0xff, hash * sizeof(int32_t));
+    cache->head     = -1;
+    cache->tail     = -1;
+    cache->last_lba = 0xffffffff;
+
+    cache->lock   = thread_create_mutex();
+    cache->wake   = thread_create_event();
+    cache->run    = 1;
+    img->cache    = cache;
+    cache->thread = thread_create(cache_thread, img);
+
+    image_log(img->log, "Sector cache: %i sectors\n", entries);
+}
+
+static void
+image_cache_close(cd_image_t *img)
+{
+    image_cache_t *cache = img->cache;
+
+    if (cache == NULL)
+        return;
+
+    cache->run = 0;
+    thread_set_event(cache->wake);
+    thread_wait(cache->thread);
+
+    thread_destroy_event(cache->wake);
+    thread_close_mutex(cache->lock);
+
+    free(cache->hash);
+    free(cache->entry);
+    free(cache->data);
+    free(cache->batch);
+    free(cache);
+    img->cache = NULL;
+}
+
 /* Root functions. */
 static void
 image_clear_tracks(cd_image_t *img)
@@ -2788,7 +3088,7 @@ image_read_sector(const void *local, uint8_t *buffer,
 
             if (idx->type >= INDEX_NORMAL)
                 /* Read the data from the file. */
-                ret = idx->file->read(idx->file, buffer, seek, trk->sector_size);
+                ret = image_read_file(img, idx->file, buffer, seek, trk->sector_size, lba);
             else
                 /* Index is not in the file, no read to fail here. */
                 ret = 1;
@@ -2952,6 +3252,7 @@ image_close(void *local)
     cd_image_t *img = (cd_image_t *) local;
 
     if (img != NULL) {
+        image_cache_close(img);
         image_clear_tracks(img);
 
         image_log(img->log, "Log closed\n");
@@ -3038,6 +3339,9 @@ image_open(cdrom_t *dev, const char *path)
             }
 
             dev->ops = &image_ops;
+
+            if (dev->cache_size > 0)
+                image_cache_init(img, dev->cache_size);
         } else {
             log_warning(img->log, "Unable to load CD-ROM image: %s\n", path);
 
@@ -54,15 +54,47 @@ typedef struct codeblock_t {
     uint16_t prev, next;
     uint16_t prev_2, next_2;
 
+    /*Block last executed after this one, so that the dispatcher can go
+      straight to it. Only valid while link_gen matches codegen_link_gen.*/
+    uint16_t link;
+    uint32_t link_gen;
+
+    /*Number of times the block has been run by the interpreter since it was
+      marked, checked against dynarec_compile_threshold.*/
+    uint8_t interp_count;
+
     /*First mem_block_t used by this block. Any subsequent mem_block_ts
       will be in the list starting at head_mem_block->next.*/
     struct mem_block_t *head_mem_block;
+
+#ifdef USE_CODEGEN_PROFILE
+    /*Index of the profile entry for this block's start address*/
+    uint32_t profile;
+#endif
 } codeblock_t;
 
 extern codeblock_t *codeblock;
 
 extern uint16_t *codeblock_hash;
 
+/*Number of code blocks and size of the hash table, both powers of two and set
+  by codegen_init() from the code cache size. Block numbers are 16-bit, which
+  limits the number of blocks to 64k.*/
+#define CODEGEN_BLOCK_NR_MIN  0x4000
+#define CODEGEN_BLOCK_NR_MAX  0x10000
+#define CODEGEN_HASH_SIZE_MIN 0x20000
+#define CODEGEN_HASH_SIZE_MAX 0x400000
+
+extern uint32_t codegen_block_nr;
+extern uint32_t codegen_block_mask;
+extern uint32_t codegen_hash_size;
+extern uint32_t codegen_hash_mask;
+
+/*Generation of block links. Incremented, dropping every link at once, whenever
+  a block is invalidated or deleted, and whenever the MMU mappings are flushed
+  (links skip the linear to physical lookup).*/
+extern uint32_t codegen_link_gen;
+
 extern uint8_t *block_write_data;
 
 /*Code block uses FPU*/
@@ -81,6 +113,8 @@ extern uint8_t *block_write_data;
 #define CODEBLOCK_IN_DIRTY_LIST 0x40
 /*Code block is not inlining immediate parameters, parameters must be fetched from memory*/
 #define CODEBLOCK_NO_IMMEDIATES 0x80
+/*Code block has been executed since the eviction hand last passed it*/
+#define CODEBLOCK_REFERENCED 0x100
 
 #define BLOCK_PC_INVALID        0xffffffff
 
@@ -309,9 +343,11 @@ extern void codegen_check_seg_write(codeblock_t *block, struct ir_data_t *ir, x8
 extern void codegen_check_regs(void);
 
 extern int codegen_purge_purgable_list(void);
-/*Delete a random code block to free memory. This is obviously quite expensive, and
-  will only be called when the allocator is out of memory*/
-extern void codegen_delete_random_block(int required_mem_block);
+/*Evict a code block to free a block or executable memory, approximating least
+  recently used order with a CLOCK sweep over the referenced flag. This will only
+  be called when the free and dirty lists are empty, or when the allocator is out
+  of memory*/
+extern void codegen_evict_block(int required_mem_block);
 
 extern int      cpu_block_end;
 extern uint32_t codegen_endpc;
@@ -381,4 +417,52 @@ void codegen_set_loop_start(struct ir_data_t *ir, int first_instruction);
 extern uint32_t instr_counts[256 * 256];
 #endif
 
+/*Code block profiler. When built with USE_CODEGEN_PROFILE, statistics are kept
+  for each guest block start address (rather than for each codeblock_t, as those
+  are recycled), and a report sorted by execution count is logged on exit. This
+  is meant for finding out why a guest is slow under the dynarec - blocks which
+  are recompiled over and over, or which keep being thrown out.*/
+enum {
+    CODEGEN_PROFILE_SMC = 0,     /*Code was written to, found on block entry*/
+    CODEGEN_PROFILE_PAGE_EVICT,  /*Code was written to, found when purging the page evict list*/
+    CODEGEN_PROFILE_DIRTY_EVICT, /*Invalidated block dropped from the dirty list*/
+    CODEGEN_PROFILE_EVICT,       /*Evicted to free a code block*/
+    CODEGEN_PROFILE_MEM,         /*Evicted to free executable memory*/
+    CODEGEN_PROFILE_ABORT,       /*Recompilation was abandoned*/
+
+    CODEGEN_PROFILE_CAUSES
+};
+
+#ifdef USE_CODEGEN_PROFILE
+typedef struct codegen_profile_t {
+    uint32_t phys;
+    uint32_t pc;
+    uint64_t execs;
+    uint32_t creates;
+    uint32_t recompiles;
+    uint32_t host_bytes;
+    uint32_t removed[CODEGEN_PROFILE_CAUSES];
+} codegen_profile_t;
+
+extern codegen_profile_t *codegen_profile;
+
+extern void codegen_profile_init(void);
+extern void codegen_profile_create(codeblock_t *block);
+extern void codegen_profile_recompile(codeblock_t *block);
+extern void codegen_profile_remove(codeblock_t *block, int cause);
+extern void codegen_profile_report(void);
+
+static inline void
+codegen_profile_exec(codeblock_t *block)
+{
+    codegen_profile[block->profile].execs++;
+}
+#else
+#    define codegen_profile_init()
+#    define codegen_profile_create(block)
+#    define codegen_profile_recompile(block)
+#    define codegen_profile_remove(block, cause)
+#    define codegen_profile_exec(block)
+#endif
+
 #endif
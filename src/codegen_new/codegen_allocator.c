@@ -7,7 +7,6 @@
 #    include <windows.h>
 #endif
 
-#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -21,58 +20,6 @@
 #include "codegen_allocator.h"
 #include "codegen_backend.h"
 
-struct mem_code_block_t;
-
-typedef struct mem_code_block_t
-{
-    struct mem_code_block_t* prev;
-    struct mem_code_block_t* next;
-
-    int number;
-} mem_code_block_t;
-
-static bool valid_code_blocks[BLOCK_SIZE];
-static mem_code_block_t mem_code_blocks[BLOCK_SIZE];
-static mem_code_block_t* mem_code_block_head = NULL;
-static mem_code_block_t* mem_code_block_tail = NULL;
-
-static void
-remove_from_block_list(mem_code_block_t* block)
-{
-    valid_code_blocks[block->number] = 0;
-    if (block->prev) {
-        block->prev->next = block->next;
-        if (block->next) {
-            block->next->prev = block->prev;
-        } else {
-            mem_code_block_tail = block->prev;
-        }
-    } else if (block->next) {
-        mem_code_block_head = block->next;
-        if (mem_code_block_head && mem_code_block_head->next) {
-            mem_code_block_head->next->prev = mem_code_block_head;
-        }
-    } else if (block == mem_code_block_head) {
-        mem_code_block_head = mem_code_block_tail = NULL;
-    }
-    block->next = block->prev = NULL;
-}
-
-static void
-add_to_block_list(int code_block)
-{
-    if (!mem_code_block_head) {
-        mem_code_block_head = &mem_code_blocks[code_block];
-        mem_code_block_head->number = code_block;
-        mem_code_block_tail = mem_code_block_head;
-    } else {
-        mem_code_block_tail->next = &mem_code_blocks[code_block];
-        mem_code_blocks[code_block].prev = mem_code_block_tail;
-        mem_code_block_tail = &mem_code_blocks[code_block];
-        mem_code_blocks[code_block].number = code_block;
-    }
-}
-
 typedef struct mem_block_t {
     uint32_t offset; /*Offset into mem_block_alloc*/
     uint32_t next;
@@ -80,8 +27,10 @@ typedef struct mem_block_t {
     uint16_t code_block;
 } mem_block_t;
 
-static mem_block_t mem_blocks[MEM_BLOCK_NR];
-static uint32_t    mem_block_free_list;
+uint32_t mem_block_nr = MEM_BLOCK_NR_DEFAULT;
+
+static mem_block_t *mem_blocks = NULL;
+static uint32_t     mem_block_free_list;
 static uint8_t    *mem_block_alloc = NULL;
 
 int codegen_allocator_usage = 0;
@@ -89,13 +38,16 @@ int codegen_allocator_usage = 0;
 void
 codegen_allocator_init(void)
 {
-    mem_block_alloc = plat_mmap(MEM_BLOCK_NR * MEM_BLOCK_SIZE, 1);
+    mem_block_alloc = plat_mmap((size_t) mem_block_nr * MEM_BLOCK_SIZE, 1);
+    mem_blocks      = malloc(mem_block_nr * sizeof(mem_block_t));
+    if ((mem_block_alloc == NULL) || (mem_blocks == NULL))
+        fatal("codegen_allocator_init(): Unable to allocate %u memory blocks\n", mem_block_nr);
 
-    for (uint32_t c = 0; c < MEM_BLOCK_NR; c++) {
+    for (uint32_t c = 0; c < mem_block_nr; c++) {
         mem_blocks[c].offset     = c * MEM_BLOCK_SIZE;
         mem_blocks[c].code_block = BLOCK_INVALID;
         mem_blocks[c].tail       = 0;
-        if (c < MEM_BLOCK_NR - 1)
+        if (c < mem_block_nr - 1)
             mem_blocks[c].next = c + 2;
         else
             mem_blocks[c].next = 0;
@@ -109,26 +61,11 @@ codegen_allocator_allocate(mem_block_t *parent, int code_block)
     mem_block_t *block;
     uint32_t     block_nr;
 
-    if (!mem_block_free_list) {
-        if (mem_code_block_head == mem_code_block_tail) {
-            fatal("Out of memory blocks!\n");
-        } else {
-            mem_code_block_t* mem_code_block = mem_code_block_head;
-            while (mem_code_block) {
-                if (code_block != mem_code_block->number) {
-                    codegen_delete_block(&codeblock[mem_code_block->number]);
-                }
-                mem_code_block = mem_code_block->next;
-            }
-
-            if (mem_block_free_list)
-                goto block_allocate;
-
-            fatal("Out of memory blocks!\n");
-        }
-    }
+    /*Out of memory, evict code blocks until some is freed. The block being
+      compiled is never evicted.*/
+    while (!mem_block_free_list)
+        codegen_evict_block(1);
 
-block_allocate:
     /*Remove from free list*/
     block_nr            = mem_block_free_list;
     block               = &mem_blocks[block_nr - 1];
@@ -144,15 +81,9 @@ block_allocate:
         else
             parent->next = parent->tail = block_nr;
         block->next = block->tail = 0;
-    } else {
+    } else
         block->next = block->tail = 0;
 
-        if (!valid_code_blocks[code_block]) {
-            valid_code_blocks[code_block] = 1;
-            add_to_block_list(code_block);
-        }
-    }
-
     codegen_allocator_usage++;
     return block;
 }
@@ -162,8 +93,6 @@ codegen_allocator_free(mem_block_t *block)
     int block_nr = (((uintptr_t) block - (uintptr_t) mem_blocks) / sizeof(mem_block_t)) + 1;
 
     block->tail = 0;
-    if (valid_code_blocks[block->code_block])
-        remove_from_block_list(&mem_code_blocks[block->code_block]);
 
     while (1) {
         int next_block_nr = block->next;
@@ -187,6 +116,19 @@ codeblock_allocator_get_ptr(mem_block_t *block)
     return &mem_block_alloc[block->offset];
 }
 
+int
+codegen_allocator_get_count(mem_block_t *block)
+{
+    int count = 1;
+
+    while (block->next) {
+        block = &mem_blocks[block->next - 1];
+        count++;
+    }
+
+    return count;
+}
+
 void
 codegen_allocator_clean_blocks(UNUSED(struct mem_block_t *block))
 {
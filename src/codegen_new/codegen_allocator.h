@@ -12,14 +12,25 @@
 
   Due to the chaining, the total memory size is limited by the range of a jump
   instruction. ARMv8 is limited to +/- 128 MB, x86 to
-  +/- 2GB. It was 32 MB on ARMv7 before we removed it*/
+  +/- 2GB. It was 32 MB on ARMv7 before we removed it
 
-#define MEM_BLOCK_NR 131072
+  The number of blocks is set by codegen_init() before the allocator is
+  initialised, from the configured cache size or from the guest RAM size. When
+  memory runs out, code blocks are evicted with codegen_evict_block().*/
 
-
-#define MEM_BLOCK_MASK (MEM_BLOCK_NR - 1)
 #define MEM_BLOCK_SIZE 0x3c0
 
+/*Default number of blocks, just under 120 MB. Also the minimum used when the
+  cache is sized automatically*/
+#define MEM_BLOCK_NR_DEFAULT 131072
+#if defined __ARM_EABI__ || defined __aarch64__ || defined _M_ARM64
+#    define MEM_BLOCK_NR_MAX MEM_BLOCK_NR_DEFAULT
+#else
+#    define MEM_BLOCK_NR_MAX ((1024 << 20) / MEM_BLOCK_SIZE)
+#endif
+
+extern uint32_t mem_block_nr;
+
 void codegen_allocator_init(void);
 /*Allocate a mem_block_t, and the associated backing memory.
   If parent is non-NULL, then the new block will be added to the list in
@@ -29,6 +40,8 @@ struct mem_block_t *codegen_allocator_allocate(struct mem_block_t *parent, int c
 void codegen_allocator_free(struct mem_block_t *block);
 /*Get a pointer to the backing memory associated with block*/
 uint8_t *codeblock_allocator_get_ptr(struct mem_block_t *block);
+/*Get the number of memory blocks in the list starting at block*/
+int codegen_allocator_get_count(struct mem_block_t *block);
 /*Cache clean memory block list*/
 void codegen_allocator_clean_blocks(struct mem_block_t *block);
 
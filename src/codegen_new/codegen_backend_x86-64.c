@@ -5,6 +5,7 @@
 #    include <86box/86box.h>
 #    include "cpu.h"
 #    include <86box/mem.h>
+#    include <86box/plat_unused.h>
 
 #    include "codegen.h"
 #    include "codegen_allocator.h"
@@ -12,6 +13,7 @@
 #    include "codegen_backend_x86-64_defs.h"
 #    include "codegen_backend_x86-64_ops.h"
 #    include "codegen_backend_x86-64_ops_sse.h"
+#    include "codegen_backend_x86-64_ops_helpers.h"
 #    include "codegen_reg.h"
 #    include "x86.h"
 #    include "x86seg_common.h"
@@ -53,27 +55,55 @@ host_reg_def_t codegen_host_reg_list[CODEGEN_HOST_REGS] = {
 };
 
 host_reg_def_t codegen_host_fp_reg_list[CODEGEN_HOST_FP_REGS] = {
-#    if _WIN64
-  /*Windows x86-64 calling convention preserves XMM6-XMM15*/
-    {REG_XMM6,  0                     },
-    { REG_XMM7, 0                     },
-#    else
-    /*System V AMD64 calling convention does not preserve any XMM registers*/
-    { REG_XMM6, HOST_REG_FLAG_VOLATILE },
-    { REG_XMM7, HOST_REG_FLAG_VOLATILE },
-#    endif
-    { REG_XMM1, HOST_REG_FLAG_VOLATILE},
-    { REG_XMM2, HOST_REG_FLAG_VOLATILE},
-    { REG_XMM3, HOST_REG_FLAG_VOLATILE},
-    { REG_XMM4, HOST_REG_FLAG_VOLATILE},
-    { REG_XMM5, HOST_REG_FLAG_VOLATILE}
+  /*Neither calling convention preserves all of these, however the memory
+  access routines save and restore them around calls to the C memory
+  handlers, so FPU and MMX registers can stay in host registers across guest
+  memory accesses. Everything else that calls out of the generated code is a
+  barrier, and invalidates all host registers anyway*/
+    {REG_XMM6,  0},
+    { REG_XMM7, 0},
+    { REG_XMM1, 0},
+    { REG_XMM2, 0},
+    { REG_XMM3, 0},
+    { REG_XMM4, 0},
+    { REG_XMM5, 0}
 };
 
+/*Space on the stack used to preserve the FP registers. Only the low 64 bits
+  of each register are ever used by the recompiler. Keeps the stack 16 byte
+  aligned*/
+#    define FP_REG_SAVE_SIZE ((CODEGEN_HOST_FP_REGS * 8 + 15) & ~15)
+
+/*Upper bound on the size of a single load or store routine*/
+#    define ROUTINE_MAX_LEN 0x100
+
+static void
+build_fp_reg_save(codeblock_t *block)
+{
+    host_x86_SUB64_REG_IMM(block, REG_RSP, FP_REG_SAVE_SIZE);
+    for (int c = 0; c < CODEGEN_HOST_FP_REGS; c++)
+        host_x86_MOVQ_BASE_OFFSET_XREG(block, REG_RSP, c * 8, codegen_host_fp_reg_list[c].reg);
+}
+
 static void
+build_fp_reg_restore(codeblock_t *block)
+{
+    for (int c = 0; c < CODEGEN_HOST_FP_REGS; c++)
+        host_x86_MOVQ_XREG_BASE_OFFSET(block, codegen_host_fp_reg_list[c].reg, REG_RSP, c * 8);
+    host_x86_ADD64_REG_IMM(block, REG_RSP, FP_REG_SAVE_SIZE);
+}
+
+static void *
 build_load_routine(codeblock_t *block, int size, int is_float)
 {
     uint8_t *branch_offset;
     uint8_t *misaligned_offset = NULL;
+    void    *routine;
+
+    /*The routine contains short branches, so must not cross into another
+      memory block*/
+    codegen_alloc_bytes(block, ROUTINE_MAX_LEN);
+    routine = &block_write_data[block_pos];
 
     /*In - ESI = address
       Out - ECX = data, ESI = abrt*/
@@ -88,7 +118,9 @@ build_load_routine(codeblock_t *block, int size, int is_float)
     * PUSH EAX
       PUSH EDX
       PUSH ECX
+      (save XMM registers)
       CALL readmembl
+      (restore XMM registers)
       POP ECX
       POP EDX
       POP EAX
@@ -125,6 +157,7 @@ build_load_routine(codeblock_t *block, int size, int is_float)
         *misaligned_offset = (uint8_t) ((uintptr_t) &block_write_data[block_pos] - (uintptr_t) misaligned_offset) - 1;
     host_x86_PUSH(block, REG_RAX);
     host_x86_PUSH(block, REG_RDX);
+    build_fp_reg_save(block);
 #    if _WIN64
     host_x86_SUB64_REG_IMM(block, REG_RSP, 0x20);
     // host_x86_MOV32_REG_REG(block, REG_ECX, uop->imm_data);
@@ -151,17 +184,24 @@ build_load_routine(codeblock_t *block, int size, int is_float)
 #    if _WIN64
     host_x86_ADD64_REG_IMM(block, REG_RSP, 0x20);
 #    endif
+    build_fp_reg_restore(block);
     host_x86_POP(block, REG_RDX);
     host_x86_POP(block, REG_RAX);
     host_x86_MOVZX_REG_ABS_32_8(block, REG_ESI, &cpu_state.abrt);
     host_x86_RET(block);
+
+    return routine;
 }
 
-static void
+static void *
 build_store_routine(codeblock_t *block, int size, int is_float)
 {
     uint8_t *branch_offset;
     uint8_t *misaligned_offset = NULL;
+    void    *routine;
+
+    codegen_alloc_bytes(block, ROUTINE_MAX_LEN);
+    routine = &block_write_data[block_pos];
 
     /*In - ECX = data, ESI = address
       Out - ESI = abrt
@@ -177,7 +217,9 @@ build_store_routine(codeblock_t *block, int size, int is_float)
     * PUSH EAX
       PUSH EDX
       PUSH ECX
+      (save XMM registers)
       CALL writemembl
+      (restore XMM registers)
       POP ECX
       POP EDX
       POP EAX
@@ -214,6 +256,7 @@ build_store_routine(codeblock_t *block, int size, int is_float)
         *misaligned_offset = (uint8_t) ((uintptr_t) &block_write_data[block_pos] - (uintptr_t) misaligned_offset) - 1;
     host_x86_PUSH(block, REG_RAX);
     host_x86_PUSH(block, REG_RDX);
+    build_fp_reg_save(block);
 #    if _WIN64
     host_x86_SUB64_REG_IMM(block, REG_RSP, 0x28);
     if (size == 4 && is_float)
@@ -246,40 +289,31 @@ build_store_routine(codeblock_t *block, int size, int is_float)
 #    else
     host_x86_ADD64_REG_IMM(block, REG_RSP, 0x8);
 #    endif
+    build_fp_reg_restore(block);
     host_x86_POP(block, REG_RDX);
     host_x86_POP(block, REG_RAX);
     host_x86_MOVZX_REG_ABS_32_8(block, REG_ESI, &cpu_state.abrt);
     host_x86_RET(block);
+
+    return routine;
 }
 
 static void
 build_loadstore_routines(codeblock_t *block)
 {
-    codegen_mem_load_byte = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 1, 0);
-    codegen_mem_load_word = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 2, 0);
-    codegen_mem_load_long = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 4, 0);
-    codegen_mem_load_quad = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 8, 0);
-    codegen_mem_load_single = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 4, 1);
-    codegen_mem_load_double = &codeblock[block_current].data[block_pos];
-    build_load_routine(block, 8, 1);
-
-    codegen_mem_store_byte = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 1, 0);
-    codegen_mem_store_word = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 2, 0);
-    codegen_mem_store_long = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 4, 0);
-    codegen_mem_store_quad = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 8, 0);
-    codegen_mem_store_single = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 4, 1);
-    codegen_mem_store_double = &codeblock[block_current].data[block_pos];
-    build_store_routine(block, 8, 1);
+    codegen_mem_load_byte    = build_load_routine(block, 1, 0);
+    codegen_mem_load_word    = build_load_routine(block, 2, 0);
+    codegen_mem_load_long    = build_load_routine(block, 4, 0);
+    codegen_mem_load_quad    = build_load_routine(block, 8, 0);
+    codegen_mem_load_single  = build_load_routine(block, 4, 1);
+    codegen_mem_load_double  = build_load_routine(block, 8, 1);
+
+    codegen_mem_store_byte   = build_store_routine(block, 1, 0);
+    codegen_mem_store_word   = build_store_routine(block, 2, 0);
+    codegen_mem_store_long   = build_store_routine(block, 4, 0);
+    codegen_mem_store_quad   = build_store_routine(block, 8, 0);
+    codegen_mem_store_single = build_store_routine(block, 4, 1);
+    codegen_mem_store_double = build_store_routine(block, 8, 1);
 }
 
 void
@@ -288,13 +322,13 @@ codegen_backend_init(void)
     codeblock_t *block;
     int          c;
 
-    codeblock      = malloc(BLOCK_SIZE * sizeof(codeblock_t));
-    codeblock_hash = malloc(HASH_SIZE * sizeof(codeblock_t *));
+    codeblock      = malloc(codegen_block_nr * sizeof(codeblock_t));
+    codeblock_hash = malloc(codegen_hash_size * sizeof(uint16_t));
 
-    memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(codeblock_t *));
+    memset(codeblock, 0, codegen_block_nr * sizeof(codeblock_t));
+    memset(codeblock_hash, 0, codegen_hash_size * sizeof(uint16_t));
 
-    for (c = 0; c < BLOCK_SIZE; c++)
+    for (c = 0; c < codegen_block_nr; c++)
         codeblock[c].pc = BLOCK_PC_INVALID;
 
     block_current                           = 0;
@@ -305,7 +339,7 @@ codegen_backend_init(void)
     block_write_data                        = codeblock[block_current].data;
     build_loadstore_routines(&codeblock[block_current]);
 
-    codegen_gpf_rout = &codeblock[block_current].data[block_pos];
+    codegen_gpf_rout = &block_write_data[block_pos];
 #    if _WIN64
     host_x86_XOR32_REG_REG(block, REG_ECX, REG_ECX);
     host_x86_XOR32_REG_REG(block, REG_EDX, REG_EDX);
@@ -314,7 +348,7 @@ codegen_backend_init(void)
     host_x86_XOR32_REG_REG(block, REG_ESI, REG_ESI);
 #    endif
     host_x86_CALL(block, (void *) x86gpf);
-    codegen_exit_rout = &codeblock[block_current].data[block_pos];
+    codegen_exit_rout = &block_write_data[block_pos];
 #ifdef _WIN64
     host_x86_ADD64_REG_IMM(block, REG_RSP, 0x38);
 #else
@@ -43,6 +43,15 @@ int        block_current = 0;
 static int block_num;
 int        block_pos;
 
+uint32_t codegen_block_nr;
+uint32_t codegen_block_mask;
+uint32_t codegen_hash_size;
+uint32_t codegen_hash_mask;
+
+uint32_t codegen_link_gen = 0;
+
+static uint32_t evict_hand;
+
 uint32_t codegen_endpc;
 
 int        codegen_block_cycles;
@@ -60,6 +69,7 @@ uint32_t instr_counts[256 * 256];
 static uint16_t block_free_list;
 static void     delete_block(codeblock_t *block);
 static void     delete_dirty_block(codeblock_t *block);
+static void     check_flush(page_t *page, int cause);
 
 /*Temporary list of code blocks that have recently been evicted. This allows for
   some historical state to be kept when a block is the target of self-modifying
@@ -167,7 +177,7 @@ codegen_purge_purgable_list(void)
         page_t *page = &pages[purgable_page_list_head];
 
         if (page->code_present_mask & page->dirty_mask) {
-            codegen_check_flush(page, page->dirty_mask, purgable_page_list_head << 12);
+            check_flush(page, CODEGEN_PROFILE_PAGE_EVICT);
 
             if (block_free_list)
                 return 1;
@@ -204,7 +214,7 @@ block_free_list_get(void)
         }
         /*Free list is empty - free up a block*/
         if (!codegen_purge_purgable_list())
-            codegen_delete_random_block(0);
+            codegen_evict_block(0);
     }
 
     block           = &codeblock[block_free_list];
@@ -214,29 +224,75 @@ block_free_list_get(void)
     return block;
 }
 
+static uint32_t
+codegen_pow2(uint64_t val, uint32_t min, uint32_t max)
+{
+    uint32_t ret = min;
+
+    while ((ret < max) && (ret < val))
+        ret <<= 1;
+
+    return ret;
+}
+
+/*Size the code cache. The executable memory is either as configured, or half
+  of guest RAM, and never smaller than the old fixed size. The number of code
+  blocks follows the memory, assuming an average of eight memory blocks per
+  code block, and the hash table follows guest RAM.*/
+static void
+codegen_size_cache(void)
+{
+    uint64_t cache_size;
+
+    if (dynarec_cache_size > 0)
+        cache_size = (uint64_t) dynarec_cache_size << 20;
+    else {
+        cache_size = (uint64_t) mem_size << 9;
+        if (cache_size < ((uint64_t) MEM_BLOCK_NR_DEFAULT * MEM_BLOCK_SIZE))
+            cache_size = (uint64_t) MEM_BLOCK_NR_DEFAULT * MEM_BLOCK_SIZE;
+    }
+
+    mem_block_nr = cache_size / MEM_BLOCK_SIZE;
+    if (mem_block_nr > MEM_BLOCK_NR_MAX)
+        mem_block_nr = MEM_BLOCK_NR_MAX;
+    else if (mem_block_nr < (CODEGEN_BLOCK_NR_MIN * 2))
+        mem_block_nr = CODEGEN_BLOCK_NR_MIN * 2;
+
+    codegen_block_nr   = codegen_pow2(mem_block_nr >> 3, CODEGEN_BLOCK_NR_MIN, CODEGEN_BLOCK_NR_MAX);
+    codegen_block_mask = codegen_block_nr - 1;
+    codegen_hash_size  = codegen_pow2((uint64_t) mem_size << 2, CODEGEN_HASH_SIZE_MIN, CODEGEN_HASH_SIZE_MAX);
+    codegen_hash_mask  = codegen_hash_size - 1;
+
+    pclog("Dynarec: %u KB code cache, %u code blocks, %u hash entries\n",
+          (uint32_t) (((uint64_t) mem_block_nr * MEM_BLOCK_SIZE) >> 10), codegen_block_nr, codegen_hash_size);
+}
+
 void
 codegen_init(void)
 {
     codegen_check_regs();
+    codegen_size_cache();
     codegen_allocator_init();
 
     codegen_backend_init();
     block_free_list = 0;
-    for (uint32_t c = 0; c < BLOCK_SIZE; c++)
+    evict_hand      = 1;
+    for (uint32_t c = 0; c < codegen_block_nr; c++)
         block_free_list_add(&codeblock[c]);
     block_dirty_list_head = block_dirty_list_tail = 0;
     dirty_list_size                               = 0;
 #ifdef DEBUG_EXTRA
     memset(instr_counts, 0, sizeof(instr_counts));
 #endif
+    codegen_profile_init();
 }
 
 void
 codegen_reset(void)
 {
-    int c;
+    uint32_t c;
 
-    for (c = 1; c < BLOCK_SIZE; c++) {
+    for (c = 1; c < codegen_block_nr; c++) {
         codeblock_t *block = &codeblock[c];
 
         if (block->pc != BLOCK_PC_INVALID) {
@@ -246,12 +302,12 @@ codegen_reset(void)
         }
     }
 
-    memset(codeblock, 0, BLOCK_SIZE * sizeof(codeblock_t));
-    memset(codeblock_hash, 0, HASH_SIZE * sizeof(uint16_t));
+    memset(codeblock, 0, codegen_block_nr * sizeof(codeblock_t));
+    memset(codeblock_hash, 0, codegen_hash_size * sizeof(uint16_t));
     mem_reset_page_blocks();
 
     block_free_list = 0;
-    for (c = 0; c < BLOCK_SIZE; c++) {
+    for (c = 0; c < codegen_block_nr; c++) {
         codeblock[c].pc = BLOCK_PC_INVALID;
         block_free_list_add(&codeblock[c]);
     }
@@ -367,7 +423,7 @@ remove_from_block_list(codeblock_t *block, UNUSED(uint32_t pc))
 }
 
 static void
-invalidate_block(codeblock_t *block)
+invalidate_block(codeblock_t *block, UNUSED(int cause))
 {
     uint32_t old_pc = block->pc;
 
@@ -377,6 +433,8 @@ invalidate_block(codeblock_t *block)
     if (block->pc == BLOCK_PC_INVALID)
         fatal("Invalidating deleted block\n");
 #endif
+    codegen_profile_remove(block, cause);
+    codegen_link_gen++;
     remove_from_block_list(block, old_pc);
     block_dirty_list_add(block);
     if (block->head_mem_block)
@@ -397,6 +455,7 @@ delete_block(codeblock_t *block)
         fatal("Deleting deleted block\n");
 #endif
     block->pc = BLOCK_PC_INVALID;
+    codegen_link_gen++;
 
     codeblock_tree_delete(block);
     if (block->flags & CODEBLOCK_IN_DIRTY_LIST)
@@ -420,7 +479,9 @@ delete_dirty_block(codeblock_t *block)
         fatal("Deleting deleted block\n");
 #endif
     block->pc = BLOCK_PC_INVALID;
+    codegen_link_gen++;
 
+    codegen_profile_remove(block, CODEGEN_PROFILE_DIRTY_EVICT);
     codeblock_tree_delete(block);
     block_free_list_add(block);
 }
@@ -433,25 +494,35 @@ codegen_delete_block(codeblock_t *block)
 }
 
 void
-codegen_delete_random_block(int required_mem_block)
+codegen_evict_block(int required_mem_block)
 {
-    int block_nr = rand() & BLOCK_MASK;
+    /*Two full turns of the hand are enough to clear every referenced flag.*/
+    for (uint32_t c = 0; c < (codegen_block_nr << 1); c++) {
+        uint32_t     block_nr = evict_hand;
+        codeblock_t *block    = &codeblock[block_nr];
 
-    while (1) {
-        if (block_nr && block_nr != block_current) {
-            codeblock_t *block = &codeblock[block_nr];
+        evict_hand = (evict_hand + 1) & codegen_block_mask;
 
-            if (block->pc != BLOCK_PC_INVALID && (!required_mem_block || block->head_mem_block)) {
-                delete_block(block);
-                return;
-            }
+        if (!block_nr || (block_nr == block_current) || (block->pc == BLOCK_PC_INVALID) ||
+            (required_mem_block && !block->head_mem_block))
+            continue;
+
+        if (block->flags & CODEBLOCK_REFERENCED) {
+            /*Executed since the last pass, give it a second chance.*/
+            block->flags &= ~CODEBLOCK_REFERENCED;
+            continue;
         }
-        block_nr = (block_nr + 1) & BLOCK_MASK;
+
+        codegen_profile_remove(block, required_mem_block ? CODEGEN_PROFILE_MEM : CODEGEN_PROFILE_EVICT);
+        delete_block(block);
+        return;
     }
+
+    fatal("codegen_evict_block(): No block to evict\n");
 }
 
-void
-codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_addr))
+static void
+check_flush(page_t *page, UNUSED(int cause))
 {
     uint16_t block_nr               = page->block;
     int      remove_from_evict_list = 0;
@@ -461,7 +532,7 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
         uint16_t     next_block = block->next;
 
         if (*block->dirty_mask & block->page_mask) {
-            invalidate_block(block);
+            invalidate_block(block, cause);
         }
 #ifndef RELEASE_BUILD
         if (block_nr == next_block)
@@ -477,7 +548,7 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
         uint16_t     next_block = block->next_2;
 
         if (*block->dirty_mask2 & block->page_mask2) {
-            invalidate_block(block);
+            invalidate_block(block, cause);
         }
 #ifndef RELEASE_BUILD
         if (block_nr == next_block)
@@ -501,6 +572,12 @@ codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_ad
         page_remove_from_evict_list(page);
 }
 
+void
+codegen_check_flush(page_t *page, UNUSED(uint64_t mask), UNUSED(uint32_t phys_addr))
+{
+    check_flush(page, CODEGEN_PROFILE_SMC);
+}
+
 void
 codegen_block_init(uint32_t phys_addr)
 {
@@ -528,11 +605,14 @@ codegen_block_init(uint32_t phys_addr)
     block->next = block->prev = BLOCK_INVALID;
     block->next_2 = block->prev_2 = BLOCK_INVALID;
     block->page_mask = block->page_mask2 = 0;
-    block->flags                         = CODEBLOCK_STATIC_TOP;
+    block->link                          = BLOCK_INVALID;
+    block->interp_count                  = 1;
+    block->flags                         = CODEBLOCK_STATIC_TOP | CODEBLOCK_REFERENCED;
     block->status                        = cpu_cur_status;
 
     recomp_page = block->phys & ~0xfff;
     codeblock_tree_add(block);
+    codegen_profile_create(block);
 }
 
 static ir_data_t *ir_data;
@@ -616,6 +696,7 @@ codegen_block_remove(void)
 {
     codeblock_t *block = &codeblock[block_current];
 
+    codegen_profile_remove(block, CODEGEN_PROFILE_ABORT);
     delete_block(block);
 
     recomp_page = -1;
@@ -781,12 +862,14 @@ codegen_block_end_recompile(codeblock_t *block)
 
     codegen_accumulate_flush(ir_data);
     codegen_ir_compile(ir_data, block);
+    codegen_profile_recompile(block);
 }
 
 void
 codegen_flush(void)
 {
-    return;
+    /*The MMU mappings have changed, drop all block links.*/
+    codegen_link_gen++;
 }
 
 void
@@ -0,0 +1,175 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Per code block profiler of the new dynamic recompiler.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <86box/86box.h>
+#include "cpu.h"
+#include <86box/mem.h>
+
+#include "codegen.h"
+#include "codegen_allocator.h"
+
+#ifdef USE_CODEGEN_PROFILE
+/*Profile entries are kept in an open addressed hash table, keyed on the
+  physical and linear start address of the block. Entry 0 is never hashed to
+  and collects blocks that did not fit in the table.*/
+#    define PROFILE_SIZE   (1 << 16)
+#    define PROFILE_MASK   (PROFILE_SIZE - 1)
+#    define PROFILE_REPORT 100
+
+codegen_profile_t *codegen_profile = NULL;
+
+static int profile_used;
+
+static const char *cause_names[CODEGEN_PROFILE_CAUSES] = {
+    [CODEGEN_PROFILE_SMC]         = "smc",
+    [CODEGEN_PROFILE_PAGE_EVICT]  = "page_evict",
+    [CODEGEN_PROFILE_DIRTY_EVICT] = "dirty_evict",
+    [CODEGEN_PROFILE_EVICT]       = "evict",
+    [CODEGEN_PROFILE_MEM]         = "mem",
+    [CODEGEN_PROFILE_ABORT]       = "abort"
+};
+
+void
+codegen_profile_init(void)
+{
+    if (codegen_profile == NULL) {
+        codegen_profile = (codegen_profile_t *) calloc(PROFILE_SIZE, sizeof(codegen_profile_t));
+        if (codegen_profile == NULL)
+            fatal("codegen_profile_init(): Unable to allocate the profile table\n");
+    }
+}
+
+static uint32_t
+profile_find(uint32_t phys, uint32_t pc)
+{
+    uint32_t hash = ((phys >> 2) ^ (pc << 3) ^ (pc >> 13)) & PROFILE_MASK;
+
+    /*Give up after a fixed number of probes rather than filling the table.*/
+    for (int c = 0; c < 64; c++) {
+        uint32_t           nr    = (hash + c) & PROFILE_MASK;
+        codegen_profile_t *entry = &codegen_profile[nr];
+
+        if (!nr)
+            continue;
+
+        if (!entry->creates) {
+            entry->phys = phys;
+            entry->pc   = pc;
+            profile_used++;
+            return nr;
+        }
+        if ((entry->phys == phys) && (entry->pc == pc))
+            return nr;
+    }
+
+    return 0;
+}
+
+void
+codegen_profile_create(codeblock_t *block)
+{
+    block->profile = profile_find(block->phys, block->pc);
+    codegen_profile[block->profile].creates++;
+}
+
+void
+codegen_profile_recompile(codeblock_t *block)
+{
+    codegen_profile_t *entry = &codegen_profile[block->profile];
+
+    entry->recompiles++;
+    entry->host_bytes = codegen_allocator_get_count(block->head_mem_block) * MEM_BLOCK_SIZE;
+}
+
+void
+codegen_profile_remove(codeblock_t *block, int cause)
+{
+    codegen_profile[block->profile].removed[cause]++;
+}
+
+static int
+profile_compare(const void *a, const void *b)
+{
+    const codegen_profile_t *pa = &codegen_profile[*(const uint32_t *) a];
+    const codegen_profile_t *pb = &codegen_profile[*(const uint32_t *) b];
+
+    if (pa->execs != pb->execs)
+        return (pa->execs < pb->execs) ? 1 : -1;
+
+    return (int) pb->recompiles - (int) pa->recompiles;
+}
+
+void
+codegen_profile_report(void)
+{
+    uint32_t *order;
+    uint64_t  execs                          = 0;
+    uint64_t  recompiles                     = 0;
+    uint64_t  removed[CODEGEN_PROFILE_CAUSES] = { 0 };
+    int       num                            = 0;
+
+    if (codegen_profile == NULL)
+        return;
+
+    order = (uint32_t *) malloc(PROFILE_SIZE * sizeof(uint32_t));
+    if (order == NULL)
+        return;
+
+    for (uint32_t c = 0; c < PROFILE_SIZE; c++) {
+        const codegen_profile_t *entry = &codegen_profile[c];
+
+        if (!entry->creates)
+            continue;
+
+        execs += entry->execs;
+        recompiles += entry->recompiles;
+        for (int d = 0; d < CODEGEN_PROFILE_CAUSES; d++)
+            removed[d] += entry->removed[d];
+        order[num++] = c;
+    }
+
+    qsort(order, num, sizeof(uint32_t), profile_compare);
+
+    pclog("Code block profile: %i start addresses, %" PRIu64 " executions, %" PRIu64 " recompiles\n",
+          profile_used, execs, recompiles);
+    for (int d = 0; d < CODEGEN_PROFILE_CAUSES; d++)
+        pclog("  Removed (%s): %" PRIu64 "\n", cause_names[d], removed[d]);
+    if (codegen_profile[0].creates)
+        pclog("  Untracked: %u blocks created, %" PRIu64 " executions\n",
+              codegen_profile[0].creates, codegen_profile[0].execs);
+
+    pclog("     phys       pc            execs  creates  recomps  bytes  smc pgev drty evct  mem abrt\n");
+    for (int c = 0; (c < num) && (c < PROFILE_REPORT); c++) {
+        const codegen_profile_t *entry = &codegen_profile[order[c]];
+
+        if (!order[c])
+            continue;
+
+        pclog(" %08x %08x %16" PRIu64 " %8u %8u %6u %4u %4u %4u %4u %4u %4u\n",
+              entry->phys, entry->pc, entry->execs, entry->creates, entry->recompiles, entry->host_bytes,
+              entry->removed[CODEGEN_PROFILE_SMC], entry->removed[CODEGEN_PROFILE_PAGE_EVICT],
+              entry->removed[CODEGEN_PROFILE_DIRTY_EVICT], entry->removed[CODEGEN_PROFILE_EVICT],
+              entry->removed[CODEGEN_PROFILE_MEM], entry->removed[CODEGEN_PROFILE_ABORT]);
+    }
+
+    free(order);
+}
+#endif
@@ -203,10 +203,11 @@ load_general(void)
         scale = 9;
     dpi_scale = ini_section_get_int(cat, "dpi_scale", 1);
 
-    enable_overscan  = !!ini_section_get_int(cat, "enable_overscan", 0);
-    vid_cga_contrast = !!ini_section_get_int(cat, "vid_cga_contrast", 0);
-    video_grayscale  = ini_section_get_int(cat, "video_grayscale", 0);
-    video_graytype   = ini_section_get_int(cat, "video_graytype", 0);
+    enable_overscan     = !!ini_section_get_int(cat, "enable_overscan", 0);
+    video_dirty_scanout = !!ini_section_get_int(cat, "video_dirty_scanout", 0);
+    vid_cga_contrast    = !!ini_section_get_int(cat, "vid_cga_contrast", 0);
+    video_grayscale     = ini_section_get_int(cat, "video_grayscale", 0);
+    video_graytype      = ini_section_get_int(cat, "video_graytype", 0);
 
     force_10ms = !!ini_section_get_int(cat, "force_10ms", 0);
 
@@ -500,6 +501,20 @@ load_machine(void)
         time_sync = TIME_SYNC_ENABLED;
 
     pit_mode = ini_section_get_int(cat, "pit_mode", -1);
+
+    mmu_tlb_size = ini_section_get_int(cat, "mmu_tlb_size", 1024);
+
+    dynarec_cache_size = ini_section_get_int(cat, "dynarec_cache_size", 0);
+
+    dynarec_compile_threshold = ini_section_get_int(cat, "dynarec_compile_threshold", 1);
+    if (dynarec_compile_threshold < 1)
+        dynarec_compile_threshold = 1;
+    else if (dynarec_compile_threshold > 255)
+        dynarec_compile_threshold = 255;
+
+    dynarec_compile_budget = ini_section_get_int(cat, "dynarec_compile_budget", 0);
+    if (dynarec_compile_budget < 0)
+        dynarec_compile_budget = 0;
 }
 
 /* Load "Video" section. */
@@ -1251,6 +1266,7 @@ load_hard_disks(void)
     uint32_t      max_tracks;
     uint32_t      board = 0;
     uint32_t      dev = 0;
+    int           cache;
 
     hdd_audio_load_profiles();
 
@@ -1327,6 +1343,11 @@ load_hard_disks(void)
         p = ini_section_get_string(cat, temp, "none");
         hdd[c].audio_profile = hdd_audio_get_profile_by_internal_name(p);
 
+        /* Memory-mapped image */
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        p                = ini_section_get_string(cat, temp, "off");
+        hdd[c].mmap_mode = hdd_mmap_get_from_internal_name(p);
+
         /* MFM/RLL */
         sprintf(temp, "hdd_%02i_mfm_channel", c + 1);
         if (hdd[c].bus_type == HDD_BUS_MFM)
@@ -1414,6 +1435,23 @@ load_hard_disks(void)
         sprintf(temp, "hdd_%02i_vhd_blocksize", c + 1);
         hdd[c].vhd_blocksize = ini_section_get_int(cat, temp, 0);
 
+        sprintf(temp, "hdd_%02i_vhd_cache", c + 1);
+        cache = ini_section_get_int(cat, temp, 0);
+        if (cache < 0)
+            cache = 0;
+        else if (cache > HDD_MAX_VHD_CACHE)
+            cache = HDD_MAX_VHD_CACHE;
+        hdd[c].vhd_cache = cache;
+
+        memset(hdd[c].overlay_fn, 0x00, sizeof(hdd[c].overlay_fn));
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        p = ini_section_get_string(cat, temp, "");
+        if ((p[0] != 0x00) && load_image_file(hdd[c].overlay_fn, p, NULL))
+            fatal("Configuration: Length of hdd_%02i_overlay is more than 511\n", c + 1);
+
+        sprintf(temp, "hdd_%02i_overlay_discard", c + 1);
+        hdd[c].overlay_discard = !!ini_section_get_int(cat, temp, 0);
+
         sprintf(temp, "hdd_%02i_vhd_parent", c + 1);
         p = ini_section_get_string(cat, temp, "");
         strncpy(hdd[c].vhd_parent, p, sizeof(hdd[c].vhd_parent) - 1);
@@ -1457,6 +1495,7 @@ load_floppy_and_cdrom_drives(void)
     unsigned int  dev = 0;
     int           c;
     int           d;
+    int           cache;
     int           count = cdrom_get_type_count();
     
 #ifndef DISABLE_FDD_AUDIO
@@ -1570,6 +1609,14 @@ load_floppy_and_cdrom_drives(void)
         sprintf(temp, "cdrom_%02i_no_check", c + 1);
         cdrom[c].no_check = ini_section_get_int(cat, temp, 0);
 
+        sprintf(temp, "cdrom_%02i_cache", c + 1);
+        cache = ini_section_get_int(cat, temp, 0);
+        if (cache < 0)
+            cache = 0;
+        else if (cache > CDROM_MAX_CACHE)
+            cache = CDROM_MAX_CACHE;
+        cdrom[c].cache_size = cache;
+
         sprintf(temp, "cdrom_%02i_type", c + 1);
         p = ini_section_get_string(cat, temp, cdrom[c].bus_type == CDROM_BUS_MKE ? "cr563" : "86cd");
         /* TODO: Configuration migration, remove when no longer needed. */
@@ -2472,6 +2519,11 @@ save_general(void)
     else
         ini_section_set_int(cat, "enable_overscan", enable_overscan);
 
+    if (video_dirty_scanout == 0)
+        ini_section_delete_var(cat, "video_dirty_scanout");
+    else
+        ini_section_set_int(cat, "video_dirty_scanout", video_dirty_scanout);
+
     if (vid_cga_contrast == 0)
         ini_section_delete_var(cat, "vid_cga_contrast");
     else
@@ -2680,6 +2732,26 @@ save_machine(void)
     else
         ini_section_set_int(cat, "pit_mode", pit_mode);
 
+    if (mmu_tlb_size == 1024)
+        ini_section_delete_var(cat, "mmu_tlb_size");
+    else
+        ini_section_set_int(cat, "mmu_tlb_size", mmu_tlb_size);
+
+    if (dynarec_cache_size == 0)
+        ini_section_delete_var(cat, "dynarec_cache_size");
+    else
+        ini_section_set_int(cat, "dynarec_cache_size", dynarec_cache_size);
+
+    if (dynarec_compile_threshold == 1)
+        ini_section_delete_var(cat, "dynarec_compile_threshold");
+    else
+        ini_section_set_int(cat, "dynarec_compile_threshold", dynarec_compile_threshold);
+
+    if (dynarec_compile_budget == 0)
+        ini_section_delete_var(cat, "dynarec_compile_budget");
+    else
+        ini_section_set_int(cat, "dynarec_compile_budget", dynarec_compile_budget);
+
     ini_delete_section_if_empty(config, cat);
 }
 
@@ -3477,6 +3549,30 @@ save_hard_disks(void)
             else
                 ini_section_delete_var(cat, temp);
         }
+
+        sprintf(temp, "hdd_%02i_mmap", c + 1);
+        if (!hdd_is_valid(c) || (hdd[c].mmap_mode == HDD_MMAP_OFF))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_string(cat, temp, hdd_mmap_get_internal_name(hdd[c].mmap_mode));
+
+        sprintf(temp, "hdd_%02i_vhd_cache", c + 1);
+        if (!hdd_is_valid(c) || (hdd[c].vhd_cache == 0))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, hdd[c].vhd_cache);
+
+        sprintf(temp, "hdd_%02i_overlay", c + 1);
+        if (hdd_is_valid(c) && hdd[c].overlay_fn[0])
+            save_image_file(cat, temp, hdd[c].overlay_fn);
+        else
+            ini_section_delete_var(cat, temp);
+
+        sprintf(temp, "hdd_%02i_overlay_discard", c + 1);
+        if (hdd_is_valid(c) && hdd[c].overlay_fn[0] && hdd[c].overlay_discard)
+            ini_section_set_int(cat, temp, 1);
+        else
+            ini_section_delete_var(cat, temp);
     }
 
     ini_delete_section_if_empty(config, cat);
@@ -3557,6 +3653,12 @@ save_floppy_and_cdrom_drives(void)
         else
             ini_section_delete_var(cat, temp);
 
+        sprintf(temp, "cdrom_%02i_cache", c + 1);
+        if ((cdrom[c].bus_type == 0) || (cdrom[c].cache_size == 0))
+            ini_section_delete_var(cat, temp);
+        else
+            ini_section_set_int(cat, temp, cdrom[c].cache_size);
+
         sprintf(temp, "cdrom_%02i_speed", c + 1);
         if ((cdrom[c].bus_type == 0) || (cdrom[c].speed == 8))
             ini_section_delete_var(cat, temp);
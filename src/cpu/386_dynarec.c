@@ -387,6 +387,54 @@ block_ended:
     cpu_end_block_after_ins = 0;
 }
 
+#    ifdef USE_NEW_DYNAREC
+/* Blocks that may still be compiled in this call to exec386_dynarec(), when
+   dynarec_compile_budget is set. Spreads the compilation of a burst of new
+   code over several slices rather than stalling in one. */
+static int compile_budget = 0;
+#    endif
+
+#    if defined(USE_NEW_DYNAREC) && !defined(USE_GDBSTUB)
+/* Last compiled block executed, to be linked to the next one. */
+static uint16_t link_prev     = BLOCK_INVALID;
+static uint32_t link_prev_gen = 0;
+
+/* Return the block linked from the one just executed if it can be run
+   straight away, without going through the hash lookup and back through
+   exec386_dynarec(): nothing may need the attention of the dispatcher
+   loop, and the block must still be compiled and valid for the current
+   state. The MMU mappings have not changed since the link was made, so
+   the physical address checks done when the block was entered through
+   the hash lookup still hold. */
+static __inline codeblock_t *
+exec386_dynarec_link(const codeblock_t *block)
+{
+    codeblock_t *next;
+
+    if (cpu_state.abrt || (cycles <= 0) || new_ne || smi_line || cpu_init || x86_was_reset ||
+        (nmi && nmi_enable && nmi_mask) || ((cpu_state.flags & I_FLAG) && pic.int_pending) ||
+        (cpu_state.flags & T_FLAG) || trap || cpu_end_block_after_ins ||
+        cpu_force_interpreter || cpu_override_dynarec || !CACHE_ON() ||
+        TIMER_VAL_LESS_THAN_VAL(timer_target, tsc + (uint64_t) (cycles_old - cycles)))
+        return NULL;
+
+    if ((block->link == BLOCK_INVALID) || (block->link_gen != codegen_link_gen))
+        return NULL;
+
+    next = &codeblock[block->link];
+
+    if ((next->pc != cs + cpu_state.pc) || (next->_cs != cs) ||
+        ((next->status ^ cpu_cur_status) & CPU_STATUS_FLAGS) ||
+        ((next->status & cpu_cur_status & CPU_STATUS_MASK) != (cpu_cur_status & CPU_STATUS_MASK)) ||
+        ((next->flags & (CODEBLOCK_WAS_RECOMPILED | CODEBLOCK_IN_DIRTY_LIST)) != CODEBLOCK_WAS_RECOMPILED) ||
+        (next->page_mask & *next->dirty_mask) || (next->page_mask2 & *next->dirty_mask2) ||
+        ((next->flags & CODEBLOCK_STATIC_TOP) && (next->TOP != (cpu_state.TOP & 7))))
+        return NULL;
+
+    return next;
+}
+#    endif
+
 #if defined(__linux__) && !defined(__clang__) && defined(USE_NEW_DYNAREC)
 static inline void __attribute__((optimize("O2")))
 #else
@@ -403,6 +451,11 @@ exec386_dynarec_dyn(void)
     codeblock_t *block = codeblock_hash[hash];
 #    endif
     int valid_block = 0;
+#    if defined(USE_NEW_DYNAREC) && !defined(USE_GDBSTUB)
+    uint16_t prev = link_prev;
+
+    link_prev = BLOCK_INVALID;
+#    endif
 
 #    ifdef USE_NEW_DYNAREC
     if (!cpu_state.abrt)
@@ -519,9 +572,21 @@ exec386_dynarec_dyn(void)
 #    endif
     {
         void (*code)(void) = (void *) &block->data[BLOCK_START];
+#    if defined(USE_NEW_DYNAREC) && !defined(USE_GDBSTUB)
+        codeblock_t *next;
+#    endif
 
 #    ifndef USE_NEW_DYNAREC
         codeblock_hash[hash] = block;
+#    else
+#        ifndef USE_GDBSTUB
+        if ((prev != BLOCK_INVALID) && (link_prev_gen == codegen_link_gen)) {
+            codeblock[prev].link     = get_block_nr(block);
+            codeblock[prev].link_gen = codegen_link_gen;
+        }
+#        endif
+        block->flags |= CODEBLOCK_REFERENCED;
+        codegen_profile_exec(block);
 #    endif
         inrecomp = 1;
         code();
@@ -533,11 +598,43 @@ exec386_dynarec_dyn(void)
 #    ifndef USE_NEW_DYNAREC
         if (!use32)
             cpu_state.pc &= 0xffff;
+#    elif !defined(USE_GDBSTUB)
+        /* Follow the block links for as long as possible. */
+        while ((next = exec386_dynarec_link(block)) != NULL) {
+            block = next;
+            block->flags |= CODEBLOCK_REFERENCED;
+            codegen_profile_exec(block);
+
+            code     = (void *) &block->data[BLOCK_START];
+            inrecomp = 1;
+            code();
+#        ifdef USE_ACYCS
+            acycs = 0;
+#        endif
+            inrecomp = 0;
+        }
+
+        if (!cpu_state.abrt) {
+            link_prev     = get_block_nr(block);
+            link_prev_gen = codegen_link_gen;
+        }
 #    endif
-    } else if (valid_block && !cpu_state.abrt) {
+    }
+#    ifdef USE_NEW_DYNAREC
+    else if (valid_block && !cpu_state.abrt && ((block->interp_count < dynarec_compile_threshold) || (dynarec_compile_budget && (compile_budget <= 0)))) {
+        /* Block is not hot enough yet, or the compile budget for this slice
+           has been used up. Interpret it, and compile it on a later run. */
+        if (block->interp_count < dynarec_compile_threshold)
+            block->interp_count++;
+        exec386_dynarec_int();
+    }
+#    endif
+    else if (valid_block && !cpu_state.abrt) {
 #    ifdef USE_NEW_DYNAREC
         start_pc                 = cs + cpu_state.pc;
         const int max_block_size = (block->flags & CODEBLOCK_BYTE_MASK) ? ((128 - 25) - (start_pc & 0x3f)) : 1000;
+
+        compile_budget--;
 #    else
         start_pc = cpu_state.pc;
 #    endif
@@ -758,6 +855,9 @@ exec386_dynarec(int32_t cycs)
 
 #    ifdef USE_ACYCS
     acycs = 0;
+#    endif
+#    ifdef USE_NEW_DYNAREC
+    compile_budget = force_10ms ? (dynarec_compile_budget * 10) : dynarec_compile_budget;
 #    endif
     cycles_main += cycs;
     while (cycles_main > 0) {
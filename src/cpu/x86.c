@@ -14,6 +14,7 @@
  *          Copyright 2015-2020 Andrew Jenner.
  *          Copyright 2016-2020 Miran Grca.
  */
+#include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -144,6 +145,13 @@ dumpregs(int force)
                 AX, BX, CX, DX, DI, SI, BP, SP);
     }
     x86_log("Entries in readlookup : %i    writelookup : %i\n", readlnum, writelnum);
+    for (int c = 0; c < 2; c++) {
+        mem_tlb_stats_t tlb;
+
+        mem_tlb_get_stats(c, &tlb);
+        x86_log("%s TLB: %u/%u entries, %u-way, %" PRIu64 " misses, %" PRIu64 " evictions, %" PRIu64 " flushes\n",
+                c ? "Write" : "Read", tlb.used, tlb.entries, tlb.ways, tlb.misses, tlb.evictions, tlb.flushes);
+    }
     x87_dumpregs();
     indump = 0;
 }
@@ -53,11 +53,10 @@
 #include <86box/mem.h>
 #include <86box/plat.h>
 #include <86box/rom.h>
+#include <86box/snapshot.h>
 #include <86box/sound.h>
 #include <86box/ui.h>
 
-#define DEVICE_MAX 256 /* max # of devices */
-
 static device_t        *devices[DEVICE_MAX];
 static void            *device_priv[DEVICE_MAX];
 static device_context_t device_current;
@@ -638,6 +637,70 @@ device_force_redraw(void)
     }
 }
 
+void
+device_save_all(struct snapshot_t *snap)
+{
+    for (uint16_t c = 0; c < DEVICE_MAX; c++) {
+        if (devices[c] == NULL)
+            continue;
+
+        if (devices[c]->save != NULL) {
+            snapshot_begin_section(snap, "DEV ", devices[c]->internal_name, c);
+            devices[c]->save(device_priv[c], snap);
+            snapshot_end_section(snap);
+        }
+    }
+}
+
+int
+device_snapshot_supported(void)
+{
+    int ret = 1;
+
+    for (uint16_t c = 0; c < DEVICE_MAX; c++) {
+        if ((devices[c] != NULL) && ((devices[c]->save == NULL) || (devices[c]->load == NULL)) &&
+            !(devices[c]->flags & DEVICE_STATELESS)) {
+            pclog("DEVICE: '%s' does not support snapshots\n", devices[c]->name);
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+int
+device_check_snapshot(const uint8_t *present)
+{
+    int ret = 1;
+
+    for (uint16_t c = 0; c < DEVICE_MAX; c++) {
+        if ((devices[c] != NULL) && (devices[c]->load != NULL) && !present[c]) {
+            pclog("DEVICE: Snapshot has no state for device '%s' in slot %u\n", devices[c]->name, c);
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+int
+device_load(struct snapshot_t *snap, const char *internal_name, uint32_t instance)
+{
+    /* Devices are matched by slot, which is stable for a given configuration. */
+    if ((instance >= DEVICE_MAX) || (devices[instance] == NULL) ||
+        (devices[instance]->internal_name == NULL) || strcmp(devices[instance]->internal_name, internal_name)) {
+        pclog("DEVICE: Snapshot has state for missing device '%s' in slot %u\n", internal_name, instance);
+        return 0;
+    }
+
+    if (devices[instance]->load == NULL) {
+        pclog("DEVICE: '%s' is stateless, skipping its snapshot state\n", devices[instance]->name);
+        return 1;
+    }
+
+    return devices[instance]->load(device_priv[instance], snap);
+}
+
 int
 device_get_instance(void)
 {
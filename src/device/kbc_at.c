@@ -14,6 +14,7 @@
  *          Copyright 2023-2025 Miran Grca.
  *          Copyright 2023-2025 EngiNerd.
  */
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -38,6 +39,7 @@
 #include <86box/fdc.h>
 #include <86box/pci.h>
 #include <86box/keyboard.h>
+#include <86box/snapshot.h>
 
 #define STAT_PARITY        0x80
 #define STAT_RTIMEOUT      0x40
@@ -2866,6 +2868,55 @@ kbc_at_set_irq(int num, uint16_t irq, void *priv)
     dev->irq[num] = irq;
 }
 
+static void
+kbc_at_save(void *priv, struct snapshot_t *snap)
+{
+    atkbc_t *dev = (atkbc_t *) priv;
+
+    snapshot_write(snap, dev, offsetof(atkbc_t, handler_enable));
+    snapshot_write_var(snap, dev->handler_enable);
+    snapshot_write_var(snap, dev->base_addr);
+    snapshot_write_var(snap, dev->irq);
+
+    /* The attached devices save their own state, only the port latches live here. */
+    for (int i = 0; i < 2; i++) {
+        if (kbc_at_ports[i] != NULL) {
+            snapshot_write_var(snap, kbc_at_ports[i]->wantcmd);
+            snapshot_write_var(snap, kbc_at_ports[i]->dat);
+            snapshot_write_var(snap, kbc_at_ports[i]->out_new);
+        }
+    }
+
+    snapshot_write_timer(snap, &dev->kbc_poll_timer);
+    snapshot_write_timer(snap, &dev->kbc_dev_poll_timer);
+    snapshot_write_timer(snap, &dev->pulse_cb);
+}
+
+static int
+kbc_at_load(void *priv, struct snapshot_t *snap)
+{
+    atkbc_t *dev = (atkbc_t *) priv;
+    uint8_t  handler_enable[2];
+    uint16_t base_addr[2];
+
+    if (!snapshot_read(snap, dev, offsetof(atkbc_t, handler_enable)) || !snapshot_read_var(snap, handler_enable) ||
+        !snapshot_read_var(snap, base_addr) || !snapshot_read_var(snap, dev->irq))
+        return 0;
+
+    for (int i = 0; i < 2; i++)
+        kbc_at_port_handler(i, handler_enable[i], base_addr[i], dev);
+
+    for (int i = 0; i < 2; i++) {
+        if ((kbc_at_ports[i] != NULL) &&
+            (!snapshot_read_var(snap, kbc_at_ports[i]->wantcmd) || !snapshot_read_var(snap, kbc_at_ports[i]->dat) ||
+             !snapshot_read_var(snap, kbc_at_ports[i]->out_new)))
+            return 0;
+    }
+
+    return snapshot_read_timer(snap, &dev->kbc_poll_timer) && snapshot_read_timer(snap, &dev->kbc_dev_poll_timer) &&
+           snapshot_read_timer(snap, &dev->pulse_cb);
+}
+
 static void *
 kbc_at_init(const device_t *info)
 {
@@ -3040,5 +3091,7 @@ const device_t kbc_at_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = kbc_at_save,
+    .load          = kbc_at_load
 };
@@ -116,6 +116,8 @@ hdc_reset(void)
 {
     hdc_onboard_enabled = 1;
 
+    hdd_image_reset();
+
     for (int i = 0; i < HDC_MAX; i++) {
         hdc_log("HDC %i: reset(current=%d, internal=%d)\n", i,
                 hdc_current[i], hdc_current[i] == HDC_INTERNAL);
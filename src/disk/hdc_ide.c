@@ -96,6 +96,7 @@
 #define WIN_SETIDLE1                   0xe3
 #define WIN_CHECKPOWERMODE1            0xe5
 #define WIN_SLEEP1                     0xe6
+#define WIN_FLUSH_CACHE                0xe7
 #define WIN_IDENTIFY                   0xec /* Ask drive to identify itself */
 #define WIN_SET_FEATURES               0xef
 #define WIN_READ_NATIVE_MAX            0xf8
@@ -995,6 +996,39 @@ ide_set_callback(ide_t *ide, double callback)
         timer_on_auto(&ide->timer, callback);
 }
 
+/* Runs an image transfer on the image's I/O thread so the emulation does not
+   stall on the host, polling for its completion from the callback timer.
+   Returns 1 while the transfer is in flight, in which case the callback has
+   been re-armed and the caller has to return. */
+static int
+ide_image_io(ide_t *ide, int op, uint32_t sector, uint32_t count, uint8_t *buffer, int *ret)
+{
+    if (!ide->aio_pending) {
+        hdd_image_aio_submit(ide->hdd_num, op, sector, count, buffer);
+        ide->aio_pending = 1;
+    }
+
+    if (hdd_image_aio_busy(ide->hdd_num)) {
+        ide_set_callback(ide, IDE_TIME);
+        return 1;
+    }
+
+    ide->aio_pending = 0;
+    *ret             = hdd_image_aio_result(ide->hdd_num);
+
+    return 0;
+}
+
+static void
+ide_image_io_cancel(ide_t *ide)
+{
+    if (ide->aio_pending) {
+        hdd_image_aio_wait(ide->hdd_num);
+        (void) hdd_image_aio_result(ide->hdd_num);
+        ide->aio_pending = 0;
+    }
+}
+
 void
 ide_set_board_callback(uint8_t board, double callback)
 {
@@ -1725,6 +1759,7 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                 break;
 
             ide_irq_lower(ide);
+            ide_image_io_cancel(ide);
             ide->command = val;
 
             ide->tf->error = 0;
@@ -1919,6 +1954,7 @@ ide_writeb(uint16_t addr, uint8_t val, void *priv)
                 case WIN_SETIDLE1:          /* Idle */
                 case WIN_CHECKPOWERMODE1:
                 case WIN_SLEEP1:
+                case WIN_FLUSH_CACHE:
                     ide->tf->atastat = BSY_STAT;
                     ide_callback(ide);
                     break;
@@ -2277,6 +2313,7 @@ ide_callback(void *priv)
     const ide_bm_t *bm  = ide_boards[ide->board]->bm;
     int             chk_chs;
     int             ret;
+    uint8_t        *data;
     uint8_t         err = 0x00;
 
     ide_log("ide_callback(%i): %02X\n", ide->channel, ide->command);
@@ -2347,6 +2384,16 @@ ide_callback(void *priv)
             ide_irq_raise(ide);
             break;
 
+        case WIN_FLUSH_CACHE:
+            if (ide->type == IDE_ATAPI)
+                err = ABRT_ERR;
+            else {
+                hdd_image_flush(ide->hdd_num);
+                ide->tf->atastat = DRDY_STAT | DSC_STAT;
+                ide_irq_raise(ide);
+            }
+            break;
+
         case WIN_READ:
         case WIN_READ_NORETRY:
             ide_log("IDE(%d) read(%d,%d,%d)\n", ide->channel, ide->tf->cylinder, ide->tf->head, ide->tf->sector);
@@ -2357,10 +2404,11 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 if (ide->do_initial_read) {
+                    if (ide_image_io(ide, HDD_AIO_READ, ide_get_sector(ide),
+                                     ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer, &ret))
+                        return;
                     ide->do_initial_read = 0;
                     ide->sector_pos      = 0;
-                    ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
-                                         ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
                 } else
                     ret = 0;
 
@@ -2398,12 +2446,24 @@ ide_callback(void *priv)
 
                 ide->tf->pos = 0;
 
-                if (hdd_image_read(ide->hdd_num, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer) < 0) {
+                /* A memory-mapped image is transferred straight from the mapping,
+                   otherwise it is read only once, the DMA may have to be retried. */
+                ret  = 0;
+                data = ide->aio_pending ? NULL : hdd_image_map_range(ide->hdd_num, ide_get_sector(ide), ide->sector_pos);
+                if (data == NULL) {
+                    data = ide->sector_buffer;
+                    if (ide->do_initial_read &&
+                        ide_image_io(ide, HDD_AIO_READ, ide_get_sector(ide), ide->sector_pos, ide->sector_buffer, &ret))
+                        return;
+                }
+                ide->do_initial_read = 0;
+
+                if (ret < 0) {
                     ide_log("IDE %i: DMA read aborted (image read error)\n", ide->channel);
                     err = UNC_ERR;
                 } else if (!ide_boards[ide->board]->force_ata3 && bm->dma) {
                     /* We should not abort - we should simply wait for the host to start DMA. */
-                    ret = bm->dma(ide->sector_buffer, ide->sector_pos * 512, 0, 0, bm->priv);
+                    ret = bm->dma(data, ide->sector_pos * 512, 0, 0, bm->priv);
                     if (ret == 2) {
                         /* Bus master DMA disabled, simply wait for the host to enable DMA. */
                         ide->tf->atastat = DRQ_STAT | DRDY_STAT | DSC_STAT;
@@ -2442,10 +2502,11 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 if (ide->do_initial_read) {
+                    if (ide_image_io(ide, HDD_AIO_READ, ide_get_sector(ide),
+                                     ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer, &ret))
+                        return;
                     ide->do_initial_read = 0;
                     ide->sector_pos      = 0;
-                    ret = hdd_image_read(ide->hdd_num, ide_get_sector(ide),
-                                         ide->tf->secount ? ide->tf->secount : 256, ide->sector_buffer);
                 } else {
                     ret = 0;
                 }
@@ -2479,7 +2540,8 @@ ide_callback(void *priv)
                 err = IDNF_ERR;
             else {
                 ui_sb_update_icon_write(SB_HDD | hdd[ide->hdd_num].bus_type, 1);
-                ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide), 1, (uint8_t *) ide->buffer);
+                if (ide_image_io(ide, HDD_AIO_WRITE, ide_get_sector(ide), 1, (uint8_t *) ide->buffer, &ret))
+                    return;
                 ide_irq_raise(ide);
                 ide->tf->secount--;
                 if (ide->tf->secount) {
@@ -2510,7 +2572,13 @@ ide_callback(void *priv)
                     else
                         ide->sector_pos = 256;
 
-                    ret = bm->dma(ide->sector_buffer, ide->sector_pos * 512, 0, 1, bm->priv);
+                    /* A memory-mapped image is written straight into the mapping.
+                       Once the data is in, only the image write is being waited on. */
+                    data = ide->aio_pending ? NULL : hdd_image_map_range(ide->hdd_num, ide_get_sector(ide), ide->sector_pos);
+                    if (ide->aio_pending)
+                        ret = 1;
+                    else
+                        ret = bm->dma(data ? data : ide->sector_buffer, ide->sector_pos * 512, 0, 1, bm->priv);
 
                     if (ret == 2) {
                         /* Bus master DMA disabled, simply wait for the host to enable DMA. */
@@ -2520,8 +2588,12 @@ ide_callback(void *priv)
                     } else if (ret & 1) {
                         /* DMA successful */
                         ui_sb_update_icon_write(SB_HDD | hdd[ide->hdd_num].bus_type, 1);
-                        ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide),
-                                              ide->sector_pos, ide->sector_buffer);
+                        if (data != NULL) {
+                            hdd_image_map_written(ide->hdd_num, ide_get_sector(ide), ide->sector_pos);
+                            ret = 0;
+                        } else if (ide_image_io(ide, HDD_AIO_WRITE, ide_get_sector(ide),
+                                                ide->sector_pos, ide->sector_buffer, &ret))
+                            return;
 
                         ide_log("IDE %i: DMA write %ssuccessful\n", ide->channel, (ret < 0) ? "un" : "");
 
@@ -2554,7 +2626,8 @@ ide_callback(void *priv)
             else if (!ide->tf->lba && (ide->cfg_spt == 0))
                 err = IDNF_ERR;
             else {
-                ret = hdd_image_write(ide->hdd_num, ide_get_sector(ide), 1, (uint8_t *) ide->buffer);
+                if (ide_image_io(ide, HDD_AIO_WRITE, ide_get_sector(ide), 1, (uint8_t *) ide->buffer, &ret))
+                    return;
                 ide->blockcount++;
                 if (ide->blockcount >= ide->blocksize || ide->tf->secount == 1) {
                     ide->blockcount = 0;
@@ -2865,6 +2938,8 @@ ide_board_close(int board)
                 dev->tf = NULL;
             }
 
+            ide_image_io_cancel(dev);
+
             if (dev->buffer) {
                 free(dev->buffer);
                 dev->buffer = NULL;
@@ -3238,6 +3313,8 @@ ide_drive_reset(int d)
 
     ide_set_signature(ide_drives[d]);
 
+    ide_image_io_cancel(ide_drives[d]);
+
     if (ide_drives[d]->sector_buffer)
         memset(ide_drives[d]->sector_buffer, 0, 256 * 512);
 
@@ -611,6 +611,33 @@ hdd_preset_get_from_internal_name(char *s)
     return 0;
 }
 
+static const char *hdd_mmap_names[] = {
+    [HDD_MMAP_OFF]   = "off",
+    [HDD_MMAP_CLOSE] = "close",
+    [HDD_MMAP_ASYNC] = "async",
+    [HDD_MMAP_SYNC]  = "sync"
+};
+
+const char *
+hdd_mmap_get_internal_name(int mode)
+{
+    if ((mode < 0) || (mode >= (sizeof(hdd_mmap_names) / sizeof(hdd_mmap_names[0]))))
+        return hdd_mmap_names[HDD_MMAP_OFF];
+
+    return hdd_mmap_names[mode];
+}
+
+int
+hdd_mmap_get_from_internal_name(const char *s)
+{
+    for (int i = 0; i < (sizeof(hdd_mmap_names) / sizeof(hdd_mmap_names[0])); i++) {
+        if (!strcmp(hdd_mmap_names[i], s))
+            return i;
+    }
+
+    return HDD_MMAP_OFF;
+}
+
 void
 hdd_preset_apply(int hdd_id)
 {
@@ -18,20 +18,28 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <wchar.h>
 #include <errno.h>
-#ifdef __unix__
-#include <unistd.h>
+#ifdef _WIN32
+#    include <windows.h>
+#    include <io.h>
+#else
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
 #endif
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/random.h>
+#include <86box/thread.h>
+#include <86box/timer.h>
 #include <86box/hdd.h>
 #include "minivhd/minivhd.h"
 #include "minivhd/internal.h"
@@ -41,6 +49,28 @@
 #define HDD_IMAGE_HDX 2
 #define HDD_IMAGE_VHD 3
 
+/* Copy-on-write delta: a header sector, the index with one 32-bit entry per
+   chunk of the image (the chunk's position in the delta plus one, 0 while it
+   is still on the base image), then the chunks in the order they were first
+   written. */
+#define HDD_OVERLAY_MAGIC   "86BoxOVL"
+#define HDD_OVERLAY_VERSION 1
+#define HDD_OVERLAY_CHUNK   128 /* sectors */
+#define HDD_OVERLAY_INDEX   512
+
+typedef struct hdd_overlay_header_t {
+    char     magic[8];
+    uint32_t version;
+    uint32_t chunk_sectors;
+    uint64_t sectors; /* of the image */
+    uint32_t chunks;
+    uint32_t pad;
+} hdd_overlay_header_t;
+
+#define HDD_AIO_IDLE   0
+#define HDD_AIO_QUEUED 1
+#define HDD_AIO_DONE   2
+
 typedef struct hdd_image_t {
     FILE     *file; /* Used for HDD_IMAGE_RAW, HDD_IMAGE_HDI, and HDD_IMAGE_HDX. */
     MVHDMeta *vhd;  /* Used for HDD_IMAGE_VHD. */
@@ -49,10 +79,43 @@ typedef struct hdd_image_t {
     uint32_t  last_sector;
     uint8_t   type; /* HDD_IMAGE_RAW, HDD_IMAGE_HDI, HDD_IMAGE_HDX, or HDD_IMAGE_VHD */
     uint8_t   loaded;
+
+    /* Mapping of the whole file, if the image is memory-mapped. */
+    uint8_t  *map;
+    uint64_t  map_size;
+#ifdef _WIN32
+    HANDLE    map_handle;
+#endif
+
+    /* Copy-on-write delta, if the image has an overlay. */
+    FILE     *ovl_file;
+    uint32_t *ovl_index;
+    uint32_t  ovl_chunks;
+    uint32_t  ovl_used;
+    uint64_t  ovl_data;
+    uint8_t  *ovl_buffer; /* one chunk */
+    char     *ovl_fn;     /* kept to delete a discarded delta */
+
+    /* Asynchronous request, see hdd_image_aio_submit(). */
+    thread_t  *aio_thread;
+    event_t   *aio_wake;
+    event_t   *aio_done;
+    ATOMIC_INT aio_state;
+    ATOMIC_INT aio_ret;
+    int        aio_run;
+    int        aio_op;
+    uint32_t   aio_sector;
+    uint32_t   aio_count;
+    uint8_t   *aio_buffer;
 } hdd_image_t;
 
 hdd_image_t hdd_images[HDD_NUM];
 
+/* Deferred VHD metadata is written back at least this often, in us. */
+#define HDD_IMAGE_FLUSH_PERIOD 5000000.0
+
+static pc_timer_t hdd_image_flush_timer;
+
 static char  empty_sector[512];
 #ifndef __unix__
 static char *empty_sector_1mb;
@@ -241,6 +304,361 @@ prepare_new_hard_disk(uint8_t id, uint64_t full_size)
     return 1;
 }
 
+static void
+hdd_image_map_flush(uint8_t id, uint64_t offset, uint64_t length, int wait)
+{
+    hdd_image_t *img = &hdd_images[id];
+#ifdef _WIN32
+    FlushViewOfFile(img->map + offset, (SIZE_T) length);
+    if (wait)
+        FlushFileBuffers((HANDLE) _get_osfhandle(fileno(img->file)));
+#else
+    uint64_t page = (uint64_t) sysconf(_SC_PAGESIZE);
+
+    /* msync() wants a page aligned address. */
+    length += offset & (page - 1);
+    offset &= ~(page - 1);
+    msync(img->map + offset, (size_t) length, wait ? MS_SYNC : MS_ASYNC);
+#endif
+}
+
+#ifndef _WIN32
+/* A guest write through the mapping into a hole that the host can not
+   allocate raises SIGBUS instead of an I/O error, so sparse files are not
+   mapped. */
+static int
+hdd_image_map_is_sparse(uint8_t id, uint64_t size)
+{
+    struct stat st;
+
+    if (fstat(fileno(hdd_images[id].file), &st) == -1)
+        return 1;
+
+    return ((uint64_t) st.st_blocks << 9) < size;
+}
+#endif
+
+/* Maps the whole file of a raw, HDI or HDX image if the disk asks for it;
+   the image stays on stdio if that fails. */
+static void
+hdd_image_map_open(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint64_t     size;
+
+    if ((hdd[id].mmap_mode == HDD_MMAP_OFF) || (img->file == NULL) || (img->map != NULL))
+        return;
+
+    /* The base of an overlay is read-only. */
+    if (img->ovl_file != NULL)
+        return;
+
+    if (fseeko64(img->file, 0, SEEK_END) == -1)
+        return;
+    size = ftello64(img->file);
+    if ((size == 0) || (size != (size_t) size))
+        return;
+
+#ifndef _WIN32
+    if (hdd_image_map_is_sparse(id, size)) {
+        pclog("Hard disk image %i: Not memory-mapping '%s', it is sparse; using stdio\n", id, hdd[id].fn);
+        return;
+    }
+#endif
+
+#ifdef _WIN32
+    img->map_handle = CreateFileMapping((HANDLE) _get_osfhandle(fileno(img->file)), NULL, PAGE_READWRITE,
+                                        (DWORD) (size >> 32), (DWORD) size, NULL);
+    if (img->map_handle != NULL) {
+        img->map = (uint8_t *) MapViewOfFile(img->map_handle, FILE_MAP_WRITE, 0, 0, (SIZE_T) size);
+        if (img->map == NULL) {
+            CloseHandle(img->map_handle);
+            img->map_handle = NULL;
+        }
+    }
+#else
+    img->map = (uint8_t *) mmap(NULL, (size_t) size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(img->file), 0);
+    if (img->map == (uint8_t *) MAP_FAILED)
+        img->map = NULL;
+#endif
+
+    if (img->map == NULL) {
+        hdd_image_log("Hard disk image %i: Unable to map %" PRIu64 " bytes, using stdio\n", id, size);
+        return;
+    }
+
+    img->map_size = size;
+    hdd_image_log("Hard disk image %i: Mapped %" PRIu64 " bytes\n", id, size);
+}
+
+static void
+hdd_image_map_close(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->map == NULL)
+        return;
+
+    hdd_image_map_flush(id, 0, img->map_size, 1);
+
+#ifdef _WIN32
+    UnmapViewOfFile(img->map);
+    CloseHandle(img->map_handle);
+    img->map_handle = NULL;
+#else
+    munmap(img->map, (size_t) img->map_size);
+#endif
+    img->map      = NULL;
+    img->map_size = 0;
+}
+
+/* Returns the mapping of the given sectors, or NULL if they are not all in it. */
+static uint8_t *
+hdd_image_map_get(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_t *img    = &hdd_images[id];
+    uint64_t     offset = ((uint64_t) sector << 9) + img->base;
+
+    if ((img->map == NULL) || ((offset + ((uint64_t) count << 9)) > img->map_size))
+        return NULL;
+
+    return img->map + offset;
+}
+
+static uint64_t
+hdd_image_overlay_offset(uint8_t id, uint32_t slot, uint32_t sector)
+{
+    return hdd_images[id].ovl_data + ((uint64_t) (slot - 1) * (HDD_OVERLAY_CHUNK << 9)) +
+           ((uint64_t) (sector % HDD_OVERLAY_CHUNK) << 9);
+}
+
+/* Opens the copy-on-write delta of an image whose file has been opened
+   read-only, creating it if it does not exist yet or is to be discarded. */
+static int
+hdd_image_overlay_open(uint8_t id)
+{
+    hdd_image_t         *img     = &hdd_images[id];
+    uint32_t             sectors = img->last_sector + 1;
+    hdd_overlay_header_t hdr;
+    char                *fn      = hdd[id].overlay_fn;
+
+    path_normalize(fn);
+
+    img->ovl_chunks = (sectors + HDD_OVERLAY_CHUNK - 1) / HDD_OVERLAY_CHUNK;
+    img->ovl_data   = (HDD_OVERLAY_INDEX + ((uint64_t) img->ovl_chunks << 2) + 4095) & ~4095ULL;
+    img->ovl_index  = (uint32_t *) calloc(img->ovl_chunks, sizeof(uint32_t));
+    img->ovl_buffer = (uint8_t *) malloc(HDD_OVERLAY_CHUNK << 9);
+    img->ovl_fn     = strdup(fn);
+    img->ovl_used   = 0;
+
+    img->ovl_file = hdd[id].overlay_discard ? NULL : plat_fopen(fn, "rb+");
+    if (img->ovl_file != NULL) {
+        if ((fread(&hdr, 1, sizeof(hdr), img->ovl_file) != sizeof(hdr)) || memcmp(hdr.magic, HDD_OVERLAY_MAGIC, 8) ||
+            (hdr.version != HDD_OVERLAY_VERSION) || (hdr.chunk_sectors != HDD_OVERLAY_CHUNK)) {
+            hdd_image_log("Hard disk image %i: '%s' is not an overlay\n", id, fn);
+            return 0;
+        }
+        if ((hdr.sectors != sectors) || (hdr.chunks != img->ovl_chunks)) {
+            hdd_image_log("Hard disk image %i: Overlay '%s' is of a %" PRIu64 "-sector image, not %" PRIu32 "\n",
+                          id, fn, hdr.sectors, sectors);
+            return 0;
+        }
+        if ((fseeko64(img->ovl_file, HDD_OVERLAY_INDEX, SEEK_SET) == -1) ||
+            (fread(img->ovl_index, sizeof(uint32_t), img->ovl_chunks, img->ovl_file) != img->ovl_chunks))
+            return 0;
+
+        for (uint32_t i = 0; i < img->ovl_chunks; i++) {
+            if (img->ovl_index[i] > img->ovl_used)
+                img->ovl_used = img->ovl_index[i];
+        }
+    } else {
+        img->ovl_file = plat_fopen(fn, "wb+");
+        if (img->ovl_file == NULL)
+            return 0;
+
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(hdr.magic, HDD_OVERLAY_MAGIC, 8);
+        hdr.version       = HDD_OVERLAY_VERSION;
+        hdr.chunk_sectors = HDD_OVERLAY_CHUNK;
+        hdr.sectors       = sectors;
+        hdr.chunks        = img->ovl_chunks;
+
+        memset(img->ovl_buffer, 0, HDD_OVERLAY_INDEX);
+        memcpy(img->ovl_buffer, &hdr, sizeof(hdr));
+        if ((fwrite(img->ovl_buffer, 1, HDD_OVERLAY_INDEX, img->ovl_file) != HDD_OVERLAY_INDEX) ||
+            (fwrite(img->ovl_index, sizeof(uint32_t), img->ovl_chunks, img->ovl_file) != img->ovl_chunks))
+            return 0;
+        fflush(img->ovl_file);
+    }
+
+    hdd_image_log("Hard disk image %i: Overlay '%s', %" PRIu32 " of %" PRIu32 " chunks written\n",
+                  id, fn, img->ovl_used, img->ovl_chunks);
+
+    return 1;
+}
+
+static void
+hdd_image_overlay_close(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->ovl_file != NULL) {
+        fclose(img->ovl_file);
+        img->ovl_file = NULL;
+
+        if (hdd[id].overlay_discard && (img->ovl_fn != NULL))
+            plat_remove(img->ovl_fn);
+    }
+
+    free(img->ovl_index);
+    free(img->ovl_buffer);
+    free(img->ovl_fn);
+    img->ovl_index  = NULL;
+    img->ovl_buffer = NULL;
+    img->ovl_fn     = NULL;
+}
+
+static int
+hdd_image_overlay_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    FILE        *fp;
+    uint64_t     offset;
+    uint32_t     chunk;
+    uint32_t     slot;
+    uint32_t     n;
+    size_t       num_read;
+
+    while (count > 0) {
+        chunk = sector / HDD_OVERLAY_CHUNK;
+        if (chunk >= img->ovl_chunks)
+            return -1;
+        slot = img->ovl_index[chunk];
+
+        /* Read as far as the chunks stay on the base, or stay in order in
+           the delta. */
+        n = HDD_OVERLAY_CHUNK - (sector % HDD_OVERLAY_CHUNK);
+        while ((n < count) && ((chunk + 1) < img->ovl_chunks) &&
+               (img->ovl_index[chunk + 1] == (slot ? (slot + 1) : 0))) {
+            n += HDD_OVERLAY_CHUNK;
+            chunk++;
+            if (slot)
+                slot++;
+        }
+        if (n > count)
+            n = count;
+
+        slot = img->ovl_index[sector / HDD_OVERLAY_CHUNK];
+        if (slot) {
+            fp     = img->ovl_file;
+            offset = hdd_image_overlay_offset(id, slot, sector);
+        } else {
+            fp     = img->file;
+            offset = ((uint64_t) sector << 9) + img->base;
+        }
+
+        if (fseeko64(fp, offset, SEEK_SET) == -1) {
+            hdd_image_log("Hard disk image %i: Overlay read error during seek\n", id);
+            return -1;
+        }
+        num_read = fread(buffer, 512, n, fp);
+        if (num_read < n) {
+            if (!feof(fp))
+                return -1;
+            /* A base image shorter than the disk reads as zeroes. */
+            memset(buffer + (num_read << 9), 0, (size_t) (n - num_read) << 9);
+        }
+
+        sector += n;
+        count -= n;
+        buffer += (size_t) n << 9;
+    }
+
+    img->pos = sector;
+
+    return 0;
+}
+
+static int
+hdd_image_overlay_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+    uint32_t     chunk;
+    uint32_t     slot;
+    uint32_t     first;
+    uint32_t     n;
+    size_t       num_read;
+
+    while (count > 0) {
+        chunk = sector / HDD_OVERLAY_CHUNK;
+        if (chunk >= img->ovl_chunks)
+            return -1;
+        slot  = img->ovl_index[chunk];
+        first = sector % HDD_OVERLAY_CHUNK;
+        n     = HDD_OVERLAY_CHUNK - first;
+        if (n > count)
+            n = count;
+
+        if (slot == 0) {
+            /* First write to the chunk: copy it from the base unless it is
+               overwritten as a whole, append it to the delta, and only then
+               point the index at it. */
+            slot = img->ovl_used + 1;
+
+            if (n < HDD_OVERLAY_CHUNK) {
+                if (fseeko64(img->file, ((uint64_t) (chunk * HDD_OVERLAY_CHUNK) << 9) + img->base, SEEK_SET) == -1)
+                    return -1;
+                num_read = fread(img->ovl_buffer, 512, HDD_OVERLAY_CHUNK, img->file);
+                if ((num_read < HDD_OVERLAY_CHUNK) && !feof(img->file))
+                    return -1;
+                memset(img->ovl_buffer + (num_read << 9), 0, (HDD_OVERLAY_CHUNK - num_read) << 9);
+            }
+            memcpy(img->ovl_buffer + (first << 9), buffer, (size_t) n << 9);
+
+            if ((fseeko64(img->ovl_file, hdd_image_overlay_offset(id, slot, 0), SEEK_SET) == -1) ||
+                (fwrite(img->ovl_buffer, 512, HDD_OVERLAY_CHUNK, img->ovl_file) != HDD_OVERLAY_CHUNK))
+                return -1;
+            fflush(img->ovl_file);
+
+            if ((fseeko64(img->ovl_file, HDD_OVERLAY_INDEX + ((uint64_t) chunk << 2), SEEK_SET) == -1) ||
+                (fwrite(&slot, sizeof(uint32_t), 1, img->ovl_file) != 1))
+                return -1;
+
+            img->ovl_index[chunk] = slot;
+            img->ovl_used         = slot;
+        } else if ((fseeko64(img->ovl_file, hdd_image_overlay_offset(id, slot, sector), SEEK_SET) == -1) ||
+                   (fwrite(buffer, 512, n, img->ovl_file) != n))
+            return -1;
+
+        sector += n;
+        count -= n;
+        buffer += (size_t) n << 9;
+        img->pos = sector;
+    }
+
+    fflush(img->ovl_file);
+
+    return 0;
+}
+
+static void hdd_image_aio_stop(uint8_t id);
+
+static void
+hdd_image_release(uint8_t id)
+{
+    hdd_image_aio_stop(id);
+    hdd_image_map_close(id);
+    hdd_image_overlay_close(id);
+
+    if (hdd_images[id].file != NULL) {
+        fclose(hdd_images[id].file);
+        hdd_images[id].file = NULL;
+    } else if (hdd_images[id].vhd != NULL) {
+        mvhd_close(hdd_images[id].vhd);
+        hdd_images[id].vhd = NULL;
+    }
+}
+
 void
 hdd_image_init(void)
 {
@@ -273,13 +691,7 @@ hdd_image_load(int id)
     hdd_images[id].base = 0;
 
     if (hdd_images[id].loaded) {
-        if (hdd_images[id].file) {
-            fclose(hdd_images[id].file);
-            hdd_images[id].file = NULL;
-        } else if (hdd_images[id].vhd) {
-            mvhd_close(hdd_images[id].vhd);
-            hdd_images[id].vhd = NULL;
-        }
+        hdd_image_release(id);
         hdd_images[id].loaded = 0;
     }
 
@@ -297,14 +709,14 @@ hdd_image_load(int id)
         memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
         goto fail_raw;
     }
-    hdd_images[id].file = plat_fopen(fn, "rb+");
+    hdd_images[id].file = plat_fopen(fn, hdd[id].overlay_fn[0] ? "rb" : "rb+");
     if (hdd_images[id].file == NULL) {
         /* Failed to open existing hard disk image */
         if (errno == ENOENT) {
             /* Failed because it does not exist,
                so try to create new file */
-            if (hdd[id].wp) {
-                hdd_image_log("A write-protected image must exist\n");
+            if (hdd[id].wp || hdd[id].overlay_fn[0]) {
+                hdd_image_log("A write-protected or overlaid image must exist\n");
                 memset(hdd[id].fn, 0, sizeof(hdd[id].fn));
                 goto fail_raw;
             }
@@ -378,6 +790,7 @@ retry_vhd:
                         fatal("hdd_image_load(): VHD: Could not create VHD : %s\n", mvhd_strerr(vhd_error));
                     }
                     hdd_images[id].type = HDD_IMAGE_VHD;
+                    mvhd_set_cache_size(hdd_images[id].vhd, (size_t) hdd[id].vhd_cache << 20);
 
                     return 1;
                 } else {
@@ -391,6 +804,7 @@ retry_vhd:
             ret = prepare_new_hard_disk(id, full_size);
             if (ret <= 0)
                 goto fail_raw;
+            hdd_image_map_open(id);
             return ret;
         } else {
             /* Failed for another reason */
@@ -464,6 +878,8 @@ fail_raw:
         } else if (is_vhd[1]) {
             fclose(hdd_images[id].file);
             hdd_images[id].file = NULL;
+            if (hdd[id].overlay_fn[0])
+                pclog("hdd_image_load(): VHD: Overlays are not supported on VHD files, use a differencing VHD instead\n");
             hdd_images[id].vhd  = mvhd_open(fn, (bool) 0, &vhd_error);
             if (hdd_images[id].vhd == NULL) {
                 if (vhd_error == MVHD_ERR_FILE)
@@ -487,6 +903,7 @@ fail_raw:
                are there. */
             hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
             hdd_images[id].loaded      = 1;
+            mvhd_set_cache_size(hdd_images[id].vhd, (size_t) hdd[id].vhd_cache << 20);
             return 1;
         } else {
             full_size           = ((uint64_t) hdd[id].spt) * ((uint64_t) hdd[id].hpc) * ((uint64_t) hdd[id].tracks) << 9LL;
@@ -497,7 +914,7 @@ fail_raw:
     if (fseeko64(hdd_images[id].file, 0, SEEK_END) == -1)
         fatal("hdd_image_load(): Error seeking to the end of file\n");
     s = ftello64(hdd_images[id].file);
-    if (s < (full_size + hdd_images[id].base))
+    if ((s < (full_size + hdd_images[id].base)) && !hdd[id].overlay_fn[0])
         ret = prepare_new_hard_disk(id, full_size);
     else {
         hdd_images[id].last_sector = (uint32_t) (full_size >> 9) - 1;
@@ -505,6 +922,12 @@ fail_raw:
         ret                        = 1;
     }
 
+    if ((ret > 0) && hdd[id].overlay_fn[0] && !hdd_image_overlay_open(id))
+        fatal("hdd_image_load(): Unable to open overlay '%s' of image '%s'\n", hdd[id].overlay_fn, fn);
+
+    if (ret > 0)
+        hdd_image_map_open(id);
+
     return ret;
 }
 
@@ -514,6 +937,8 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     off64_t addr = sector;
     addr         = (uint64_t) sector << 9LL;
 
+    hdd_image_aio_wait(id);
+
     hdd_images[id].pos = sector;
     if (hdd_images[id].type != HDD_IMAGE_VHD) {
         if (!hdd_images[id].file || (fseeko64(hdd_images[id].file, addr + hdd_images[id].base, SEEK_SET) == -1)) {
@@ -525,13 +950,19 @@ hdd_image_seek(uint8_t id, uint32_t sector)
     return 0;
 }
 
-int
-hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_do_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_read;
-
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    int      non_transferred_sectors;
+    size_t   num_read;
+    uint8_t *map = hdd_image_map_get(id, sector, count);
+
+    if (map != NULL) {
+        memcpy(buffer, map, (size_t) count << 9);
+        hdd_images[id].pos = sector + count;
+    } else if (hdd_images[id].ovl_file != NULL) {
+        return hdd_image_overlay_read(id, sector, count, buffer);
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
         non_transferred_sectors   = mvhd_read_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
@@ -552,6 +983,14 @@ hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
+int
+hdd_image_read(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_aio_wait(id);
+
+    return hdd_image_do_read(id, sector, count, buffer);
+}
+
 uint32_t
 hdd_image_get_last_sector(uint8_t id)
 {
@@ -581,13 +1020,19 @@ hdd_image_read_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
-int
-hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+static int
+hdd_image_do_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
-    int    non_transferred_sectors;
-    size_t num_write;
-
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    int      non_transferred_sectors;
+    size_t   num_write;
+    uint8_t *map = hdd_image_map_get(id, sector, count);
+
+    if (map != NULL) {
+        memcpy(map, buffer, (size_t) count << 9);
+        hdd_image_map_written(id, sector, count);
+    } else if (hdd_images[id].ovl_file != NULL) {
+        return hdd_image_overlay_write(id, sector, count, buffer);
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error = 0;
         non_transferred_sectors   = mvhd_write_sectors(hdd_images[id].vhd, sector, count, buffer);
         hdd_images[id].pos        = sector + count - non_transferred_sectors - 1;
@@ -609,6 +1054,14 @@ hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
     return 0;
 }
 
+int
+hdd_image_write(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_aio_wait(id);
+
+    return hdd_image_do_write(id, sector, count, buffer);
+}
+
 int
 hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 {
@@ -629,7 +1082,22 @@ hdd_image_write_ex(uint8_t id, uint32_t sector, uint32_t count, uint8_t *buffer)
 int
 hdd_image_zero(uint8_t id, uint32_t sector, uint32_t count)
 {
-    if (hdd_images[id].type == HDD_IMAGE_VHD) {
+    uint8_t *map;
+
+    hdd_image_aio_wait(id);
+
+    map = hdd_image_map_get(id, sector, count);
+    if (map != NULL) {
+        memset(map, 0, (size_t) count << 9);
+        hdd_image_map_written(id, sector, count);
+    } else if (hdd_images[id].ovl_file != NULL) {
+        memset(empty_sector, 0, 512);
+
+        for (uint32_t i = 0; i < count; i++) {
+            if (hdd_image_overlay_write(id, sector + i, 1, (uint8_t *) empty_sector) < 0)
+                return -1;
+        }
+    } else if (hdd_images[id].type == HDD_IMAGE_VHD) {
         hdd_images[id].vhd->error   = 0;
         int non_transferred_sectors = mvhd_format_sectors(hdd_images[id].vhd, sector, count);
         hdd_images[id].pos          = sector + count - non_transferred_sectors - 1;
@@ -674,6 +1142,165 @@ hdd_image_zero_ex(uint8_t id, uint32_t sector, uint32_t count)
     return 0;
 }
 
+static void
+hdd_image_aio_thread(void *param)
+{
+    uint8_t      id  = (uint8_t) (uintptr_t) param;
+    hdd_image_t *img = &hdd_images[id];
+
+    while (1) {
+        thread_wait_event(img->aio_wake, -1);
+        thread_reset_event(img->aio_wake);
+
+        if (ATOMIC_LOAD(img->aio_state) == HDD_AIO_QUEUED) {
+            if (img->aio_op == HDD_AIO_WRITE)
+                ATOMIC_STORE(img->aio_ret, hdd_image_do_write(id, img->aio_sector, img->aio_count, img->aio_buffer));
+            else
+                ATOMIC_STORE(img->aio_ret, hdd_image_do_read(id, img->aio_sector, img->aio_count, img->aio_buffer));
+
+            ATOMIC_STORE(img->aio_state, HDD_AIO_DONE);
+            thread_set_event(img->aio_done);
+        }
+
+        if (!img->aio_run)
+            break;
+    }
+}
+
+static void
+hdd_image_aio_stop(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->aio_thread == NULL)
+        return;
+
+    hdd_image_aio_wait(id);
+
+    img->aio_run = 0;
+    thread_set_event(img->aio_wake);
+    thread_wait(img->aio_thread);
+    img->aio_thread = NULL;
+
+    thread_destroy_event(img->aio_wake);
+    thread_destroy_event(img->aio_done);
+    img->aio_wake = NULL;
+    img->aio_done = NULL;
+
+    ATOMIC_STORE(img->aio_state, HDD_AIO_IDLE);
+}
+
+void
+hdd_image_aio_submit(uint8_t id, int op, uint32_t sector, uint32_t count, uint8_t *buffer)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (img->aio_thread == NULL) {
+        hdd_image_log("Hard disk image %i: Starting I/O thread\n", id);
+        img->aio_wake   = thread_create_event();
+        img->aio_done   = thread_create_event();
+        img->aio_run    = 1;
+        img->aio_thread = thread_create(hdd_image_aio_thread, (void *) (uintptr_t) id);
+    } else
+        hdd_image_aio_wait(id);
+
+    img->aio_op     = op;
+    img->aio_sector = sector;
+    img->aio_count  = count;
+    img->aio_buffer = buffer;
+    ATOMIC_STORE(img->aio_ret, 0);
+
+    thread_reset_event(img->aio_done);
+    ATOMIC_STORE(img->aio_state, HDD_AIO_QUEUED);
+    thread_set_event(img->aio_wake);
+}
+
+int
+hdd_image_aio_busy(uint8_t id)
+{
+    return ATOMIC_LOAD(hdd_images[id].aio_state) == HDD_AIO_QUEUED;
+}
+
+int
+hdd_image_aio_result(uint8_t id)
+{
+    hdd_image_aio_wait(id);
+
+    ATOMIC_STORE(hdd_images[id].aio_state, HDD_AIO_IDLE);
+
+    return ATOMIC_LOAD(hdd_images[id].aio_ret);
+}
+
+void
+hdd_image_aio_wait(uint8_t id)
+{
+    while (ATOMIC_LOAD(hdd_images[id].aio_state) == HDD_AIO_QUEUED)
+        thread_wait_event(hdd_images[id].aio_done, -1);
+}
+
+uint8_t *
+hdd_image_map_range(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_image_aio_wait(id);
+
+    return hdd_image_map_get(id, sector, count);
+}
+
+void
+hdd_image_map_written(uint8_t id, uint32_t sector, uint32_t count)
+{
+    hdd_images[id].pos = sector + count;
+
+    if (hdd[id].mmap_mode >= HDD_MMAP_ASYNC)
+        hdd_image_map_flush(id, ((uint64_t) sector << 9) + hdd_images[id].base, (uint64_t) count << 9,
+                            hdd[id].mmap_mode == HDD_MMAP_SYNC);
+}
+
+void
+hdd_image_flush(uint8_t id)
+{
+    hdd_image_t *img = &hdd_images[id];
+
+    if (!img->loaded)
+        return;
+
+    hdd_image_aio_wait(id);
+
+    if (img->type == HDD_IMAGE_VHD) {
+        if (img->vhd != NULL)
+            mvhd_flush(img->vhd);
+    } else if (img->map != NULL) {
+        /* Deferring the write-back to close is what that mode asks for. */
+        if (hdd[id].mmap_mode != HDD_MMAP_CLOSE)
+            hdd_image_map_flush(id, 0, img->map_size, 1);
+    } else if (img->file != NULL)
+        fflush(img->file);
+
+    if (img->ovl_file != NULL)
+        fflush(img->ovl_file);
+}
+
+/* Writes back the BAT entries and sector bitmaps of cached VHDs, so that a
+   crash does not lose the blocks allocated since the image was loaded. */
+static void
+hdd_image_flush_timer_cb(UNUSED(void *priv))
+{
+    for (uint8_t id = 0; id < HDD_NUM; id++) {
+        if (hdd_images[id].loaded && (hdd_images[id].type == HDD_IMAGE_VHD) && hdd[id].vhd_cache &&
+            !hdd_image_aio_busy(id))
+            hdd_image_flush(id);
+    }
+
+    timer_on_auto(&hdd_image_flush_timer, HDD_IMAGE_FLUSH_PERIOD);
+}
+
+void
+hdd_image_reset(void)
+{
+    timer_add(&hdd_image_flush_timer, hdd_image_flush_timer_cb, NULL, 0);
+    timer_on_auto(&hdd_image_flush_timer, HDD_IMAGE_FLUSH_PERIOD);
+}
+
 uint32_t
 hdd_image_get_pos(uint8_t id)
 {
@@ -693,13 +1320,7 @@ hdd_image_unload(uint8_t id, UNUSED(int fn_preserve))
         return;
 
     if (hdd_images[id].loaded) {
-        if (hdd_images[id].file != NULL) {
-            fclose(hdd_images[id].file);
-            hdd_images[id].file = NULL;
-        } else if (hdd_images[id].vhd != NULL) {
-            mvhd_close(hdd_images[id].vhd);
-            hdd_images[id].vhd = NULL;
-        }
+        hdd_image_release(id);
         hdd_images[id].loaded = 0;
     }
 
@@ -716,13 +1337,7 @@ hdd_image_close(uint8_t id)
     if (!hdd_images[id].loaded)
         return;
 
-    if (hdd_images[id].file != NULL) {
-        fclose(hdd_images[id].file);
-        hdd_images[id].file = NULL;
-    } else if (hdd_images[id].vhd != NULL) {
-        mvhd_close(hdd_images[id].vhd);
-        hdd_images[id].vhd = NULL;
-    }
+    hdd_image_release(id);
 
     memset(&hdd_images[id], 0, sizeof(hdd_image_t));
     hdd_images[id].loaded = 0;
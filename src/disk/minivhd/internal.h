@@ -65,8 +65,36 @@ typedef struct MVHDSectorBitmap {
     uint8_t* curr_bitmap;
     int      sector_count;
     int      curr_block;
+    bool     dirty;        /* curr_bitmap has not been written to the file yet */
 } MVHDSectorBitmap;
 
+/* A cached sector bitmap or data chunk. */
+typedef struct MVHDCacheEntry {
+    int32_t  key;          /* block for a bitmap, chunk for data, -1 if unused */
+    int32_t  hash_next;
+    uint64_t last_used;    /* use count for bitmaps, referenced flag for data */
+    bool     dirty;
+    uint8_t* data;
+} MVHDCacheEntry;
+
+/* Sector bitmap and data cache of a sparse or differencing image, see
+   mvhd_set_cache_size(). Bitmaps and BAT entries are written back when
+   evicted or flushed; data is written through. */
+typedef struct MVHDCache {
+    MVHDCacheEntry* bitmaps;
+    int             bitmap_count;
+    MVHDCacheEntry* chunks;
+    int             chunk_count;
+    int             chunk_sectors;
+    int             clock_hand;
+    int32_t*        chunk_hash;
+    uint32_t        chunk_hash_mask;
+    uint8_t*        mem;
+    uint64_t        use_count;
+    uint32_t        bat_dirty_first;   /* BAT entries [first, end) are to be written */
+    uint32_t        bat_dirty_end;
+} MVHDCache;
+
 typedef struct MVHDFooter {
     uint8_t  cookie[8];
     uint32_t features;
@@ -123,6 +151,7 @@ struct MVHDMeta {
     uint32_t*        block_offset;
     int              sect_per_block;
     MVHDSectorBitmap bitmap;
+    MVHDCache        cache;
     int (*read_sectors)(struct MVHDMeta*, uint32_t, int, void*);
     int (*write_sectors)(struct MVHDMeta*, uint32_t, int, void*);
     struct {
@@ -390,6 +419,8 @@ int mvhd_sparse_diff_write(struct MVHDMeta* vhdm, uint32_t offset, int num_secto
  */
 int mvhd_noop_write(struct MVHDMeta* vhdm, uint32_t offset, int num_sectors, void* in_buff);
 
+void mvhd_cache_free(struct MVHDMeta* vhdm);
+
 /**
  * \brief Save the contents of a VHD footer from a buffer to a struct
  * 
@@ -624,6 +624,8 @@ mvhd_close(MVHDMeta* vhdm)
     if (vhdm->parent != NULL)
         mvhd_close(vhdm->parent);
 
+    mvhd_cache_free(vhdm);
+
     fclose(vhdm->f);
 
     if (vhdm->block_offset != NULL) {
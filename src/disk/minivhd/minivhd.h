@@ -395,6 +395,27 @@ MVHDAPI int mvhd_write_sectors(MVHDMeta* vhdm, uint32_t offset, int num_sectors,
  */
 MVHDAPI int mvhd_format_sectors(MVHDMeta* vhdm, uint32_t offset, int num_sectors);
 
+/**
+ * \brief Set the memory budget of the sector bitmap and data cache
+ *
+ * Sparse and differencing images keep recently used sector bitmaps and data
+ * in memory, and defer writing sector bitmaps and BAT entries until they are
+ * evicted, mvhd_flush() is called or the image is closed. Each image of a
+ * differencing chain gets its own cache of the given size. A size of zero
+ * turns the cache off, which is the default.
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] size_in_bytes the memory budget, in bytes
+ */
+MVHDAPI void mvhd_set_cache_size(MVHDMeta* vhdm, size_t size_in_bytes);
+
+/**
+ * \brief Write deferred sector bitmaps and BAT entries to the VHD file
+ *
+ * \param [in] vhdm MiniVHD data structure
+ */
+MVHDAPI void mvhd_flush(MVHDMeta* vhdm);
+
 #ifdef __cplusplus
 }
 #endif
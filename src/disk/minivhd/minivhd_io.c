@@ -96,11 +96,106 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
     return 1;
 }
 
+/**
+ * \brief Write a sector bitmap to file
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block the sector bitmap belongs to
+ * \param [in] bitmap The sector bitmap
+ */
+static void
+write_sect_bitmap(MVHDMeta* vhdm, int blk, const uint8_t* bitmap)
+{
+    int64_t abs_offset = (int64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
+        vhdm->error = 1;
+}
+
+/**
+ * \brief Write the current sector bitmap in memory to file
+ *
+ * \param [in] vhdm MiniVHD data structure
+ */
+static void
+write_curr_sect_bitmap(MVHDMeta* vhdm)
+{
+    if (vhdm->bitmap.curr_block >= 0) {
+        write_sect_bitmap(vhdm, vhdm->bitmap.curr_block, vhdm->bitmap.curr_bitmap);
+        vhdm->bitmap.dirty = false;
+    }
+}
+
+/**
+ * \brief Find the least recently used of a set of cache entries
+ */
+static MVHDCacheEntry*
+cache_lru(MVHDCacheEntry* entries, int count)
+{
+    MVHDCacheEntry* lru = &entries[0];
+
+    for (int i = 0; i < count; i++) {
+        if (entries[i].key < 0)
+            return &entries[i];
+        if (entries[i].last_used < lru->last_used)
+            lru = &entries[i];
+    }
+
+    return lru;
+}
+
+static MVHDCacheEntry*
+cache_find_bitmap(MVHDMeta* vhdm, int blk)
+{
+    for (int i = 0; i < vhdm->cache.bitmap_count; i++) {
+        if (vhdm->cache.bitmaps[i].key == blk)
+            return &vhdm->cache.bitmaps[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Move the current sector bitmap into the bitmap cache
+ *
+ * The least recently used bitmap is written back if needed to make room.
+ *
+ * \param [in] vhdm MiniVHD data structure
+ */
+static void
+cache_park_curr_bitmap(MVHDMeta* vhdm)
+{
+    int             blk = vhdm->bitmap.curr_block;
+    MVHDCacheEntry* entry;
+
+    if (blk < 0)
+        return;
+
+    entry = cache_find_bitmap(vhdm, blk);
+    if (entry == NULL) {
+        entry = cache_lru(vhdm->cache.bitmaps, vhdm->cache.bitmap_count);
+        if ((entry->key >= 0) && entry->dirty)
+            write_sect_bitmap(vhdm, entry->key, entry->data);
+        entry->key   = blk;
+        entry->dirty = false;
+    }
+
+    memcpy(entry->data, vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+    entry->dirty |= vhdm->bitmap.dirty;
+    entry->last_used = ++vhdm->cache.use_count;
+
+    vhdm->bitmap.dirty = false;
+}
+
 /**
  * \brief Read the sector bitmap for a block.
  *
  * If the block is sparse, the sector bitmap in memory will be
- * zeroed. Otherwise, the sector bitmap is read from the VHD file.
+ * zeroed. Otherwise, the sector bitmap is taken from the cache or read
+ * from the VHD file. A modified sector bitmap of the previous block is
+ * written back first, or kept in the cache.
  *
  * \param [in] vhdm MiniVHD data structure
  * \param [in] blk The block for which to read the sector bitmap from
@@ -108,7 +203,18 @@ mvhd_write_empty_sectors(FILE *f, int sector_count)
 static void
 read_sect_bitmap(MVHDMeta *vhdm, int blk)
 {
-    if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
+    MVHDCacheEntry* entry = NULL;
+
+    if (vhdm->cache.bitmap_count) {
+        cache_park_curr_bitmap(vhdm);
+        entry = cache_find_bitmap(vhdm, blk);
+    } else if (vhdm->bitmap.dirty)
+        write_curr_sect_bitmap(vhdm);
+
+    if (entry != NULL) {
+        memcpy(vhdm->bitmap.curr_bitmap, entry->data, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+        entry->last_used = ++vhdm->cache.use_count;
+    } else if (vhdm->block_offset[blk] != MVHD_SPARSE_BLK) {
         mvhd_fseeko64(vhdm->f, (uint64_t)vhdm->block_offset[blk] * MVHD_SECTOR_SIZE, SEEK_SET);
         if (!fread(vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE, 1, vhdm->f))
             vhdm->error = 1;
@@ -116,22 +222,182 @@ read_sect_bitmap(MVHDMeta *vhdm, int blk)
         memset(vhdm->bitmap.curr_bitmap, 0, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
 
     vhdm->bitmap.curr_block = blk;
+    vhdm->bitmap.dirty = false;
 }
 
 /**
- * \brief Write the current sector bitmap in memory to file
+ * \brief Count the sectors from sib on whose bitmap bits equal set
+ *
+ * \param [in] bitmap The sector bitmap
+ * \param [in] sib The first sector in the block
+ * \param [in] max The maximum number of sectors to count
+ * \param [in] set Whether to count set or clear bits
+ */
+static int
+bitmap_run(const uint8_t* bitmap, int sib, int max, bool set)
+{
+    uint8_t full = set ? 0xff : 0x00;
+    int     n = 0;
+
+    while (n < max) {
+        int k = sib + n;
+
+        if (!(k & 7) && ((max - n) >= 8) && (bitmap[k >> 3] == full)) {
+            n += 8;
+            continue;
+        }
+        if ((VHD_TESTBIT(bitmap, k) != 0) != set)
+            break;
+        n++;
+    }
+
+    return n;
+}
+
+static uint8_t*
+cache_get_chunk(MVHDMeta* vhdm, int blk, int chunk_in_blk)
+{
+    MVHDCache*      cache = &vhdm->cache;
+    int32_t         key = (int32_t)(blk * (vhdm->sect_per_block / cache->chunk_sectors) + chunk_in_blk);
+    uint32_t        hash = ((uint32_t)key * 0x9e3779b1) >> 8;
+    int32_t*        link;
+    MVHDCacheEntry* entry;
+
+    for (int32_t i = cache->chunk_hash[hash & cache->chunk_hash_mask]; i >= 0; i = cache->chunks[i].hash_next) {
+        if (cache->chunks[i].key == key) {
+            cache->chunks[i].last_used = 1;
+            return cache->chunks[i].data;
+        }
+    }
+
+    /* Miss, pick a chunk not used since the clock hand last passed it (there
+       are too many chunks to look for the least recently used one), drop it
+       from its hash chain and reuse it. */
+    while (1) {
+        entry = &cache->chunks[cache->clock_hand];
+        if (++cache->clock_hand == cache->chunk_count)
+            cache->clock_hand = 0;
+        if ((entry->key < 0) || !entry->last_used)
+            break;
+        entry->last_used = 0;
+    }
+    if (entry->key >= 0) {
+        uint32_t old_hash = ((uint32_t)entry->key * 0x9e3779b1) >> 8;
+
+        for (link = &cache->chunk_hash[old_hash & cache->chunk_hash_mask]; *link != (entry - cache->chunks);
+             link = &cache->chunks[*link].hash_next)
+            ;
+        *link = entry->hash_next;
+        entry->key = -1;
+    }
+
+    int64_t addr = ((int64_t)vhdm->block_offset[blk] + vhdm->bitmap.sector_count +
+                    (int64_t)chunk_in_blk * cache->chunk_sectors) * MVHD_SECTOR_SIZE;
+    if ((mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1) ||
+        !fread(entry->data, (size_t)cache->chunk_sectors * MVHD_SECTOR_SIZE, 1, vhdm->f))
+        return NULL;
+
+    entry->key = key;
+    entry->last_used = 1;
+    entry->hash_next = cache->chunk_hash[hash & cache->chunk_hash_mask];
+    cache->chunk_hash[hash & cache->chunk_hash_mask] = (int32_t)(entry - cache->chunks);
+
+    return entry->data;
+}
+
+static uint8_t*
+cache_find_chunk(MVHDMeta* vhdm, int blk, int chunk_in_blk)
+{
+    MVHDCache* cache = &vhdm->cache;
+    int32_t    key = (int32_t)(blk * (vhdm->sect_per_block / cache->chunk_sectors) + chunk_in_blk);
+    uint32_t   hash = ((uint32_t)key * 0x9e3779b1) >> 8;
+
+    for (int32_t i = cache->chunk_hash[hash & cache->chunk_hash_mask]; i >= 0; i = cache->chunks[i].hash_next) {
+        if (cache->chunks[i].key == key)
+            return cache->chunks[i].data;
+    }
+
+    return NULL;
+}
+
+/**
+ * \brief Read allocated sectors of a block
  *
  * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block to read from
+ * \param [in] sib The first sector in the block
+ * \param [in] count The number of sectors, all in the block
+ * \param [out] buff The buffer to read the sectors into
  */
 static void
-write_curr_sect_bitmap(MVHDMeta* vhdm)
+read_blk_sectors(MVHDMeta* vhdm, int blk, int sib, int count, uint8_t* buff)
 {
-    if (vhdm->bitmap.curr_block >= 0) {
-        int64_t abs_offset = (int64_t)vhdm->block_offset[vhdm->bitmap.curr_block] * MVHD_SECTOR_SIZE;
-        if (mvhd_fseeko64(vhdm->f, abs_offset, SEEK_SET) == -1)
-            vhdm->error = 1;
-        if (!fwrite(vhdm->bitmap.curr_bitmap, MVHD_SECTOR_SIZE, vhdm->bitmap.sector_count, vhdm->f))
-            vhdm->error = 1;
+    if (vhdm->cache.chunk_count) {
+        int chunk_sectors = vhdm->cache.chunk_sectors;
+
+        while (count > 0) {
+            int      in_chunk = sib % chunk_sectors;
+            int      n = chunk_sectors - in_chunk;
+            uint8_t* chunk = cache_get_chunk(vhdm, blk, sib / chunk_sectors);
+
+            if (n > count)
+                n = count;
+            if (chunk == NULL)
+                break;
+
+            memcpy(buff, chunk + ((size_t)in_chunk * MVHD_SECTOR_SIZE), (size_t)n * MVHD_SECTOR_SIZE);
+            buff += (size_t)n * MVHD_SECTOR_SIZE;
+            sib += n;
+            count -= n;
+        }
+
+        /* A chunk that could not be read in full, near the end of the file. */
+        if (count == 0)
+            return;
+    }
+
+    int64_t addr = (((int64_t)vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
+    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fread(buff, (size_t)count * MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
+        vhdm->error = 1;
+}
+
+/**
+ * \brief Write sectors of an allocated block, updating any cached data
+ *
+ * \param [in] vhdm MiniVHD data structure
+ * \param [in] blk The block to write to
+ * \param [in] sib The first sector in the block
+ * \param [in] count The number of sectors, all in the block
+ * \param [in] buff The sectors to write
+ */
+static void
+write_blk_sectors(MVHDMeta* vhdm, int blk, int sib, int count, const uint8_t* buff)
+{
+    int64_t addr = (((int64_t)vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) * MVHD_SECTOR_SIZE;
+
+    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
+        vhdm->error = 1;
+    if (!fwrite(buff, (size_t)count * MVHD_SECTOR_SIZE, 1, vhdm->f))
+        vhdm->error = 1;
+
+    if (vhdm->cache.chunk_count) {
+        int chunk_sectors = vhdm->cache.chunk_sectors;
+
+        while (count > 0) {
+            int      in_chunk = sib % chunk_sectors;
+            int      n = chunk_sectors - in_chunk;
+            uint8_t* chunk = cache_find_chunk(vhdm, blk, sib / chunk_sectors);
+
+            if (n > count)
+                n = count;
+            if (chunk != NULL)
+                memcpy(chunk + ((size_t)in_chunk * MVHD_SECTOR_SIZE), buff, (size_t)n * MVHD_SECTOR_SIZE);
+            buff += (size_t)n * MVHD_SECTOR_SIZE;
+            sib += n;
+            count -= n;
+        }
     }
 }
 
@@ -147,6 +413,18 @@ write_bat_entry(MVHDMeta *vhdm, int blk)
     uint64_t table_offset = vhdm->sparse.bat_offset + ((uint64_t)blk * sizeof *vhdm->block_offset);
     uint32_t offset = mvhd_to_be32(vhdm->block_offset[blk]);
 
+    /* Coalesced with the other new blocks and written by mvhd_flush(). */
+    if (vhdm->cache.bitmap_count) {
+        if (vhdm->cache.bat_dirty_end <= vhdm->cache.bat_dirty_first) {
+            vhdm->cache.bat_dirty_first = blk;
+            vhdm->cache.bat_dirty_end = blk + 1;
+        } else if ((uint32_t) blk < vhdm->cache.bat_dirty_first)
+            vhdm->cache.bat_dirty_first = blk;
+        else if ((uint32_t) blk >= vhdm->cache.bat_dirty_end)
+            vhdm->cache.bat_dirty_end = blk + 1;
+        return;
+    }
+
     if (mvhd_fseeko64(vhdm->f, table_offset, SEEK_SET) == -1)
         vhdm->error = 1;
     if (!fwrite(&offset, sizeof offset, 1, vhdm->f))
@@ -246,39 +524,30 @@ mvhd_sparse_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buf
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t*)out_buff;
-    int64_t addr = 0ULL;
-    uint32_t s = 0;
-    uint32_t ls = 0;
-    int blk = 0;
-    int prev_blk = -1;
-    int sib = 0;
-    ls = offset + transfer_sectors;
-
-    for (s = offset; s < ls; s++) {
-        blk = s / vhdm->sect_per_block;
-        sib = s % vhdm->sect_per_block;
-        if (blk != prev_blk) {
-            prev_blk = blk;
-            if (vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(vhdm, blk);
-                if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                    vhdm->error = 1;
-            } else {
-                addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                       MVHD_SECTOR_SIZE;
-                if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                    vhdm->error = 1;
-            }
-        }
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
 
-        if (VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib)) {
-            if (!fread(buff, MVHD_SECTOR_SIZE, 1, vhdm->f) && !feof(vhdm->f))
-                vhdm->error = 1;
-        } else {
-            memset(buff, 0, MVHD_SECTOR_SIZE);
-            mvhd_fseeko64(vhdm->f, MVHD_SECTOR_SIZE, SEEK_CUR);
-        }
-        buff += MVHD_SECTOR_SIZE;
+    /* Runs of sectors that are all present or all absent are transferred at once. */
+    while (s < ls) {
+        int blk = s / vhdm->sect_per_block;
+        int sib = s % vhdm->sect_per_block;
+        int max = vhdm->sect_per_block - sib;
+
+        if (max > (int)(ls - s))
+            max = ls - s;
+        if (vhdm->bitmap.curr_block != blk)
+            read_sect_bitmap(vhdm, blk);
+
+        bool present = VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib) != 0;
+        int  run = bitmap_run(vhdm->bitmap.curr_bitmap, sib, max, present);
+
+        if (present)
+            read_blk_sectors(vhdm, blk, sib, run, buff);
+        else
+            memset(buff, 0, (size_t)run * MVHD_SECTOR_SIZE);
+
+        buff += (size_t)run * MVHD_SECTOR_SIZE;
+        s += run;
     }
 
     return truncated_sectors;
@@ -294,39 +563,38 @@ mvhd_diff_read(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *out_buff)
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t *buff = (uint8_t*)out_buff;
-    MVHDMeta *curr_vhdm = vhdm;
-    uint32_t s = 0;
-    uint32_t ls = 0;
-    int blk = 0;
-    int sib = 0;
-    ls = offset + transfer_sectors;
-
-    for (s = offset; s < ls; s++) {
-        while (curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) {
-            blk = s / curr_vhdm->sect_per_block;
-            sib = s % curr_vhdm->sect_per_block;
-            if (curr_vhdm->bitmap.curr_block != blk) {
-                read_sect_bitmap(curr_vhdm, blk);
+    MVHDMeta *parent = vhdm->parent;
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
+
+    /* Runs of sectors present in this image are read from it at once, the
+       runs in between are handed to the parent, which may be differencing
+       as well. */
+    while (s < ls) {
+        int blk = s / vhdm->sect_per_block;
+        int sib = s % vhdm->sect_per_block;
+        int max = vhdm->sect_per_block - sib;
+
+        if (max > (int)(ls - s))
+            max = ls - s;
+        if (vhdm->bitmap.curr_block != blk)
+            read_sect_bitmap(vhdm, blk);
+
+        bool present = VHD_TESTBIT(vhdm->bitmap.curr_bitmap, sib) != 0;
+        int  run = bitmap_run(vhdm->bitmap.curr_bitmap, sib, max, present);
+
+        if (present)
+            read_blk_sectors(vhdm, blk, sib, run, buff);
+        else {
+            parent->read_sectors(parent, s, run, buff);
+            if (parent->error) {
+                parent->error = 0;
+                vhdm->error = 1;
             }
-            if (!VHD_TESTBIT(curr_vhdm->bitmap.curr_bitmap, sib)) {
-                curr_vhdm = curr_vhdm->parent;
-            } else { break; }
-        }
-
-        /* We handle actual sector reading using the fixed or sparse functions,
-           as a differencing VHD is also a sparse VHD */
-        if ((curr_vhdm->footer.disk_type == MVHD_TYPE_DIFF) ||
-            (curr_vhdm->footer.disk_type == MVHD_TYPE_DYNAMIC))
-            mvhd_sparse_read(curr_vhdm, s, 1, buff);
-        else
-            mvhd_fixed_read(curr_vhdm, s, 1, buff);
-        if (curr_vhdm->error) {
-            curr_vhdm->error = 0;
-            vhdm->error = 1;
         }
 
-        curr_vhdm = vhdm;
-        buff += MVHD_SECTOR_SIZE;
+        buff += (size_t)run * MVHD_SECTOR_SIZE;
+        s += run;
     }
 
     return truncated_sectors;
@@ -362,53 +630,39 @@ mvhd_sparse_diff_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *i
     check_sectors(offset, num_sectors, total_sectors, &transfer_sectors, &truncated_sectors);
 
     uint8_t* buff = (uint8_t *) in_buff;
-    int64_t addr = 0ULL;
-    uint32_t s = 0;
-    uint32_t ls = 0;
-    int blk = 0;
-    int prev_blk = -1;
-    int sib = 0;
-    ls = offset + transfer_sectors;
+    uint32_t s = offset;
+    uint32_t ls = offset + transfer_sectors;
 
     if (offset < total_sectors) {
-        for (s = offset; s < ls; s++) {
-            blk = s / vhdm->sect_per_block;
-            sib = s % vhdm->sect_per_block;
-            if (vhdm->bitmap.curr_block != blk && prev_blk >= 0) {
-                /* Write the sector bitmap for the previous block, before we replace it. */
-                write_curr_sect_bitmap(vhdm);
-            }
+        while (s < ls) {
+            int blk = s / vhdm->sect_per_block;
+            int sib = s % vhdm->sect_per_block;
+            int run = vhdm->sect_per_block - sib;
+
+            if (run > (int)(ls - s))
+                run = ls - s;
 
-            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK) {
-                /* "read" the sector bitmap first, before creating a new block, as the bitmap will be
-                   zero either way */
+            /* Switching blocks writes back or caches the sector bitmap of the previous one. The
+               bitmap of a sparse block is zero, so it is "read" before the block is created. */
+            if (vhdm->bitmap.curr_block != blk)
                 read_sect_bitmap(vhdm, blk);
+            if (vhdm->block_offset[blk] == MVHD_SPARSE_BLK)
                 create_block(vhdm, blk);
-            }
 
-            if (blk != prev_blk) {
-                if (vhdm->bitmap.curr_block != blk) {
-                    read_sect_bitmap(vhdm, blk);
-                    if (mvhd_fseeko64(vhdm->f, (uint64_t)sib * MVHD_SECTOR_SIZE, SEEK_CUR) == -1)
-                        vhdm->error = 1;
-                } else {
-                    addr = (((int64_t) vhdm->block_offset[blk]) + vhdm->bitmap.sector_count + sib) *
-                           MVHD_SECTOR_SIZE;
-                    if (mvhd_fseeko64(vhdm->f, addr, SEEK_SET) == -1)
-                        vhdm->error = 1;
-                }
-                prev_blk = blk;
-            }
+            write_blk_sectors(vhdm, blk, sib, run, buff);
+            for (int i = 0; i < run; i++)
+                VHD_SETBIT(vhdm->bitmap.curr_bitmap, (sib + i));
+            vhdm->bitmap.dirty = true;
 
-            if (!fwrite(buff, MVHD_SECTOR_SIZE, 1, vhdm->f))
-                vhdm->error = 1;
-            VHD_SETBIT(vhdm->bitmap.curr_bitmap, sib);
-            buff += MVHD_SECTOR_SIZE;
+            buff += (size_t)run * MVHD_SECTOR_SIZE;
+            s += run;
         }
     }
 
-    /* And write the sector bitmap for the last block we visited to disk */
-    write_curr_sect_bitmap(vhdm);
+    /* And write the sector bitmap for the last block we visited to disk,
+       unless the cache holds it back. */
+    if (!vhdm->cache.bitmap_count && vhdm->bitmap.dirty)
+        write_curr_sect_bitmap(vhdm);
 
     fflush(vhdm->f);
 
@@ -425,3 +679,141 @@ mvhd_noop_write(MVHDMeta *vhdm, uint32_t offset, int num_sectors, void *in_buff)
 
     return 0;
 }
+
+MVHDAPI void
+mvhd_flush(MVHDMeta* vhdm)
+{
+    MVHDCache* cache = &vhdm->cache;
+
+    if (vhdm->bitmap.dirty) {
+        MVHDCacheEntry* entry = cache->bitmap_count ? cache_find_bitmap(vhdm, vhdm->bitmap.curr_block) : NULL;
+
+        write_curr_sect_bitmap(vhdm);
+        if (entry != NULL) {
+            memcpy(entry->data, vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+            entry->dirty = false;
+        }
+    }
+
+    for (int i = 0; i < cache->bitmap_count; i++) {
+        if ((cache->bitmaps[i].key >= 0) && cache->bitmaps[i].dirty) {
+            /* The current bitmap is newer than its copy in the cache. */
+            if (cache->bitmaps[i].key == vhdm->bitmap.curr_block)
+                memcpy(cache->bitmaps[i].data, vhdm->bitmap.curr_bitmap, vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE);
+            write_sect_bitmap(vhdm, cache->bitmaps[i].key, cache->bitmaps[i].data);
+            cache->bitmaps[i].dirty = false;
+        }
+    }
+
+    if (cache->bat_dirty_end > cache->bat_dirty_first) {
+        uint32_t count = cache->bat_dirty_end - cache->bat_dirty_first;
+        uint32_t* entries = malloc(count * sizeof *entries);
+
+        if (entries == NULL)
+            vhdm->error = 1;
+        else {
+            for (uint32_t i = 0; i < count; i++)
+                entries[i] = mvhd_to_be32(vhdm->block_offset[cache->bat_dirty_first + i]);
+
+            if (mvhd_fseeko64(vhdm->f, vhdm->sparse.bat_offset + ((uint64_t)cache->bat_dirty_first * sizeof *entries),
+                              SEEK_SET) == -1)
+                vhdm->error = 1;
+            if (!fwrite(entries, sizeof *entries, count, vhdm->f))
+                vhdm->error = 1;
+            free(entries);
+        }
+
+        cache->bat_dirty_first = 0;
+        cache->bat_dirty_end = 0;
+    }
+
+    if (vhdm->f != NULL)
+        fflush(vhdm->f);
+}
+
+void
+mvhd_cache_free(MVHDMeta* vhdm)
+{
+    MVHDCache* cache = &vhdm->cache;
+
+    mvhd_flush(vhdm);
+
+    free(cache->bitmaps);
+    free(cache->chunks);
+    free(cache->chunk_hash);
+    free(cache->mem);
+    memset(cache, 0, sizeof *cache);
+}
+
+MVHDAPI void
+mvhd_set_cache_size(MVHDMeta* vhdm, size_t size_in_bytes)
+{
+    MVHDCache* cache = &vhdm->cache;
+
+    if (vhdm->parent != NULL)
+        mvhd_set_cache_size(vhdm->parent, size_in_bytes);
+
+    if ((vhdm->footer.disk_type != MVHD_TYPE_DYNAMIC) && (vhdm->footer.disk_type != MVHD_TYPE_DIFF))
+        return;
+
+    /* Park the current bitmap, so that it is not older than a cached copy. */
+    if (cache->bitmap_count)
+        cache_park_curr_bitmap(vhdm);
+    mvhd_cache_free(vhdm);
+
+    size_t bitmap_bytes = (size_t)vhdm->bitmap.sector_count * MVHD_SECTOR_SIZE;
+    if (size_in_bytes < (4 * bitmap_bytes))
+        return;
+
+    /* A sixteenth of the budget goes to sector bitmaps, the rest to data
+       chunks of up to 32 KB that evenly divide a block. */
+    int bitmap_count = (int)((size_in_bytes / 16) / bitmap_bytes);
+    if (bitmap_count < 4)
+        bitmap_count = 4;
+    else if (bitmap_count > 256)
+        bitmap_count = 256;
+
+    int chunk_sectors = 64;
+    while ((chunk_sectors > 1) && (vhdm->sect_per_block % chunk_sectors))
+        chunk_sectors >>= 1;
+    size_t chunk_bytes = (size_t)chunk_sectors * MVHD_SECTOR_SIZE;
+    size_t chunk_count = (size_in_bytes - (bitmap_count * bitmap_bytes)) / chunk_bytes;
+    if (chunk_count > 0x100000)
+        chunk_count = 0x100000;
+
+    uint32_t hash_size = 1;
+    while (hash_size < chunk_count)
+        hash_size <<= 1;
+
+    cache->mem = malloc((bitmap_count * bitmap_bytes) + (chunk_count * chunk_bytes));
+    cache->bitmaps = calloc(bitmap_count, sizeof *cache->bitmaps);
+    cache->chunks = chunk_count ? calloc(chunk_count, sizeof *cache->chunks) : NULL;
+    cache->chunk_hash = chunk_count ? malloc(hash_size * sizeof *cache->chunk_hash) : NULL;
+    if ((cache->mem == NULL) || (cache->bitmaps == NULL) || (chunk_count && ((cache->chunks == NULL) || (cache->chunk_hash == NULL)))) {
+        mvhd_cache_free(vhdm);
+        return;
+    }
+
+    uint8_t* mem = cache->mem;
+    for (int i = 0; i < bitmap_count; i++) {
+        cache->bitmaps[i].key = -1;
+        cache->bitmaps[i].data = mem;
+        mem += bitmap_bytes;
+    }
+    for (size_t i = 0; i < chunk_count; i++) {
+        cache->chunks[i].key = -1;
+        cache->chunks[i].hash_next = -1;
+        cache->chunks[i].data = mem;
+        mem += chunk_bytes;
+    }
+    /* A budget that only covers the bitmaps leaves no chunk hash. */
+    if (chunk_count) {
+        for (uint32_t i = 0; i < hash_size; i++)
+            cache->chunk_hash[i] = -1;
+    }
+
+    cache->bitmap_count = bitmap_count;
+    cache->chunk_count = (int)chunk_count;
+    cache->chunk_sectors = chunk_sectors;
+    cache->chunk_hash_mask = hash_size - 1;
+}
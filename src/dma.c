@@ -31,6 +31,7 @@
 #include <86box/io.h>
 #include <86box/pic.h>
 #include <86box/dma.h>
+#include <86box/snapshot.h>
 #include <86box/plat_unused.h>
 
 dma_t   dma[8];
@@ -1913,3 +1914,32 @@ dma_bm_write(uint32_t PhysAddress, const uint8_t *DataWrite, uint32_t TotalSize,
     if (dma_at)
         mem_invalidate_range(PhysAddress, PhysAddress + TotalSize - 1);
 }
+
+void
+dma_save(struct snapshot_t *snap)
+{
+    snapshot_write_var(snap, dma);
+    snapshot_write_var(snap, dma_e);
+    snapshot_write_var(snap, dma_m);
+    snapshot_write_var(snap, dmaregs);
+    snapshot_write_var(snap, dma_wp);
+    snapshot_write_var(snap, dma_stat);
+    snapshot_write_var(snap, dma_stat_rq);
+    snapshot_write_var(snap, dma_stat_rq_pc);
+    snapshot_write_var(snap, dma_stat_adv_pend);
+    snapshot_write_var(snap, dma_command);
+    snapshot_write_var(snap, dma_ps2);
+}
+
+int
+dma_load(struct snapshot_t *snap)
+{
+    /* dma_advanced, dma_at, dma_mask and the S/G register base are set
+       up by the machine and are left alone. */
+    return snapshot_read_var(snap, dma) && snapshot_read_var(snap, dma_e) &&
+           snapshot_read_var(snap, dma_m) && snapshot_read_var(snap, dmaregs) &&
+           snapshot_read_var(snap, dma_wp) && snapshot_read_var(snap, dma_stat) &&
+           snapshot_read_var(snap, dma_stat_rq) && snapshot_read_var(snap, dma_stat_rq_pc) &&
+           snapshot_read_var(snap, dma_stat_adv_pend) && snapshot_read_var(snap, dma_command) &&
+           snapshot_read_var(snap, dma_ps2);
+}
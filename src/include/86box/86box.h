@@ -194,6 +194,7 @@ extern int      force_43;                   /* (C) video */
 extern int      video_filter_method;        /* (C) video */
 extern int      video_vsync;                /* (C) video */
 extern int      video_framerate;            /* (C) video */
+extern int      video_dirty_scanout;        /* (C) skip blits of unchanged frames */
 extern double   video_gl_input_scale;       /* (C) OpenGL 3.x input scale */
 extern int      video_gl_input_scale_mode;  /* (C) OpenGL 3.x input stretch mode */
 extern int      gfxcard[GFXCARD_MAX];       /* (C) graphics/video card */
@@ -214,6 +215,10 @@ extern uint32_t mem_size;                   /* (C) memory size (Installed on sys
 extern uint32_t isa_mem_size;               /* (C) memory size (ISA Memory Cards) */
 extern int      cpu;                        /* (C) cpu type */
 extern int      cpu_use_dynarec;            /* (C) cpu uses/needs Dyna */
+extern int      mmu_tlb_size;               /* (C) software TLB entries */
+extern int      dynarec_cache_size;         /* (C) dynarec code cache size in MB, 0 = automatic */
+extern int      dynarec_compile_threshold;  /* (C) interpreted runs before a block is compiled */
+extern int      dynarec_compile_budget;     /* (C) blocks compiled per millisecond, 0 = unlimited */
 extern int      fpu_type;                   /* (C) fpu type */
 extern int      fpu_softfloat;              /* (C) fpu uses softfloat */
 extern int      time_sync;                  /* (C) enable time sync */
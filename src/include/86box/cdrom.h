@@ -20,6 +20,7 @@
 #endif
 
 #define CDROM_NUM                   8
+#define CDROM_MAX_CACHE             1024 /* MB */
 
 #define CD_STATUS_EMPTY             0
 #define CD_STATUS_DATA_ONLY         1
@@ -379,6 +380,8 @@ typedef struct cdrom {
     uint8_t            mode2;
 
     int                no_check;
+    uint32_t           cache_size;   /* Image sector cache and read-ahead, in MB,
+                                        0 = off */
 
     uint8_t            _F_LUT[_LUT_SIZE];
     uint8_t            _B_LUT[_LUT_SIZE];
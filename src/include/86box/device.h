@@ -39,6 +39,8 @@
 #ifndef EMU_DEVICE_H
 #define EMU_DEVICE_H
 
+#define DEVICE_MAX          256                         /* max # of devices */
+
 #define CONFIG_END         -1                          /* N/A */
 
 #define CONFIG_SHIFT        4
@@ -105,6 +107,7 @@ enum {
 
     DEVICE_KBC       = 0x800000,   /* is a keyboard controller */
     DEVICE_SOFTRESET = 0x1000000,  /* requires to be reset on soft reset */
+    DEVICE_STATELESS = 0x2000000,  /* has no state for a snapshot to keep */
 
     DEVICE_ONBOARD   = 0x40000000, /* is on-board */
     DEVICE_PIT       = 0x80000000, /* device is a PIT */
@@ -155,6 +158,8 @@ typedef struct _device_config_ {
     const device_config_bios_t       bios[32];
 } device_config_t;
 
+struct snapshot_t;
+
 typedef struct _device_ {
     const char *name;
     const char *internal_name;
@@ -172,6 +177,11 @@ typedef struct _device_ {
     void (*force_redraw)(void *priv);
 
     const device_config_t *config;
+
+    /* Snapshot hooks, see snapshot.h. A machine with a device that has
+       neither hooks nor DEVICE_STATELESS can not be snapshotted. */
+    void (*save)(void *priv, struct snapshot_t *snap);
+    int  (*load)(void *priv, struct snapshot_t *snap);
 } device_t;
 
 typedef struct device_context_t {
@@ -206,6 +216,10 @@ extern void *device_get_priv(const device_t *dev);
 extern int   device_available(const device_t *dev);
 extern void  device_speed_changed(void);
 extern void  device_force_redraw(void);
+extern void  device_save_all(struct snapshot_t *snap);
+extern int   device_load(struct snapshot_t *snap, const char *internal_name, uint32_t instance);
+extern int   device_check_snapshot(const uint8_t *present);
+extern int   device_snapshot_supported(void);
 extern const char *device_get_bus_name(const device_t *dev);
 extern void  device_get_name(const device_t *dev, int bus, char *name);
 extern int   device_has_config(const device_t *dev);
@@ -96,6 +96,7 @@ typedef struct ide_s {
     int      reset;
     int      mdma_mode;
     int      do_initial_read;
+    int      aio_pending; /* an image transfer is in flight on the I/O thread */
     uint32_t drive;
     uint32_t cfg_spt;
     uint32_t cfg_hpc;
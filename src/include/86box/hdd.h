@@ -83,8 +83,20 @@ enum {
     HDD_OP_WRITE = 3
 };
 
+/* Memory-mapped raw, HDI and HDX images, and when their writes are flushed.
+   On POSIX hosts sparse images (such as newly created ones) stay on stdio,
+   as a write into a hole the host disk can not allocate would kill the
+   emulator; allocate the file in full (e.g. fallocate -l) to map it. */
+enum {
+    HDD_MMAP_OFF   = 0, /* stdio */
+    HDD_MMAP_CLOSE = 1, /* when the image is closed */
+    HDD_MMAP_ASYNC = 2, /* write-back started after every write */
+    HDD_MMAP_SYNC  = 3  /* waited for after every write */
+};
+
 #define HDD_MAX_ZONES     16
 #define HDD_MAX_CACHE_SEG 16
+#define HDD_MAX_VHD_CACHE 1024 /* MB */
 
 typedef struct hdd_preset_t {
     const char *name;
@@ -164,6 +176,9 @@ typedef struct hard_disk_t {
     char               fn[MAX_IMAGE_PATH_LEN];     /* Name of current image file */
     /* Differential VHD parent file */
     char               vhd_parent[1280];
+    /* Copy-on-write delta of a raw, HDI or HDX image, which is then opened
+       read-only and can be shared by several machines */
+    char               overlay_fn[MAX_IMAGE_PATH_LEN];
 
     uint32_t           seek_pos;
     uint32_t           seek_len;
@@ -173,6 +188,7 @@ typedef struct hard_disk_t {
     uint32_t           tracks;
     uint32_t           speed_preset;
     uint32_t           audio_profile;
+    uint32_t           mmap_mode;    /* HDD_MMAP_* */
 
     uint32_t           num_zones;
     uint32_t           phy_cyl;
@@ -182,9 +198,12 @@ typedef struct hard_disk_t {
     uint32_t           cur_track;
     uint32_t           cur_addr;
     uint32_t           vhd_blocksize;
+    uint32_t           vhd_cache;    /* MiniVHD cache budget in MB, 0 = off */
 
     uint8_t            max_multiple_block;
-    uint8_t            pad1[3];
+    uint8_t            overlay_discard; /* Start every run with an empty delta and
+                                           delete it when the image is closed */
+    uint8_t            pad1[2];
 
     const char        *model;
 
@@ -222,8 +241,32 @@ extern uint32_t hdd_image_get_pos(uint8_t id);
 extern uint8_t  hdd_image_get_type(uint8_t id);
 extern void     hdd_image_unload(uint8_t id, int fn_preserve);
 extern void     hdd_image_close(uint8_t id);
+extern void     hdd_image_flush(uint8_t id);
+extern void     hdd_image_reset(void);
 extern void     hdd_image_calc_chs(uint32_t *c, uint32_t *h, uint32_t *s, uint32_t size);
 
+/* Asynchronous image requests, executed one at a time per image by an I/O
+   thread. A request is collected with hdd_image_aio_result() once
+   hdd_image_aio_busy() returns 0; the synchronous functions above first wait
+   for any request in flight on the same image. */
+#define HDD_AIO_READ  0
+#define HDD_AIO_WRITE 1
+
+extern void hdd_image_aio_submit(uint8_t id, int op, uint32_t sector, uint32_t count, uint8_t *buffer);
+extern int  hdd_image_aio_busy(uint8_t id);
+extern int  hdd_image_aio_result(uint8_t id);
+extern void hdd_image_aio_wait(uint8_t id);
+
+/* Direct access to a memory-mapped image, for bus master DMA straight to and
+   from guest memory. hdd_image_map_range() returns NULL if the image is not
+   mapped or the range is not entirely inside the mapping; a range that has
+   been written through the pointer is reported with hdd_image_map_written(). */
+extern uint8_t *hdd_image_map_range(uint8_t id, uint32_t sector, uint32_t count);
+extern void     hdd_image_map_written(uint8_t id, uint32_t sector, uint32_t count);
+
+extern const char *hdd_mmap_get_internal_name(int mode);
+extern int         hdd_mmap_get_from_internal_name(const char *s);
+
 extern int image_is_hdi(const char *s);
 extern int image_is_hdx(const char *s, int check_signature);
 extern int image_is_vhd(const char *s, int check_signature);
@@ -195,6 +195,21 @@ typedef struct _mem_mapping_ {
     void *priv; /* backpointer to device */
 } mem_mapping_t;
 
+/* Software TLB geometry; the number of entries is set by mmu_tlb_size. */
+#define MMU_TLB_WAYS 4
+#define MMU_TLB_MIN  64
+#define MMU_TLB_MAX  65536
+#define MMU_TLB_INV  0xffffffff
+
+typedef struct mem_tlb_stats_t {
+    uint32_t entries;
+    uint32_t ways;
+    uint32_t used;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t flushes;
+} mem_tlb_stats_t;
+
 #ifdef USE_NEW_DYNAREC
 extern uint64_t *byte_dirty_mask;
 extern uint64_t *byte_code_present_mask;
@@ -254,20 +269,14 @@ typedef struct _page_ {
 #endif
 
 extern uint8_t *ram;
-extern uint8_t *ram2;
 extern uint32_t rammask;
 
 extern uint8_t *rom;
 extern uint32_t biosmask;
 extern uint32_t biosaddr;
 
-extern int        readlookup[256];
 extern uintptr_t  old_rl2;
 extern uint8_t    uncached;
-extern int        readlnext;
-extern int        writelookup[256];
-
-extern int        writelnext;
 extern uint32_t   ram_mapped_addr[64];
 extern uint8_t    page_ff[4096];
 
@@ -275,7 +284,6 @@ extern mem_mapping_t ram_low_mapping;
 extern mem_mapping_t ram_mid_mapping;
 extern mem_mapping_t ram_remapped_mapping;
 extern mem_mapping_t ram_high_mapping;
-extern mem_mapping_t ram_2gb_mapping;
 extern mem_mapping_t bios_mapping;
 extern mem_mapping_t bios_high_mapping;
 
@@ -356,6 +364,7 @@ extern uint64_t mmutranslatereal(uint32_t addr, int rw);
 extern uint32_t mmutranslatereal32(uint32_t addr, int rw);
 extern void     addreadlookup(uint32_t virt, uint32_t phys);
 extern void     addwritelookup(uint32_t virt, uint32_t phys);
+extern void     mem_tlb_get_stats(int write, mem_tlb_stats_t *stats);
 
 extern void mem_mapping_set(mem_mapping_t *,
                             uint32_t base,
@@ -425,13 +434,6 @@ extern void     mem_write_ram(uint32_t addr, uint8_t val, void *priv);
 extern void     mem_write_ramw(uint32_t addr, uint16_t val, void *priv);
 extern void     mem_write_raml(uint32_t addr, uint32_t val, void *priv);
 
-extern uint8_t  mem_read_ram_2gb(uint32_t addr, void *priv);
-extern uint16_t mem_read_ram_2gbw(uint32_t addr, void *priv);
-extern uint32_t mem_read_ram_2gbl(uint32_t addr, void *priv);
-extern void     mem_write_ram_2gb(uint32_t addr, uint8_t val, void *priv);
-extern void     mem_write_ram_2gbw(uint32_t addr, uint16_t val, void *priv);
-extern void     mem_write_ram_2gbl(uint32_t addr, uint32_t val, void *priv);
-
 extern int mem_addr_is_ram(uint32_t addr);
 
 extern uint64_t mmutranslate_noabrt(uint32_t addr, int rw);
@@ -455,6 +457,10 @@ extern void mem_debug_check_addr(uint32_t addr, int write);
 extern void mem_a20_init(void);
 extern void mem_a20_recalc(void);
 
+struct snapshot_t;
+extern void mem_save(struct snapshot_t *snap);
+extern int  mem_load(struct snapshot_t *snap);
+
 extern void mem_init(void);
 extern void mem_close(void);
 extern void mem_zero(void);
@@ -139,6 +139,9 @@ extern int      plat_file_check(const char *path);
 extern int      plat_dir_create(char *path);
 extern void    *plat_mmap(size_t size, uint8_t executable);
 extern void     plat_munmap(void *ptr, size_t size);
+extern int      plat_file_stat(const char *path, uint64_t *size, uint64_t *mtime);
+extern void    *plat_mmap_file(const char *path, size_t *size);
+extern void     plat_munmap_file(void *ptr, size_t size);
 extern uint64_t plat_timer_read(void);
 extern uint32_t plat_get_ticks(void);
 extern void     plat_delay_ms(uint32_t count);
@@ -151,6 +154,7 @@ extern void     plat_resize_request(int x, int y, int monitor_index);
 extern int      plat_language_code(char *langcode);
 extern void     plat_language_code_r(int id, char *outbuf, int len);
 extern void     plat_get_cpu_string(char *outbuf, uint8_t len);
+extern int      plat_get_cpu_count(void);
 #ifdef _WIN32
 extern void     plat_get_system_directory(char *outbuf);
 #endif
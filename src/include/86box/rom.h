@@ -74,6 +74,7 @@ extern int rom_load_linear(const char *fn, uint32_t addr, int sz,
                            int off, uint8_t *ptr);
 extern int rom_load_interleaved(const char *fnl, const char *fnh, uint32_t addr,
                                 int sz, int off, uint8_t *ptr);
+extern void rom_cache_close(void);
 
 extern uint8_t  bios_read(uint32_t addr, void *priv);
 extern uint16_t bios_readw(uint32_t addr, void *priv);
@@ -0,0 +1,64 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the machine snapshot (save state) subsystem.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef EMU_SNAPSHOT_H
+#define EMU_SNAPSHOT_H
+
+#define SNAPSHOT_MAGIC   "86BoxSNP"
+#define SNAPSHOT_VERSION 2
+
+/* A snapshot is a header followed by a list of sections. Every section has a
+   four-character tag, a name (the device internal name for device sections),
+   an instance number and a length, so that a reader can skip sections it does
+   not know about. */
+typedef struct snapshot_t snapshot_t;
+
+struct pc_timer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Section data accessors, used by the save/load hooks. */
+extern void snapshot_write(snapshot_t *snap, const void *buf, size_t len);
+extern int  snapshot_read(snapshot_t *snap, void *buf, size_t len);
+
+#define snapshot_write_var(snap, var) snapshot_write(snap, &(var), sizeof(var))
+#define snapshot_read_var(snap, var)  snapshot_read(snap, &(var), sizeof(var))
+
+/* Save and restore a timer relative to the current TSC. The timer must
+   already have been added with timer_add(). */
+extern void snapshot_write_timer(snapshot_t *snap, struct pc_timer_t *timer);
+extern int  snapshot_read_timer(snapshot_t *snap, struct pc_timer_t *timer);
+
+/* Section framing, used by the core and by device_save_all(). */
+extern void snapshot_begin_section(snapshot_t *snap, const char *tag, const char *name, uint32_t instance);
+extern void snapshot_end_section(snapshot_t *snap);
+
+/* Save or restore the whole machine. Must be called between CPU execution
+   slices, normally through snapshot_request(). */
+extern int snapshot_save(const char *fn);
+extern int snapshot_load(const char *fn);
+
+/* Queue a save or load to be done from pc_run() before the next slice. */
+extern void snapshot_request(int load, const char *fn);
+extern void snapshot_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*EMU_SNAPSHOT_H*/
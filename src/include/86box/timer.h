@@ -42,8 +42,11 @@ typedef struct pc_timer_t {
     void (*callback)(void *priv);
     void *priv;
 
-    struct pc_timer_t *prev;
-    struct pc_timer_t *next;
+    uint32_t heap_pos; /* Position in the timer queue, valid while enabled. */
+    uint32_t seq;      /* Enable sequence number, used to order equal timestamps. */
+
+    uint64_t fire_count;  /* Number of times the timer has expired. */
+    uint64_t rearm_count; /* Number of times the timer has been enabled. */
 } pc_timer_t;
 
 #ifdef __cplusplus
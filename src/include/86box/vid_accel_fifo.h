@@ -0,0 +1,82 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Asynchronous command FIFO shared by the 2D accelerators.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef VIDEO_ACCEL_FIFO_H
+#define VIDEO_ACCEL_FIFO_H
+
+#define ACCEL_FIFO_SIZE      65536
+#define ACCEL_FIFO_MASK      (ACCEL_FIFO_SIZE - 1)
+#define ACCEL_FIFO_THRESHOLD 0xe000
+
+/* Each entry holds a 24-bit register address and an 8-bit card-defined type. */
+#define ACCEL_FIFO_TYPE      0xff000000
+#define ACCEL_FIFO_ADDR      0x00ffffff
+
+typedef struct accel_fifo_entry_t {
+    uint32_t addr_type;
+    uint32_t val;
+} accel_fifo_entry_t;
+
+typedef struct accel_fifo_t {
+    const char *name;
+
+    accel_fifo_entry_t entries[ACCEL_FIFO_SIZE];
+    ATOMIC_INT         read_idx;
+    ATOMIC_INT         write_idx;
+    ATOMIC_INT         busy; /* Set while the worker is executing entries. */
+    ATOMIC_INT         thread_run;
+
+    /* Executes one entry on the worker thread; type is (addr_type & ACCEL_FIFO_TYPE). */
+    void (*process)(void *priv, uint32_t addr, uint32_t val, uint32_t type);
+    /* Optional, called on the worker thread each time the FIFO has drained. */
+    void (*drained)(void *priv);
+    void *priv;
+
+    thread_t *thread;
+    event_t  *wake_thread;
+    event_t  *not_full_event;
+
+    /* Statistics, reported when the FIFO is closed. */
+    uint64_t queued;
+    uint64_t stalls;
+    uint64_t busy_time;
+    uint32_t max_depth;
+} accel_fifo_t;
+
+#define ACCEL_FIFO_ENTRIES(fifo) ((fifo)->write_idx - (fifo)->read_idx)
+#define ACCEL_FIFO_EMPTY(fifo)   ((fifo)->read_idx == (fifo)->write_idx)
+#define ACCEL_FIFO_FULL(fifo)    (ACCEL_FIFO_ENTRIES(fifo) >= ACCEL_FIFO_SIZE)
+
+extern void accel_fifo_init(accel_fifo_t *fifo, const char *name,
+                            void (*process)(void *priv, uint32_t addr, uint32_t val, uint32_t type),
+                            void (*drained)(void *priv), void *priv);
+extern void accel_fifo_close(accel_fifo_t *fifo);
+extern void accel_fifo_reset(accel_fifo_t *fifo);
+
+/* Queues an entry, waiting for room if the FIFO holds limit entries or more.
+   A limit of 0 waits only when the FIFO is full. */
+extern void accel_fifo_queue(accel_fifo_t *fifo, uint32_t addr, uint32_t val, uint32_t type, int limit);
+
+extern void accel_fifo_wake(accel_fifo_t *fifo);
+/* Waits until every queued entry has been executed. Must not be called from the worker. */
+extern void accel_fifo_wait_idle(accel_fifo_t *fifo);
+
+/* Returns non-zero while entries are queued or still executing, for status registers. */
+static inline int
+accel_fifo_busy(accel_fifo_t *fifo)
+{
+    return !ACCEL_FIFO_EMPTY(fifo) || fifo->busy;
+}
+
+#endif /*VIDEO_ACCEL_FIFO_H*/
@@ -0,0 +1,76 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Per-frame timing statistics of the video pipeline.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef VIDEO_STATS_H
+#define VIDEO_STATS_H
+
+/* Stages are timed on whichever thread runs them; the time spent in each is
+   summed over a frame of the primary monitor and then added to the stage's
+   histogram. Stages that did not run during a frame are not sampled. */
+enum {
+    VIDEO_STAT_SVGA_POLL = 0, /* svga_poll(), every scanline */
+    VIDEO_STAT_SVGA_RENDER,   /* the SVGA line renderers */
+    VIDEO_STAT_SVGA_BLIT,     /* svga_doblit(), including the hand-off to the blit ring */
+    VIDEO_STAT_BLIT_WAIT,     /* a frame waiting in the blit ring for the blit thread */
+    VIDEO_STAT_BLIT,          /* the frontend's blit, until video_blit_complete() */
+    VIDEO_STAT_PRESENT,       /* the frontend renderer presenting a blitted frame */
+    VIDEO_STAT_VOODOO_FIFO,   /* the Voodoo FIFO thread executing commands */
+    VIDEO_STAT_VOODOO_RENDER, /* the Voodoo render threads drawing triangles */
+    VIDEO_STAT_VOODOO_SWAP,   /* a Voodoo buffer swap waiting for its retrace */
+    VIDEO_STAT_MAX
+};
+
+#define VIDEO_STATS_BUCKETS   128
+#define VIDEO_STATS_BUCKET_US 250 /* the last bucket holds everything above 31.75 ms */
+
+typedef struct video_stat_t {
+    uint64_t frames; /* frames in which the stage ran */
+    uint64_t total_us;
+    uint32_t max_us;
+    uint32_t hist[VIDEO_STATS_BUCKETS];
+} video_stat_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern volatile int video_stats_enabled;
+
+extern void video_stats_init(void);
+extern void video_stats_close(void);
+
+/* Clears the histograms and starts or stops collecting. */
+extern void video_stats_start(void);
+extern void video_stats_stop(void);
+
+/* Returns a start time for video_stats_end(), which may be called on another
+   thread; 0 while statistics are not being collected. */
+extern uint64_t video_stats_begin(int stage);
+extern void     video_stats_end(int stage, uint64_t start);
+
+/* Closes the current frame; called once per frame of each monitor. */
+extern void video_stats_frame_end(int monitor_index);
+
+extern const char *video_stats_name(int stage);
+extern uint64_t    video_stats_frames(void);
+extern void        video_stats_get(int stage, video_stat_t *stat);
+/* Upper bound of the histogram bucket holding the given percentile, in us. */
+extern uint32_t video_stats_percentile(const video_stat_t *stat, int percent);
+extern int      video_stats_dump(const char *fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*VIDEO_STATS_H*/
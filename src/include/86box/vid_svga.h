@@ -320,6 +320,15 @@ typedef struct svga_t {
     /* Return a 32 bpp color from a 15/16 bpp color. */
     uint32_t (*conv_16to32)(struct svga_t *svga, uint16_t color, uint8_t bpp);
 
+    /* State of the last frame handed to the blitter, for dirty scanout. */
+    int      blit_valid;
+    int      blit_wx;
+    int      blit_wy;
+    int      blit_dpms;
+    uint32_t blit_overscan_color;
+    uint64_t line_hash[2048]; /* of lines under an overlay or cursor, as last drawn */
+    uint8_t  line_hash_valid[2048];
+
     void *  dev8514;
     void *  ext8514;
     void *  clock_gen8514;
@@ -375,6 +384,8 @@ extern int  svga_init(const device_t *info, svga_t *svga, void *priv, int memsiz
 extern void svga_recalctimings(svga_t *svga);
 extern void svga_close(svga_t *svga);
 
+extern uint32_t svga_conv_16to32(struct svga_t *svga, uint16_t color, uint8_t bpp);
+
 uint8_t  svga_read(uint32_t addr, void *priv);
 uint16_t svga_readw(uint32_t addr, void *priv);
 uint32_t svga_readl(uint32_t addr, void *priv);
@@ -0,0 +1,34 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorised scanline conversion kernels for the SVGA renderers.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef VIDEO_SVGA_RENDER_SIMD_H
+#define VIDEO_SVGA_RENDER_SIMD_H
+
+/*
+   All kernels convert count source pixels. When dbl is set, every pixel is
+   written twice, as the low resolution renderers do. Results are identical
+   to the video_15to32/video_16to32 tables and to an unmapped lookup_lut().
+ */
+typedef struct svga_render_kernels_t {
+    void (*pal8)(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count, int dbl);
+    void (*rgb555)(uint32_t *p, const uint8_t *src, int count, int dbl);
+    void (*rgb565)(uint32_t *p, const uint8_t *src, int count, int dbl);
+    void (*rgb888)(uint32_t *p, const uint8_t *src, int count, int dbl);
+} svga_render_kernels_t;
+
+extern svga_render_kernels_t svga_render_kernels;
+
+extern void svga_render_kernels_init(void);
+
+#endif /*VIDEO_SVGA_RENDER_SIMD_H*/
@@ -0,0 +1,1556 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          AArch64 code generator for the Voodoo span renderer.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+/*Registers :
+
+  x19 - state
+  x20 - params
+  x21 - x
+  x22 - real_y
+  x23 - fb_mem
+  x24 - aux_mem
+  x25 - x2
+  x26 - x_tiled
+  x27 - dither table (R/B)
+  x28 - dither table (G)
+
+  Per pixel :
+  w0-w3   - src_r, src_g, src_b, src_a
+  w4      - w_depth
+  w5      - new_depth
+  w6-w9   - dest_r, dest_g, dest_b, dest_a
+  w10-w12 - clocal_r, clocal_g, clocal_b (colbfog_r/g/b after the colour combine)
+  w13     - alocal
+  w14     - aother
+  w15-w17 - temporaries
+
+  The generated code follows the C pipeline in vid_voodoo_render.c step for
+  step, so that it produces the same framebuffer contents. Bilinear filtering
+  and the per-pixel iterator updates use NEON, everything else is scalar.
+*/
+
+#ifndef VIDEO_VOODOO_CODEGEN_ARM64_H
+#define VIDEO_VOODOO_CODEGEN_ARM64_H
+
+#if defined(__APPLE__)
+#    include <pthread.h>
+#endif
+
+#define BLOCK_NUM  256
+#define BLOCK_SIZE 8192
+
+#define LOD_MASK   (LOD_TMIRROR_S | LOD_TMIRROR_T)
+
+#define SKIP_MAX   16
+
+#include <86box/vid_voodoo_codegen_cache.h>
+
+/*Bilinear weights for each (ds | dt << 4), as two vectors of eight halfwords :
+  d[0] x 4, d[1] x 4 and d[2] x 4, d[3] x 4*/
+static uint16_t bilinear_lookup[256][16];
+
+#define addlong(val)                                \
+    do {                                            \
+        *(uint32_t *) &code_block[block_pos] = val; \
+        block_pos += 4;                             \
+    } while (0)
+
+#define REG_STATE       19
+#define REG_PARAMS      20
+#define REG_X           21
+#define REG_REAL_Y      22
+#define REG_FB_MEM      23
+#define REG_AUX_MEM     24
+#define REG_X2          25
+#define REG_X_TILED     26
+#define REG_DITHER_RB   27
+#define REG_DITHER_G    28
+#define REG_ZR          31
+#define REG_SP          31
+
+#define COND_EQ         0x0
+#define COND_NE         0x1
+#define COND_HS         0x2
+#define COND_LO         0x3
+#define COND_HI         0x8
+#define COND_LS         0x9
+#define COND_GE         0xa
+#define COND_LT         0xb
+#define COND_GT         0xc
+#define COND_LE         0xd
+
+#define SHIFT_LSL       0
+#define SHIFT_LSR       1
+#define SHIFT_ASR       2
+
+#define EXTEND_UXTW     2
+#define EXTEND_LSL      3
+#define EXTEND_SXTW     6
+
+/*Data processing, shifted register*/
+#define ARM64_DP_REG(op, d, n, m, type, amount) ((op) | ((type) << 22) | ((m) << 16) | ((amount) << 10) | ((n) << 5) | (d))
+
+#define ARM64_ADD_W(d, n, m)                    ARM64_DP_REG(0x0b000000, d, n, m, 0, 0)
+#define ARM64_ADD_W_SHIFT(d, n, m, type, s)     ARM64_DP_REG(0x0b000000, d, n, m, type, s)
+#define ARM64_ADD_X(d, n, m)                    ARM64_DP_REG(0x8b000000, d, n, m, 0, 0)
+#define ARM64_ADD_X_SHIFT(d, n, m, type, s)     ARM64_DP_REG(0x8b000000, d, n, m, type, s)
+#define ARM64_SUB_W(d, n, m)                    ARM64_DP_REG(0x4b000000, d, n, m, 0, 0)
+#define ARM64_NEG_W(d, m)                       ARM64_DP_REG(0x4b000000, d, REG_ZR, m, 0, 0)
+#define ARM64_CMP_W(n, m)                       ARM64_DP_REG(0x6b000000, REG_ZR, n, m, 0, 0)
+#define ARM64_ORR_W(d, n, m)                    ARM64_DP_REG(0x2a000000, d, n, m, 0, 0)
+#define ARM64_ORR_W_SHIFT(d, n, m, type, s)     ARM64_DP_REG(0x2a000000, d, n, m, type, s)
+#define ARM64_AND_W(d, n, m)                    ARM64_DP_REG(0x0a000000, d, n, m, 0, 0)
+#define ARM64_MOV_W(d, m)                       ARM64_DP_REG(0x2a000000, d, REG_ZR, m, 0, 0)
+#define ARM64_MOV_X(d, m)                       ARM64_DP_REG(0xaa000000, d, REG_ZR, m, 0, 0)
+#define ARM64_MVN_W(d, m)                       ARM64_DP_REG(0x2a200000, d, REG_ZR, m, 0, 0)
+
+/*Data processing, immediate. imm is 12 bits, optionally shifted left by 12*/
+#define ARM64_DP_IMM(op, d, n, imm)             ((op) | (((imm) < 0x1000) ? ((imm) << 10) : (((imm) >> 12) << 10) | (1 << 22)) | ((n) << 5) | (d))
+
+#define ARM64_ADD_W_IMM(d, n, imm)              ARM64_DP_IMM(0x11000000, d, n, imm)
+#define ARM64_ADD_X_IMM(d, n, imm)              ARM64_DP_IMM(0x91000000, d, n, imm)
+#define ARM64_SUB_W_IMM(d, n, imm)              ARM64_DP_IMM(0x51000000, d, n, imm)
+#define ARM64_CMP_W_IMM(n, imm)                 ARM64_DP_IMM(0x71000000, REG_ZR, n, imm)
+#define ARM64_CMP_X_IMM(n, imm)                 ARM64_DP_IMM(0xf1000000, REG_ZR, n, imm)
+
+/*Logical immediate, limited to masks of the low 'width' bits*/
+#define ARM64_AND_W_MASK(d, n, width)           (0x12000000 | (((width) - 1) << 10) | ((n) << 5) | (d))
+#define ARM64_EOR_W_MASK(d, n, width)           (0x52000000 | (((width) - 1) << 10) | ((n) << 5) | (d))
+
+/*Bitfield moves*/
+#define ARM64_UBFX_W(d, n, lsb, width)          (0x53000000 | ((lsb) << 16) | (((lsb) + (width) - 1) << 10) | ((n) << 5) | (d))
+#define ARM64_UBFX_X(d, n, lsb, width)          (0xd3400000 | ((lsb) << 16) | (((lsb) + (width) - 1) << 10) | ((n) << 5) | (d))
+#define ARM64_LSL_W_IMM(d, n, s)                (0x53000000 | (((32 - (s)) & 31) << 16) | ((31 - (s)) << 10) | ((n) << 5) | (d))
+#define ARM64_LSR_W_IMM(d, n, s)                (0x53000000 | ((s) << 16) | (31 << 10) | ((n) << 5) | (d))
+#define ARM64_ASR_W_IMM(d, n, s)                (0x13000000 | ((s) << 16) | (31 << 10) | ((n) << 5) | (d))
+#define ARM64_ASR_X_IMM(d, n, s)                (0x93400000 | ((s) << 16) | (63 << 10) | ((n) << 5) | (d))
+#define ARM64_ROR_W_IMM(d, n, s)                (0x13800000 | ((n) << 16) | ((s) << 10) | ((n) << 5) | (d))
+
+/*Data processing, two and three source*/
+#define ARM64_LSLV_W(d, n, m)                   (0x1ac02000 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_LSLV_X(d, n, m)                   (0x9ac02000 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_LSRV_W(d, n, m)                   (0x1ac02400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_ASRV_W(d, n, m)                   (0x1ac02800 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_UDIV_X(d, n, m)                   (0x9ac00800 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_MUL_W(d, n, m)                    (0x1b007c00 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_MUL_X(d, n, m)                    (0x9b007c00 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_CLZ_X(d, n)                       (0xdac01000 | ((n) << 5) | (d))
+#define ARM64_CSEL_W(d, n, m, cond)             (0x1a800000 | ((m) << 16) | ((cond) << 12) | ((n) << 5) | (d))
+
+/*Wide moves*/
+#define ARM64_MOVZ_W(d, imm, hw)                (0x52800000 | ((hw) << 21) | ((imm) << 5) | (d))
+#define ARM64_MOVZ_X(d, imm, hw)                (0xd2800000 | ((hw) << 21) | ((imm) << 5) | (d))
+#define ARM64_MOVK_X(d, imm, hw)                (0xf2800000 | ((hw) << 21) | ((imm) << 5) | (d))
+
+/*Loads and stores. The immediate forms take an unsigned, scaled offset, the
+  register forms are derived from them by arm64_ldst()*/
+#define ARM64_LDR_W                             0xb9400000
+#define ARM64_STR_W                             0xb9000000
+#define ARM64_LDR_X                             0xf9400000
+#define ARM64_STR_X                             0xf9000000
+#define ARM64_LDRH                              0x79400000
+#define ARM64_STRH                              0x79000000
+#define ARM64_LDRSH_W                           0x79c00000
+#define ARM64_LDRB                              0x39400000
+#define ARM64_LDR_Q                             0x3dc00000
+
+#define ARM64_LDST_REG(op, t, n, m, ext, s)     (((op) & ~0x01000000) | 0x00200800 | ((m) << 16) | ((ext) << 13) | ((s) << 12) | ((n) << 5) | (t))
+
+#define ARM64_STP_X_PREIDX(t, t2, n, off)       (0xa9800000 | ((((off) >> 3) & 0x7f) << 15) | ((t2) << 10) | ((n) << 5) | (t))
+#define ARM64_STP_X(t, t2, n, off)              (0xa9000000 | ((((off) >> 3) & 0x7f) << 15) | ((t2) << 10) | ((n) << 5) | (t))
+#define ARM64_LDP_X(t, t2, n, off)              (0xa9400000 | ((((off) >> 3) & 0x7f) << 15) | ((t2) << 10) | ((n) << 5) | (t))
+#define ARM64_LDP_X_POSTIDX(t, t2, n, off)      (0xa8c00000 | ((((off) >> 3) & 0x7f) << 15) | ((t2) << 10) | ((n) << 5) | (t))
+
+/*Branches. Offsets are filled in by arm64_patch_branch()*/
+#define ARM64_B                                 0x14000000
+#define ARM64_BCOND(cond)                       (0x54000000 | (cond))
+#define ARM64_CBZ_W(t)                          (0x34000000 | (t))
+#define ARM64_CBNZ_X(t)                         (0xb5000000 | (t))
+#define ARM64_TBZ(t, bit)                       (0x36000000 | (((bit) >> 5) << 31) | (((bit) & 31) << 19) | (t))
+#define ARM64_TBNZ(t, bit)                      (0x37000000 | (((bit) >> 5) << 31) | (((bit) & 31) << 19) | (t))
+#define ARM64_RET                               0xd65f03c0
+
+/*NEON*/
+#define ARM64_FMOV_S_W(d, n)                    (0x1e270000 | ((n) << 5) | (d))
+#define ARM64_INS_S(d, idx, n)                  (0x4e001c00 | ((((idx) << 3) | 4) << 16) | ((n) << 5) | (d))
+#define ARM64_UMOV_H(d, n, idx)                 (0x0e003c00 | ((((idx) << 2) | 2) << 16) | ((n) << 5) | (d))
+#define ARM64_UXTL_8H(d, n)                     (0x2f08a400 | ((n) << 5) | (d))
+#define ARM64_UXTL2_8H(d, n)                    (0x6f08a400 | ((n) << 5) | (d))
+#define ARM64_MUL_8H(d, n, m)                   (0x4e609c00 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_MLA_8H(d, n, m)                   (0x4e609400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_EXT_16B(d, n, m, imm)             (0x6e000000 | ((m) << 16) | ((imm) << 11) | ((n) << 5) | (d))
+#define ARM64_ADD_4H(d, n, m)                   (0x0e608400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_USHR_4H(d, n, s)                  (0x2f000400 | ((32 - (s)) << 16) | ((n) << 5) | (d))
+#define ARM64_ADD_4S(d, n, m)                   (0x4ea08400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_SUB_4S(d, n, m)                   (0x6ea08400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_ADD_2D(d, n, m)                   (0x4ee08400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_SUB_2D(d, n, m)                   (0x6ee08400 | ((m) << 16) | ((n) << 5) | (d))
+#define ARM64_LD1_4S(t, n)                      (0x4c407800 | ((n) << 5) | (t))
+#define ARM64_ST1_4S(t, n)                      (0x4c007800 | ((n) << 5) | (t))
+#define ARM64_LD1_2D(t, n)                      (0x4c407c00 | ((n) << 5) | (t))
+#define ARM64_ST1_2D(t, n)                      (0x4c007c00 | ((n) << 5) | (t))
+
+/*Load or store a field at a constant offset from a base register. Offsets
+  that do not fit the scaled 12 bit immediate go through x17*/
+static inline int
+arm64_ldst(uint8_t *code_block, int block_pos, uint32_t opcode, int size, int rt, int rn, uintptr_t offset)
+{
+    if (!(offset & ((1 << size) - 1)) && (offset >> size) < 0x1000)
+        addlong(opcode | ((offset >> size) << 10) | (rn << 5) | rt);
+    else {
+        addlong(ARM64_MOVZ_X(17, offset & 0xffff, 0));
+        if (offset >> 16)
+            addlong(ARM64_MOVK_X(17, (offset >> 16) & 0xffff, 1));
+        addlong(ARM64_LDST_REG(opcode, rt, rn, 17, EXTEND_LSL, 0));
+    }
+
+    return block_pos;
+}
+
+#define LOAD_STATE_W(reg, field)    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, reg, REG_STATE, offsetof(voodoo_state_t, field))
+#define STORE_STATE_W(reg, field)   block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, reg, REG_STATE, offsetof(voodoo_state_t, field))
+#define LOAD_STATE_X(reg, field)    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, reg, REG_STATE, offsetof(voodoo_state_t, field))
+#define LOAD_PARAMS_W(reg, field)   block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, reg, REG_PARAMS, offsetof(voodoo_params_t, field))
+#define LOAD_PARAMS_B(reg, field)   block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRB, 0, reg, REG_PARAMS, offsetof(voodoo_params_t, field))
+
+/*Load a 64 bit constant, usually the address of a table or counter*/
+static inline int
+arm64_mov_imm64(uint8_t *code_block, int block_pos, int reg, uint64_t val)
+{
+    addlong(ARM64_MOVZ_X(reg, val & 0xffff, 0));
+    for (uint8_t hw = 1; hw < 4; hw++) {
+        if ((val >> (hw * 16)) & 0xffff)
+            addlong(ARM64_MOVK_X(reg, (val >> (hw * 16)) & 0xffff, hw));
+    }
+
+    return block_pos;
+}
+
+/*Clamp a signed value to 0..max. Clobbers w17*/
+static inline int
+arm64_clamp(uint8_t *code_block, int block_pos, int reg, int max)
+{
+    addlong(ARM64_MOVZ_W(17, max, 0));
+    addlong(ARM64_CMP_W_IMM(reg, 0));
+    addlong(ARM64_CSEL_W(reg, REG_ZR, reg, COND_LT));
+    addlong(ARM64_CMP_W(reg, 17));
+    addlong(ARM64_CSEL_W(reg, 17, reg, COND_GT));
+
+    return block_pos;
+}
+
+/*CLAMP(iterator >> shift)*/
+static inline int
+arm64_iter_clamp(uint8_t *code_block, int block_pos, int reg, uintptr_t offset, int shift)
+{
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, reg, REG_STATE, offset);
+    addlong(ARM64_ASR_W_IMM(reg, reg, shift));
+    block_pos = arm64_clamp(code_block, block_pos, reg, 0xff);
+
+    return block_pos;
+}
+
+/*d = (n * m) / 255, for products up to 255 * 255*/
+static inline int
+arm64_mul_div255(uint8_t *code_block, int block_pos, int d, int n, int m)
+{
+    addlong(ARM64_MUL_W(d, n, m));
+    addlong(ARM64_ADD_W_SHIFT(d, d, d, SHIFT_LSR, 8));
+    addlong(ARM64_ADD_W_IMM(d, d, 1));
+    addlong(ARM64_LSR_W_IMM(d, d, 8));
+
+    return block_pos;
+}
+
+/*d = 255 - n*/
+static inline int
+arm64_inv255(uint8_t *code_block, int block_pos, int d, int n)
+{
+    addlong(ARM64_MOVZ_W(d, 0xff, 0));
+    addlong(ARM64_SUB_W(d, d, n));
+
+    return block_pos;
+}
+
+/*Increment one of the voodoo statistics counters. Clobbers w16 and x17*/
+static inline int
+arm64_inc_counter(uint8_t *code_block, int block_pos, uint32_t *counter)
+{
+    block_pos = arm64_mov_imm64(code_block, block_pos, 17, (uintptr_t) counter);
+    addlong(ARM64_LDR_W | (17 << 5) | 16);
+    addlong(ARM64_ADD_W_IMM(16, 16, 1));
+    addlong(ARM64_STR_W | (17 << 5) | 16);
+
+    return block_pos;
+}
+
+/*Fill in the target of a branch emitted at pos*/
+static inline void
+arm64_patch_branch(uint8_t *code_block, int pos, int target)
+{
+    uint32_t *insn   = (uint32_t *) &code_block[pos];
+    int       offset = (target - pos) >> 2;
+
+    if ((*insn & 0xfc000000) == ARM64_B)
+        *insn |= offset & 0x3ffffff;
+    else if ((*insn & 0x7e000000) == 0x36000000) /*TBZ/TBNZ*/
+        *insn |= (offset & 0x3fff) << 5;
+    else /*B.cond, CBZ/CBNZ*/
+        *insn |= (offset & 0x7ffff) << 5;
+}
+
+/*Wrap or clamp a texture coordinate against its mask*/
+static inline int
+arm64_tex_wrap(uint8_t *code_block, int block_pos, int reg, int mask, int clamp)
+{
+    if (clamp) {
+        addlong(ARM64_CMP_W_IMM(reg, 0));
+        addlong(ARM64_CSEL_W(reg, REG_ZR, reg, COND_LT));
+        addlong(ARM64_CMP_W(reg, mask));
+        addlong(ARM64_CSEL_W(reg, mask, reg, COND_GT));
+    } else
+        addlong(ARM64_AND_W(reg, reg, mask));
+
+    return block_pos;
+}
+
+/*(detail_bias - lod) << detail_scale, limited to detail_max. lod is in w14*/
+static inline int
+arm64_detail_factor(uint8_t *code_block, int block_pos, int reg, int tmp, int tmu)
+{
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, reg, REG_PARAMS, offsetof(voodoo_params_t, detail_bias[tmu]));
+    addlong(ARM64_SUB_W(reg, reg, 14));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, tmp, REG_PARAMS, offsetof(voodoo_params_t, detail_scale[tmu]));
+    addlong(ARM64_LSLV_W(reg, reg, tmp));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, tmp, REG_PARAMS, offsetof(voodoo_params_t, detail_max[tmu]));
+    addlong(ARM64_CMP_W(reg, tmp));
+    addlong(ARM64_CSEL_W(reg, tmp, reg, COND_GT));
+
+    return block_pos;
+}
+
+/*Turn blend factors into multipliers : optionally invert them (always, or only
+  on odd LODs when trilinear filtering), then add one. lod is in w14*/
+static inline int
+arm64_blend_factor(uint8_t *code_block, int block_pos, int *regs, int nr, int reverse, int trilinear)
+{
+    int trilinear_pos = 0;
+
+    if (reverse) {
+        for (int c = 0; c < nr; c++)
+            addlong(ARM64_EOR_W_MASK(regs[c], regs[c], 8));
+    }
+    if (trilinear) {
+        trilinear_pos = block_pos;
+        addlong(ARM64_TBZ(14, 0));
+        for (int c = 0; c < nr; c++)
+            addlong(ARM64_EOR_W_MASK(regs[c], regs[c], 8));
+        arm64_patch_branch(code_block, trilinear_pos, block_pos);
+    }
+    for (int c = 0; c < nr; c++)
+        addlong(ARM64_ADD_W_IMM(regs[c], regs[c], 1));
+
+    return block_pos;
+}
+
+/*Texture fetch for one TMU, equivalent to voodoo_tmu_fetch(). Leaves the
+  texel in state->tex_r/g/b/a[tmu] and the LOD in state->lod.
+  Preserves w4, w5 and x19-x28*/
+static inline int
+codegen_texture_fetch(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, int block_pos, int tmu)
+{
+    uintptr_t off_s = tmu ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s);
+    uintptr_t off_t = tmu ? offsetof(voodoo_state_t, tmu1_t) : offsetof(voodoo_state_t, tmu0_t);
+    uintptr_t off_w = tmu ? offsetof(voodoo_state_t, tmu1_w) : offsetof(voodoo_state_t, tmu0_w);
+    int       clamp_s = params->textureMode[tmu] & TEXTUREMODE_TCLAMPS;
+    int       clamp_t = params->textureMode[tmu] & TEXTUREMODE_TCLAMPT;
+    int       mirror_pos;
+
+    if (params->textureMode[tmu] & 1) {
+        /*_w = (1 << 48) / tmu_w. UDIV returns 0 for a zero divisor*/
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 16, REG_STATE, off_w);
+        addlong(ARM64_MOVZ_X(15, 1, 3));
+        addlong(ARM64_UDIV_X(16, 15, 16));
+        addlong(ARM64_MOVZ_X(17, 0x2000, 1)); /*1 << 29*/
+
+        /*tex_s = ((((tmu_s + (1 << 13)) >> 14) * _w) + (1 << 29)) >> 30*/
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 15, REG_STATE, off_s);
+        addlong(ARM64_ADD_X_IMM(15, 15, 1 << 13));
+        addlong(ARM64_ASR_X_IMM(15, 15, 14));
+        addlong(ARM64_MUL_X(15, 15, 16));
+        addlong(ARM64_ADD_X(15, 15, 17));
+        addlong(ARM64_ASR_X_IMM(15, 15, 30));
+        STORE_STATE_W(15, tex_s);
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 15, REG_STATE, off_t);
+        addlong(ARM64_ADD_X_IMM(15, 15, 1 << 13));
+        addlong(ARM64_ASR_X_IMM(15, 15, 14));
+        addlong(ARM64_MUL_X(15, 15, 16));
+        addlong(ARM64_ADD_X(15, 15, 17));
+        addlong(ARM64_ASR_X_IMM(15, 15, 30));
+        STORE_STATE_W(15, tex_t);
+
+        /*fastlog(_w). Shifting _w left by its leading zero count leaves the
+          eight fraction bits at 62:55*/
+        addlong(ARM64_CLZ_X(14, 16));
+        addlong(ARM64_LSLV_X(13, 16, 14));
+        addlong(ARM64_UBFX_X(13, 13, 55, 8));
+        block_pos = arm64_mov_imm64(code_block, block_pos, 12, (uintptr_t) logtable);
+        addlong(ARM64_LDST_REG(ARM64_LDRB, 13, 12, 13, EXTEND_LSL, 0));
+        addlong(ARM64_MOVZ_W(12, 63, 0));
+        addlong(ARM64_SUB_W(12, 12, 14));
+        addlong(ARM64_ORR_W_SHIFT(13, 13, 12, SHIFT_LSL, 8));
+        addlong(ARM64_MOVZ_W(12, 0x8000, 1));
+        addlong(ARM64_CMP_X_IMM(16, 0));
+        addlong(ARM64_CSEL_W(13, 12, 13, COND_EQ));
+
+        /*lod = tmu[tmu].lod + (fastlog(_w) - (19 << 8))*/
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 12, REG_STATE, offsetof(voodoo_state_t, tmu[tmu].lod));
+        addlong(ARM64_ADD_W(12, 12, 13));
+        addlong(ARM64_MOVZ_W(13, 19 << 8, 0));
+        addlong(ARM64_SUB_W(12, 12, 13));
+    } else {
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 15, REG_STATE, off_s);
+        addlong(ARM64_ASR_X_IMM(15, 15, 28));
+        STORE_STATE_W(15, tex_s);
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 15, REG_STATE, off_t);
+        addlong(ARM64_ASR_X_IMM(15, 15, 28));
+        STORE_STATE_W(15, tex_t);
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 12, REG_STATE, offsetof(voodoo_state_t, tmu[tmu].lod));
+    }
+
+    /*Clamp LOD to lod_min/lod_max, compared in the same order as the C code*/
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 13, REG_STATE, offsetof(voodoo_state_t, lod_min[tmu]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 14, REG_STATE, offsetof(voodoo_state_t, lod_max[tmu]));
+    addlong(ARM64_CMP_W(12, 14));
+    addlong(ARM64_CSEL_W(15, 14, 12, COND_GT));
+    addlong(ARM64_CMP_W(12, 13));
+    addlong(ARM64_CSEL_W(12, 13, 15, COND_LT));
+    addlong(ARM64_UBFX_W(13, 12, 0, 8));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 13, REG_STATE, offsetof(voodoo_state_t, lod_frac[tmu]));
+    addlong(ARM64_ASR_W_IMM(12, 12, 8));
+    STORE_STATE_W(12, lod);
+
+    /*w13 = tex_lod, w14 = w_mask, w11 = h_mask, x10 = texture data, w9 = tex_shift*/
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 13, REG_STATE, offsetof(voodoo_state_t, tex_lod[tmu]));
+    addlong(ARM64_LDST_REG(ARM64_LDR_W, 13, 13, 12, EXTEND_SXTW, 1));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 14, REG_STATE, offsetof(voodoo_state_t, tex_w_mask[tmu]));
+    addlong(ARM64_LDST_REG(ARM64_LDR_W, 14, 14, 12, EXTEND_SXTW, 1));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_X, 3, 11, REG_STATE, offsetof(voodoo_state_t, tex_h_mask[tmu]));
+    addlong(ARM64_LDST_REG(ARM64_LDR_W, 11, 11, 12, EXTEND_SXTW, 1));
+    addlong(ARM64_ADD_X_IMM(10, REG_STATE, offsetof(voodoo_state_t, tex[tmu][0])));
+    addlong(ARM64_LDST_REG(ARM64_LDR_X, 10, 10, 12, EXTEND_SXTW, 1));
+    addlong(ARM64_MOVZ_W(9, 8, 0));
+    addlong(ARM64_SUB_W(9, 9, 13));
+
+    LOAD_STATE_W(0, tex_s);
+    LOAD_STATE_W(1, tex_t);
+    if (params->tLOD[tmu] & LOD_TMIRROR_S) {
+        mirror_pos = block_pos;
+        addlong(ARM64_TBZ(0, 12));
+        addlong(ARM64_MVN_W(0, 0));
+        arm64_patch_branch(code_block, mirror_pos, block_pos);
+    }
+    if (params->tLOD[tmu] & LOD_TMIRROR_T) {
+        mirror_pos = block_pos;
+        addlong(ARM64_TBZ(1, 12));
+        addlong(ARM64_MVN_W(1, 1));
+        arm64_patch_branch(code_block, mirror_pos, block_pos);
+    }
+
+    if (voodoo->bilinear_enabled && (params->textureMode[tmu] & 6)) {
+        /*tex_s -= 1 << (3 + tex_lod), likewise tex_t*/
+        addlong(ARM64_ADD_W_IMM(15, 13, 3));
+        addlong(ARM64_MOVZ_W(16, 1, 0));
+        addlong(ARM64_LSLV_W(16, 16, 15));
+        addlong(ARM64_SUB_W(0, 0, 16));
+        addlong(ARM64_SUB_W(1, 1, 16));
+        STORE_STATE_W(0, tex_s);
+        STORE_STATE_W(1, tex_t);
+
+        /*w0/w1 = s/t, w2/w3 = ds/dt*/
+        addlong(ARM64_ASRV_W(0, 0, 13));
+        addlong(ARM64_ASRV_W(1, 1, 13));
+        addlong(ARM64_UBFX_W(2, 0, 0, 4));
+        addlong(ARM64_UBFX_W(3, 1, 0, 4));
+        addlong(ARM64_ASR_W_IMM(0, 0, 4));
+        addlong(ARM64_ASR_W_IMM(1, 1, 4));
+
+        /*v2/v3 = weights*/
+        addlong(ARM64_ORR_W_SHIFT(2, 2, 3, SHIFT_LSL, 4));
+        block_pos = arm64_mov_imm64(code_block, block_pos, 16, (uintptr_t) bilinear_lookup);
+        addlong(ARM64_ADD_X_SHIFT(16, 16, 2, SHIFT_LSL, 5));
+        addlong(ARM64_LDR_Q | (16 << 5) | 2);
+        addlong(ARM64_LDR_Q | (1 << 10) | (16 << 5) | 3);
+
+        /*Wrap or clamp each of s, s + 1, t and t + 1. For coordinates inside
+          the texture this is a no-op, so it matches tex_read_4()'s fast path*/
+        addlong(ARM64_ADD_W_IMM(2, 0, 1));
+        addlong(ARM64_ADD_W_IMM(3, 1, 1));
+        block_pos = arm64_tex_wrap(code_block, block_pos, 0, 14, clamp_s);
+        block_pos = arm64_tex_wrap(code_block, block_pos, 2, 14, clamp_s);
+        block_pos = arm64_tex_wrap(code_block, block_pos, 1, 11, clamp_t);
+        block_pos = arm64_tex_wrap(code_block, block_pos, 3, 11, clamp_t);
+        addlong(ARM64_LSLV_W(1, 1, 9));
+        addlong(ARM64_LSLV_W(3, 3, 9));
+
+        addlong(ARM64_ADD_W(6, 0, 1));
+        addlong(ARM64_LDST_REG(ARM64_LDR_W, 6, 10, 6, EXTEND_SXTW, 1));
+        addlong(ARM64_ADD_W(7, 2, 1));
+        addlong(ARM64_LDST_REG(ARM64_LDR_W, 7, 10, 7, EXTEND_SXTW, 1));
+        addlong(ARM64_ADD_W(8, 0, 3));
+        addlong(ARM64_LDST_REG(ARM64_LDR_W, 8, 10, 8, EXTEND_SXTW, 1));
+        addlong(ARM64_ADD_W(15, 2, 3));
+        addlong(ARM64_LDST_REG(ARM64_LDR_W, 15, 10, 15, EXTEND_SXTW, 1));
+
+        /*Weighted sum of the four texels. The weights add up to 256, so
+          every channel fits in 16 bits*/
+        addlong(ARM64_FMOV_S_W(0, 6));
+        addlong(ARM64_INS_S(0, 1, 7));
+        addlong(ARM64_INS_S(0, 2, 8));
+        addlong(ARM64_INS_S(0, 3, 15));
+        addlong(ARM64_UXTL_8H(1, 0));
+        addlong(ARM64_UXTL2_8H(0, 0));
+        addlong(ARM64_MUL_8H(1, 1, 2));
+        addlong(ARM64_MLA_8H(1, 0, 3));
+        addlong(ARM64_EXT_16B(0, 1, 1, 8));
+        addlong(ARM64_ADD_4H(1, 1, 0));
+        addlong(ARM64_USHR_4H(1, 1, 8));
+        addlong(ARM64_UMOV_H(0, 1, 0));
+        addlong(ARM64_UMOV_H(1, 1, 1));
+        addlong(ARM64_UMOV_H(2, 1, 2));
+        addlong(ARM64_UMOV_H(3, 1, 3));
+    } else {
+        if (params->tLOD[tmu] & LOD_TMIRROR_S)
+            STORE_STATE_W(0, tex_s);
+        if (params->tLOD[tmu] & LOD_TMIRROR_T)
+            STORE_STATE_W(1, tex_t);
+
+        addlong(ARM64_ADD_W_IMM(15, 13, 4));
+        addlong(ARM64_ASRV_W(0, 0, 15));
+        addlong(ARM64_ASRV_W(1, 1, 15));
+        block_pos = arm64_tex_wrap(code_block, block_pos, 0, 14, clamp_s);
+        block_pos = arm64_tex_wrap(code_block, block_pos, 1, 11, clamp_t);
+        addlong(ARM64_LSLV_W(1, 1, 9));
+        addlong(ARM64_ADD_W(0, 0, 1));
+        addlong(ARM64_LDST_REG(ARM64_LDR_W, 15, 10, 0, EXTEND_SXTW, 1));
+        addlong(ARM64_UBFX_W(0, 15, 0, 8));
+        addlong(ARM64_UBFX_W(1, 15, 8, 8));
+        addlong(ARM64_UBFX_W(2, 15, 16, 8));
+        addlong(ARM64_LSR_W_IMM(3, 15, 24));
+    }
+
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 0, REG_STATE, offsetof(voodoo_state_t, tex_b[tmu]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 1, REG_STATE, offsetof(voodoo_state_t, tex_g[tmu]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 2, REG_STATE, offsetof(voodoo_state_t, tex_r[tmu]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 3, REG_STATE, offsetof(voodoo_state_t, tex_a[tmu]));
+
+    return block_pos;
+}
+
+/*Texture fetch and blending for both TMUs, equivalent to
+  voodoo_tmu_fetch_and_blend()*/
+static inline int
+codegen_texture_fetch_and_blend(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, int block_pos)
+{
+    int regs[3];
+
+    block_pos = codegen_texture_fetch(code_block, voodoo, params, block_pos, 1);
+
+    if (tc_sub_clocal_1 || tca_sub_clocal_1) {
+        /*w0-w3 = TMU1 texel, w14 = lod*/
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 0, REG_STATE, offsetof(voodoo_state_t, tex_r[1]));
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 1, REG_STATE, offsetof(voodoo_state_t, tex_g[1]));
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 2, REG_STATE, offsetof(voodoo_state_t, tex_b[1]));
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 3, REG_STATE, offsetof(voodoo_state_t, tex_a[1]));
+        LOAD_STATE_W(14, lod);
+    }
+
+    if (tc_sub_clocal_1) {
+        int nr = 1;
+
+        regs[0] = 6;
+        regs[1] = 7;
+        regs[2] = 8;
+        switch (tc_mselect_1) {
+            case TC_MSELECT_CLOCAL:
+                addlong(ARM64_MOV_W(6, 0));
+                addlong(ARM64_MOV_W(7, 1));
+                addlong(ARM64_MOV_W(8, 2));
+                nr = 3;
+                break;
+            case TC_MSELECT_ALOCAL:
+                addlong(ARM64_MOV_W(6, 3));
+                break;
+            case TC_MSELECT_DETAIL:
+                block_pos = arm64_detail_factor(code_block, block_pos, 6, 15, 1);
+                break;
+            case TC_MSELECT_LOD_FRAC:
+                block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 6, REG_STATE, offsetof(voodoo_state_t, lod_frac[1]));
+                break;
+
+            default:
+                addlong(ARM64_MOVZ_W(6, 0, 0));
+                break;
+        }
+        block_pos = arm64_blend_factor(code_block, block_pos, regs, nr, !tc_reverse_blend, params->textureMode[1] & TEXTUREMODE_TRILINEAR);
+
+        for (int c = 0; c < 3; c++) {
+            static const uintptr_t tex_offset[3] = { offsetof(voodoo_state_t, tex_r[1]), offsetof(voodoo_state_t, tex_g[1]), offsetof(voodoo_state_t, tex_b[1]) };
+
+            addlong(ARM64_NEG_W(15, c));
+            addlong(ARM64_MUL_W(15, 15, regs[(nr == 3) ? c : 0]));
+            addlong(ARM64_ASR_W_IMM(15, 15, 8));
+            if (tc_add_clocal_1)
+                addlong(ARM64_ADD_W(15, 15, c));
+            else if (tc_add_alocal_1)
+                addlong(ARM64_ADD_W(15, 15, 3));
+            block_pos = arm64_clamp(code_block, block_pos, 15, 0xff);
+            block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 15, REG_STATE, tex_offset[c]);
+        }
+    }
+    if (tca_sub_clocal_1) {
+        regs[0] = 6;
+        switch (tca_mselect_1) {
+            case TCA_MSELECT_CLOCAL:
+            case TCA_MSELECT_ALOCAL:
+                addlong(ARM64_MOV_W(6, 3));
+                break;
+            case TCA_MSELECT_DETAIL:
+                block_pos = arm64_detail_factor(code_block, block_pos, 6, 15, 1);
+                break;
+            case TCA_MSELECT_LOD_FRAC:
+                block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 6, REG_STATE, offsetof(voodoo_state_t, lod_frac[1]));
+                break;
+
+            default:
+                addlong(ARM64_MOVZ_W(6, 0, 0));
+                break;
+        }
+        block_pos = arm64_blend_factor(code_block, block_pos, regs, 1, tca_reverse_blend, params->textureMode[1] & TEXTUREMODE_TRILINEAR);
+
+        addlong(ARM64_NEG_W(15, 3));
+        addlong(ARM64_MUL_W(15, 15, 6));
+        addlong(ARM64_ASR_W_IMM(15, 15, 8));
+        if (tca_add_clocal_1 || tca_add_alocal_1)
+            addlong(ARM64_ADD_W(15, 15, 3));
+        block_pos = arm64_clamp(code_block, block_pos, 15, 0xff);
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 15, REG_STATE, offsetof(voodoo_state_t, tex_a[1]));
+    }
+
+    block_pos = codegen_texture_fetch(code_block, voodoo, params, block_pos, 0);
+
+    /*w6-w9 = TMU0 texel, w10-w13 = TMU1 texel, w14 = lod*/
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 6, REG_STATE, offsetof(voodoo_state_t, tex_r[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 7, REG_STATE, offsetof(voodoo_state_t, tex_g[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 8, REG_STATE, offsetof(voodoo_state_t, tex_b[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 9, REG_STATE, offsetof(voodoo_state_t, tex_a[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 10, REG_STATE, offsetof(voodoo_state_t, tex_r[1]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 11, REG_STATE, offsetof(voodoo_state_t, tex_g[1]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 12, REG_STATE, offsetof(voodoo_state_t, tex_b[1]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 13, REG_STATE, offsetof(voodoo_state_t, tex_a[1]));
+    LOAD_STATE_W(14, lod);
+
+    /*Colour*/
+    for (int c = 0; c < 3; c++) {
+        if (tc_zero_other)
+            addlong(ARM64_MOVZ_W(c, 0, 0));
+        else
+            addlong(ARM64_MOV_W(c, 10 + c));
+        if (tc_sub_clocal)
+            addlong(ARM64_SUB_W(c, c, 6 + c));
+    }
+    {
+        int nr = 1;
+
+        regs[0] = 15;
+        regs[1] = 16;
+        regs[2] = 17;
+        switch (tc_mselect) {
+            case TC_MSELECT_CLOCAL:
+                addlong(ARM64_MOV_W(15, 6));
+                addlong(ARM64_MOV_W(16, 7));
+                addlong(ARM64_MOV_W(17, 8));
+                nr = 3;
+                break;
+            case TC_MSELECT_AOTHER:
+                addlong(ARM64_MOV_W(15, 13));
+                break;
+            case TC_MSELECT_ALOCAL:
+                addlong(ARM64_MOV_W(15, 9));
+                break;
+            case TC_MSELECT_DETAIL:
+                block_pos = arm64_detail_factor(code_block, block_pos, 15, 16, 0);
+                break;
+            case TC_MSELECT_LOD_FRAC:
+                block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 15, REG_STATE, offsetof(voodoo_state_t, lod_frac[0]));
+                break;
+
+            default:
+                addlong(ARM64_MOVZ_W(15, 0, 0));
+                break;
+        }
+        block_pos = arm64_blend_factor(code_block, block_pos, regs, nr, !tc_reverse_blend, params->textureMode[0] & TEXTUREMODE_TRILINEAR);
+
+        for (int c = 0; c < 3; c++) {
+            addlong(ARM64_MUL_W(c, c, regs[(nr == 3) ? c : 0]));
+            addlong(ARM64_ASR_W_IMM(c, c, 8));
+            if (tc_add_clocal)
+                addlong(ARM64_ADD_W(c, c, 6 + c));
+            else if (tc_add_alocal)
+                addlong(ARM64_ADD_W(c, c, 9));
+        }
+    }
+
+    /*Alpha*/
+    if (tca_zero_other)
+        addlong(ARM64_MOVZ_W(3, 0, 0));
+    else
+        addlong(ARM64_MOV_W(3, 13));
+    if (tca_sub_clocal)
+        addlong(ARM64_SUB_W(3, 3, 9));
+    regs[0] = 15;
+    switch (tca_mselect) {
+        case TCA_MSELECT_CLOCAL:
+        case TCA_MSELECT_ALOCAL:
+            addlong(ARM64_MOV_W(15, 9));
+            break;
+        case TCA_MSELECT_AOTHER:
+            addlong(ARM64_MOV_W(15, 13));
+            break;
+        case TCA_MSELECT_DETAIL:
+            block_pos = arm64_detail_factor(code_block, block_pos, 15, 16, 0);
+            break;
+        case TCA_MSELECT_LOD_FRAC:
+            block_pos = arm64_ldst(code_block, block_pos, ARM64_LDR_W, 2, 15, REG_STATE, offsetof(voodoo_state_t, lod_frac[0]));
+            break;
+
+        default:
+            addlong(ARM64_MOVZ_W(15, 0, 0));
+            break;
+    }
+    block_pos = arm64_blend_factor(code_block, block_pos, regs, 1, !tca_reverse_blend, params->textureMode[0] & TEXTUREMODE_TRILINEAR);
+    addlong(ARM64_MUL_W(3, 3, 15));
+    addlong(ARM64_ASR_W_IMM(3, 3, 8));
+    if (tca_add_clocal || tca_add_alocal)
+        addlong(ARM64_ADD_W(3, 3, 9));
+
+    for (int c = 0; c < 4; c++) {
+        block_pos = arm64_clamp(code_block, block_pos, c, 0xff);
+        if ((c < 3) ? tc_invert_output : tca_invert_output)
+            addlong(ARM64_EOR_W_MASK(c, c, 8));
+    }
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 0, REG_STATE, offsetof(voodoo_state_t, tex_r[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 1, REG_STATE, offsetof(voodoo_state_t, tex_g[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 2, REG_STATE, offsetof(voodoo_state_t, tex_b[0]));
+    block_pos = arm64_ldst(code_block, block_pos, ARM64_STR_W, 2, 3, REG_STATE, offsetof(voodoo_state_t, tex_a[0]));
+
+    return block_pos;
+}
+
+/*Returns the size of the generated code, or 0 if this pipeline state is not
+  supported and the C renderer should be used instead*/
+static inline int
+voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int depthop)
+{
+    int block_pos     = 0;
+    int skip_pos[SKIP_MAX];
+    int skip_nr       = 0;
+    int loop_jump_pos = 0;
+    int fb_idx        = params->col_tiled ? REG_X_TILED : REG_X;
+    int aux_idx       = params->aux_tiled ? REG_X_TILED : REG_X;
+    int need_w_depth  = (params->fbzMode & FBZ_W_BUFFER) || (params->fogMode & (FOG_ENABLE | FOG_CONSTANT | FOG_Z | FOG_ALPHA)) == FOG_ENABLE;
+    int texels;
+    int pos;
+    int pos2;
+
+    /*These combinations make the C renderer bail out with fatal()*/
+    if (cca_localselect == 3 || a_sel == A_SEL_LFB || cc_mselect > CC_MSELECT_TEXRGB || cca_mselect > CCA_MSELECT_TEX || cc_add == 3)
+        return 0;
+
+    if ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH || (params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL)
+        texels = 1;
+    else
+        texels = 2;
+
+    addlong(ARM64_STP_X_PREIDX(29, 30, REG_SP, -96));
+    addlong(ARM64_STP_X(19, 20, REG_SP, 16));
+    addlong(ARM64_STP_X(21, 22, REG_SP, 32));
+    addlong(ARM64_STP_X(23, 24, REG_SP, 48));
+    addlong(ARM64_STP_X(25, 26, REG_SP, 64));
+    addlong(ARM64_STP_X(27, 28, REG_SP, 80));
+
+    addlong(ARM64_MOV_X(REG_STATE, 0));
+    addlong(ARM64_MOV_X(REG_PARAMS, 1));
+    addlong(ARM64_MOV_W(REG_REAL_Y, 3));
+    LOAD_STATE_X(REG_FB_MEM, fb_mem);
+    LOAD_STATE_X(REG_AUX_MEM, aux_mem);
+    LOAD_STATE_W(REG_X, x);
+    LOAD_STATE_W(REG_X2, x2);
+    if (dither) {
+        block_pos = arm64_mov_imm64(code_block, block_pos, REG_DITHER_RB, dither2x2 ? (uintptr_t) dither_rb2x2 : (uintptr_t) dither_rb);
+        block_pos = arm64_mov_imm64(code_block, block_pos, REG_DITHER_G, dither2x2 ? (uintptr_t) dither_g2x2 : (uintptr_t) dither_g);
+    }
+
+    loop_jump_pos = block_pos;
+
+    if (params->col_tiled || params->aux_tiled) {
+        /*x_tiled = (x & 63) | ((x >> 6) * 128 * 32 / 2)*/
+        addlong(ARM64_ASR_W_IMM(15, REG_X, 6));
+        addlong(ARM64_UBFX_W(REG_X_TILED, REG_X, 0, 6));
+        addlong(ARM64_ORR_W_SHIFT(REG_X_TILED, REG_X_TILED, 15, SHIFT_LSL, 11));
+    }
+    STORE_STATE_W(REG_X, x);
+
+    if (need_w_depth) {
+        LOAD_STATE_X(15, w);
+        addlong(ARM64_UBFX_X(16, 15, 32, 16));
+        pos = block_pos;
+        addlong(ARM64_CBNZ_X(16));
+        addlong(ARM64_UBFX_W(17, 15, 16, 16));
+        pos2 = block_pos;
+        addlong(ARM64_CBZ_W(17));
+
+        /*exp = voodoo_fls(w >> 16), mant = (~w >> (19 - exp)) & 0xfff*/
+        addlong(ARM64_CLZ_X(16, 17));
+        addlong(ARM64_SUB_W_IMM(16, 16, 48));
+        addlong(ARM64_MVN_W(15, 15));
+        addlong(ARM64_MOVZ_W(17, 19, 0));
+        addlong(ARM64_SUB_W(17, 17, 16));
+        addlong(ARM64_LSRV_W(15, 15, 17));
+        addlong(ARM64_UBFX_W(15, 15, 0, 12));
+        addlong(ARM64_LSL_W_IMM(4, 16, 12));
+        addlong(ARM64_ADD_W(4, 4, 15));
+        addlong(ARM64_ADD_W_IMM(4, 4, 1));
+        addlong(ARM64_MOVZ_W(17, 0xffff, 0));
+        addlong(ARM64_CMP_W(4, 17));
+        addlong(ARM64_CSEL_W(4, 17, 4, COND_GT));
+        addlong(ARM64_B | 4); /*Skip the two cases below*/
+
+        arm64_patch_branch(code_block, pos, block_pos);
+        addlong(ARM64_MOVZ_W(4, 0, 0));
+        addlong(ARM64_B | 2);
+
+        arm64_patch_branch(code_block, pos2, block_pos);
+        addlong(ARM64_MOVZ_W(4, 0xf001, 0));
+    }
+
+    if (params->fbzMode & FBZ_STIPPLE) {
+        if (params->fbzMode & FBZ_STIPPLE_PATT) {
+            /*index = ((real_y & 3) << 3) | (~x & 7)*/
+            addlong(ARM64_UBFX_W(15, REG_REAL_Y, 0, 2));
+            addlong(ARM64_MVN_W(16, REG_X));
+            addlong(ARM64_AND_W_MASK(16, 16, 3));
+            addlong(ARM64_ORR_W_SHIFT(15, 16, 15, SHIFT_LSL, 3));
+            LOAD_STATE_W(16, stipple);
+            addlong(ARM64_LSRV_W(16, 16, 15));
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_TBZ(16, 0));
+        } else {
+            LOAD_STATE_W(16, stipple);
+            addlong(ARM64_ROR_W_IMM(16, 16, 31));
+            STORE_STATE_W(16, stipple);
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_TBZ(16, 31));
+        }
+    }
+
+    if (params->fbzMode & FBZ_W_BUFFER)
+        addlong(ARM64_MOV_W(5, 4));
+    else {
+        LOAD_STATE_W(5, z);
+        addlong(ARM64_ASR_W_IMM(5, 5, 12));
+        block_pos = arm64_clamp(code_block, block_pos, 5, 0xffff);
+    }
+    if (params->fbzMode & FBZ_DEPTH_BIAS) {
+        block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRSH_W, 1, 15, REG_PARAMS, offsetof(voodoo_params_t, zaColor));
+        addlong(ARM64_ADD_W(5, 5, 15));
+        block_pos = arm64_clamp(code_block, block_pos, 5, 0xffff);
+    }
+
+    if (params->fbzMode & FBZ_DEPTH_ENABLE) {
+        int comp = 5;
+
+        if (params->fbzMode & FBZ_DEPTH_SOURCE) {
+            block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRH, 1, 16, REG_PARAMS, offsetof(voodoo_params_t, zaColor));
+            comp      = 16;
+        }
+        if (depthop == DEPTHOP_NEVER) {
+            block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiZFuncFail);
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_B);
+        } else if (depthop != DEPTHOP_ALWAYS) {
+            static const int depth_cond[8] = { 0, COND_LO, COND_EQ, COND_LS, COND_HI, COND_NE, COND_HS, 0 };
+
+            addlong(ARM64_LDST_REG(ARM64_LDRH, 15, REG_AUX_MEM, aux_idx, EXTEND_SXTW, 1));
+            addlong(ARM64_CMP_W(comp, 15));
+            pos = block_pos;
+            addlong(ARM64_BCOND(depth_cond[depthop]));
+            block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiZFuncFail);
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_B);
+            arm64_patch_branch(code_block, pos, block_pos);
+        }
+    }
+
+    if (params->fbzColorPath & FBZCP_TEXTURE_ENABLED) {
+        if ((params->textureMode[0] & TEXTUREMODE_LOCAL_MASK) == TEXTUREMODE_LOCAL || !voodoo->dual_tmus) {
+            /*TMU0 only sampling local colour or only one TMU, only sample TMU0*/
+            block_pos = codegen_texture_fetch(code_block, voodoo, params, block_pos, 0);
+        } else if ((params->textureMode[0] & TEXTUREMODE_MASK) == TEXTUREMODE_PASSTHROUGH) {
+            /*TMU0 in pass-through mode, only sample TMU1*/
+            block_pos = codegen_texture_fetch(code_block, voodoo, params, block_pos, 1);
+            STORE_STATE_W(0, tex_b[0]);
+            STORE_STATE_W(1, tex_g[0]);
+            STORE_STATE_W(2, tex_r[0]);
+            STORE_STATE_W(3, tex_a[0]);
+        } else
+            block_pos = codegen_texture_fetch_and_blend(code_block, voodoo, params, block_pos);
+    }
+
+    if (voodoo->trexInit1[0] & (1 << 18)) {
+        STORE_STATE_W(REG_ZR, tex_r[0]);
+        STORE_STATE_W(REG_ZR, tex_g[0]);
+        block_pos = arm64_mov_imm64(code_block, block_pos, 15, (uintptr_t) &voodoo->tmuConfig);
+        addlong(ARM64_LDR_W | (15 << 5) | 15);
+        STORE_STATE_W(15, tex_b[0]);
+    }
+
+    if (params->alphaMode & (1 << 4)) {
+        /*Destination colour is only needed for alpha blending*/
+        addlong(ARM64_LDST_REG(ARM64_LDRH, 15, REG_FB_MEM, fb_idx, EXTEND_SXTW, 1));
+        addlong(ARM64_UBFX_W(6, 15, 11, 5));
+        addlong(ARM64_LSL_W_IMM(6, 6, 3));
+        addlong(ARM64_ORR_W_SHIFT(6, 6, 6, SHIFT_LSR, 5));
+        addlong(ARM64_UBFX_W(7, 15, 5, 6));
+        addlong(ARM64_LSL_W_IMM(7, 7, 2));
+        addlong(ARM64_ORR_W_SHIFT(7, 7, 7, SHIFT_LSR, 6));
+        addlong(ARM64_UBFX_W(8, 15, 0, 5));
+        addlong(ARM64_LSL_W_IMM(8, 8, 3));
+        addlong(ARM64_ORR_W_SHIFT(8, 8, 8, SHIFT_LSR, 5));
+        if (params->fbzMode & FBZ_ALPHA_ENABLE) {
+            addlong(ARM64_LDST_REG(ARM64_LDRH, 9, REG_AUX_MEM, aux_idx, EXTEND_SXTW, 1));
+            addlong(ARM64_AND_W_MASK(9, 9, 8));
+        } else
+            addlong(ARM64_MOVZ_W(9, 0xff, 0));
+    }
+
+    /*clocal*/
+    if (cc_localselect_override || !cc_localselect) {
+        block_pos = arm64_iter_clamp(code_block, block_pos, 10, offsetof(voodoo_state_t, ir), 12);
+        block_pos = arm64_iter_clamp(code_block, block_pos, 11, offsetof(voodoo_state_t, ig), 12);
+        block_pos = arm64_iter_clamp(code_block, block_pos, 12, offsetof(voodoo_state_t, ib), 12);
+    }
+    if (cc_localselect_override || cc_localselect) {
+        pos = 0;
+        if (cc_localselect_override) {
+            LOAD_STATE_W(15, tex_a[0]);
+            pos = block_pos;
+            addlong(ARM64_TBZ(15, 7));
+        }
+        LOAD_PARAMS_W(15, color0);
+        addlong(ARM64_UBFX_W(10, 15, 16, 8));
+        addlong(ARM64_UBFX_W(11, 15, 8, 8));
+        addlong(ARM64_UBFX_W(12, 15, 0, 8));
+        if (pos)
+            arm64_patch_branch(code_block, pos, block_pos);
+    }
+
+    /*cother, straight into src_r/g/b*/
+    switch (_rgb_sel) {
+        case CC_LOCALSELECT_ITER_RGB:
+            block_pos = arm64_iter_clamp(code_block, block_pos, 0, offsetof(voodoo_state_t, ir), 12);
+            block_pos = arm64_iter_clamp(code_block, block_pos, 1, offsetof(voodoo_state_t, ig), 12);
+            block_pos = arm64_iter_clamp(code_block, block_pos, 2, offsetof(voodoo_state_t, ib), 12);
+            break;
+        case CC_LOCALSELECT_TEX:
+            LOAD_STATE_W(0, tex_r[0]);
+            LOAD_STATE_W(1, tex_g[0]);
+            LOAD_STATE_W(2, tex_b[0]);
+            addlong(ARM64_AND_W_MASK(2, 2, 8)); /*tex_b may hold tmuConfig*/
+            break;
+        case CC_LOCALSELECT_COLOR1:
+            LOAD_PARAMS_W(15, color1);
+            addlong(ARM64_UBFX_W(0, 15, 16, 8));
+            addlong(ARM64_UBFX_W(1, 15, 8, 8));
+            addlong(ARM64_UBFX_W(2, 15, 0, 8));
+            break;
+        case CC_LOCALSELECT_LFB:
+            addlong(ARM64_MOVZ_W(0, 0, 0));
+            addlong(ARM64_MOVZ_W(1, 0, 0));
+            addlong(ARM64_MOVZ_W(2, 0, 0));
+            break;
+
+        default:
+            break;
+    }
+
+    if (params->fbzMode & FBZ_CHROMAKEY) {
+        int pos_r;
+        int pos_g;
+        int pos_b;
+
+        LOAD_PARAMS_W(15, chromaKey_r);
+        addlong(ARM64_CMP_W(0, 15));
+        pos_r = block_pos;
+        addlong(ARM64_BCOND(COND_NE));
+        LOAD_PARAMS_W(15, chromaKey_g);
+        addlong(ARM64_CMP_W(1, 15));
+        pos_g = block_pos;
+        addlong(ARM64_BCOND(COND_NE));
+        LOAD_PARAMS_W(15, chromaKey_b);
+        addlong(ARM64_CMP_W(2, 15));
+        pos_b = block_pos;
+        addlong(ARM64_BCOND(COND_NE));
+        block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiChromaFail);
+        skip_pos[skip_nr++] = block_pos;
+        addlong(ARM64_B);
+        arm64_patch_branch(code_block, pos_r, block_pos);
+        arm64_patch_branch(code_block, pos_g, block_pos);
+        arm64_patch_branch(code_block, pos_b, block_pos);
+    }
+
+    switch (cca_localselect) {
+        case CCA_LOCALSELECT_ITER_A:
+            block_pos = arm64_iter_clamp(code_block, block_pos, 13, offsetof(voodoo_state_t, ia), 12);
+            break;
+        case CCA_LOCALSELECT_COLOR0:
+            LOAD_PARAMS_W(13, color0);
+            addlong(ARM64_LSR_W_IMM(13, 13, 24));
+            break;
+        case CCA_LOCALSELECT_ITER_Z:
+            block_pos = arm64_iter_clamp(code_block, block_pos, 13, offsetof(voodoo_state_t, z), 20);
+            break;
+
+        default:
+            break;
+    }
+
+    switch (a_sel) {
+        case A_SEL_ITER_A:
+            block_pos = arm64_iter_clamp(code_block, block_pos, 14, offsetof(voodoo_state_t, ia), 12);
+            break;
+        case A_SEL_TEX:
+            LOAD_STATE_W(14, tex_a[0]);
+            break;
+        case A_SEL_COLOR1:
+            LOAD_PARAMS_W(14, color1);
+            addlong(ARM64_LSR_W_IMM(14, 14, 24));
+            break;
+
+        default:
+            break;
+    }
+
+    if (params->fbzMode & FBZ_ALPHA_MASK) {
+        skip_pos[skip_nr++] = block_pos;
+        addlong(ARM64_TBZ(14, 0));
+    }
+
+    /*Colour combine*/
+    if (cc_zero_other) {
+        addlong(ARM64_MOVZ_W(0, 0, 0));
+        addlong(ARM64_MOVZ_W(1, 0, 0));
+        addlong(ARM64_MOVZ_W(2, 0, 0));
+    }
+    if (cca_zero_other)
+        addlong(ARM64_MOVZ_W(3, 0, 0));
+    else
+        addlong(ARM64_MOV_W(3, 14));
+
+    if (cc_sub_clocal) {
+        addlong(ARM64_SUB_W(0, 0, 10));
+        addlong(ARM64_SUB_W(1, 1, 11));
+        addlong(ARM64_SUB_W(2, 2, 12));
+    }
+    if (cca_sub_clocal)
+        addlong(ARM64_SUB_W(3, 3, 13));
+
+    switch (cc_mselect) {
+        case CC_MSELECT_ZERO:
+            addlong(ARM64_MOVZ_W(15, 0, 0));
+            addlong(ARM64_MOVZ_W(16, 0, 0));
+            addlong(ARM64_MOVZ_W(17, 0, 0));
+            break;
+        case CC_MSELECT_CLOCAL:
+            addlong(ARM64_MOV_W(15, 10));
+            addlong(ARM64_MOV_W(16, 11));
+            addlong(ARM64_MOV_W(17, 12));
+            break;
+        case CC_MSELECT_AOTHER:
+            addlong(ARM64_MOV_W(15, 14));
+            addlong(ARM64_MOV_W(16, 14));
+            addlong(ARM64_MOV_W(17, 14));
+            break;
+        case CC_MSELECT_ALOCAL:
+            addlong(ARM64_MOV_W(15, 13));
+            addlong(ARM64_MOV_W(16, 13));
+            addlong(ARM64_MOV_W(17, 13));
+            break;
+        case CC_MSELECT_TEX:
+            LOAD_STATE_W(15, tex_a[0]);
+            addlong(ARM64_MOV_W(16, 15));
+            addlong(ARM64_MOV_W(17, 15));
+            break;
+        case CC_MSELECT_TEXRGB:
+            LOAD_STATE_W(15, tex_r[0]);
+            LOAD_STATE_W(16, tex_g[0]);
+            LOAD_STATE_W(17, tex_b[0]);
+            break;
+
+        default:
+            break;
+    }
+    for (int c = 0; c < 3; c++) {
+        if (!cc_reverse_blend)
+            addlong(ARM64_EOR_W_MASK(15 + c, 15 + c, 8));
+        addlong(ARM64_ADD_W_IMM(15 + c, 15 + c, 1));
+        addlong(ARM64_MUL_W(c, c, 15 + c));
+        addlong(ARM64_ASR_W_IMM(c, c, 8));
+    }
+
+    switch (cca_mselect) {
+        case CCA_MSELECT_ZERO:
+            addlong(ARM64_MOVZ_W(15, 0, 0));
+            break;
+        case CCA_MSELECT_ALOCAL:
+        case CCA_MSELECT_ALOCAL2:
+            addlong(ARM64_MOV_W(15, 13));
+            break;
+        case CCA_MSELECT_AOTHER:
+            addlong(ARM64_MOV_W(15, 14));
+            break;
+        case CCA_MSELECT_TEX:
+            LOAD_STATE_W(15, tex_a[0]);
+            break;
+
+        default:
+            break;
+    }
+    if (!cca_reverse_blend)
+        addlong(ARM64_EOR_W_MASK(15, 15, 8));
+    addlong(ARM64_ADD_W_IMM(15, 15, 1));
+    addlong(ARM64_MUL_W(3, 3, 15));
+    addlong(ARM64_ASR_W_IMM(3, 3, 8));
+
+    if (cc_add == CC_ADD_CLOCAL) {
+        addlong(ARM64_ADD_W(0, 0, 10));
+        addlong(ARM64_ADD_W(1, 1, 11));
+        addlong(ARM64_ADD_W(2, 2, 12));
+    } else if (cc_add == CC_ADD_ALOCAL) {
+        addlong(ARM64_ADD_W(0, 0, 13));
+        addlong(ARM64_ADD_W(1, 1, 13));
+        addlong(ARM64_ADD_W(2, 2, 13));
+    }
+    if (cca_add)
+        addlong(ARM64_ADD_W(3, 3, 13));
+
+    for (int c = 0; c < 4; c++) {
+        block_pos = arm64_clamp(code_block, block_pos, c, 0xff);
+        if ((c < 3) ? cc_invert_output : cca_invert_output)
+            addlong(ARM64_EOR_W_MASK(c, c, 8));
+    }
+
+    if ((params->alphaMode & (1 << 4)) && dest_afunc == AFUNC_ACOLORBEFOREFOG) {
+        addlong(ARM64_MOV_W(10, 0));
+        addlong(ARM64_MOV_W(11, 1));
+        addlong(ARM64_MOV_W(12, 2));
+    }
+
+    if (params->fogMode & FOG_ENABLE) {
+        if (params->fogMode & FOG_CONSTANT) {
+            LOAD_PARAMS_B(15, fogColor.r);
+            LOAD_PARAMS_B(16, fogColor.g);
+            LOAD_PARAMS_B(17, fogColor.b);
+            addlong(ARM64_ADD_W(0, 0, 15));
+            addlong(ARM64_ADD_W(1, 1, 16));
+            addlong(ARM64_ADD_W(2, 2, 17));
+        } else {
+            /*fog_a in w13*/
+            switch (params->fogMode & (FOG_Z | FOG_ALPHA)) {
+                case 0:
+                    addlong(ARM64_UBFX_W(14, 4, 10, 6));
+                    addlong(ARM64_ADD_X_SHIFT(14, REG_PARAMS, 14, SHIFT_LSL, 1));
+                    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRB, 0, 13, 14, offsetof(voodoo_params_t, fogTable[0].fog));
+                    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRB, 0, 15, 14, offsetof(voodoo_params_t, fogTable[0].dfog));
+                    addlong(ARM64_UBFX_W(16, 4, 2, 8));
+                    addlong(ARM64_MUL_W(15, 15, 16));
+                    addlong(ARM64_ADD_W_SHIFT(13, 13, 15, SHIFT_ASR, 10));
+                    break;
+                case FOG_Z:
+                    LOAD_STATE_W(13, z);
+                    addlong(ARM64_UBFX_W(13, 13, 20, 8));
+                    break;
+                case FOG_ALPHA:
+                    block_pos = arm64_iter_clamp(code_block, block_pos, 13, offsetof(voodoo_state_t, ia), 12);
+                    break;
+                case FOG_W:
+                    block_pos = arm64_ldst(code_block, block_pos, ARM64_LDRB, 0, 13, REG_STATE, offsetof(voodoo_state_t, w) + 4);
+                    break;
+
+                default:
+                    break;
+            }
+            addlong(ARM64_ADD_W_IMM(13, 13, 1));
+
+            if (params->fogMode & FOG_ADD) {
+                addlong(ARM64_MOVZ_W(15, 0, 0));
+                addlong(ARM64_MOVZ_W(16, 0, 0));
+                addlong(ARM64_MOVZ_W(17, 0, 0));
+            } else {
+                LOAD_PARAMS_B(15, fogColor.r);
+                LOAD_PARAMS_B(16, fogColor.g);
+                LOAD_PARAMS_B(17, fogColor.b);
+            }
+            for (int c = 0; c < 3; c++) {
+                if (!(params->fogMode & FOG_MULT))
+                    addlong(ARM64_SUB_W(15 + c, 15 + c, c));
+                addlong(ARM64_MUL_W(15 + c, 15 + c, 13));
+                addlong(ARM64_ASR_W_IMM(15 + c, 15 + c, 8));
+                if (params->fogMode & FOG_MULT)
+                    addlong(ARM64_MOV_W(c, 15 + c));
+                else
+                    addlong(ARM64_ADD_W(c, c, 15 + c));
+            }
+        }
+        block_pos = arm64_clamp(code_block, block_pos, 0, 0xff);
+        block_pos = arm64_clamp(code_block, block_pos, 1, 0xff);
+        block_pos = arm64_clamp(code_block, block_pos, 2, 0xff);
+    }
+
+    if (params->alphaMode & 1) {
+        if (alpha_func == AFUNC_NEVER) {
+            block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiAFuncFail);
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_B);
+        } else if (alpha_func != AFUNC_ALWAYS) {
+            static const int alpha_cond[8] = { 0, COND_LO, COND_EQ, COND_LS, COND_HI, COND_NE, COND_HS, 0 };
+
+            addlong(ARM64_CMP_W_IMM(3, a_ref));
+            pos = block_pos;
+            addlong(ARM64_BCOND(alpha_cond[alpha_func]));
+            block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiAFuncFail);
+            skip_pos[skip_nr++] = block_pos;
+            addlong(ARM64_B);
+            arm64_patch_branch(code_block, pos, block_pos);
+        }
+    }
+
+    if (params->alphaMode & (1 << 4)) {
+        if (dithersub && voodoo->dithersub_enabled) {
+            int shift = dither2x2 ? 2 : 4;
+
+            /*w15 = row/column index into the subtraction tables*/
+            if (dither2x2) {
+                addlong(ARM64_UBFX_W(15, REG_REAL_Y, 0, 1));
+                addlong(ARM64_UBFX_W(16, REG_X, 0, 1));
+                addlong(ARM64_ORR_W_SHIFT(15, 16, 15, SHIFT_LSL, 1));
+                block_pos = arm64_mov_imm64(code_block, block_pos, 16, (uintptr_t) dithersub_rb2x2);
+                block_pos = arm64_mov_imm64(code_block, block_pos, 17, (uintptr_t) dithersub_g2x2);
+            } else {
+                addlong(ARM64_UBFX_W(15, REG_REAL_Y, 0, 2));
+                addlong(ARM64_UBFX_W(16, REG_X, 0, 2));
+                addlong(ARM64_ORR_W_SHIFT(15, 16, 15, SHIFT_LSL, 2));
+                block_pos = arm64_mov_imm64(code_block, block_pos, 16, (uintptr_t) dithersub_rb);
+                block_pos = arm64_mov_imm64(code_block, block_pos, 17, (uintptr_t) dithersub_g);
+            }
+            addlong(ARM64_ADD_W_SHIFT(13, 15, 6, SHIFT_LSL, shift));
+            addlong(ARM64_LDST_REG(ARM64_LDRB, 6, 16, 13, EXTEND_LSL, 0));
+            addlong(ARM64_ADD_W_SHIFT(13, 15, 7, SHIFT_LSL, shift));
+            addlong(ARM64_LDST_REG(ARM64_LDRB, 7, 17, 13, EXTEND_LSL, 0));
+            addlong(ARM64_ADD_W_SHIFT(13, 15, 8, SHIFT_LSL, shift));
+            addlong(ARM64_LDST_REG(ARM64_LDRB, 8, 16, 13, EXTEND_LSL, 0));
+        }
+
+        /*newdest_r/g/b in w15-w17*/
+        switch (dest_afunc) {
+            case AFUNC_ASRC_ALPHA:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 3);
+                break;
+            case AFUNC_A_COLOR:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, c);
+                break;
+            case AFUNC_ADST_ALPHA:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 9);
+                break;
+            case AFUNC_AONE:
+                for (int c = 0; c < 3; c++)
+                    addlong(ARM64_MOV_W(15 + c, 6 + c));
+                break;
+            case AFUNC_AOMSRC_ALPHA:
+                block_pos = arm64_inv255(code_block, block_pos, 13, 3);
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 13);
+                break;
+            case AFUNC_AOM_COLOR:
+                for (int c = 0; c < 3; c++) {
+                    block_pos = arm64_inv255(code_block, block_pos, 13, c);
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 13);
+                }
+                break;
+            case AFUNC_AOMDST_ALPHA:
+                block_pos = arm64_inv255(code_block, block_pos, 13, 9);
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 13);
+                break;
+            case AFUNC_ACOLORBEFOREFOG:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, 15 + c, 6 + c, 10 + c);
+                break;
+
+            default:
+                for (int c = 0; c < 3; c++)
+                    addlong(ARM64_MOVZ_W(15 + c, 0, 0));
+                break;
+        }
+
+        switch (src_afunc) {
+            case AFUNC_AZERO:
+                for (int c = 0; c < 3; c++)
+                    addlong(ARM64_MOVZ_W(c, 0, 0));
+                break;
+            case AFUNC_ASRC_ALPHA:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 3);
+                break;
+            case AFUNC_A_COLOR:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 6 + c);
+                break;
+            case AFUNC_ADST_ALPHA:
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 9);
+                break;
+            case AFUNC_AOMSRC_ALPHA:
+                block_pos = arm64_inv255(code_block, block_pos, 13, 3);
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 13);
+                break;
+            case AFUNC_AOM_COLOR:
+                for (int c = 0; c < 3; c++) {
+                    block_pos = arm64_inv255(code_block, block_pos, 13, 6 + c);
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 13);
+                }
+                break;
+            case AFUNC_AOMDST_ALPHA:
+                block_pos = arm64_inv255(code_block, block_pos, 13, 9);
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, c, 13);
+                break;
+            case AFUNC_ASATURATE:
+                block_pos = arm64_inv255(code_block, block_pos, 13, 9);
+                addlong(ARM64_CMP_W(3, 13));
+                addlong(ARM64_CSEL_W(13, 3, 13, COND_LT));
+                for (int c = 0; c < 3; c++)
+                    block_pos = arm64_mul_div255(code_block, block_pos, c, 6 + c, 13);
+                break;
+
+            default:
+                break;
+        }
+
+        for (int c = 0; c < 3; c++)
+            addlong(ARM64_ADD_W(c, c, 15 + c));
+        for (int c = 0; c < 3; c++)
+            block_pos = arm64_clamp(code_block, block_pos, c, 0xff);
+
+        if (dest_aafunc == 4 && src_aafunc == 4)
+            addlong(ARM64_ADD_W(3, 3, 9));
+        else if (dest_aafunc == 4)
+            addlong(ARM64_MOV_W(3, 9));
+        else if (src_aafunc != 4)
+            addlong(ARM64_MOVZ_W(3, 0, 0));
+    }
+
+    if (dither) {
+        int shift = dither2x2 ? 2 : 4;
+
+        if (dither2x2) {
+            addlong(ARM64_UBFX_W(15, REG_REAL_Y, 0, 1));
+            addlong(ARM64_UBFX_W(16, REG_X, 0, 1));
+            addlong(ARM64_ORR_W_SHIFT(15, 16, 15, SHIFT_LSL, 1));
+        } else {
+            addlong(ARM64_UBFX_W(15, REG_REAL_Y, 0, 2));
+            addlong(ARM64_UBFX_W(16, REG_X, 0, 2));
+            addlong(ARM64_ORR_W_SHIFT(15, 16, 15, SHIFT_LSL, 2));
+        }
+        addlong(ARM64_ADD_W_SHIFT(16, 15, 0, SHIFT_LSL, shift));
+        addlong(ARM64_LDST_REG(ARM64_LDRB, 0, REG_DITHER_RB, 16, EXTEND_LSL, 0));
+        addlong(ARM64_ADD_W_SHIFT(16, 15, 1, SHIFT_LSL, shift));
+        addlong(ARM64_LDST_REG(ARM64_LDRB, 1, REG_DITHER_G, 16, EXTEND_LSL, 0));
+        addlong(ARM64_ADD_W_SHIFT(16, 15, 2, SHIFT_LSL, shift));
+        addlong(ARM64_LDST_REG(ARM64_LDRB, 2, REG_DITHER_RB, 16, EXTEND_LSL, 0));
+    } else {
+        addlong(ARM64_LSR_W_IMM(0, 0, 3));
+        addlong(ARM64_LSR_W_IMM(1, 1, 2));
+        addlong(ARM64_LSR_W_IMM(2, 2, 3));
+    }
+
+    if (params->fbzMode & FBZ_RGB_WMASK) {
+        addlong(ARM64_ORR_W_SHIFT(15, 2, 1, SHIFT_LSL, 5));
+        addlong(ARM64_ORR_W_SHIFT(15, 15, 0, SHIFT_LSL, 11));
+        addlong(ARM64_LDST_REG(ARM64_STRH, 15, REG_FB_MEM, fb_idx, EXTEND_SXTW, 1));
+    }
+    if ((params->fbzMode & (FBZ_DEPTH_WMASK | FBZ_ALPHA_ENABLE)) == (FBZ_DEPTH_WMASK | FBZ_ALPHA_ENABLE))
+        addlong(ARM64_LDST_REG(ARM64_STRH, 3, REG_AUX_MEM, aux_idx, EXTEND_SXTW, 1));
+    else if ((params->fbzMode & (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE)) == (FBZ_DEPTH_WMASK | FBZ_DEPTH_ENABLE))
+        addlong(ARM64_LDST_REG(ARM64_STRH, 5, REG_AUX_MEM, aux_idx, EXTEND_SXTW, 1));
+
+    block_pos = arm64_inc_counter(code_block, block_pos, &voodoo->fbiPixelsOut);
+
+    /*skip_pixel*/
+    for (int c = 0; c < skip_nr; c++)
+        arm64_patch_branch(code_block, skip_pos[c], block_pos);
+
+    /*ib/ig/ir/ia and dBdX/dGdX/dRdX/dAdX are laid out the same way, as are
+      tmuX_s/t and tmu[X].dSdX/dTdX*/
+    addlong(ARM64_ADD_X_IMM(15, REG_STATE, offsetof(voodoo_state_t, ib)));
+    addlong(ARM64_ADD_X_IMM(16, REG_PARAMS, offsetof(voodoo_params_t, dBdX)));
+    addlong(ARM64_LD1_4S(0, 15));
+    addlong(ARM64_LD1_4S(1, 16));
+    addlong((state->xdir > 0) ? ARM64_ADD_4S(0, 0, 1) : ARM64_SUB_4S(0, 0, 1));
+    addlong(ARM64_ST1_4S(0, 15));
+    for (int c = 0; c < 2; c++) {
+        addlong(ARM64_ADD_X_IMM(15, REG_STATE, c ? offsetof(voodoo_state_t, tmu1_s) : offsetof(voodoo_state_t, tmu0_s)));
+        block_pos = arm64_mov_imm64(code_block, block_pos, 16, offsetof(voodoo_params_t, tmu[c].dSdX));
+        addlong(ARM64_ADD_X(16, REG_PARAMS, 16));
+        addlong(ARM64_LD1_2D(0, 15));
+        addlong(ARM64_LD1_2D(1, 16));
+        addlong((state->xdir > 0) ? ARM64_ADD_2D(0, 0, 1) : ARM64_SUB_2D(0, 0, 1));
+        addlong(ARM64_ST1_2D(0, 15));
+    }
+    {
+        static const struct {
+            uintptr_t state_off;
+            uintptr_t params_off;
+            int       size;
+        } iter[4] = {
+            {offsetof(voodoo_state_t, z),       offsetof(voodoo_params_t, dZdX),        2},
+            { offsetof(voodoo_state_t, tmu0_w), offsetof(voodoo_params_t, tmu[0].dWdX), 3},
+            { offsetof(voodoo_state_t, tmu1_w), offsetof(voodoo_params_t, tmu[1].dWdX), 3},
+            { offsetof(voodoo_state_t, w),      offsetof(voodoo_params_t, dWdX),        3}
+        };
+
+        for (int c = 0; c < 4; c++) {
+            uint32_t ldr = (iter[c].size == 3) ? ARM64_LDR_X : ARM64_LDR_W;
+            uint32_t str = (iter[c].size == 3) ? ARM64_STR_X : ARM64_STR_W;
+            uint32_t sf  = (iter[c].size == 3) ? 0x80000000 : 0;
+
+            block_pos = arm64_ldst(code_block, block_pos, ldr, iter[c].size, 15, REG_STATE, iter[c].state_off);
+            block_pos = arm64_ldst(code_block, block_pos, ldr, iter[c].size, 16, REG_PARAMS, iter[c].params_off);
+            addlong(((state->xdir > 0) ? ARM64_ADD_W(15, 15, 16) : ARM64_SUB_W(15, 15, 16)) | sf);
+            block_pos = arm64_ldst(code_block, block_pos, str, iter[c].size, 15, REG_STATE, iter[c].state_off);
+        }
+    }
+
+    LOAD_STATE_W(15, pixel_count);
+    addlong(ARM64_ADD_W_IMM(15, 15, 1));
+    STORE_STATE_W(15, pixel_count);
+    LOAD_STATE_W(15, texel_count);
+    addlong(ARM64_ADD_W_IMM(15, 15, texels));
+    STORE_STATE_W(15, texel_count);
+
+    /*Loop until the pixel just drawn was x2*/
+    addlong(ARM64_CMP_W(REG_X, REG_X2));
+    if (state->xdir > 0)
+        addlong(ARM64_ADD_W_IMM(REG_X, REG_X, 1));
+    else
+        addlong(ARM64_SUB_W_IMM(REG_X, REG_X, 1));
+    pos = block_pos;
+    addlong(ARM64_BCOND(COND_NE));
+    arm64_patch_branch(code_block, pos, loop_jump_pos);
+
+    addlong(ARM64_LDP_X(27, 28, REG_SP, 80));
+    addlong(ARM64_LDP_X(25, 26, REG_SP, 64));
+    addlong(ARM64_LDP_X(23, 24, REG_SP, 48));
+    addlong(ARM64_LDP_X(21, 22, REG_SP, 32));
+    addlong(ARM64_LDP_X(19, 20, REG_SP, 16));
+    addlong(ARM64_LDP_X_POSTIDX(29, 30, REG_SP, 96));
+    addlong(ARM64_RET);
+
+    if (block_pos > BLOCK_SIZE)
+        fatal("voodoo_generate : code block overflow (%i bytes)\n", block_pos);
+
+    return block_pos;
+}
+
+static inline void *
+voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
+{
+    voodoo_codegen_cache_t *cache = &((voodoo_codegen_cache_t *) voodoo->codegen_data)[odd_even];
+    voodoo_codegen_key_t    key;
+    uint8_t                *code_block;
+    int                     hash;
+    int                     b;
+
+    voodoo_codegen_key_init(&key, voodoo, params, state);
+
+    b = voodoo_codegen_cache_find(cache, &key, &hash);
+    if (b != -1)
+        return cache->entries[b].valid ? &cache->code[b * BLOCK_SIZE] : NULL;
+
+    b          = voodoo_codegen_cache_insert(cache, &key, hash);
+    code_block = &cache->code[b * BLOCK_SIZE];
+
+#if defined(__APPLE__)
+    if (__builtin_available(macOS 11.0, *)) {
+        pthread_jit_write_protect_np(0);
+    }
+#endif
+    cache->entries[b].valid = voodoo_generate(code_block, voodoo, params, state, depth_op) ? 1 : 0;
+#if defined(__APPLE__)
+    if (__builtin_available(macOS 11.0, *)) {
+        pthread_jit_write_protect_np(1);
+    }
+#endif
+    __clear_cache(code_block, &code_block[BLOCK_SIZE]);
+
+    return cache->entries[b].valid ? code_block : NULL;
+}
+
+void
+voodoo_codegen_init(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_alloc(voodoo);
+
+    for (uint16_t c = 0; c < 256; c++) {
+        int d[4];
+        int _ds = c & 0xf;
+        int dt  = c >> 4;
+
+        d[0] = (16 - _ds) * (16 - dt);
+        d[1] = _ds * (16 - dt);
+        d[2] = (16 - _ds) * dt;
+        d[3] = _ds * dt;
+
+        for (uint8_t e = 0; e < 4; e++) {
+            bilinear_lookup[c][e]      = d[0];
+            bilinear_lookup[c][e + 4]  = d[1];
+            bilinear_lookup[c][e + 8]  = d[2];
+            bilinear_lookup[c][e + 12] = d[3];
+        }
+    }
+}
+
+void
+voodoo_codegen_close(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_free(voodoo);
+}
+
+#endif /*VIDEO_VOODOO_CODEGEN_ARM64_H*/
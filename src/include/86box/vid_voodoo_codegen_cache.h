@@ -0,0 +1,215 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Compiled span function cache, shared by the Voodoo code
+ *          generators.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+/*Each render thread owns a cache of BLOCK_NUM compiled pipeline variants.
+  Variants are found through a chained hash table keyed on the full pipeline
+  state, and the least recently used variant is replaced when the cache is
+  full. The includer defines BLOCK_NUM, BLOCK_SIZE and LOD_MASK.
+
+  Statistics are kept per cache, so render threads never write to shared
+  counters, and are summed by voodoo_codegen_stats().
+*/
+
+#ifndef VIDEO_VOODOO_CODEGEN_CACHE_H
+#define VIDEO_VOODOO_CODEGEN_CACHE_H
+
+#define BLOCK_HASH_SIZE (BLOCK_NUM * 2)
+#define BLOCK_HASH_MASK (BLOCK_HASH_SIZE - 1)
+
+/*All members are 32 bits wide, so keys can be compared with memcmp()*/
+typedef struct voodoo_codegen_key_t {
+    int32_t  xdir;
+    uint32_t alphaMode;
+    uint32_t fbzMode;
+    uint32_t fogMode;
+    uint32_t fbzColorPath;
+    uint32_t textureMode[2];
+    uint32_t tLOD[2];
+    uint32_t trexInit1;
+    uint32_t is_tiled;
+} voodoo_codegen_key_t;
+
+typedef struct voodoo_codegen_entry_t {
+    voodoo_codegen_key_t key;
+    uint64_t             last_used;
+    int16_t              hash_next; /*Next entry in this hash chain, -1 if none*/
+    int16_t              hash;      /*Hash chain this entry is on, -1 if unused*/
+    int                  valid;     /*Zero if the state can not be compiled*/
+} voodoo_codegen_entry_t;
+
+typedef struct voodoo_codegen_cache_t {
+    voodoo_codegen_entry_t entries[BLOCK_NUM];
+    int16_t                hash_table[BLOCK_HASH_SIZE];
+    uint64_t               use_count;
+    int                    last;
+    int                    used;
+    uint8_t               *code;
+
+    int                    recomp;
+    uint64_t               recomp_hits;
+    int                    recomp_evict;
+} voodoo_codegen_cache_t;
+
+static inline void
+voodoo_codegen_key_init(voodoo_codegen_key_t *key, voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state)
+{
+    key->xdir           = state->xdir;
+    key->alphaMode      = params->alphaMode;
+    key->fbzMode        = params->fbzMode;
+    key->fogMode        = params->fogMode;
+    key->fbzColorPath   = params->fbzColorPath;
+    key->textureMode[0] = params->textureMode[0];
+    key->textureMode[1] = params->textureMode[1];
+    key->tLOD[0]        = params->tLOD[0] & LOD_MASK;
+    key->tLOD[1]        = params->tLOD[1] & LOD_MASK;
+    key->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
+    key->is_tiled       = (params->col_tiled ? 1 : 0) | (params->aux_tiled ? 2 : 0);
+}
+
+static inline int
+voodoo_codegen_key_hash(const voodoo_codegen_key_t *key)
+{
+    const uint32_t *p = (const uint32_t *) key;
+    uint32_t        h = 0;
+
+    for (unsigned int c = 0; c < sizeof(voodoo_codegen_key_t) / 4; c++)
+        h = (h ^ p[c]) * 0x9e3779b1;
+
+    return (h >> 16) & BLOCK_HASH_MASK;
+}
+
+/*Returns the entry matching key, or -1 on a miss. *hash is set for a
+  following voodoo_codegen_cache_insert()*/
+static inline int
+voodoo_codegen_cache_find(voodoo_codegen_cache_t *cache, const voodoo_codegen_key_t *key, int *hash)
+{
+    voodoo_codegen_entry_t *entry = &cache->entries[cache->last];
+    int                     b;
+
+    *hash = voodoo_codegen_key_hash(key);
+
+    /*Consecutive triangles almost always share their pipeline state*/
+    if (entry->hash != -1 && !memcmp(&entry->key, key, sizeof(voodoo_codegen_key_t))) {
+        entry->last_used = ++cache->use_count;
+        cache->recomp_hits++;
+        return cache->last;
+    }
+
+    for (b = cache->hash_table[*hash]; b != -1; b = cache->entries[b].hash_next) {
+        entry = &cache->entries[b];
+
+        if (!memcmp(&entry->key, key, sizeof(voodoo_codegen_key_t))) {
+            entry->last_used = ++cache->use_count;
+            cache->last      = b;
+            cache->recomp_hits++;
+            return b;
+        }
+    }
+
+    return -1;
+}
+
+/*Claims an entry for key, evicting the least recently used one if the cache
+  is full. The caller generates code into the entry and sets valid.*/
+static inline int
+voodoo_codegen_cache_insert(voodoo_codegen_cache_t *cache, const voodoo_codegen_key_t *key, int hash)
+{
+    voodoo_codegen_entry_t *entry;
+    int                     b;
+
+    if (cache->used < BLOCK_NUM)
+        b = cache->used++;
+    else {
+        int16_t *prev;
+
+        b = 0;
+        for (int c = 1; c < BLOCK_NUM; c++) {
+            if (cache->entries[c].last_used < cache->entries[b].last_used)
+                b = c;
+        }
+
+        prev = &cache->hash_table[cache->entries[b].hash];
+        while (*prev != b)
+            prev = &cache->entries[*prev].hash_next;
+        *prev = cache->entries[b].hash_next;
+
+        cache->recomp_evict++;
+    }
+
+    entry            = &cache->entries[b];
+    entry->key       = *key;
+    entry->last_used = ++cache->use_count;
+    entry->hash      = hash;
+    entry->hash_next = cache->hash_table[hash];
+    entry->valid     = 0;
+
+    cache->hash_table[hash] = b;
+    cache->last             = b;
+    cache->recomp++;
+
+    return b;
+}
+
+static void
+voodoo_codegen_cache_alloc(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_t *caches = calloc(voodoo->render_threads, sizeof(voodoo_codegen_cache_t));
+    uint8_t                *code   = plat_mmap(BLOCK_SIZE * BLOCK_NUM * voodoo->render_threads, 1);
+
+    if (caches == NULL || code == NULL)
+        fatal("voodoo_codegen_init : unable to allocate the code cache\n");
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        caches[c].code = &code[BLOCK_SIZE * BLOCK_NUM * c];
+        memset(caches[c].hash_table, 0xff, sizeof(caches[c].hash_table));
+        for (int d = 0; d < BLOCK_NUM; d++)
+            caches[c].entries[d].hash = -1;
+    }
+
+    voodoo->codegen_data = caches;
+}
+
+static void
+voodoo_codegen_cache_free(voodoo_t *voodoo)
+{
+    voodoo_codegen_cache_t *caches = voodoo->codegen_data;
+
+    plat_munmap(caches[0].code, BLOCK_SIZE * BLOCK_NUM * voodoo->render_threads);
+    free(caches);
+    voodoo->codegen_data = NULL;
+}
+
+void
+voodoo_codegen_stats(voodoo_t *voodoo, int *recomp, uint64_t *hits, int *evict)
+{
+    voodoo_codegen_cache_t *caches = voodoo->codegen_data;
+
+    *recomp = 0;
+    *hits   = 0;
+    *evict  = 0;
+
+    if (caches == NULL)
+        return;
+
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        *recomp += caches[c].recomp;
+        *hits += caches[c].recomp_hits;
+        *evict += caches[c].recomp_evict;
+    }
+}
+
+#endif /*VIDEO_VOODOO_CODEGEN_CACHE_H*/
@@ -10,8 +10,7 @@
 
 #include <xmmintrin.h>
 
-#define BLOCK_NUM  8
-#define BLOCK_MASK (BLOCK_NUM - 1)
+#define BLOCK_NUM  256
 #define BLOCK_SIZE 8192
 
 #define LOD_MASK   (LOD_TMIRROR_S | LOD_TMIRROR_T)
@@ -21,25 +20,7 @@
 #    pragma GCC diagnostic ignored "-Wstringop-overflow"
 #endif
 
-typedef struct voodoo_x86_data_t {
-    uint8_t  code_block[BLOCK_SIZE];
-    int      xdir;
-    uint32_t alphaMode;
-    uint32_t fbzMode;
-    uint32_t fogMode;
-    uint32_t fbzColorPath;
-    uint32_t textureMode[2];
-    uint32_t tLOD[2];
-    uint32_t trexInit1;
-    int      is_tiled;
-} voodoo_x86_data_t;
-
-#if 0
-static voodoo_x86_data_t voodoo_x86_data[2][BLOCK_NUM];
-#endif
-
-static int last_block[4]          = { 0, 0 };
-static int next_block_to_write[4] = { 0, 0 };
+#include <86box/vid_voodoo_codegen_cache.h>
 
 #define addbyte(val)                   \
     do {                               \
@@ -1019,7 +1000,9 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
         } else
             fatal("Bad depth_op\n");
     } else if ((params->fbzMode & FBZ_DEPTH_ENABLE) && (depthop == DEPTHOP_NEVER)) {
-        addbyte(0xC3); /*RET*/
+        addbyte(0xe9); /*JMP skip*/
+        z_skip_pos = block_pos;
+        addlong(0);
     }
 
     /*XMM0 = colour*/
@@ -1062,7 +1045,7 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
         addbyte(0x0f);
         addbyte(0x6e);
         addbyte(0xd8);
-        if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && tc_sub_clocal_1) {
+        if ((params->textureMode[1] & TEXTUREMODE_TRILINEAR) && (tc_sub_clocal_1 || tca_sub_clocal_1)) {
             addbyte(0x8b); /*MOV EAX, state->lod*/
             addbyte(0x87);
             addlong(offsetof(voodoo_state_t, lod));
@@ -1300,7 +1283,7 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
                 addbyte(0x35); /*XOR EAX, 0xff*/
                 addlong(0xff);
             }
-            addbyte(0x8e); /*ADD EAX, 1*/
+            addbyte(0x83); /*ADD EAX, 1*/
             addbyte(0xc0);
             addbyte(1);
             addbyte(0x0f); /*IMUL EAX, EBX*/
@@ -1910,7 +1893,6 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
         } else {
             addbyte(0xf6); /*TEST state->tex_a, 0x80*/
             addbyte(0x87);
-            addbyte(0x23);
             addlong(offsetof(voodoo_state_t, tex_a));
             addbyte(0x80);
             addbyte(0x74); /*JZ !cc_localselect*/
@@ -2463,7 +2445,9 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
                 break;
         }
     } else if ((params->alphaMode & 1) && (alpha_func == AFUNC_NEVER)) {
-        addbyte(0xC3); /*RET*/
+        addbyte(0xe9); /*JMP skip*/
+        a_skip_pos = block_pos;
+        addlong(0);
     }
 
     if (params->alphaMode & (1 << 4)) {
@@ -2478,8 +2462,8 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
             addbyte(0x8b);
             addbyte(0x8f);
             addlong(offsetof(voodoo_state_t, aux_mem));
-            addbyte(0x0f); /*MOVZX EBX, [ECX+EBX*2]*/
-            addbyte(0xb7);
+            addbyte(0x0f); /*MOVZX EBX, BYTE [ECX+EBX*2]*/
+            addbyte(0xb6);
             addbyte(0x1c);
             addbyte(0x59);
         } else {
@@ -3483,53 +3467,31 @@ voodoo_generate(uint8_t *code_block, voodoo_t *voodoo, voodoo_params_t *params,
 
     addbyte(0xC3); /*RET*/
 }
-int voodoo_recomp = 0;
 static inline void *
 voodoo_get_block(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *state, int odd_even)
 {
-    int                b               = last_block[odd_even];
-    voodoo_x86_data_t *voodoo_x86_data = voodoo->codegen_data;
-    voodoo_x86_data_t *data;
+    voodoo_codegen_cache_t *cache = &((voodoo_codegen_cache_t *) voodoo->codegen_data)[odd_even];
+    voodoo_codegen_key_t    key;
+    int                     hash;
+    int                     b;
 
-    for (uint8_t c = 0; c < 8; c++) {
-        data = &voodoo_x86_data[odd_even + c * 4]; //&voodoo_x86_data[odd_even][b];
+    voodoo_codegen_key_init(&key, voodoo, params, state);
 
-        if (state->xdir == data->xdir && params->alphaMode == data->alphaMode && params->fbzMode == data->fbzMode && params->fogMode == data->fogMode && params->fbzColorPath == data->fbzColorPath && (voodoo->trexInit1[0] & (1 << 18)) == data->trexInit1 && params->textureMode[0] == data->textureMode[0] && params->textureMode[1] == data->textureMode[1] && (params->tLOD[0] & LOD_MASK) == data->tLOD[0] && (params->tLOD[1] & LOD_MASK) == data->tLOD[1] && ((params->col_tiled || params->aux_tiled) ? 1 : 0) == data->is_tiled) {
-            last_block[odd_even] = b;
-            return data->code_block;
-        }
+    b = voodoo_codegen_cache_find(cache, &key, &hash);
+    if (b == -1) {
+        b = voodoo_codegen_cache_insert(cache, &key, hash);
 
-        b = (b + 1) & 7;
+        voodoo_generate(&cache->code[b * BLOCK_SIZE], voodoo, params, state, depth_op);
+        cache->entries[b].valid = 1;
     }
-    voodoo_recomp++;
-    data = &voodoo_x86_data[odd_even + next_block_to_write[odd_even] * 4];
-#if 0
-    code_block = data->code_block;
-#endif
-
-    voodoo_generate(data->code_block, voodoo, params, state, depth_op);
-
-    data->xdir           = state->xdir;
-    data->alphaMode      = params->alphaMode;
-    data->fbzMode        = params->fbzMode;
-    data->fogMode        = params->fogMode;
-    data->fbzColorPath   = params->fbzColorPath;
-    data->trexInit1      = voodoo->trexInit1[0] & (1 << 18);
-    data->textureMode[0] = params->textureMode[0];
-    data->textureMode[1] = params->textureMode[1];
-    data->tLOD[0]        = params->tLOD[0] & LOD_MASK;
-    data->tLOD[1]        = params->tLOD[1] & LOD_MASK;
-    data->is_tiled       = (params->col_tiled || params->aux_tiled) ? 1 : 0;
-
-    next_block_to_write[odd_even] = (next_block_to_write[odd_even] + 1) & 7;
 
-    return data->code_block;
+    return &cache->code[b * BLOCK_SIZE];
 }
 
 void
 voodoo_codegen_init(voodoo_t *voodoo)
 {
-    voodoo->codegen_data = plat_mmap(sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4, 1);
+    voodoo_codegen_cache_alloc(voodoo);
 
     for (uint16_t c = 0; c < 256; c++) {
         int d[4];
@@ -3555,7 +3517,7 @@ voodoo_codegen_init(voodoo_t *voodoo)
 void
 voodoo_codegen_close(voodoo_t *voodoo)
 {
-    plat_munmap(voodoo->codegen_data, sizeof(voodoo_x86_data_t) * BLOCK_NUM * 4);
+    voodoo_codegen_cache_free(voodoo);
 }
 
 #endif /*VIDEO_VOODOO_CODEGEN_X86_64_H*/
@@ -27,7 +27,10 @@
 
 #define TEX_DIRTY_SHIFT 10
 
-#define TEX_CACHE_MAX   64
+#define TEX_CACHE_MIN   64
+#define TEX_CACHE_MAX   256
+#define TEX_HASH_SIZE   512
+#define TEX_HASH_MASK   (TEX_HASH_SIZE - 1)
 
 enum {
     VOODOO_1 = 0,
@@ -101,6 +104,8 @@ enum {
 #define PARAM_FULL(x)    ((voodoo->params_write_idx - voodoo->params_read_idx[x]) >= PARAM_SIZE)
 #define PARAM_EMPTY(x)   (voodoo->params_read_idx[x] == voodoo->params_write_idx)
 
+#define VOODOO_MAX_RENDER_THREADS 16
+
 typedef struct
 {
     uint32_t addr_type;
@@ -232,12 +237,16 @@ typedef struct voodoo_params_t {
 typedef struct texture_t {
     uint32_t   base;
     uint32_t   tLOD;
+    int        tformat;
     ATOMIC_INT refcount;
-    ATOMIC_INT refcount_r[4];
+    ATOMIC_INT refcount_r[VOODOO_MAX_RENDER_THREADS];
     int        is16;
     uint32_t   palette_checksum;
-    uint32_t   addr_start[4];
-    uint32_t   addr_end[4];
+    uint32_t   addr_start[LOD_MAX + 1];
+    uint32_t   addr_end[LOD_MAX + 1];
+    uint16_t   lod_dirty; /*Mip levels overwritten since they were decoded*/
+    int16_t    hash_next;
+    uint64_t   last_used;
     uint32_t  *data;
 } texture_t;
 
@@ -265,6 +274,11 @@ typedef struct clip_t {
     int y_max;
 } clip_t;
 
+typedef struct voodoo_render_thread_param_t {
+    struct voodoo_t *voodoo;
+    int              odd_even;
+} voodoo_render_thread_param_t;
+
 typedef struct voodoo_t {
     mem_mapping_t mapping;
 
@@ -361,27 +375,28 @@ typedef struct voodoo_t {
     int    ncc_dirty[2];
 
     thread_t *fifo_thread;
-    thread_t *render_thread[4];
+    thread_t *render_thread[VOODOO_MAX_RENDER_THREADS];
     event_t  *wake_fifo_thread;
     event_t  *wake_main_thread;
     event_t  *fifo_not_full_event;
     event_t  *fifo_empty_event;
     ATOMIC_INT fifo_empty_signaled;
-    event_t  *render_not_full_event[4];
-    event_t  *wake_render_thread[4];
+    event_t  *render_not_full_event[VOODOO_MAX_RENDER_THREADS];
+    event_t  *wake_render_thread[VOODOO_MAX_RENDER_THREADS];
 
     int voodoo_busy;
-    int render_voodoo_busy[4];
+    int render_voodoo_busy[VOODOO_MAX_RENDER_THREADS];
 
     int render_threads;
-    int odd_even_mask;
 
-    int pixel_count[4];
-    int texel_count[4];
+    voodoo_render_thread_param_t render_thread_param[VOODOO_MAX_RENDER_THREADS];
+
+    int pixel_count[VOODOO_MAX_RENDER_THREADS];
+    int texel_count[VOODOO_MAX_RENDER_THREADS];
     int tri_count;
     int frame_count;
-    int pixel_count_old[4];
-    int texel_count_old[4];
+    int pixel_count_old[VOODOO_MAX_RENDER_THREADS];
+    int texel_count_old[VOODOO_MAX_RENDER_THREADS];
     int wr_count;
     int rd_count;
     int tex_count;
@@ -390,6 +405,7 @@ typedef struct voodoo_t {
     int      swap_interval;
     uint32_t swap_offset;
     int      swap_pending;
+    uint64_t swap_stats_start; /* video_stats_begin() time of the pending swap */
 
     int bilinear_enabled;
     int dithersub_enabled;
@@ -414,7 +430,7 @@ typedef struct voodoo_t {
     ATOMIC_INT   pending_draw_cmds_buf[VOODOO_BUF_COUNT];
 
     voodoo_params_t params_buffer[PARAM_SIZE];
-    ATOMIC_INT      params_read_idx[4];
+    ATOMIC_INT      params_read_idx[VOODOO_MAX_RENDER_THREADS];
     ATOMIC_INT      params_write_idx;
 
     uint32_t   cmdfifo_base;
@@ -631,7 +647,9 @@ typedef struct voodoo_t {
     rgbvoodoo_t clutData[33];
     int         clutData_dirty;
     rgbvoodoo_t clutData256[256];
-    uint32_t    video_16to32[0x10000];
+    uint8_t     clut_r5[32]; /* clutData256 indexed by the RGB565 channels, for the scanout kernels */
+    uint8_t     clut_g6[64];
+    uint8_t     clut_b5[32];
 
     uint8_t dirty_line[2048];
     int     dirty_line_low;
@@ -666,16 +684,25 @@ typedef struct voodoo_t {
     uint8_t  thefilterg[256][256];
     uint8_t  thefilterb[256][256];
     uint16_t purpleline[256][3];
+    int      filter_cap[3]; /* R, G and B thresholds of the v1 tables */
 
     texture_t texture_cache[2][TEX_CACHE_MAX];
+    int16_t   texture_hash[2][TEX_HASH_SIZE];
     uint8_t   texture_present[2][16384];
-    int       texture_last_removed;
+    int       texture_cache_size;
+    uint64_t  texture_use_count;
+    uint64_t  texture_hits;
+    uint64_t  texture_misses;
+    uint64_t  texture_shared;      /*Misses satisfied by copying the other TMU's entry*/
+    uint64_t  texture_redecodes;   /*Hits that re-decoded overwritten mip levels*/
+    uint64_t  texture_decode_time;
 
     uint32_t palette_checksum[2];
     int      palette_dirty[2];
 
     uint64_t time;
-    int      render_time[4];
+    uint64_t render_time[VOODOO_MAX_RENDER_THREADS];      /*Ticks spent drawing*/
+    uint64_t render_idle_time[VOODOO_MAX_RENDER_THREADS]; /*Ticks spent waiting for work*/
     uint64_t fifo_full_waits;
     uint64_t fifo_full_wait_ticks;
     uint64_t fifo_full_spin_checks;
@@ -715,7 +742,7 @@ typedef struct voodoo_t {
     uint32_t launch_pending;
 
     uint8_t fifo_thread_run;
-    uint8_t render_thread_run[4];
+    uint8_t render_thread_run[VOODOO_MAX_RENDER_THREADS];
 
     uint8_t *vram;
     uint8_t *changedvram;
@@ -0,0 +1,36 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorised scanout kernels for the Voodoo display.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef VIDEO_VOODOO_DISPLAY_SIMD_H
+#define VIDEO_VOODOO_DISPLAY_SIMD_H
+
+typedef struct voodoo_display_kernels_t {
+    /* Converts RGB565 pixels to 32-bit through per-channel CLUT tables of
+       32, 64 and 32 entries. */
+    void (*rgb565_clut)(uint32_t *p, const uint16_t *src, const uint8_t *clut_r,
+                        const uint8_t *clut_g, const uint8_t *clut_b, int count);
+    /* Splits RGB565 pixels into 8-bit planes, as the screen filter expects
+       them, adding add_rb to red and blue. */
+    void (*rgb565_planar)(uint8_t *r, uint8_t *g, uint8_t *b, const uint16_t *src,
+                          uint8_t add_rb, int count);
+    /* One pass of the Voodoo 1 screen filter over a plane:
+       dst[x] = src[x] + (clamp(nb[x] - src[x], -cap, cap) >> 1). */
+    void (*filter)(uint8_t *dst, const uint8_t *src, const uint8_t *nb, int cap, int count);
+} voodoo_display_kernels_t;
+
+extern voodoo_display_kernels_t voodoo_display_kernels;
+
+extern void voodoo_display_kernels_init(void);
+
+#endif /*VIDEO_VOODOO_DISPLAY_SIMD_H*/
@@ -131,6 +131,7 @@ typedef struct monitor_t {
     double                   mon_res_y;
     int                      mon_bpp;
     bitmap_t                *target_buffer;
+    bitmap_t                *mon_blit_buffer; /* Frame being handed to the renderer, see video_blit_memtoscreen_monitor(). */
     int                      mon_video_timing_read_b;
     int                      mon_video_timing_read_w;
     int                      mon_video_timing_read_l;
@@ -38,6 +38,7 @@
 #include <86box/plat.h>
 #include <86box/rom.h>
 #include <86box/gdbstub.h>
+#include <86box/snapshot.h>
 #ifdef USE_DYNAREC
 #    include "codegen_public.h"
 #else
@@ -61,7 +62,6 @@ mem_mapping_t ram_mid_mapping2;      /* 640..1024K mapping, second part, for SiS
 mem_mapping_t ram_remapped_mapping;  /* 640..1024K mapping */
 mem_mapping_t ram_remapped_mapping2; /* 640..1024K second mapping, for SiS 471 mode */
 mem_mapping_t ram_high_mapping;      /* 1024K+ mapping */
-mem_mapping_t ram_2gb_mapping;       /* 1024M+ mapping */
 mem_mapping_t ram_split_mapping;
 mem_mapping_t bios_mapping;
 mem_mapping_t bios_high_mapping;
@@ -70,7 +70,6 @@ page_t  *pages;       /* RAM page table */
 uint32_t pages_sz;    /* #pages in table */
 
 uint8_t *ram;  /* the virtual RAM */
-uint8_t *ram2; /* the virtual RAM */
 uint8_t  page_ff[4096];
 uint32_t rammask;
 uint32_t addr_space_size;
@@ -82,12 +81,8 @@ uint32_t biosaddr;
 uint32_t pccache;
 uint8_t *pccache2;
 
-int        readlnext;
-int        readlookup[256];
 uintptr_t  old_rl2;
 uint8_t    uncached = 0;
-int        writelnext;
-int        writelookup[256];
 
 /* The lookup tables. */
 page_t *page_lookup[1048576] = { 0 };
@@ -101,7 +96,6 @@ int shadowbios = 0;
 int shadowbios_write;
 int readlnum  = 0;
 int writelnum = 0;
-int cachesize = 256;
 
 uint32_t get_phys_virt;
 uint32_t get_phys_phys;
@@ -140,6 +134,28 @@ static uint32_t       remap_start_addr;
 static uint32_t       remap_start_addr2;
 static size_t ram_size = 0;
 
+/* The software TLB: a set-associative record of which virtual pages currently
+   have a valid readlookup2[]/writelookup2[] entry, so that they can be evicted
+   by tag on a miss or a flush. A compact list of the occupied entries is kept
+   so that flushing costs the number of cached pages rather than the size of
+   the TLB. */
+typedef struct mmu_tlb_t {
+    uint32_t *tag;      /* Virtual page held by each entry, or MMU_TLB_INV. */
+    uint32_t *used;     /* Indices of the occupied entries. */
+    uint32_t *used_pos; /* Position of each occupied entry in used[]. */
+    uint8_t  *victim;   /* Next way to replace, per set. */
+    uint32_t  size;
+    uint32_t  set_mask;
+    int      *num;      /* Number of occupied entries. */
+
+    uint64_t  misses;
+    uint64_t  evictions;
+    uint64_t  flushes;
+} mmu_tlb_t;
+
+static mmu_tlb_t read_tlb  = { .num = &readlnum };
+static mmu_tlb_t write_tlb = { .num = &writelnum };
+
 #ifdef ENABLE_MEM_LOG
 int mem_do_log = ENABLE_MEM_LOG;
 
@@ -167,43 +183,150 @@ mem_addr_is_ram(uint32_t addr)
            (mapping == &ram_mid_mapping2) || (mapping == &ram_remapped_mapping);
 }
 
+static void
+mmu_tlb_alloc(mmu_tlb_t *tlb, uint32_t size)
+{
+    if (tlb->size != size) {
+        free(tlb->tag);
+        free(tlb->used);
+        free(tlb->used_pos);
+        free(tlb->victim);
+
+        tlb->tag      = (uint32_t *) malloc(size * sizeof(uint32_t));
+        tlb->used     = (uint32_t *) malloc(size * sizeof(uint32_t));
+        tlb->used_pos = (uint32_t *) malloc(size * sizeof(uint32_t));
+        tlb->victim   = (uint8_t *) malloc(size / MMU_TLB_WAYS);
+        if (!tlb->tag || !tlb->used || !tlb->used_pos || !tlb->victim)
+            fatal("mmu_tlb_alloc(): Unable to allocate a %u-entry TLB\n", size);
+
+        tlb->size     = size;
+        tlb->set_mask = (size / MMU_TLB_WAYS) - 1;
+    }
+
+    memset(tlb->tag, 0xff, size * sizeof(uint32_t));
+    memset(tlb->victim, 0x00, size / MMU_TLB_WAYS);
+    *tlb->num = 0;
+
+    tlb->misses    = 0;
+    tlb->evictions = 0;
+    tlb->flushes   = 0;
+}
+
+/* Insert virtual page vpage into the TLB, returning the page it evicted, or
+   MMU_TLB_INV if a free entry was used. */
+static __inline uint32_t
+mmu_tlb_insert(mmu_tlb_t *tlb, uint32_t vpage)
+{
+    uint32_t set   = (vpage & tlb->set_mask) * MMU_TLB_WAYS;
+    uint32_t entry = set + tlb->victim[vpage & tlb->set_mask];
+    uint32_t old   = MMU_TLB_INV;
+
+    /* Prefer a free way over the round-robin victim. */
+    for (uint32_t w = 0; w < MMU_TLB_WAYS; w++) {
+        if (tlb->tag[set + w] == MMU_TLB_INV) {
+            entry = set + w;
+            break;
+        }
+    }
+
+    if (tlb->tag[entry] != MMU_TLB_INV) {
+        old = tlb->tag[entry];
+        tlb->evictions++;
+    } else {
+        tlb->used_pos[entry]     = *tlb->num;
+        tlb->used[(*tlb->num)++] = entry;
+    }
+
+    tlb->victim[vpage & tlb->set_mask] = ((entry - set) + 1) & (MMU_TLB_WAYS - 1);
+    tlb->tag[entry] = vpage;
+    tlb->misses++;
+
+    return old;
+}
+
+static __inline void
+mmu_tlb_remove(mmu_tlb_t *tlb, uint32_t entry)
+{
+    uint32_t pos  = tlb->used_pos[entry];
+    uint32_t last = tlb->used[--(*tlb->num)];
+
+    tlb->used[pos]      = last;
+    tlb->used_pos[last] = pos;
+    tlb->tag[entry]     = MMU_TLB_INV;
+}
+
+static void
+mmu_tlb_flush_read(void)
+{
+    for (int c = 0; c < readlnum; c++) {
+        uint32_t entry = read_tlb.used[c];
+
+        readlookup2[read_tlb.tag[entry]] = LOOKUP_INV;
+        read_tlb.tag[entry]              = MMU_TLB_INV;
+    }
+    readlnum = 0;
+    read_tlb.flushes++;
+}
+
+static void
+mmu_tlb_flush_write(void)
+{
+    for (int c = 0; c < writelnum; c++) {
+        uint32_t entry = write_tlb.used[c];
+
+        page_lookup[write_tlb.tag[entry]]  = NULL;
+        writelookup2[write_tlb.tag[entry]] = LOOKUP_INV;
+        write_tlb.tag[entry]               = MMU_TLB_INV;
+    }
+    writelnum = 0;
+    write_tlb.flushes++;
+}
+
+void
+mem_tlb_get_stats(int write, mem_tlb_stats_t *stats)
+{
+    const mmu_tlb_t *tlb = write ? &write_tlb : &read_tlb;
+
+    stats->entries   = tlb->size;
+    stats->ways      = MMU_TLB_WAYS;
+    stats->used      = *tlb->num;
+    stats->misses    = tlb->misses;
+    stats->evictions = tlb->evictions;
+    stats->flushes   = tlb->flushes;
+}
+
 void
 resetreadlookup(void)
 {
+    uint32_t size = MMU_TLB_MIN;
+
+    /* Round the configured TLB size to a supported power of two. */
+    while ((size < MMU_TLB_MAX) && (size < (uint32_t) mmu_tlb_size))
+        size <<= 1;
+
     /* Initialize the page lookup table. */
     memset(page_lookup, 0x00, (1 << 20) * sizeof(page_t *));
 
-    /* Initialize the tables for lower (<= 1024K) RAM. */
-    for (uint16_t c = 0; c < 256; c++) {
-        readlookup[c]  = 0xffffffff;
-        writelookup[c] = 0xffffffff;
-    }
+    /* Initialize the TLB entries. */
+    mmu_tlb_alloc(&read_tlb, size);
+    mmu_tlb_alloc(&write_tlb, size);
+
+    mem_log("MEM: %u-entry %i-way software TLB\n", size, MMU_TLB_WAYS);
 
     /* Initialize the tables for high (> 1024K) RAM. */
     memset(readlookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
 
     memset(writelookup2, 0xff, (1 << 20) * sizeof(uintptr_t));
 
-    readlnext  = 0;
-    writelnext = 0;
-    pccache    = 0xffffffff;
-    high_page  = 0;
+    pccache   = 0xffffffff;
+    high_page = 0;
 }
 
 void
 flushmmucache(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
-        if (readlookup[c] != (int) 0xffffffff) {
-            readlookup2[readlookup[c]] = LOOKUP_INV;
-            readlookup[c]              = 0xffffffff;
-        }
-        if (writelookup[c] != (int) 0xffffffff) {
-            page_lookup[writelookup[c]]  = NULL;
-            writelookup2[writelookup[c]] = LOOKUP_INV;
-            writelookup[c]               = 0xffffffff;
-        }
-    }
+    mmu_tlb_flush_read();
+    mmu_tlb_flush_write();
     mmuflush++;
 
     pccache  = (uint32_t) 0xffffffff;
@@ -217,13 +340,7 @@ flushmmucache(void)
 void
 flushmmucache_write(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
-        if (writelookup[c] != (int) 0xffffffff) {
-            page_lookup[writelookup[c]]  = NULL;
-            writelookup2[writelookup[c]] = LOOKUP_INV;
-            writelookup[c]               = 0xffffffff;
-        }
-    }
+    mmu_tlb_flush_write();
     mmuflush++;
 }
 
@@ -243,32 +360,26 @@ flushmmucache_pc(void)
 void
 flushmmucache_nopc(void)
 {
-    for (uint16_t c = 0; c < 256; c++) {
-        if (readlookup[c] != (int) 0xffffffff) {
-            readlookup2[readlookup[c]] = LOOKUP_INV;
-            readlookup[c]              = 0xffffffff;
-        }
-        if (writelookup[c] != (int) 0xffffffff) {
-            page_lookup[writelookup[c]]  = NULL;
-            writelookup2[writelookup[c]] = LOOKUP_INV;
-            writelookup[c]               = 0xffffffff;
-        }
-    }
+    mmu_tlb_flush_read();
+    mmu_tlb_flush_write();
 }
 
 void
 mem_flush_write_page(uint32_t addr, uint32_t virt)
 {
     const page_t *page_target = &pages[addr >> 12];
-
-    for (uint16_t c = 0; c < 256; c++) {
-        if (writelookup[c] != (int) 0xffffffff) {
-            uintptr_t target = (uintptr_t) &ram[(uintptr_t) (addr & ~0xfff) - (virt & ~0xfff)];
-            if (writelookup2[writelookup[c]] == target || page_lookup[writelookup[c]] == page_target) {
-                writelookup2[writelookup[c]] = LOOKUP_INV;
-                page_lookup[writelookup[c]]  = NULL;
-                writelookup[c]               = 0xffffffff;
-            }
+    uintptr_t     target      = (uintptr_t) &ram[(uintptr_t) (addr & ~0xfff) - (virt & ~0xfff)];
+
+    for (int c = 0; c < writelnum; c++) {
+        uint32_t entry = write_tlb.used[c];
+        uint32_t vpage = write_tlb.tag[entry];
+
+        if (writelookup2[vpage] == target || page_lookup[vpage] == page_target) {
+            writelookup2[vpage] = LOOKUP_INV;
+            page_lookup[vpage]  = NULL;
+            mmu_tlb_remove(&write_tlb, entry);
+            /* The last occupied entry was moved into this slot. */
+            c--;
         }
     }
 }
@@ -571,38 +682,44 @@ mem_addr_translate(uint32_t addr, uint32_t chunk_start, uint32_t len)
 void
 addreadlookup(uint32_t virt, uint32_t phys)
 {
+    uint32_t old;
+
     if (virt == 0xffffffff)
         return;
 
     if (readlookup2[virt >> 12] != (uintptr_t) LOOKUP_INV)
         return;
 
-    if (readlookup[readlnext] != (int) 0xffffffff) {
-        if ((readlookup[readlnext] == ((es + DI) >> 12)) || (readlookup[readlnext] == ((es + EDI) >> 12)))
+    old = mmu_tlb_insert(&read_tlb, virt >> 12);
+    if (old != MMU_TLB_INV) {
+        if ((old == ((es + DI) >> 12)) || (old == ((es + EDI) >> 12)))
             uncached = 1;
-        readlookup2[readlookup[readlnext]] = LOOKUP_INV;
+        readlookup2[old] = LOOKUP_INV;
     }
 
     readlookup2[virt >> 12] = (uintptr_t) &ram[(uintptr_t) (phys & ~0xFFF) - (uintptr_t) (virt & ~0xfff)];
 
-    readlookup[readlnext++] = virt >> 12;
-    readlnext &= (cachesize - 1);
-
     cycles -= 9;
 }
 
-void
-addwritelookup(uint32_t virt, uint32_t phys)
+/* Add a write lookup for virtual address virt, which maps to the bus address
+   phys, backed by RAM at ram_addr. The two only differ for remapped RAM, where
+   the code block tracking is done on the bus page but the data lives in low RAM. */
+static void
+addwritelookup_ex(uint32_t virt, uint32_t phys, uint32_t ram_addr)
 {
+    uint32_t old;
+
     if (virt == 0xffffffff)
         return;
 
     if (page_lookup[virt >> 12])
         return;
 
-    if (writelookup[writelnext] != -1) {
-        page_lookup[writelookup[writelnext]]  = NULL;
-        writelookup2[writelookup[writelnext]] = LOOKUP_INV;
+    old = mmu_tlb_insert(&write_tlb, virt >> 12);
+    if (old != MMU_TLB_INV) {
+        page_lookup[old]  = NULL;
+        writelookup2[old] = LOOKUP_INV;
     }
 
 #ifdef USE_NEW_DYNAREC
@@ -621,15 +738,18 @@ addwritelookup(uint32_t virt, uint32_t phys)
         page_lookup[virt >> 12]  = &pages[phys >> 12];
     } else {
 
-        writelookup2[virt >> 12] = (uintptr_t) &ram[(uintptr_t) (phys & ~0xFFF) - (uintptr_t) (virt & ~0xfff)];
+        writelookup2[virt >> 12] = (uintptr_t) &ram[(uintptr_t) (ram_addr & ~0xFFF) - (uintptr_t) (virt & ~0xfff)];
     }
 
-    writelookup[writelnext++] = virt >> 12;
-    writelnext &= (cachesize - 1);
-
     cycles -= 9;
 }
 
+void
+addwritelookup(uint32_t virt, uint32_t phys)
+{
+    addwritelookup_ex(virt, phys, phys);
+}
+
 uint8_t *
 getpccache(uint32_t a)
 {
@@ -1806,45 +1926,6 @@ mem_read_raml(uint32_t addr, UNUSED(void *priv))
     return *(uint32_t *) &ram[addr];
 }
 
-uint8_t
-mem_read_ram_2gb(uint32_t addr, UNUSED(void *priv))
-{
-#ifdef ENABLE_MEM_LOG
-    if ((addr >= 0xa0000) && (addr <= 0xbffff))
-        mem_log("Read  B       %02X from %08X\n", ram[addr], addr);
-#endif
-
-    addreadlookup(mem_logical_addr, addr);
-
-    return ram2[addr - (1 << 30)];
-}
-
-uint16_t
-mem_read_ram_2gbw(uint32_t addr, UNUSED(void *priv))
-{
-#ifdef ENABLE_MEM_LOG
-    if ((addr >= 0xa0000) && (addr <= 0xbffff))
-        mem_log("Read  W     %04X from %08X\n", *(uint16_t *) &ram[addr], addr);
-#endif
-
-    addreadlookup(mem_logical_addr, addr);
-
-    return *(uint16_t *) &ram2[addr - (1 << 30)];
-}
-
-uint32_t
-mem_read_ram_2gbl(uint32_t addr, UNUSED(void *priv))
-{
-#ifdef ENABLE_MEM_LOG
-    if ((addr >= 0xa0000) && (addr <= 0xbffff))
-        mem_log("Read  L %08X from %08X\n", *(uint32_t *) &ram[addr], addr);
-#endif
-
-    addreadlookup(mem_logical_addr, addr);
-
-    return *(uint32_t *) &ram2[addr - (1 << 30)];
-}
-
 #ifdef USE_NEW_DYNAREC
 static inline int
 page_index(page_t *page)
@@ -2130,7 +2211,7 @@ mem_write_remapped(uint32_t addr, uint8_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xA0000 + (addr - remap_start_addr);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_ramb_page(addr, val, &pages[oldaddr >> 12]);
     } else
         ram[addr] = val;
@@ -2142,7 +2223,7 @@ mem_write_remappedw(uint32_t addr, uint16_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xA0000 + (addr - remap_start_addr);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_ramw_page(addr, val, &pages[oldaddr >> 12]);
     } else
         *(uint16_t *) &ram[addr] = val;
@@ -2154,7 +2235,7 @@ mem_write_remappedl(uint32_t addr, uint32_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xA0000 + (addr - remap_start_addr);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_raml_page(addr, val, &pages[oldaddr >> 12]);
     } else
         *(uint32_t *) &ram[addr] = val;
@@ -2166,7 +2247,7 @@ mem_write_remapped2(uint32_t addr, uint8_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xD0000 + (addr - remap_start_addr2);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_ramb_page(addr, val, &pages[oldaddr >> 12]);
     } else
         ram[addr] = val;
@@ -2178,7 +2259,7 @@ mem_write_remappedw2(uint32_t addr, uint16_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xD0000 + (addr - remap_start_addr2);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_ramw_page(addr, val, &pages[oldaddr >> 12]);
     } else
         *(uint16_t *) &ram[addr] = val;
@@ -2190,7 +2271,7 @@ mem_write_remappedl2(uint32_t addr, uint32_t val, UNUSED(void *priv))
     uint32_t oldaddr = addr;
     addr             = 0xD0000 + (addr - remap_start_addr2);
     if (cpu_use_exec) {
-        addwritelookup(mem_logical_addr, addr);
+        addwritelookup_ex(mem_logical_addr, oldaddr, addr);
         mem_write_raml_page(addr, val, &pages[oldaddr >> 12]);
     } else
         *(uint32_t *) &ram[addr] = val;
@@ -2896,7 +2977,6 @@ mem_init(void)
 {
     /* Perform a one-time init. */
     ram = rom = NULL;
-    ram2      = NULL;
     pages     = NULL;
 }
 
@@ -3102,6 +3182,83 @@ mem_reset_page_blocks(void)
     }
 }
 
+void
+mem_save(struct snapshot_t *snap)
+{
+    mem_mapping_t *map   = base_mapping;
+    uint32_t       count = 0;
+    uint32_t       run;
+
+    snapshot_write_var(snap, mem_a20_key);
+    snapshot_write_var(snap, mem_a20_alt);
+    snapshot_write_var(snap, mem_a20_chipset);
+    snapshot_write_var(snap, mem_a20_state);
+    snapshot_write_var(snap, rammask);
+    snapshot_write_var(snap, old_rammask);
+
+    /* The mappings are created in the same order for a given configuration;
+       chipsets move, enable and disable them for shadow RAM, SMRAM, etc. */
+    for (map = base_mapping; map != NULL; map = map->next)
+        count++;
+    snapshot_write_var(snap, count);
+    for (map = base_mapping; map != NULL; map = map->next) {
+        snapshot_write_var(snap, map->enable);
+        snapshot_write_var(snap, map->base);
+        snapshot_write_var(snap, map->size);
+        snapshot_write_var(snap, map->base_ignore);
+        snapshot_write_var(snap, map->mask);
+    }
+
+    /* The access states set through mem_set_mem_state(), as runs. */
+    for (uint32_t c = 0; c < MEM_MAPPINGS_NO; c += run) {
+        for (run = 1; ((c + run) < MEM_MAPPINGS_NO) && !memcmp(&_mem_state[c + run], &_mem_state[c], sizeof(mem_state_t)); run++)
+            ;
+        snapshot_write_var(snap, run);
+        snapshot_write_var(snap, _mem_state[c]);
+    }
+}
+
+int
+mem_load(struct snapshot_t *snap)
+{
+    mem_mapping_t *map   = base_mapping;
+    uint32_t       count = 0;
+    uint32_t       saved;
+    uint32_t       run;
+    mem_state_t    state;
+
+    if (!snapshot_read_var(snap, mem_a20_key) || !snapshot_read_var(snap, mem_a20_alt) ||
+        !snapshot_read_var(snap, mem_a20_chipset) || !snapshot_read_var(snap, mem_a20_state) ||
+        !snapshot_read_var(snap, rammask) || !snapshot_read_var(snap, old_rammask))
+        return 0;
+
+    for (map = base_mapping; map != NULL; map = map->next)
+        count++;
+    if (!snapshot_read_var(snap, saved) || (saved != count)) {
+        mem_log("MEM: Snapshot has %u memory mappings, machine has %u\n", saved, count);
+        return 0;
+    }
+    for (map = base_mapping; map != NULL; map = map->next) {
+        if (!snapshot_read_var(snap, map->enable) || !snapshot_read_var(snap, map->base) ||
+            !snapshot_read_var(snap, map->size) || !snapshot_read_var(snap, map->base_ignore) ||
+            !snapshot_read_var(snap, map->mask))
+            return 0;
+    }
+
+    for (uint32_t c = 0; c < MEM_MAPPINGS_NO; c += run) {
+        if (!snapshot_read_var(snap, run) || !snapshot_read_var(snap, state) ||
+            (run == 0) || (run > (MEM_MAPPINGS_NO - c)))
+            return 0;
+        for (uint32_t i = 0; i < run; i++)
+            _mem_state[c + i] = state;
+    }
+
+    mem_mapping_recalc(0x000000000ULL, 0x100000000ULL);
+    flushmmucache();
+
+    return 1;
+}
+
 void
 mem_a20_recalc(void)
 {
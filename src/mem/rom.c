@@ -55,6 +55,21 @@ rom_log(const char *fmt, ...)
 #    define rom_log(fmt, ...)
 #endif
 
+/* Images are mapped read-only once per process and kept here, so that the
+   same file loaded by several devices, or again on every hard reset, is not
+   re-read from the host. An entry is remapped if the file's size or
+   modification time has changed. Loading still copies the image into the
+   machine's own ROM buffer. */
+typedef struct rom_cache_t {
+    char                fn[1024];
+    const uint8_t      *data;
+    long                size;
+    uint64_t            mtime;
+    struct rom_cache_t *next;
+} rom_cache_t;
+
+static rom_cache_t *rom_cache = NULL;
+
 static void
 add_path(rom_path_t *list, const char *path)
 {
@@ -430,12 +445,96 @@ rom_writel(uint32_t addr, uint32_t val, void *priv)
     *(uint32_t *) &rom->rom[(addr - rom->mapping.base) & rom->mask] = val;
 }
 
+static const rom_cache_t *
+rom_cache_get(const char *fn)
+{
+    char         temp[1024] = { 0 };
+    uint64_t     size;
+    uint64_t     mtime;
+    size_t       map_size   = 0;
+    void        *data       = NULL;
+    rom_cache_t *rc;
+
+    if ((fn == NULL) || !rom_getfile(fn, temp, sizeof(temp) - 1) || !plat_file_stat(temp, &size, &mtime))
+        return NULL;
+
+    for (rc = rom_cache; rc != NULL; rc = rc->next) {
+        if (!strcmp(rc->fn, temp))
+            break;
+    }
+
+    if ((rc != NULL) && ((uint64_t) rc->size == size) && (rc->mtime == mtime))
+        return rc;
+
+    /* An empty file has nothing to map. */
+    if ((size > 0) && ((data = plat_mmap_file(temp, &map_size)) == NULL)) {
+        rom_log("ROM: unable to map image '%s'\n", temp);
+        return NULL;
+    }
+
+    if (rc == NULL) {
+        rc = (rom_cache_t *) calloc(1, sizeof(rom_cache_t));
+        if (rc == NULL) {
+            if (data != NULL)
+                plat_munmap_file(data, map_size);
+            return NULL;
+        }
+        strcpy(rc->fn, temp);
+        rc->next  = rom_cache;
+        rom_cache = rc;
+    } else if (rc->data != NULL)
+        plat_munmap_file((void *) rc->data, rc->size);
+
+    rc->data  = (const uint8_t *) data;
+    rc->size  = (long) map_size;
+    rc->mtime = mtime;
+
+    rom_log("ROM: mapped image '%s' (%li bytes)\n", rc->fn, rc->size);
+
+    return rc;
+}
+
+/* Copy up to len bytes at *pos out of a cached image, like fread() would. */
+static int
+rom_cache_read(const rom_cache_t *rc, long *pos, uint8_t *dst, int len)
+{
+    long avail = rc->size - *pos;
+
+    if (avail <= 0)
+        return 0;
+    if (avail < len)
+        len = (int) avail;
+
+    memcpy(dst, rc->data + *pos, len);
+    *pos += len;
+
+    return len;
+}
+
+void
+rom_cache_close(void)
+{
+    rom_cache_t *rc = rom_cache;
+    rom_cache_t *next;
+
+    while (rc != NULL) {
+        next = rc->next;
+        if (rc->data != NULL)
+            plat_munmap_file((void *) rc->data, rc->size);
+        free(rc);
+        rc = next;
+    }
+
+    rom_cache = NULL;
+}
+
 int
 rom_load_linear_oddeven(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
 {
-    FILE *fp = rom_fopen(fn, "rb");
+    const rom_cache_t *rc = rom_cache_get(fn);
+    long               pos = off;
 
-    if (fp == NULL) {
+    if (rc == NULL) {
         rom_log("ROM: image '%s' not found\n", fn);
         return 0;
     }
@@ -447,21 +546,16 @@ rom_load_linear_oddeven(const char *fn, uint32_t addr, int sz, int off, uint8_t
         addr &= 0x03ffff;
 
     if (ptr != NULL) {
-        if (fseek(fp, off, SEEK_SET) == -1)
-            fatal("rom_load_linear(): Error seeking to the beginning of the file\n");
         for (int i = 0; i < (sz >> 1); i++) {
-            if (fread(ptr + (addr + (i << 1)), 1, 1, fp) != 1)
+            if (rom_cache_read(rc, &pos, ptr + (addr + (i << 1)), 1) != 1)
                 fatal("rom_load_linear(): Error reading even data\n");
         }
         for (int i = 0; i < (sz >> 1); i++) {
-            if (fread(ptr + (addr + (i << 1) + 1), 1, 1, fp) != 1)
+            if (rom_cache_read(rc, &pos, ptr + (addr + (i << 1) + 1), 1) != 1)
                 fatal("rom_load_linear(): Error reading odd data\n");
         }
     }
 
-    if (fp != NULL)
-        (void) fclose(fp);
-
     return 1;
 }
 
@@ -469,9 +563,10 @@ rom_load_linear_oddeven(const char *fn, uint32_t addr, int sz, int off, uint8_t
 int
 rom_load_linear(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
 {
-    FILE *fp = rom_fopen(fn, "rb");
+    const rom_cache_t *rc = rom_cache_get(fn);
+    long               pos = off;
 
-    if (fp == NULL) {
+    if (rc == NULL) {
         rom_log("ROM: image '%s' not found\n", fn);
         return 0;
     }
@@ -482,15 +577,8 @@ rom_load_linear(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
     else
         addr &= 0x03ffff;
 
-    if (ptr != NULL) {
-        if (fseek(fp, off, SEEK_SET) == -1)
-            fatal("rom_load_linear(): Error seeking to the beginning of the file\n");
-        if (fread(ptr + addr, 1, sz, fp) > sz)
-            fatal("rom_load_linear(): Error reading data\n");
-    }
-
-    if (fp != NULL)
-        (void) fclose(fp);
+    if (ptr != NULL)
+        (void) rom_cache_read(rc, &pos, ptr + addr, sz);
 
     return 1;
 }
@@ -499,9 +587,10 @@ rom_load_linear(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
 int
 rom_load_linear_inverted(const char *fn, uint32_t addr, int sz, int off, uint8_t *ptr)
 {
-    FILE *fp = rom_fopen(fn, "rb");
+    const rom_cache_t *rc = rom_cache_get(fn);
+    long               pos = off;
 
-    if (fp == NULL) {
+    if (rc == NULL) {
         rom_log("ROM: image '%s' not found\n", fn);
         return 0;
     }
@@ -513,30 +602,18 @@ rom_load_linear_inverted(const char *fn, uint32_t addr, int sz, int off, uint8_t
         addr &= 0x03ffff;
     }
 
-    (void) fseek(fp, 0, SEEK_END);
-    if (ftell(fp) < sz) {
-        (void) fclose(fp);
+    if (rc->size < sz)
         return 0;
-    }
 
     if (ptr != NULL) {
-        if (fseek(fp, off, SEEK_SET) == -1)
-            fatal("rom_load_linear_inverted(): Error seeking to the beginning of the file\n");
-        if (fread(ptr + addr + 0x10000, 1, sz >> 1, fp) > (sz >> 1))
-            fatal("rom_load_linear_inverted(): Error reading the upper half of the data\n");
-        if (fread(ptr + addr, sz >> 1, 1, fp) > (sz >> 1))
-            fatal("rom_load_linear_inverted(): Error reading the lower half of the data\n");
+        (void) rom_cache_read(rc, &pos, ptr + addr + 0x10000, sz >> 1);
+        (void) rom_cache_read(rc, &pos, ptr + addr, sz >> 1);
         if (sz == 0x40000) {
-            if (fread(ptr + addr + 0x30000, 1, sz >> 1, fp) > (sz >> 1))
-                fatal("rom_load_linear_inverted(): Error reading the upper half of the data\n");
-            if (fread(ptr + addr + 0x20000, sz >> 1, 1, fp) > (sz >> 1))
-                fatal("rom_load_linear_inverted(): Error reading the lower half of the data\n");
+            (void) rom_cache_read(rc, &pos, ptr + addr + 0x30000, sz >> 1);
+            (void) rom_cache_read(rc, &pos, ptr + addr + 0x20000, sz >> 1);
         }
     }
 
-    if (fp != NULL)
-        (void) fclose(fp);
-
     return 1;
 }
 
@@ -544,18 +621,14 @@ rom_load_linear_inverted(const char *fn, uint32_t addr, int sz, int off, uint8_t
 int
 rom_load_interleaved(const char *fnl, const char *fnh, uint32_t addr, int sz, int off, uint8_t *ptr)
 {
-    FILE *fpl = rom_fopen(fnl, "rb");
-    FILE *fph = rom_fopen(fnh, "rb");
+    const rom_cache_t *rcl = rom_cache_get(fnl);
+    const rom_cache_t *rch = rom_cache_get(fnh);
 
-    if (fpl == NULL || fph == NULL) {
-        if (fpl == NULL)
+    if (rcl == NULL || rch == NULL) {
+        if (rcl == NULL)
             rom_log("ROM: image '%s' not found\n", fnl);
-        else
-            (void) fclose(fpl);
-        if (fph == NULL)
+        if (rch == NULL)
             rom_log("ROM: image '%s' not found\n", fnh);
-        else
-            (void) fclose(fph);
 
         return 0;
     }
@@ -568,19 +641,14 @@ rom_load_interleaved(const char *fnl, const char *fnh, uint32_t addr, int sz, in
     }
 
     if (ptr != NULL) {
-        (void) fseek(fpl, off, SEEK_SET);
-        (void) fseek(fph, off, SEEK_SET);
         for (int c = 0; c < sz; c += 2) {
-            ptr[addr + c]     = fgetc(fpl) & 0xff;
-            ptr[addr + c + 1] = fgetc(fph) & 0xff;
+            long pos = off + (c >> 1);
+
+            ptr[addr + c]     = (pos < rcl->size) ? rcl->data[pos] : 0xff;
+            ptr[addr + c + 1] = (pos < rch->size) ? rch->data[pos] : 0xff;
         }
     }
 
-    if (fph != NULL)
-        (void) fclose(fph);
-    if (fpl != NULL)
-        (void) fclose(fpl);
-
     return 1;
 }
 
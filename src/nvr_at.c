@@ -218,6 +218,7 @@
  *   USA.
  */
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
@@ -236,6 +237,7 @@
 #include <86box/rom.h>
 #include <86box/device.h>
 #include <86box/nvr.h>
+#include <86box/snapshot.h>
 
 /* RTC registers and bit definitions. */
 #define RTC_SECONDS        0
@@ -300,6 +302,18 @@
 #define FLAG_MULTI_BANK     0x100
 #define FLAG_MARTIN_HACK    0x200
 
+/* I/O ports the chip answers on, kept so that a snapshot can restore them. */
+#define NVR_IO_MAX          8
+#define NVR_IO_RW           1 /* nvr_read() and nvr_write() */
+#define NVR_IO_WO           2 /* nvr_write() only */
+#define NVR_IO_SEC          3 /* nvr_sec_read() and nvr_sec_write() */
+
+typedef struct nvr_io_t {
+    uint16_t port;
+    uint8_t  kind;
+    uint8_t  pad;
+} nvr_io_t;
+
 typedef struct local_t {
     int8_t stat;
 
@@ -328,6 +342,8 @@ typedef struct local_t {
     uint64_t   rtc_time;
     pc_timer_t update_timer;
     pc_timer_t rtc_timer;
+
+    nvr_io_t io[NVR_IO_MAX];
 } local_t;
 
 static uint8_t nvr_at_inited = 0;
@@ -1005,46 +1021,90 @@ nvr_at_speed_changed(void *priv)
     timer_set_delay_u64(&nvr->onesec_time, (10000ULL * TIMER_USEC));
 }
 
+/* Sets or removes the handler of a single port, and keeps track of it. */
+static void
+nvr_at_io(nvr_t *nvr, int set, uint16_t port, uint8_t kind)
+{
+    local_t *local = (local_t *) nvr->data;
+    int      slot  = -1;
+
+    switch (kind) {
+        case NVR_IO_RW:
+            io_handler(set, port, 1,
+                       nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
+            break;
+        case NVR_IO_WO:
+            io_handler(set, port, 1,
+                       NULL, NULL, NULL, nvr_write, NULL, NULL, nvr);
+            break;
+        case NVR_IO_SEC:
+            io_handler(set, port, 1,
+                       nvr_sec_read, NULL, NULL, nvr_sec_write, NULL, NULL, nvr);
+            break;
+
+        default:
+            return;
+    }
+
+    for (int i = 0; i < NVR_IO_MAX; i++) {
+        if ((local->io[i].kind == kind) && (local->io[i].port == port)) {
+            slot = i;
+            break;
+        }
+    }
+
+    if (!set) {
+        if (slot != -1)
+            local->io[slot].kind = 0;
+        return;
+    }
+
+    for (int i = 0; (slot == -1) && (i < NVR_IO_MAX); i++) {
+        if (local->io[i].kind == 0)
+            slot = i;
+    }
+
+    if (slot != -1) {
+        local->io[slot].port = port;
+        local->io[slot].kind = kind;
+    }
+}
+
 void
 nvr_at_handler(int set, uint16_t base, nvr_t *nvr)
 {
-    io_handler(set, base, 2,
-               nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
+    nvr_at_io(nvr, set, base, NVR_IO_RW);
+    nvr_at_io(nvr, set, base + 1, NVR_IO_RW);
 }
 
 void
 nvr_at_index_read_handler(int set, uint16_t base, nvr_t *nvr)
 {
-    io_handler(0, base, 1,
-               NULL, NULL, NULL, nvr_write, NULL, NULL, nvr);
+    nvr_at_io(nvr, 0, base, NVR_IO_WO);
     nvr_at_handler(0, base, nvr);
 
     if (set)
         nvr_at_handler(1, base, nvr);
     else {
-        io_handler(1, base, 1,
-                   NULL, NULL, NULL, nvr_write, NULL, NULL, nvr);
-        io_handler(1, base + 1, 1,
-                   nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
+        nvr_at_io(nvr, 1, base, NVR_IO_WO);
+        nvr_at_io(nvr, 1, base + 1, NVR_IO_RW);
     }
 }
 
 void
 nvr_at_data_port(int set, nvr_t *nvr)
 {
-    io_handler(0, 0x71, 1,
-               nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
+    nvr_at_io(nvr, 0, 0x71, NVR_IO_RW);
 
     if (set)
-        io_handler(1, 0x71, 1,
-                   nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
+        nvr_at_io(nvr, 1, 0x71, NVR_IO_RW);
 }
 
 void
 nvr_at_sec_handler(int set, uint16_t base, nvr_t *nvr)
 {
-    io_handler(set, base, 2,
-               nvr_sec_read, NULL, NULL, nvr_sec_write, NULL, NULL, nvr);
+    nvr_at_io(nvr, set, base, NVR_IO_SEC);
+    nvr_at_io(nvr, set, base + 1, NVR_IO_SEC);
 }
 
 void
@@ -1276,18 +1336,13 @@ nvr_at_init(const device_t *info)
         timer_load_count(nvr);
 
         /* Set up the I/O handler for this device. */
-        if (info->local == 8) {
-            io_sethandler(0x11b4, 2,
-                          nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
-        } else {
-            io_sethandler(0x0070, 2,
-                          nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
-        }
+        if (info->local == 8)
+            nvr_at_handler(1, 0x11b4, nvr);
+        else
+            nvr_at_handler(1, 0x0070, nvr);
         if (((info->local & 0x1f) == 0x11) || ((info->local & 0x1f) == 0x17) ||
-            ((info->local & 0x1f) == 0x18)) {
-            io_sethandler(0x0072, 2,
-                          nvr_read, NULL, NULL, nvr_write, NULL, NULL, nvr);
-        }
+            ((info->local & 0x1f) == 0x18))
+            nvr_at_handler(1, 0x0072, nvr);
 
         nvr_at_inited = 1;
     }
@@ -1328,6 +1383,61 @@ nvr_at_close(void *priv)
         nvr_at_inited = 0;
 }
 
+static void
+nvr_at_save(void *priv, struct snapshot_t *snap)
+{
+    nvr_t   *nvr   = (nvr_t *) priv;
+    local_t *local = (local_t *) nvr->data;
+
+    snapshot_write(snap, nvr->regs, nvr->size);
+    snapshot_write_var(snap, nvr->onesec_cnt);
+    snapshot_write_timer(snap, &nvr->onesec_time);
+
+    snapshot_write(snap, local, offsetof(local_t, lock));
+    snapshot_write(snap, local->lock, nvr->size);
+    snapshot_write_var(snap, local->count);
+    snapshot_write_var(snap, local->state);
+    snapshot_write_var(snap, local->addr);
+    snapshot_write_var(snap, local->smi_enable);
+    snapshot_write_var(snap, local->ecount);
+    snapshot_write_var(snap, local->rtc_time);
+    snapshot_write_timer(snap, &local->update_timer);
+    snapshot_write_timer(snap, &local->rtc_timer);
+    snapshot_write_var(snap, local->io);
+}
+
+static int
+nvr_at_load(void *priv, struct snapshot_t *snap)
+{
+    nvr_t   *nvr   = (nvr_t *) priv;
+    local_t *local = (local_t *) nvr->data;
+    nvr_io_t io[NVR_IO_MAX];
+
+    if (!snapshot_read(snap, nvr->regs, nvr->size) || !snapshot_read_var(snap, nvr->onesec_cnt) ||
+        !snapshot_read_timer(snap, &nvr->onesec_time))
+        return 0;
+
+    if (!snapshot_read(snap, local, offsetof(local_t, lock)) || !snapshot_read(snap, local->lock, nvr->size) ||
+        !snapshot_read_var(snap, local->count) || !snapshot_read_var(snap, local->state) ||
+        !snapshot_read_var(snap, local->addr) || !snapshot_read_var(snap, local->smi_enable) ||
+        !snapshot_read_var(snap, local->ecount) || !snapshot_read_var(snap, local->rtc_time) ||
+        !snapshot_read_timer(snap, &local->update_timer) || !snapshot_read_timer(snap, &local->rtc_timer) ||
+        !snapshot_read_var(snap, io))
+        return 0;
+
+    /* Move the chip to the ports it was on, the way the chipsets do. */
+    for (int i = 0; i < NVR_IO_MAX; i++) {
+        if (local->io[i].kind)
+            nvr_at_io(nvr, 0, local->io[i].port, local->io[i].kind);
+    }
+    for (int i = 0; i < NVR_IO_MAX; i++) {
+        if (io[i].kind)
+            nvr_at_io(nvr, 1, io[i].port, io[i].kind);
+    }
+
+    return 1;
+}
+
 const device_t at_nvr_old_device = {
     .name          = "PC/AT NVRAM (No century)",
     .internal_name = "at_nvr_old",
@@ -1339,7 +1449,9 @@ const device_t at_nvr_old_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t at_nvr_device = {
@@ -1353,7 +1465,9 @@ const device_t at_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t at_mb_nvr_device = {
@@ -1367,7 +1481,9 @@ const device_t at_mb_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ps_nvr_device = {
@@ -1381,7 +1497,9 @@ const device_t ps_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t amstrad_nvr_device = {
@@ -1395,7 +1513,9 @@ const device_t amstrad_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ibmat_nvr_device = {
@@ -1409,7 +1529,9 @@ const device_t ibmat_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t piix4_nvr_device = {
@@ -1423,7 +1545,9 @@ const device_t piix4_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ps_no_nmi_nvr_device = {
@@ -1437,7 +1561,9 @@ const device_t ps_no_nmi_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t amstrad_no_nmi_nvr_device = {
@@ -1451,7 +1577,9 @@ const device_t amstrad_no_nmi_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ami_1992_nvr_device = {
@@ -1465,7 +1593,9 @@ const device_t ami_1992_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ami_1994_nvr_device = {
@@ -1479,7 +1609,9 @@ const device_t ami_1994_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t ami_1995_nvr_device = {
@@ -1493,7 +1625,9 @@ const device_t ami_1995_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t via_nvr_device = {
@@ -1507,7 +1641,9 @@ const device_t via_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t piix4_ami_1995_nvr_device = {
@@ -1521,7 +1657,9 @@ const device_t piix4_ami_1995_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t piix4_ami_1995j_nvr_device = {
@@ -1535,7 +1673,9 @@ const device_t piix4_ami_1995j_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t p6rp4_nvr_device = {
@@ -1549,7 +1689,9 @@ const device_t p6rp4_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t amstrad_megapc_nvr_device = {
@@ -1563,7 +1705,9 @@ const device_t amstrad_megapc_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t martin_nvr_device = {
@@ -1577,7 +1721,9 @@ const device_t martin_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
 
 const device_t elt_nvr_device = {
@@ -1591,5 +1737,7 @@ const device_t elt_nvr_device = {
     .available     = NULL,
     .speed_changed = nvr_at_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = nvr_at_save,
+    .load          = nvr_at_load
 };
@@ -16,6 +16,7 @@
  *          Copyright 2016-2020 Miran Grca.
  */
 #include <inttypes.h>
+#include <stddef.h>
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -36,6 +37,7 @@
 #include <86box/apm.h>
 #include <86box/nvr.h>
 #include <86box/acpi.h>
+#include <86box/snapshot.h>
 #include <86box/plat_unused.h>
 
 enum {
@@ -923,3 +925,35 @@ picinterrupt(void)
 
     return ret;
 }
+
+void
+pic_save(struct snapshot_t *snap)
+{
+    /* Everything up to the slave pointers, which are rebuilt by pic_init(). */
+    snapshot_write(snap, &pic, offsetof(pic_t, slaves));
+    snapshot_write(snap, &pic2, offsetof(pic_t, slaves));
+    snapshot_write_var(snap, shadow);
+    snapshot_write_var(snap, elcr_enabled);
+    snapshot_write_var(snap, kbd_latch);
+    snapshot_write_var(snap, mouse_latch);
+    snapshot_write_var(snap, smi_irq_mask);
+    snapshot_write_var(snap, smi_irq_status);
+    snapshot_write_var(snap, latched_irqs);
+    snapshot_write_timer(snap, &pic_timer);
+}
+
+int
+pic_load(struct snapshot_t *snap)
+{
+    if (!snapshot_read(snap, &pic, offsetof(pic_t, slaves)) ||
+        !snapshot_read(snap, &pic2, offsetof(pic_t, slaves)) ||
+        !snapshot_read_var(snap, shadow) || !snapshot_read_var(snap, elcr_enabled) ||
+        !snapshot_read_var(snap, kbd_latch) || !snapshot_read_var(snap, mouse_latch) ||
+        !snapshot_read_var(snap, smi_irq_mask) || !snapshot_read_var(snap, smi_irq_status) ||
+        !snapshot_read_var(snap, latched_irqs) || !snapshot_read_timer(snap, &pic_timer))
+        return 0;
+
+    update_pending();
+
+    return 1;
+}
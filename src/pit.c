@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -34,6 +35,7 @@
 #include <86box/timer.h>
 #include <86box/pit.h>
 #include <86box/pit_fast.h>
+#include <86box/snapshot.h>
 #include <86box/ppi.h>
 #include <86box/machine.h>
 #include <86box/sound.h>
@@ -937,6 +939,35 @@ pit_close(void *priv)
         free(dev);
 }
 
+static void
+pit_save(void *priv, struct snapshot_t *snap)
+{
+    pit_t *dev = (pit_t *) priv;
+
+    snapshot_write_var(snap, dev->clock);
+    snapshot_write_timer(snap, &dev->callback_timer);
+    /* The output callbacks belong to the machine and are not saved. */
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        snapshot_write(snap, &dev->counters[i], offsetof(ctr_t, load_func));
+    snapshot_write_var(snap, dev->ctrl);
+    snapshot_write_var(snap, dev->pit_const);
+}
+
+static int
+pit_load(void *priv, struct snapshot_t *snap)
+{
+    pit_t *dev = (pit_t *) priv;
+
+    if (!snapshot_read_var(snap, dev->clock) || !snapshot_read_timer(snap, &dev->callback_timer))
+        return 0;
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (!snapshot_read(snap, &dev->counters[i], offsetof(ctr_t, load_func)))
+            return 0;
+    }
+
+    return snapshot_read_var(snap, dev->ctrl) && snapshot_read_var(snap, dev->pit_const);
+}
+
 static void *
 pit_init(const device_t *info)
 {
@@ -973,7 +1004,9 @@ const device_t i8253_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 const device_t i8253_ext_io_device = {
@@ -987,7 +1020,9 @@ const device_t i8253_ext_io_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 const device_t i8254_device = {
@@ -1001,7 +1036,9 @@ const device_t i8254_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 const device_t i8254_sec_device = {
@@ -1015,7 +1052,9 @@ const device_t i8254_sec_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 const device_t i8254_ext_io_device = {
@@ -1029,7 +1068,9 @@ const device_t i8254_ext_io_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 const device_t i8254_ps2_device = {
@@ -1043,7 +1084,9 @@ const device_t i8254_ps2_device = {
     .available     = NULL,
     .speed_changed = pit_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pit_save,
+    .load          = pit_load
 };
 
 pit_t *
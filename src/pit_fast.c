@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -38,6 +39,7 @@
 #include <86box/machine.h>
 #include <86box/sound.h>
 #include <86box/snd_speaker.h>
+#include <86box/snapshot.h>
 #include <86box/video.h>
 
 #define PIT_PS2          16  /* The PIT is the PS/2's second PIT. */
@@ -708,6 +710,33 @@ pitf_close(void *priv)
         free(dev);
 }
 
+static void
+pitf_save(void *priv, struct snapshot_t *snap)
+{
+    pitf_t *dev = (pitf_t *) priv;
+
+    /* The output callbacks belong to the machine and are not saved. */
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        snapshot_write(snap, &dev->counters[i], offsetof(ctrf_t, timer));
+        snapshot_write_timer(snap, &dev->counters[i].timer);
+    }
+    snapshot_write_var(snap, dev->ctrl);
+}
+
+static int
+pitf_load(void *priv, struct snapshot_t *snap)
+{
+    pitf_t *dev = (pitf_t *) priv;
+
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (!snapshot_read(snap, &dev->counters[i], offsetof(ctrf_t, timer)) ||
+            !snapshot_read_timer(snap, &dev->counters[i].timer))
+            return 0;
+    }
+
+    return snapshot_read_var(snap, dev->ctrl);
+}
+
 void
 pitf_handler(int set, uint16_t base, int size, void *priv)
 {
@@ -752,7 +781,9 @@ const device_t i8253_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pitf_save,
+    .load          = pitf_load
 };
 
 const device_t i8254_fast_device = {
@@ -766,7 +797,9 @@ const device_t i8254_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pitf_save,
+    .load          = pitf_load
 };
 
 const device_t i8254_sec_fast_device = {
@@ -780,7 +813,9 @@ const device_t i8254_sec_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pitf_save,
+    .load          = pitf_load
 };
 
 const device_t i8254_ext_io_fast_device = {
@@ -794,7 +829,9 @@ const device_t i8254_ext_io_fast_device = {
     .available     = NULL,
     .speed_changed = NULL,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pitf_save,
+    .load          = pitf_load
 };
 
 const device_t i8254_ps2_fast_device = {
@@ -808,7 +845,9 @@ const device_t i8254_ps2_fast_device = {
     .available     = NULL,
     .speed_changed = pitf_speed_changed,
     .force_redraw  = NULL,
-    .config        = NULL
+    .config        = NULL,
+    .save          = pitf_save,
+    .load          = pitf_load
 };
 
 const pit_intf_t pit_fast_intf = {
@@ -46,6 +46,7 @@ extern "C" {
 #endif
 #include <86box/device.h>
 #include <86box/video.h>
+#include <86box/vid_stats.h>
 #include <86box/mouse.h>
 #include <86box/machine.h>
 #include <86box/vid_ega.h>
@@ -811,8 +812,11 @@ MainWindow::MainWindow(QWidget *parent)
         static auto init_trace = [&] {
             mtr_init("trace.json");
             mtr_start();
+            video_stats_start();
         };
         static auto shutdown_trace = [&] {
+            video_stats_stop();
+            video_stats_dump("video_stats.json");
             mtr_stop();
             mtr_shutdown();
         };
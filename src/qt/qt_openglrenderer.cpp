@@ -54,6 +54,7 @@ extern "C" {
 #include <86box/plat.h>
 #include <86box/ui.h>
 #include <86box/video.h>
+#include <86box/vid_stats.h>
 #include <86box/path.h>
 #include <86box/ini.h>
 #include <86box/config.h>
@@ -1410,6 +1411,8 @@ OpenGLRenderer::render()
     if (notReady())
         return;
 
+    uint64_t stats_start = video_stats_begin(VIDEO_STAT_PRESENT);
+
     struct {
         uint32_t x;
         uint32_t y;
@@ -1750,5 +1753,7 @@ OpenGLRenderer::render()
 
     frameCounter++;
     context->swapBuffers(this);
+
+    video_stats_end(VIDEO_STAT_PRESENT, stats_start);
 }
 
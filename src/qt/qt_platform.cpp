@@ -62,6 +62,8 @@
 #ifdef Q_OS_UNIX
 #    include <pthread.h>
 #    include <sys/mman.h>
+#    include <fcntl.h>
+#    include <unistd.h>
 #endif
 
 #include <sys/stat.h>
@@ -452,6 +454,85 @@ plat_munmap(void *ptr, size_t size)
 #endif
 }
 
+int
+plat_file_stat(const char *path, uint64_t *size, uint64_t *mtime)
+{
+#ifdef Q_OS_WINDOWS
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    auto                      wpath = QString::fromUtf8(path).toStdWString();
+
+    if (!GetFileAttributesExW(wpath.c_str(), GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return 0;
+
+    *size  = ((uint64_t) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    *mtime = ((uint64_t) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat stats;
+
+    if ((stat(path, &stats) < 0) || S_ISDIR(stats.st_mode))
+        return 0;
+
+    *size  = (uint64_t) stats.st_size;
+    *mtime = (uint64_t) stats.st_mtime;
+#endif
+    return 1;
+}
+
+/* Maps a whole file read-only and shared, so that the pages can be shared
+   with other processes mapping the same file. */
+void *
+plat_mmap_file(const char *path, size_t *size)
+{
+    void *ret = nullptr;
+#ifdef Q_OS_WINDOWS
+    auto          wpath = QString::fromUtf8(path).toStdWString();
+    HANDLE        file  = CreateFileW(wpath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER len;
+
+    if (file == INVALID_HANDLE_VALUE)
+        return nullptr;
+
+    if (GetFileSizeEx(file, &len) && (len.QuadPart > 0) && ((uint64_t) len.QuadPart == (size_t) len.QuadPart)) {
+        HANDLE map = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (map != NULL) {
+            /* The view keeps the mapping alive. */
+            ret = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+            if (ret != nullptr)
+                *size = (size_t) len.QuadPart;
+            CloseHandle(map);
+        }
+    }
+    CloseHandle(file);
+#else
+    struct stat stats;
+    int         fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return nullptr;
+
+    if ((fstat(fd, &stats) == 0) && (stats.st_size > 0)) {
+        ret = mmap(0, (size_t) stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ret == MAP_FAILED)
+            ret = nullptr;
+        else
+            *size = (size_t) stats.st_size;
+    }
+    close(fd);
+#endif
+    return ret;
+}
+
+void
+plat_munmap_file(void *ptr, size_t size)
+{
+#ifdef Q_OS_WINDOWS
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+
 extern bool cpu_thread_running;
 
 #ifdef Q_OS_WINDOWS
@@ -938,6 +1019,14 @@ plat_get_cpu_string(char *outbuf, uint8_t len)
     qstrncpy(outbuf, cpu_string.toUtf8().constData(), len);
 }
 
+int
+plat_get_cpu_count(void)
+{
+    const unsigned int count = std::thread::hardware_concurrency();
+
+    return count ? count : 1;
+}
+
 void
 plat_set_thread_name(void *thread, const char *name)
 {
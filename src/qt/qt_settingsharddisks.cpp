@@ -43,6 +43,10 @@ const int DataBus                = Qt::UserRole;
 const int DataBusChannel         = Qt::UserRole + 1;
 const int DataBusPrevious        = Qt::UserRole + 2;
 const int DataBusChannelPrevious = Qt::UserRole + 3;
+const int DataMmapMode           = Qt::UserRole + 4; /* only set in the configuration file, kept as is */
+const int DataVhdCache           = Qt::UserRole + 5; /* likewise */
+const int DataOverlay            = Qt::UserRole + 6; /* likewise */
+const int DataOverlayDiscard     = Qt::UserRole + 7; /* likewise */
 
 QIcon hard_disk_icon;
 
@@ -88,6 +92,10 @@ addRow(QAbstractItemModel *model, hard_disk_t *hd)
     model->setData(busIndex, hd->bus_type, DataBusPrevious);
     model->setData(busIndex, hd->channel, DataBusChannel);
     model->setData(busIndex, hd->channel, DataBusChannelPrevious);
+    model->setData(busIndex, hd->mmap_mode, DataMmapMode);
+    model->setData(busIndex, hd->vhd_cache, DataVhdCache);
+    model->setData(busIndex, QString(hd->overlay_fn), DataOverlay);
+    model->setData(busIndex, hd->overlay_discard, DataOverlayDiscard);
     Harddrives::busTrackClass->device_track(1, DEV_HDD, hd->bus_type, hd->channel);
     auto    filenameIndex = model->index(row, ColumnFilename);
     QString fileName      = hd->fn;
@@ -167,6 +175,9 @@ SettingsHarddisks::save()
         auto idx            = model->index(i, ColumnBus);
         hdd[i].bus_type     = idx.data(DataBus).toUInt();
         hdd[i].channel      = idx.data(DataBusChannel).toUInt();
+        hdd[i].mmap_mode    = idx.data(DataMmapMode).toUInt();
+        hdd[i].vhd_cache    = idx.data(DataVhdCache).toUInt();
+        hdd[i].overlay_discard = idx.data(DataOverlayDiscard).toUInt();
         hdd[i].tracks       = idx.siblingAtColumn(ColumnCylinders).data().toUInt();
         hdd[i].hpc          = idx.siblingAtColumn(ColumnHeads).data().toUInt();
         hdd[i].spt          = idx.siblingAtColumn(ColumnSectors).data().toUInt();
@@ -175,6 +186,8 @@ SettingsHarddisks::save()
 
         QByteArray fileName = idx.siblingAtColumn(ColumnFilename).data(Qt::UserRole).toString().toUtf8();
         strncpy(hdd[i].fn, fileName.data(), sizeof(hdd[i].fn) - 1);
+        QByteArray overlayName = idx.data(DataOverlay).toString().toUtf8();
+        strncpy(hdd[i].overlay_fn, overlayName.data(), sizeof(hdd[i].overlay_fn) - 1);
         hdd[i].priv = nullptr;
     }
 }
@@ -27,6 +27,7 @@ extern "C" {
 #include <86box/path.h>
 #include <86box/plat.h>
 #include <86box/video.h>
+#include <86box/vid_stats.h>
 }
 
 SoftwareRenderer::SoftwareRenderer(QWidget *parent)
@@ -155,6 +156,8 @@ SoftwareRenderer::onPaint(QPaintDevice *device)
     if (cur_image == -1)
         return;
 
+    uint64_t stats_start = video_stats_begin(VIDEO_STAT_PRESENT);
+
     QPainter painter(device);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, video_filter_method > 0 ? true : false);
 #if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
@@ -165,6 +168,8 @@ SoftwareRenderer::onPaint(QPaintDevice *device)
     painter.setCompositionMode(QPainter::CompositionMode_Plus);
     painter.drawImage(destination, *images[cur_image], source);
     painter.end();
+
+    video_stats_end(VIDEO_STAT_PRESENT, stats_start);
 }
 
 std::vector<std::tuple<uint8_t *, std::atomic_flag *>>
@@ -40,6 +40,7 @@
 
 extern "C" {
 #    include <86box/86box.h>
+#    include <86box/vid_stats.h>
 }
 
 // Use a triangle strip to get a quad.
@@ -897,9 +898,10 @@ VulkanRenderer2::releaseResources()
 void
 VulkanRenderer2::startNextFrame()
 {
-    VkDevice        dev = m_window->device();
-    VkCommandBuffer cb  = m_window->currentCommandBuffer();
-    const QSize     sz  = m_window->swapChainImageSize();
+    VkDevice        dev         = m_window->device();
+    VkCommandBuffer cb          = m_window->currentCommandBuffer();
+    const QSize     sz          = m_window->swapChainImageSize();
+    uint64_t        stats_start = video_stats_begin(VIDEO_STAT_PRESENT);
 
     updateSamplers();
     // Add the necessary barriers and do the host-linear -> device-optimal copy, if not yet done.
@@ -1003,5 +1005,7 @@ VulkanRenderer2::startNextFrame()
 
     m_window->frameReady();
     m_window->requestUpdate(); // render continuously, throttled by the presentation rate
+
+    video_stats_end(VIDEO_STAT_PRESENT, stats_start);
 }
 #endif /* QT_CONFIG(vulkan) */
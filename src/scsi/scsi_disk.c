@@ -66,6 +66,7 @@ const uint8_t scsi_disk_command_flags[0x100] = {
     [0x2a ... 0x2b] = IMPLEMENTED | CHECK_READY,
     [0x2e]          = IMPLEMENTED | CHECK_READY,
     [0x2f]          = IMPLEMENTED | CHECK_READY | SCSI_ONLY,
+    [0x35]          = IMPLEMENTED | CHECK_READY,
     [0x41]          = IMPLEMENTED | CHECK_READY,
     [0x55]          = IMPLEMENTED,
     [0x5a]          = IMPLEMENTED,
@@ -1454,6 +1455,12 @@ atapi_out:
             scsi_disk_command_complete(dev);
             break;
 
+        case GPCMD_SYNCHRONIZE_CACHE:
+            hdd_image_flush(dev->id);
+            scsi_disk_set_phase(dev, SCSI_PHASE_STATUS);
+            scsi_disk_command_complete(dev);
+            break;
+
         case GPCMD_SEEK_6:
         case GPCMD_SEEK_10:
             switch (cdb[0]) {
@@ -0,0 +1,617 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Implementation of the machine snapshot (save state) subsystem.
+ *
+ *          The snapshot covers the CPU and FPU, RAM, the memory map
+ *          (A20, shadow RAM and SMRAM mappings), the timer base, the
+ *          PIC and DMA controllers, and every device through the device_t
+ *          save/load hooks. A machine with a device that has no hooks and
+ *          is not marked DEVICE_STATELESS can not be saved or restored.
+ *          A snapshot can only be restored on the machine configuration
+ *          it was taken from, and one that lacks the state of any core
+ *          component or device is refused before anything is restored.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef _LARGEFILE_SOURCE
+#    define _LARGEFILE_SOURCE
+#endif
+#ifndef _LARGEFILE64_SOURCE
+#    define _LARGEFILE64_SOURCE
+#endif
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include "cpu.h"
+#include "x86.h"
+#include "x87_sf.h"
+#include <86box/timer.h>
+#include <86box/device.h>
+#include <86box/dma.h>
+#include <86box/machine.h>
+#include <86box/mem.h>
+#include <86box/nmi.h>
+#include <86box/pic.h>
+#include <86box/plat.h>
+#include <86box/snapshot.h>
+
+/* RAM is stored as runs of 4 KB pages. */
+#define RAM_RUN_ZERO 0 /* Pages that are all zero. */
+#define RAM_RUN_FILL 1 /* Pages filled with a single byte value. */
+#define RAM_RUN_RAW  2 /* Pages stored as-is. */
+
+struct snapshot_t {
+    FILE    *fp;
+    int      error;
+    int64_t  sect_len_pos; /* Offset of the current section's length (saving). */
+    uint64_t sect_left;    /* Bytes left in the current section (loading). */
+};
+
+/* Requests come from the UI thread, and are picked up by the emulation thread. */
+#define SNAPSHOT_IDLE    0
+#define SNAPSHOT_SAVE    1
+#define SNAPSHOT_LOAD    2
+#define SNAPSHOT_WRITING 3 /* The UI thread is filling in the file name. */
+
+/* Core sections that every snapshot must have. */
+static const char *snapshot_required[] = { "TIMR", "CPU ", "FPU ", "RAM ", "MEM ", "PIC ", "DMA " };
+
+static atomic_int snapshot_pending = SNAPSHOT_IDLE;
+static char       snapshot_pending_fn[1024];
+
+#ifdef ENABLE_SNAPSHOT_LOG
+int snapshot_do_log = ENABLE_SNAPSHOT_LOG;
+
+static void
+snapshot_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (snapshot_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define snapshot_log(fmt, ...)
+#endif
+
+void
+snapshot_write(snapshot_t *snap, const void *buf, size_t len)
+{
+    if (!snap->error && (fwrite(buf, 1, len, snap->fp) != len))
+        snap->error = 1;
+}
+
+int
+snapshot_read(snapshot_t *snap, void *buf, size_t len)
+{
+    if (snap->error || (len > snap->sect_left) || (fread(buf, 1, len, snap->fp) != len)) {
+        snap->error = 1;
+        return 0;
+    }
+
+    snap->sect_left -= len;
+
+    return 1;
+}
+
+void
+snapshot_write_timer(snapshot_t *snap, struct pc_timer_t *timer)
+{
+    uint8_t enabled   = timer_is_enabled(timer);
+    uint8_t split     = !!(timer->flags & TIMER_SPLIT);
+    int64_t remaining = enabled ? (int64_t) (timer->ts_integer - (uint64_t) tsc) : 0;
+
+    snapshot_write_var(snap, enabled);
+    snapshot_write_var(snap, split);
+    snapshot_write_var(snap, remaining);
+    snapshot_write_var(snap, timer->ts_frac);
+    snapshot_write_var(snap, timer->period);
+}
+
+int
+snapshot_read_timer(snapshot_t *snap, struct pc_timer_t *timer)
+{
+    uint8_t enabled;
+    uint8_t split;
+    int64_t remaining;
+
+    if (!snapshot_read_var(snap, enabled) || !snapshot_read_var(snap, split) ||
+        !snapshot_read_var(snap, remaining) || !snapshot_read_var(snap, timer->ts_frac) ||
+        !snapshot_read_var(snap, timer->period))
+        return 0;
+
+    timer_disable(timer);
+
+    if (split)
+        timer->flags |= TIMER_SPLIT;
+    else
+        timer->flags &= ~TIMER_SPLIT;
+
+    if (enabled) {
+        timer->ts_integer = (uint64_t) tsc + remaining;
+        timer_enable(timer);
+    }
+
+    return 1;
+}
+
+void
+snapshot_begin_section(snapshot_t *snap, const char *tag, const char *name, uint32_t instance)
+{
+    uint32_t name_len = (name != NULL) ? (uint32_t) strlen(name) : 0;
+    uint64_t len      = 0;
+
+    snapshot_write(snap, tag, 4);
+    snapshot_write_var(snap, name_len);
+    if (name_len)
+        snapshot_write(snap, name, name_len);
+    snapshot_write_var(snap, instance);
+
+    /* The length is patched in by snapshot_end_section(). */
+    snap->sect_len_pos = ftello64(snap->fp);
+    snapshot_write_var(snap, len);
+}
+
+void
+snapshot_end_section(snapshot_t *snap)
+{
+    int64_t  end = ftello64(snap->fp);
+    uint64_t len = end - snap->sect_len_pos - sizeof(uint64_t);
+
+    if (snap->error)
+        return;
+
+    if (fseeko64(snap->fp, snap->sect_len_pos, SEEK_SET) != 0)
+        snap->error = 1;
+    snapshot_write_var(snap, len);
+    if (fseeko64(snap->fp, end, SEEK_SET) != 0)
+        snap->error = 1;
+}
+
+/* Read the next section header. Returns 0 at the end of the snapshot. */
+static int
+snapshot_next_section(snapshot_t *snap, char *tag, char *name, size_t name_size, uint32_t *instance)
+{
+    uint32_t name_len;
+
+    /* Skip whatever the previous reader left over. */
+    if (snap->sect_left && (fseeko64(snap->fp, snap->sect_left, SEEK_CUR) != 0))
+        snap->error = 1;
+    snap->sect_left = 0;
+
+    if (snap->error || (fread(tag, 1, 4, snap->fp) != 4) ||
+        (fread(&name_len, 1, sizeof(name_len), snap->fp) != sizeof(name_len)) || (name_len >= name_size) ||
+        (fread(name, 1, name_len, snap->fp) != name_len) ||
+        (fread(instance, 1, sizeof(uint32_t), snap->fp) != sizeof(uint32_t)) ||
+        (fread(&snap->sect_left, 1, sizeof(uint64_t), snap->fp) != sizeof(uint64_t))) {
+        snap->error = 1;
+        return 0;
+    }
+
+    tag[4]         = '\0';
+    name[name_len] = '\0';
+
+    return strcmp(tag, "END ") != 0;
+}
+
+/* Walk the section headers and make sure that the snapshot has the state of
+   every core component and of every device that can restore it, so that a
+   partial snapshot is refused instead of leaving a half-restored machine. */
+static int
+snapshot_check(snapshot_t *snap)
+{
+    int64_t  start = ftello64(snap->fp);
+    uint8_t  core[sizeof(snapshot_required) / sizeof(snapshot_required[0])] = { 0 };
+    uint8_t  present[DEVICE_MAX] = { 0 };
+    char     tag[5];
+    char     name[256];
+    uint32_t instance;
+    int      ret = 1;
+
+    while (snapshot_next_section(snap, tag, name, sizeof(name), &instance)) {
+        if (!strcmp(tag, "DEV ")) {
+            if (instance < DEVICE_MAX)
+                present[instance] = 1;
+            continue;
+        }
+
+        for (uint8_t i = 0; i < (sizeof(core) / sizeof(core[0])); i++) {
+            if (!strcmp(tag, snapshot_required[i]))
+                core[i] = 1;
+        }
+    }
+
+    if (snap->error) {
+        snapshot_log("SNAPSHOT: Truncated section list\n");
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < (sizeof(core) / sizeof(core[0])); i++) {
+        if (!core[i]) {
+            pclog("SNAPSHOT: Missing '%s' section\n", snapshot_required[i]);
+            ret = 0;
+        }
+    }
+
+    if (!device_snapshot_supported() || !device_check_snapshot(present))
+        ret = 0;
+
+    /* Rewind to the first section. */
+    snap->sect_left = 0;
+    if (fseeko64(snap->fp, start, SEEK_SET) != 0)
+        ret = 0;
+
+    return ret;
+}
+
+static void
+snapshot_save_cpu(snapshot_t *snap)
+{
+    snapshot_begin_section(snap, "CPU ", NULL, 0);
+    snapshot_write_var(snap, cpu_state);
+    snapshot_write_var(snap, cpu_cur_status);
+    snapshot_write_var(snap, cr2);
+    snapshot_write_var(snap, cr3);
+    snapshot_write_var(snap, cr4);
+    snapshot_write_var(snap, dr);
+    snapshot_write_var(snap, msr);
+    snapshot_write_var(snap, gdt);
+    snapshot_write_var(snap, ldt);
+    snapshot_write_var(snap, idt);
+    snapshot_write_var(snap, tr);
+    snapshot_write_var(snap, use32);
+    snapshot_write_var(snap, stack32);
+    snapshot_write_var(snap, oldcpl);
+    snapshot_write_var(snap, smi_latched);
+    snapshot_write_var(snap, smm_in_hlt);
+    snapshot_write_var(snap, nmi);
+    snapshot_write_var(snap, nmi_mask);
+    snapshot_write_var(snap, ccr0);
+    snapshot_write_var(snap, ccr1);
+    snapshot_write_var(snap, ccr2);
+    snapshot_write_var(snap, ccr3);
+    snapshot_write_var(snap, ccr4);
+    snapshot_write_var(snap, ccr5);
+    snapshot_write_var(snap, ccr6);
+    snapshot_write_var(snap, ccr7);
+    snapshot_end_section(snap);
+
+    snapshot_begin_section(snap, "FPU ", NULL, 0);
+    snapshot_write_var(snap, fpu_state);
+    snapshot_end_section(snap);
+}
+
+static int
+snapshot_load_cpu(snapshot_t *snap)
+{
+    snapshot_read_var(snap, cpu_state);
+    snapshot_read_var(snap, cpu_cur_status);
+    snapshot_read_var(snap, cr2);
+    snapshot_read_var(snap, cr3);
+    snapshot_read_var(snap, cr4);
+    snapshot_read_var(snap, dr);
+    snapshot_read_var(snap, msr);
+    snapshot_read_var(snap, gdt);
+    snapshot_read_var(snap, ldt);
+    snapshot_read_var(snap, idt);
+    snapshot_read_var(snap, tr);
+    snapshot_read_var(snap, use32);
+    snapshot_read_var(snap, stack32);
+    snapshot_read_var(snap, oldcpl);
+    snapshot_read_var(snap, smi_latched);
+    snapshot_read_var(snap, smm_in_hlt);
+    snapshot_read_var(snap, nmi);
+    snapshot_read_var(snap, nmi_mask);
+    snapshot_read_var(snap, ccr0);
+    snapshot_read_var(snap, ccr1);
+    snapshot_read_var(snap, ccr2);
+    snapshot_read_var(snap, ccr3);
+    snapshot_read_var(snap, ccr4);
+    snapshot_read_var(snap, ccr5);
+    snapshot_read_var(snap, ccr6);
+    snapshot_read_var(snap, ccr7);
+
+    /* The effective address segment is a pointer into cpu_state. */
+    cpu_state.ea_seg = &cpu_state.seg_ds;
+
+    return !snap->error;
+}
+
+static void
+snapshot_save_ram(snapshot_t *snap)
+{
+    uint32_t pages_num = (mem_size << 10) >> 12;
+    uint32_t page      = 0;
+
+    snapshot_begin_section(snap, "RAM ", NULL, 0);
+    snapshot_write_var(snap, mem_size);
+
+    while (page < pages_num) {
+        const uint8_t *p     = &ram[page << 12];
+        uint8_t        fill  = p[0];
+        uint8_t        type  = RAM_RUN_FILL;
+        uint32_t       count = 0;
+
+        for (int i = 1; i < 4096; i++) {
+            if (p[i] != fill) {
+                type = RAM_RUN_RAW;
+                break;
+            }
+        }
+        if ((type == RAM_RUN_FILL) && (fill == 0x00))
+            type = RAM_RUN_ZERO;
+
+        /* Extend the run while the following pages are of the same kind. */
+        while ((page + count) < pages_num) {
+            const uint8_t *q = &ram[(page + count) << 12];
+            int            same = 1;
+
+            if (type == RAM_RUN_RAW) {
+                for (int i = 1; i < 4096; i++) {
+                    if (q[i] != q[0]) {
+                        same = 0;
+                        break;
+                    }
+                }
+                /* A uniform page ends a raw run. */
+                if (same && count)
+                    break;
+            } else {
+                for (int i = 0; i < 4096; i++) {
+                    if (q[i] != fill) {
+                        same = 0;
+                        break;
+                    }
+                }
+                if (!same)
+                    break;
+            }
+            count++;
+        }
+
+        snapshot_write_var(snap, type);
+        snapshot_write_var(snap, count);
+        if (type == RAM_RUN_FILL)
+            snapshot_write_var(snap, fill);
+        else if (type == RAM_RUN_RAW)
+            snapshot_write(snap, p, (size_t) count << 12);
+
+        page += count;
+    }
+
+    snapshot_end_section(snap);
+}
+
+static int
+snapshot_load_ram(snapshot_t *snap)
+{
+    uint32_t pages_num = (mem_size << 10) >> 12;
+    uint32_t page      = 0;
+    uint32_t size;
+
+    if (!snapshot_read_var(snap, size) || (size != mem_size)) {
+        pclog("SNAPSHOT: RAM size mismatch (%u KB in snapshot, %u KB configured)\n", size, mem_size);
+        return 0;
+    }
+
+    while (page < pages_num) {
+        uint8_t  type;
+        uint8_t  fill = 0x00;
+        uint32_t count;
+
+        if (!snapshot_read_var(snap, type) || !snapshot_read_var(snap, count) || ((page + count) > pages_num))
+            return 0;
+
+        switch (type) {
+            case RAM_RUN_ZERO:
+                memset(&ram[page << 12], 0x00, (size_t) count << 12);
+                break;
+            case RAM_RUN_FILL:
+                if (!snapshot_read_var(snap, fill))
+                    return 0;
+                memset(&ram[page << 12], fill, (size_t) count << 12);
+                break;
+            case RAM_RUN_RAW:
+                if (!snapshot_read(snap, &ram[page << 12], (size_t) count << 12))
+                    return 0;
+                break;
+            default:
+                return 0;
+        }
+
+        page += count;
+    }
+
+    return 1;
+}
+
+int
+snapshot_save(const char *fn)
+{
+    snapshot_t snap    = { 0 };
+    uint32_t   version = SNAPSHOT_VERSION;
+    const char *mach   = machine_get_internal_name();
+    uint32_t   mach_len = (uint32_t) strlen(mach);
+
+    if (!device_snapshot_supported()) {
+        pclog("SNAPSHOT: Not saving '%s', the machine has devices without snapshot support\n", fn);
+        return 0;
+    }
+
+    snap.fp = plat_fopen64(fn, "wb");
+    if (snap.fp == NULL) {
+        pclog("SNAPSHOT: Unable to create '%s'\n", fn);
+        return 0;
+    }
+
+    snapshot_write(&snap, SNAPSHOT_MAGIC, 8);
+    snapshot_write_var(&snap, version);
+    snapshot_write_var(&snap, mach_len);
+    snapshot_write(&snap, mach, mach_len);
+
+    /* The timer base comes first, so that timers are restored against it. */
+    snapshot_begin_section(&snap, "TIMR", NULL, 0);
+    snapshot_write_var(&snap, tsc);
+    snapshot_end_section(&snap);
+
+    snapshot_save_cpu(&snap);
+    snapshot_save_ram(&snap);
+
+    snapshot_begin_section(&snap, "MEM ", NULL, 0);
+    mem_save(&snap);
+    snapshot_end_section(&snap);
+
+    snapshot_begin_section(&snap, "PIC ", NULL, 0);
+    pic_save(&snap);
+    snapshot_end_section(&snap);
+
+    snapshot_begin_section(&snap, "DMA ", NULL, 0);
+    dma_save(&snap);
+    snapshot_end_section(&snap);
+
+    device_save_all(&snap);
+
+    snapshot_begin_section(&snap, "END ", NULL, 0);
+    snapshot_end_section(&snap);
+
+    fclose(snap.fp);
+
+    if (snap.error) {
+        pclog("SNAPSHOT: Error writing '%s'\n", fn);
+        return 0;
+    }
+
+    pclog("SNAPSHOT: Saved '%s'\n", fn);
+    return 1;
+}
+
+int
+snapshot_load(const char *fn)
+{
+    snapshot_t snap = { 0 };
+    char       magic[8];
+    char       tag[5];
+    char       name[256];
+    uint32_t   version;
+    uint32_t   instance;
+    uint32_t   mach_len;
+    uint64_t   new_tsc;
+    int        ret = 1;
+
+    snap.fp = plat_fopen64(fn, "rb");
+    if (snap.fp == NULL) {
+        pclog("SNAPSHOT: Unable to open '%s'\n", fn);
+        return 0;
+    }
+
+    if ((fread(magic, 1, 8, snap.fp) != 8) || memcmp(magic, SNAPSHOT_MAGIC, 8) ||
+        (fread(&version, 1, sizeof(version), snap.fp) != sizeof(version)) || (version != SNAPSHOT_VERSION) ||
+        (fread(&mach_len, 1, sizeof(mach_len), snap.fp) != sizeof(mach_len)) || (mach_len >= sizeof(name)) ||
+        (fread(name, 1, mach_len, snap.fp) != mach_len)) {
+        pclog("SNAPSHOT: '%s' is not a version %i snapshot\n", fn, SNAPSHOT_VERSION);
+        fclose(snap.fp);
+        return 0;
+    }
+
+    name[mach_len] = '\0';
+    if (strcmp(name, machine_get_internal_name())) {
+        pclog("SNAPSHOT: '%s' was taken on machine '%s'\n", fn, name);
+        fclose(snap.fp);
+        return 0;
+    }
+
+    if (!snapshot_check(&snap)) {
+        pclog("SNAPSHOT: '%s' is incomplete, not loading it\n", fn);
+        fclose(snap.fp);
+        return 0;
+    }
+
+    while (ret && snapshot_next_section(&snap, tag, name, sizeof(name), &instance)) {
+        snapshot_log("SNAPSHOT: Section '%s' (%s.%u), %" PRIu64 " bytes\n", tag, name, instance, snap.sect_left);
+
+        if (!strcmp(tag, "TIMR")) {
+            if ((ret = snapshot_read_var(&snap, new_tsc)))
+                timer_set_new_tsc(new_tsc);
+        } else if (!strcmp(tag, "CPU "))
+            ret = snapshot_load_cpu(&snap);
+        else if (!strcmp(tag, "FPU "))
+            ret = snapshot_read_var(&snap, fpu_state);
+        else if (!strcmp(tag, "RAM "))
+            ret = snapshot_load_ram(&snap);
+        else if (!strcmp(tag, "MEM "))
+            ret = mem_load(&snap);
+        else if (!strcmp(tag, "PIC "))
+            ret = pic_load(&snap);
+        else if (!strcmp(tag, "DMA "))
+            ret = dma_load(&snap);
+        else if (!strcmp(tag, "DEV "))
+            ret = device_load(&snap, name, instance);
+        else
+            pclog("SNAPSHOT: Skipping unknown section '%s'\n", tag);
+    }
+
+    fclose(snap.fp);
+
+    /* Drop everything derived from the old memory and paging state. */
+    flushmmucache();
+    mem_invalidate_range(0, (mem_size << 10) - 1);
+
+    if (!ret || snap.error) {
+        pclog("SNAPSHOT: Error reading '%s', machine state is inconsistent\n", fn);
+        return 0;
+    }
+
+    pclog("SNAPSHOT: Loaded '%s'\n", fn);
+    return 1;
+}
+
+void
+snapshot_request(int load, const char *fn)
+{
+    int expected = SNAPSHOT_IDLE;
+
+    /* Claim the request slot before writing the file name. */
+    if (!atomic_compare_exchange_strong(&snapshot_pending, &expected, SNAPSHOT_WRITING)) {
+        pclog("SNAPSHOT: A snapshot request is already pending, ignoring '%s'\n", fn);
+        return;
+    }
+
+    snprintf(snapshot_pending_fn, sizeof(snapshot_pending_fn), "%s", fn);
+    atomic_store(&snapshot_pending, load ? SNAPSHOT_LOAD : SNAPSHOT_SAVE);
+}
+
+void
+snapshot_process(void)
+{
+    int pending = atomic_load(&snapshot_pending);
+
+    if ((pending != SNAPSHOT_SAVE) && (pending != SNAPSHOT_LOAD))
+        return;
+
+    if (pending == SNAPSHOT_SAVE)
+        snapshot_save(snapshot_pending_fn);
+    else
+        snapshot_load(snapshot_pending_fn);
+
+    atomic_store(&snapshot_pending, SNAPSHOT_IDLE);
+}
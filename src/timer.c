@@ -1,7 +1,11 @@
+#include <inttypes.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
+#define HAVE_STDARG_H
 #include <86box/86box.h>
 #include "cpu.h"
 #include <86box/timer.h>
@@ -10,122 +14,198 @@
 uint64_t TIMER_USEC;
 uint64_t timer_target;
 
-/*Enabled timers are stored in a linked list, with the first timer to expire at
-  the head.*/
-pc_timer_t *timer_head = NULL;
+/*Enabled timers are stored in a binary min-heap, ordered by timestamp, with
+  the first timer to expire at index 0. Timers with equal timestamps are
+  ordered by insertion sequence, most recently enabled first, which matches
+  the order of the old sorted linked list.
+
+  A timer keeps its slot while its callback runs, marked TIMER_PROCESS, so the
+  common case of a callback re-arming its own timer costs a single sift
+  instead of a removal and an insertion.*/
+static pc_timer_t **timer_heap      = NULL;
+static uint32_t     timer_heap_num  = 0;
+static uint32_t     timer_heap_size = 0;
+static uint32_t     timer_seq       = 0;
 
 /* Are we initialized? */
 int timer_inited = 0;
 
 static void timer_advance_ex(pc_timer_t *timer, int start);
 
+#ifdef ENABLE_TIMER_LOG
+int timer_do_log = ENABLE_TIMER_LOG;
+
+static void
+timer_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (timer_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define timer_log(fmt, ...)
+#endif
+
+/*True if timer a must be processed before timer b*/
+static __inline int
+timer_heap_less(pc_timer_t *a, pc_timer_t *b)
+{
+    int64_t diff = (int64_t) (a->ts_integer - b->ts_integer);
+
+    if (diff != 0)
+        return diff < 0;
+
+    return ((int32_t) (a->seq - b->seq)) > 0;
+}
+
+static __inline void
+timer_heap_set(uint32_t pos, pc_timer_t *timer)
+{
+    timer_heap[pos] = timer;
+    timer->heap_pos = pos;
+}
+
+static void
+timer_heap_sift_up(uint32_t pos)
+{
+    pc_timer_t *timer = timer_heap[pos];
+
+    while (pos > 0) {
+        uint32_t parent = (pos - 1) >> 1;
+
+        if (!timer_heap_less(timer, timer_heap[parent]))
+            break;
+
+        timer_heap_set(pos, timer_heap[parent]);
+        pos = parent;
+    }
+
+    timer_heap_set(pos, timer);
+}
+
+static void
+timer_heap_sift_down(uint32_t pos)
+{
+    pc_timer_t *timer = timer_heap[pos];
+
+    while (1) {
+        uint32_t child = (pos << 1) + 1;
+
+        if (child >= timer_heap_num)
+            break;
+
+        if (((child + 1) < timer_heap_num) && timer_heap_less(timer_heap[child + 1], timer_heap[child]))
+            child++;
+
+        if (!timer_heap_less(timer_heap[child], timer))
+            break;
+
+        timer_heap_set(pos, timer_heap[child]);
+        pos = child;
+    }
+
+    timer_heap_set(pos, timer);
+}
+
+static void
+timer_heap_remove(pc_timer_t *timer)
+{
+    uint32_t    pos  = timer->heap_pos;
+    pc_timer_t *last = timer_heap[--timer_heap_num];
+
+    if (last != timer) {
+        timer_heap_set(pos, last);
+        if ((pos > 0) && timer_heap_less(last, timer_heap[(pos - 1) >> 1]))
+            timer_heap_sift_up(pos);
+        else
+            timer_heap_sift_down(pos);
+    }
+
+    timer->heap_pos = 0;
+}
+
+/*Restores the heap order after the timestamp of a queued timer changed*/
+static void
+timer_heap_update(pc_timer_t *timer)
+{
+    uint32_t pos = timer->heap_pos;
+
+    if ((pos > 0) && timer_heap_less(timer, timer_heap[(pos - 1) >> 1]))
+        timer_heap_sift_up(pos);
+    else
+        timer_heap_sift_down(pos);
+}
+
 void
 timer_enable(pc_timer_t *timer)
 {
-    pc_timer_t *timer_node = timer_head;
-
     if (timer->flags & TIMER_ENABLED)
         timer_disable(timer);
 
-    if (timer->next || timer->prev)
-        fatal("timer_enable - timer->next\n");
+    if (timer->flags & TIMER_PROCESS) {
+        timer->flags = (timer->flags & ~TIMER_PROCESS) | TIMER_ENABLED;
+        timer->seq   = timer_seq++;
+        timer->rearm_count++;
 
-    timer->flags |= TIMER_ENABLED;
-
-    /*List currently empty - add to head*/
-    if (!timer_head) {
-        timer_head = timer;
-        timer->next = timer->prev = NULL;
-        timer_target = timer_head->ts_integer;
+        timer_heap_update(timer);
         return;
     }
 
-    timer_node = timer_head;
+    if (timer_heap_num == timer_heap_size) {
+        timer_heap_size = timer_heap_size ? (timer_heap_size << 1) : 64;
+        timer_heap      = (pc_timer_t **) realloc(timer_heap, timer_heap_size * sizeof(pc_timer_t *));
+        if (timer_heap == NULL)
+            fatal("timer_enable(): Unable to grow the timer queue to %u entries\n", timer_heap_size);
+    }
 
-    while (1) {
-        /*
-           Timer expires before timer_node.
-           Add to list in front of timer_node
-         */
-        if (TIMER_LESS_THAN(timer, timer_node)) {
-            timer->next = timer_node;
-            timer->prev = timer_node->prev;
-            timer_node->prev = timer;
-            if (timer->prev)
-                timer->prev->next = timer;
-            else {
-                timer_head = timer;
-                timer_target = timer_head->ts_integer;
-            }
-            return;
-        }
+    timer->flags |= TIMER_ENABLED;
+    timer->seq = timer_seq++;
+    timer->rearm_count++;
 
-        /*
-           timer_node is last in the list.
-           Add timer to end of list
-         */
-        if (!timer_node->next) {
-            timer_node->next = timer;
-            timer->prev = timer_node;
-            return;
-        }
+    timer_heap_set(timer_heap_num++, timer);
+    timer_heap_sift_up(timer->heap_pos);
 
-        timer_node = timer_node->next;
-    }
+    if (timer_heap[0] == timer)
+        timer_target = timer->ts_integer;
 }
 
 void
 timer_disable(pc_timer_t *timer)
 {
-    if (!timer_inited || (timer == NULL) || !(timer->flags & TIMER_ENABLED))
+    if (!timer_inited || (timer == NULL) || !(timer->flags & (TIMER_ENABLED | TIMER_PROCESS)))
         return;
 
-    if (!timer->next && !timer->prev && timer != timer_head) {
+    if ((timer->heap_pos >= timer_heap_num) || (timer_heap[timer->heap_pos] != timer)) {
         uint32_t *p = NULL;
         *p = 5;    /* Crash deliberately. */
-        fatal("timer_disable(): Attempting to disable an isolated "
-              "non-head timer incorrectly marked as enabled\n");
+        fatal("timer_disable(): Attempting to disable a timer not in the "
+              "queue incorrectly marked as enabled\n");
     }
 
-    timer->flags &= ~TIMER_ENABLED;
+    timer->flags &= ~(TIMER_ENABLED | TIMER_PROCESS);
     timer->in_callback = 0;
 
-    if (timer->prev)
-        timer->prev->next = timer->next;
-    else
-        timer_head = timer->next;
-    if (timer->next)
-        timer->next->prev = timer->prev;
-    timer->prev = timer->next = NULL;
-}
-
-static void
-timer_remove_head(void)
-{
-    if (timer_head) {
-        pc_timer_t *timer = timer_head;
-        timer_head = timer->next;
-        timer_head->prev = NULL;
-        timer->next = timer->prev = NULL;
-        timer->flags &= ~TIMER_ENABLED;
-    }
+    timer_heap_remove(timer);
 }
 
 void
 timer_process(void)
 {
-    int num = 0;
-
-    if (!timer_head)
+    if (!timer_heap_num)
         return;
 
-    while (1) {
-        pc_timer_t *timer = timer_head;
+    while (timer_heap_num) {
+        pc_timer_t *timer = timer_heap[0];
 
         if (!TIMER_LESS_THAN_VAL(timer, (uint64_t) tsc))
             break;
 
-        timer_remove_head();
+        timer->flags = (timer->flags & ~TIMER_ENABLED) | TIMER_PROCESS;
+        timer->fire_count++;
 
         if (timer->flags & TIMER_SPLIT)
             timer_advance_ex(timer, 0);   /* We're splitting a > 1 s period into
@@ -141,28 +221,37 @@ timer_process(void)
             timer->in_callback = 0;
         }
 
-        num++;
+        /*Not re-armed by the callback*/
+        if (timer->flags & TIMER_PROCESS) {
+            timer->flags &= ~TIMER_PROCESS;
+            timer_heap_remove(timer);
+        }
     }
 
-    timer_target = timer_head->ts_integer;
+    if (timer_heap_num)
+        timer_target = timer_heap[0]->ts_integer;
 }
 
 void
 timer_close(void)
 {
-    pc_timer_t *t = timer_head;
-    pc_timer_t *r;
-
-    /* Set all timers' prev and next to NULL so it is assured that
-       timers that are not in malloc'd structs don't keep pointing
-       to timers that may be in malloc'd structs. */
-    while (t != NULL) {
-        r       = t;
-        r->prev = r->next = NULL;
-        t                 = r->next;
+    /* Mark all queued timers as no longer enabled, so that timers
+       that are not in malloc'd structs are not left pointing into
+       the queue once it is emptied. */
+    for (uint32_t i = 0; i < timer_heap_num; i++) {
+        pc_timer_t *timer = timer_heap[i];
+
+        timer_log("Timer %p (callback %p): %" PRIu64 " fires, %" PRIu64 " re-arms\n",
+                  timer, timer->callback, timer->fire_count, timer->rearm_count);
+
+        timer->flags &= ~(TIMER_ENABLED | TIMER_PROCESS);
+        timer->heap_pos = 0;
     }
 
-    timer_head = NULL;
+    free(timer_heap);
+    timer_heap      = NULL;
+    timer_heap_num  = 0;
+    timer_heap_size = 0;
 
     timer_inited = 0;
 }
@@ -182,13 +271,16 @@ timer_init(void)
 void
 timer_add(pc_timer_t *timer, void (*callback)(void *priv), void *priv, int start_timer)
 {
+    /* A timer re-added from its own callback still holds its heap slot. */
+    if ((timer->flags & TIMER_PROCESS) && (timer->heap_pos < timer_heap_num) && (timer_heap[timer->heap_pos] == timer))
+        timer_heap_remove(timer);
+
     memset(timer, 0, sizeof(pc_timer_t));
 
     timer->callback    = callback;
     timer->in_callback = 0;
     timer->priv        = priv;
     timer->flags       = 0;
-    timer->prev        = timer->next = NULL;
     if (start_timer)
         timer_set_delay_u64(timer, 0);
 }
@@ -201,7 +293,7 @@ timer_stop(pc_timer_t *timer)
         return;
 
     timer->period = 0.0;
-    if (timer->flags & TIMER_ENABLED)
+    if (timer->flags & (TIMER_ENABLED | TIMER_PROCESS))
         timer_disable(timer);
     timer->flags &= ~TIMER_SPLIT;
     timer->in_callback = 0;
@@ -266,26 +358,24 @@ timer_on_auto(pc_timer_t *timer, double period)
 void
 timer_set_new_tsc(uint64_t new_tsc)
 {
-    pc_timer_t *timer = NULL;
     /* Run timers already expired. */
 #ifdef USE_DYNAREC
     if (cpu_use_dynarec)
         update_tsc();
 #endif
 
-    if (!timer_head) {
+    if (!timer_heap_num) {
         tsc = new_tsc;
         return;
     }
 
-    timer = timer_head;
-    timer_target = new_tsc + (int64_t)(timer_get_ts_int(timer_head) - (uint64_t)tsc);
+    timer_target = new_tsc + (int64_t)(timer_get_ts_int(timer_heap[0]) - (uint64_t)tsc);
 
-    while (timer) {
+    /* Every timer is shifted by the same amount, so the heap order is kept. */
+    for (uint32_t i = 0; i < timer_heap_num; i++) {
+        pc_timer_t *timer = timer_heap[i];
         int64_t offset_from_current_tsc = (int64_t)(timer_get_ts_int(timer) - (uint64_t)tsc);
         timer->ts_integer = new_tsc + offset_from_current_tsc;
-
-        timer = timer->next;
     }
 
     tsc = new_tsc;
@@ -16,6 +16,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
 #include <inttypes.h>
@@ -47,8 +48,10 @@
 #include <86box/nvr.h>
 #include <86box/version.h>
 #include <86box/video.h>
+#include <86box/vid_stats.h>
 #include <86box/ui.h>
 #include <86box/gdbstub.h>
+#include <86box/snapshot.h>
 
 #define __USE_GNU 1 /* shouldn't be done, yet it is */
 #include <pthread.h>
@@ -450,6 +453,49 @@ plat_munmap(void *ptr, size_t size)
     munmap(ptr, size);
 }
 
+int
+plat_file_stat(const char *path, uint64_t *size, uint64_t *mtime)
+{
+    struct stat stats;
+
+    if ((stat(path, &stats) < 0) || S_ISDIR(stats.st_mode))
+        return 0;
+
+    *size  = (uint64_t) stats.st_size;
+    *mtime = (uint64_t) stats.st_mtime;
+    return 1;
+}
+
+/* Maps a whole file read-only and shared, so that the pages can be shared
+   with other processes mapping the same file. */
+void *
+plat_mmap_file(const char *path, size_t *size)
+{
+    struct stat stats;
+    void       *ret = NULL;
+    int         fd  = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    if ((fstat(fd, &stats) == 0) && (stats.st_size > 0)) {
+        ret = mmap(0, (size_t) stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (ret == MAP_FAILED)
+            ret = NULL;
+        else
+            *size = (size_t) stats.st_size;
+    }
+    close(fd);
+
+    return ret;
+}
+
+void
+plat_munmap_file(void *ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
 uint64_t
 plat_timer_read(void)
 {
@@ -1104,9 +1150,12 @@ unix_executeLine(char *line)
                 "carteject <id> - eject cartridge from drive <id>.\n"
                 "moeject <id> - eject image from MO drive <id>.\n\n"
                 "hardreset - hard reset the emulated system.\n"
+                "savestate <filename> - save a snapshot of the emulated system.\n"
+                "loadstate <filename> - restore a snapshot of the emulated system.\n"
                 "pause - pause the the emulated system.\n"
                 "fastfwd - toggle fast forward.\n"
                 "screenshot - save a screenshot.\n"
+                "videostats [start|stop|dump <filename>] - collect or dump video pipeline timings, show them without arguments.\n"
                 "fullscreen - toggle fullscreen.\n"
                 "version - print version and license information.\n"
                 "exit - exit " EMU_NAME ".\n");
@@ -1152,6 +1201,28 @@ unix_executeLine(char *line)
             ++monitors[0].mon_screenshots_raw;
             endblit();
             device_force_redraw();
+        } else if (strncasecmp(xargv[0], "videostats", 10) == 0) {
+            if ((cmdargc >= 2) && (strncasecmp(xargv[1], "start", 5) == 0))
+                video_stats_start();
+            else if ((cmdargc >= 2) && (strncasecmp(xargv[1], "stop", 4) == 0))
+                video_stats_stop();
+            else if ((cmdargc >= 3) && (strncasecmp(xargv[1], "dump", 4) == 0)) {
+                if (!video_stats_dump(xargv[2]))
+                    printf("Unable to write %s\n", xargv[2]);
+            } else {
+                video_stat_t stat;
+
+                printf("%" PRIu64 " frames%s\n", video_stats_frames(), video_stats_enabled ? "" : ", not collecting");
+                printf("%-14s %8s %8s %8s %8s %8s\n", "stage", "frames", "mean ms", "p95 ms", "p99 ms", "max ms");
+                for (int i = 0; i < VIDEO_STAT_MAX; i++) {
+                    video_stats_get(i, &stat);
+                    if (!stat.frames)
+                        continue;
+                    printf("%-14s %8" PRIu64 " %8.3f %8.3f %8.3f %8.3f\n", video_stats_name(i), stat.frames,
+                           ((double) stat.total_us / stat.frames) / 1000.0, video_stats_percentile(&stat, 95) / 1000.0,
+                           video_stats_percentile(&stat, 99) / 1000.0, stat.max_us / 1000.0);
+                }
+            }
         } else if (strncasecmp(xargv[0], "pause", 5) == 0) {
             plat_pause(dopause ^ 1);
             printf("%s", dopause ? "Paused.\n" : "Unpaused.\n");
@@ -1160,6 +1231,10 @@ unix_executeLine(char *line)
             printf("%s", fast_forward ? "Fast forward on.\n" : "Fast forward off.\n");
         } else if (strncasecmp(xargv[0], "hardreset", 9) == 0) {
             pc_reset_hard();
+        } else if (strncasecmp(xargv[0], "savestate", 9) == 0 && cmdargc >= 2) {
+            snapshot_request(0, xargv[1]);
+        } else if (strncasecmp(xargv[0], "loadstate", 9) == 0 && cmdargc >= 2) {
+            snapshot_request(1, xargv[1]);
         } else if (strncasecmp(xargv[0], "cdload", 6) == 0 && cmdargc >= 3) {
             uint8_t id;
             bool    err = false;
@@ -1663,6 +1738,14 @@ plat_get_cpu_string(char *outbuf, uint8_t len) {
     strncpy(outbuf, cpu_string, len);
 }
 
+int
+plat_get_cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? count : 1;
+}
+
 void
 plat_set_thread_name(void *thread, const char *name)
 {
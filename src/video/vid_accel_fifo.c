@@ -0,0 +1,174 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Asynchronous command FIFO shared by the 2D accelerators.
+ *
+ *          Register writes that start or feed an accelerator operation
+ *          are queued by the CPU thread and executed by a per-card worker
+ *          thread, so that large blits overlap with CPU emulation. The
+ *          card supplies the function that executes an entry and reads
+ *          back accelerator state only after accel_fifo_wait_idle().
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <stdatomic.h>
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/thread.h>
+#include <86box/vid_accel_fifo.h>
+
+#ifdef ENABLE_ACCEL_FIFO_LOG
+int accel_fifo_do_log = ENABLE_ACCEL_FIFO_LOG;
+
+static void
+accel_fifo_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (accel_fifo_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define accel_fifo_log(fmt, ...)
+#endif
+
+static void
+accel_fifo_thread(void *param)
+{
+    accel_fifo_t *fifo = (accel_fifo_t *) param;
+
+    while (fifo->thread_run) {
+        thread_set_event(fifo->not_full_event);
+        thread_wait_event(fifo->wake_thread, -1);
+        thread_reset_event(fifo->wake_thread);
+        fifo->busy = 1;
+
+        uint64_t start_time = plat_timer_read();
+
+        while (!ACCEL_FIFO_EMPTY(fifo)) {
+            const accel_fifo_entry_t *entry = &fifo->entries[fifo->read_idx & ACCEL_FIFO_MASK];
+
+            fifo->process(fifo->priv, entry->addr_type & ACCEL_FIFO_ADDR, entry->val, entry->addr_type & ACCEL_FIFO_TYPE);
+
+            fifo->read_idx++;
+
+            if (ACCEL_FIFO_ENTRIES(fifo) > ACCEL_FIFO_THRESHOLD)
+                thread_set_event(fifo->not_full_event);
+        }
+
+        /* Status flags raised here must be visible before busy drops. */
+        if (fifo->drained)
+            fifo->drained(fifo->priv);
+
+        fifo->busy_time += plat_timer_read() - start_time;
+        fifo->busy = 0;
+    }
+}
+
+void
+accel_fifo_wake(accel_fifo_t *fifo)
+{
+    thread_set_event(fifo->wake_thread); /*Wake up FIFO thread if moving from idle*/
+}
+
+void
+accel_fifo_wait_idle(accel_fifo_t *fifo)
+{
+    while (accel_fifo_busy(fifo)) {
+        accel_fifo_wake(fifo);
+        thread_wait_event(fifo->not_full_event, 1);
+    }
+}
+
+void
+accel_fifo_queue(accel_fifo_t *fifo, uint32_t addr, uint32_t val, uint32_t type, int limit)
+{
+    accel_fifo_entry_t *entry = &fifo->entries[fifo->write_idx & ACCEL_FIFO_MASK];
+    int                 max   = limit ? limit : ACCEL_FIFO_SIZE;
+    int                 entries;
+
+    if (ACCEL_FIFO_ENTRIES(fifo) >= max) {
+        fifo->stalls++;
+        do {
+            thread_reset_event(fifo->not_full_event);
+            accel_fifo_wake(fifo);
+            if (ACCEL_FIFO_ENTRIES(fifo) >= max)
+                thread_wait_event(fifo->not_full_event, -1); /*Wait for room in ringbuffer*/
+        } while (ACCEL_FIFO_ENTRIES(fifo) >= max);
+    }
+
+    entry->val       = val;
+    entry->addr_type = (addr & ACCEL_FIFO_ADDR) | type;
+
+    fifo->write_idx++;
+    fifo->queued++;
+
+    entries = ACCEL_FIFO_ENTRIES(fifo);
+    if ((uint32_t) entries > fifo->max_depth)
+        fifo->max_depth = entries;
+
+    if ((entries > ACCEL_FIFO_THRESHOLD) || (entries < 8))
+        accel_fifo_wake(fifo);
+}
+
+/* Lets everything already queued finish, so that the caller can reset the
+   accelerator state without racing the worker. */
+void
+accel_fifo_reset(accel_fifo_t *fifo)
+{
+    accel_fifo_wait_idle(fifo);
+}
+
+void
+accel_fifo_init(accel_fifo_t *fifo, const char *name,
+                void (*process)(void *priv, uint32_t addr, uint32_t val, uint32_t type),
+                void (*drained)(void *priv), void *priv)
+{
+    fifo->name      = name;
+    fifo->process   = process;
+    fifo->drained   = drained;
+    fifo->priv      = priv;
+    fifo->read_idx  = 0;
+    fifo->write_idx = 0;
+    fifo->busy      = 0;
+    fifo->queued    = 0;
+    fifo->stalls    = 0;
+    fifo->busy_time = 0;
+    fifo->max_depth = 0;
+
+    fifo->wake_thread    = thread_create_event();
+    fifo->not_full_event = thread_create_event();
+    fifo->thread_run     = 1;
+    fifo->thread         = thread_create(accel_fifo_thread, fifo);
+}
+
+void
+accel_fifo_close(accel_fifo_t *fifo)
+{
+    fifo->thread_run = 0;
+    thread_set_event(fifo->wake_thread);
+    thread_wait(fifo->thread);
+    thread_destroy_event(fifo->not_full_event);
+    thread_destroy_event(fifo->wake_thread);
+
+    accel_fifo_log("%s: %" PRIu64 " entries queued, maximum depth %u, %" PRIu64 " stalls on a full FIFO, busy for %" PRIu64 " timer ticks\n",
+                   fifo->name, fifo->queued, fifo->max_depth, fifo->stalls, fifo->busy_time);
+}
@@ -38,6 +38,7 @@
 #include <86box/vid_xga.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_accel_fifo.h>
 #include <86box/vid_ati_eeprom.h>
 #include <86box/bswap.h>
 
@@ -52,29 +53,12 @@
 #define BIOS_ROMVT_PATH   "roms/video/mach64/mach64vt-660c60c135839345779942.bin"
 #define BIOS_ROMVT2_PATH  "roms/video/mach64/atimach64vt2pci.bin"
 
-#define FIFO_SIZE         65536
-#define FIFO_MASK         (FIFO_SIZE - 1)
-#define FIFO_ENTRY_SIZE   (1 << 31)
-
-#define FIFO_ENTRIES      (mach64->fifo_write_idx - mach64->fifo_read_idx)
-#define FIFO_FULL         ((mach64->fifo_write_idx - mach64->fifo_read_idx) >= FIFO_SIZE)
-#define FIFO_EMPTY        (mach64->fifo_read_idx == mach64->fifo_write_idx)
-
-#define FIFO_TYPE         0xff000000
-#define FIFO_ADDR         0x00ffffff
-
 enum {
-    FIFO_INVALID     = (0x00 << 24),
     FIFO_WRITE_BYTE  = (0x01 << 24),
     FIFO_WRITE_WORD  = (0x02 << 24),
     FIFO_WRITE_DWORD = (0x03 << 24)
 };
 
-typedef struct fifo_entry_t {
-    uint32_t addr_type;
-    uint32_t val;
-} fifo_entry_t;
-
 enum {
     MACH64_GX = 0,
     MACH64_CT,
@@ -273,16 +257,8 @@ typedef struct mach64_t {
     } dma;
 #endif
 
-    fifo_entry_t fifo[FIFO_SIZE];
-    ATOMIC_INT   fifo_read_idx;
-    ATOMIC_INT   fifo_write_idx;
-    ATOMIC_INT   blitter_busy;
-
-    thread_t *fifo_thread;
-    event_t  *wake_fifo_thread;
-    event_t  *fifo_not_full_event;
+    accel_fifo_t fifo;
 
-    uint64_t blitter_time;
     uint64_t status_time;
 
     uint16_t pci_id;
@@ -333,7 +309,6 @@ typedef struct mach64_t {
     uint32_t overlay_cur_y;
     uint32_t overlay_base;
 
-    uint8_t thread_run;
     void   *i2c;
     void   *i2c_tv;
     void   *ddc;
@@ -732,19 +707,10 @@ mach64_update_irqs(mach64_t *mach64)
         pci_clear_irq(mach64->pci_slot, PCI_INTA, &mach64->irq_state);
 }
 
-static __inline void
-wake_fifo_thread(mach64_t *mach64)
-{
-    thread_set_event(mach64->wake_fifo_thread); /*Wake up FIFO thread if moving from idle*/
-}
-
 static void
 mach64_wait_fifo_idle(mach64_t *mach64)
 {
-    while (!FIFO_EMPTY) {
-        wake_fifo_thread(mach64);
-        thread_wait_event(mach64->fifo_not_full_event, 1);
-    }
+    accel_fifo_wait_idle(&mach64->fifo);
 }
 
 #define READ8(addr, var)                \
@@ -1451,56 +1417,37 @@ run_dma(mach64_t *mach64)
 #endif
 
 static void
-fifo_thread(void *param)
+mach64_fifo_process(void *priv, uint32_t addr, uint32_t val, uint32_t type)
 {
-    mach64_t *mach64 = (mach64_t *) param;
-
-    while (mach64->thread_run) {
-        thread_set_event(mach64->fifo_not_full_event);
-        thread_wait_event(mach64->wake_fifo_thread, -1);
-        thread_reset_event(mach64->wake_fifo_thread);
-        mach64->blitter_busy = 1;
-        while (!FIFO_EMPTY) {
-            uint64_t      start_time = plat_timer_read();
-            uint64_t      end_time;
-            fifo_entry_t *fifo = &mach64->fifo[mach64->fifo_read_idx & FIFO_MASK];
-            uint32_t      val  = fifo->val;
-
-            switch (fifo->addr_type & FIFO_TYPE) {
-                case FIFO_WRITE_BYTE:
-                    mach64_accel_write_fifo(mach64, fifo->addr_type & FIFO_ADDR, val);
-                    break;
-                case FIFO_WRITE_WORD:
-                    mach64_accel_write_fifo_w(mach64, fifo->addr_type & FIFO_ADDR, val);
-                    break;
-                case FIFO_WRITE_DWORD:
-                    mach64_accel_write_fifo_l(mach64, fifo->addr_type & FIFO_ADDR, val);
-                    break;
-
-                default:
-                    break;
-            }
+    mach64_t *mach64 = (mach64_t *) priv;
 
-            mach64->fifo_read_idx++;
-            fifo->addr_type = FIFO_INVALID;
+    switch (type) {
+        case FIFO_WRITE_BYTE:
+            mach64_accel_write_fifo(mach64, addr, val);
+            break;
+        case FIFO_WRITE_WORD:
+            mach64_accel_write_fifo_w(mach64, addr, val);
+            break;
+        case FIFO_WRITE_DWORD:
+            mach64_accel_write_fifo_l(mach64, addr, val);
+            break;
 
-            if (FIFO_ENTRIES > 0xe000)
-                thread_set_event(mach64->fifo_not_full_event);
+        default:
+            break;
+    }
+}
 
-            end_time = plat_timer_read();
-            mach64->blitter_time += end_time - start_time;
-        }
 #ifdef DMA_BM
-        run_dma(mach64);
-#endif
-        mach64->blitter_busy = 0;
-    }
+static void
+mach64_fifo_drained(void *priv)
+{
+    run_dma((mach64_t *) priv);
 }
+#endif
 
 static void
 mach64_queue(mach64_t *mach64, uint32_t addr, uint32_t val, uint32_t type)
 {
-    fifo_entry_t *fifo = &mach64->fifo[mach64->fifo_write_idx & FIFO_MASK];
     int limit = 0;
 
     switch (type) {
@@ -1535,29 +1482,8 @@ mach64_queue(mach64_t *mach64, uint32_t addr, uint32_t val, uint32_t type)
             break;
     }
 
-    if (limit) {
-        if (FIFO_ENTRIES >= 16) {
-            thread_reset_event(mach64->fifo_not_full_event);
-            if (FIFO_ENTRIES >= 16)
-                thread_wait_event(mach64->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
-        }
-    } else {
-        if (FIFO_FULL) {
-            thread_reset_event(mach64->fifo_not_full_event);
-            if (FIFO_FULL)
-                thread_wait_event(mach64->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
-        }
-    }
-
-    fifo->val       = val;
-    fifo->addr_type = (addr & FIFO_ADDR) | type;
-
-    mach64->fifo_write_idx++;
-
-    if (FIFO_ENTRIES > 0xe000)
-        wake_fifo_thread(mach64);
-    if (FIFO_ENTRIES > 0xe000 || FIFO_ENTRIES < 8)
-        wake_fifo_thread(mach64);
+    /* Writes that start an operation are only queued behind a few others. */
+    accel_fifo_queue(&mach64->fifo, addr, val, type, limit ? 16 : 0);
 }
 
 void
@@ -3271,11 +3197,11 @@ mach64_ext_readb(uint32_t addr, void *priv)
 
             case 0x310:
             case 0x311:
-                if (!mach64->blitter_busy)
-                    wake_fifo_thread(mach64);
+                if (!mach64->fifo.busy)
+                    accel_fifo_wake(&mach64->fifo);
 
                 ret = 0;
-                if (FIFO_FULL)
+                if (ACCEL_FIFO_FULL(&mach64->fifo))
                     ret = 0xff;
                 break;
 
@@ -3302,14 +3228,14 @@ mach64_ext_readb(uint32_t addr, void *priv)
                 break;
 
             case 0x338:
-                if (!mach64->blitter_busy)
-                    wake_fifo_thread(mach64);
+                if (!mach64->fifo.busy)
+                    accel_fifo_wake(&mach64->fifo);
 
-                ret = FIFO_EMPTY ? 0 : 1;
+                ret = accel_fifo_busy(&mach64->fifo) ? 1 : 0;
                 break;
 
             case 0x33a:
-                ret = FIFO_EMPTY ? 32 : 31;
+                ret = ACCEL_FIFO_EMPTY(&mach64->fifo) ? 32 : 31;
                 break;
 
             default:
@@ -5336,9 +5262,7 @@ mach64_reset(void *priv)
 
     if (reset_state[dev->svga.monitor_index] != NULL) {
         mach64_disable_handlers(dev);
-        dev->blitter_busy                              = 0;
-        dev->fifo_write_idx                            = 0;
-        dev->fifo_read_idx                             = 0;
+        accel_fifo_reset(&dev->fifo);
         reset_state[dev->svga.monitor_index]->eeprom   = dev->eeprom;
         reset_state[dev->svga.monitor_index]->pci_slot = dev->pci_slot;
 
@@ -5404,10 +5328,11 @@ mach64_common_init(const device_t *info)
 
     mach64->dst_cntl = 3;
 
-    mach64->thread_run = 1;
-    mach64->wake_fifo_thread = thread_create_event();
-    mach64->fifo_not_full_event = thread_create_event();
-    mach64->fifo_thread = thread_create(fifo_thread, mach64);
+#ifdef DMA_BM
+    accel_fifo_init(&mach64->fifo, "Mach64", mach64_fifo_process, mach64_fifo_drained, mach64);
+#else
+    accel_fifo_init(&mach64->fifo, "Mach64", mach64_fifo_process, NULL, mach64);
+#endif
     mach64->on_board = !!(info->local & (1 << 19));
 
     mach64->i2c = i2c_gpio_init("ddc_ati_mach64");
@@ -5634,11 +5559,7 @@ mach64_close(void *priv)
 #ifdef DMA_BM
     mach64->dma.state = 0;
 #endif
-    mach64->thread_run = 0;
-    thread_set_event(mach64->wake_fifo_thread);
-    thread_wait(mach64->fifo_thread);
-    thread_destroy_event(mach64->fifo_not_full_event);
-    thread_destroy_event(mach64->wake_fifo_thread);
+    accel_fifo_close(&mach64->fifo);
 #ifdef DMA_BM
     thread_close_mutex(mach64->dma.lock);
 #endif
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include <wchar.h>
+#include <stdatomic.h>
 #define HAVE_STDARG_H
 #include <86box/86box.h>
 #include <86box/io.h>
@@ -33,9 +34,11 @@
 #include <86box/device.h>
 #include <86box/timer.h>
 #include <86box/plat.h>
+#include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_accel_fifo.h>
 
 #define BIOS_ROM_PATH_W32_MACHSPEED_VGA_GUI_2400S   "roms/video/et4000w32/ET4000W32VLB_bios_MX27C512.BIN"
 #define BIOS_ROM_PATH_W32I_REVB_AXIS_MICRODEVICE    "roms/video/et4000w32/ET4KW32I.VBI"
@@ -51,6 +54,11 @@
 #define ACL_XYST                               4
 #define ACL_SSO                                8
 
+enum {
+    FIFO_WRITE_ACL = (0x01 << 24), /* Accelerator register in the MMU register space */
+    FIFO_WRITE_MMU = (0x02 << 24)  /* Accelerated MMU aperture */
+};
+
 typedef enum {
     ET4000W32 = 0,
     ET4000W32I_REVB = 3,
@@ -138,6 +146,8 @@ typedef struct et4000w32p_t {
         uint8_t  ctrl;
     } mmu;
 
+    accel_fifo_t fifo;
+
     volatile int busy;
 } et4000w32p_t;
 
@@ -969,6 +979,24 @@ et4000w32p_accel_write_mmu(et4000w32p_t *et4000, uint32_t addr, uint8_t val, uin
     }
 }
 
+static void
+et4000w32p_fifo_process(void *priv, uint32_t addr, uint32_t val, uint32_t type)
+{
+    et4000w32p_t *et4000 = (et4000w32p_t *) priv;
+
+    switch (type) {
+        case FIFO_WRITE_ACL:
+            et4000w32p_accel_write_fifo(et4000, addr, val);
+            break;
+        case FIFO_WRITE_MMU:
+            et4000w32p_accel_write_mmu(et4000, addr, val, (addr >> 13) & 3);
+            break;
+
+        default:
+            break;
+    }
+}
+
 static void
 et4000w32p_mmu_write(uint32_t addr, uint8_t val, void *priv)
 {
@@ -981,7 +1009,7 @@ et4000w32p_mmu_write(uint32_t addr, uint8_t val, void *priv)
         case 0x4000: /* MMU 2 */
             et4000->bank = (addr >> 13) & 3;
             if (et4000->mmu.ctrl & (1 << et4000->bank))
-                et4000w32p_accel_write_mmu(et4000, addr & 0x7fff, val, et4000->bank);
+                accel_fifo_queue(&et4000->fifo, addr & 0x7fff, val, FIFO_WRITE_MMU, 0);
             else {
                 if (((addr & 0x1fff) + et4000->mmu.base[et4000->bank]) < svga->vram_max) {
                     svga->vram[((addr & 0x1fff) + et4000->mmu.base[et4000->bank]) & et4000->vram_mask]                = val;
@@ -991,8 +1019,10 @@ et4000w32p_mmu_write(uint32_t addr, uint8_t val, void *priv)
             break;
         case 0x6000:
             if ((addr & 0xff) >= 0x80)
-                et4000w32p_accel_write_fifo(et4000, addr & 0x7fff, val);
+                accel_fifo_queue(&et4000->fifo, addr & 0x7fff, val, FIFO_WRITE_ACL, 0);
             else {
+                /* The accelerator uses the MMU bases for implicit starts. */
+                accel_fifo_wait_idle(&et4000->fifo);
                 switch (addr & 0xff) {
                     case 0x00:
                         et4000->mmu.base[0] = (et4000->mmu.base[0] & 0xffffff00) | val;
@@ -1064,6 +1094,7 @@ et4000w32p_mmu_read(uint32_t addr, void *priv)
         case 0x4000: /* MMU 2 */
             et4000->bank = (addr >> 13) & 3;
             if (et4000->mmu.ctrl & (1 << et4000->bank)) {
+                accel_fifo_wait_idle(&et4000->fifo);
                 temp = 0xff;
                 if (et4000->acl.cpu_dat_pos) {
                     et4000->acl.cpu_dat_pos--;
@@ -1083,6 +1114,9 @@ et4000w32p_mmu_read(uint32_t addr, void *priv)
             return svga->vram[(addr & 0x1fff) + et4000->mmu.base[et4000->bank]];
 
         case 0x6000:
+            if ((addr & 0xff) >= 0x80)
+                accel_fifo_wait_idle(&et4000->fifo);
+
             switch (addr & 0xff) {
                 case 0x00:
                     return et4000->mmu.base[0] & 0xff;
@@ -1112,6 +1146,13 @@ et4000w32p_mmu_read(uint32_t addr, void *priv)
                     return et4000->mmu.ctrl;
 
                 case 0x36:
+                    /* Report queued operations as in progress rather than
+                       waiting for them, so that polling does not stall. */
+                    if (accel_fifo_busy(&et4000->fifo)) {
+                        if (!et4000->fifo.busy)
+                            accel_fifo_wake(&et4000->fifo);
+                        return et4000->acl.status | ACL_RDST | ACL_XYST;
+                    }
                     if (et4000->acl.fifo_queue) {
                         et4000->acl.status |= ACL_RDST;
                         et4000->acl.fifo_queue = 0;
@@ -2947,6 +2988,8 @@ et4000w32p_init(const device_t *info)
     et4000->svga.packed_chain4 = 1;
     et4000->svga.adv_flags |= FLAG_PANNING_ATI;
 
+    accel_fifo_init(&et4000->fifo, info->name, et4000w32p_fifo_process, NULL, et4000);
+
     return et4000;
 }
 
@@ -3003,6 +3046,8 @@ et4000w32p_close(void *priv)
 {
     et4000w32p_t *et4000 = (et4000w32p_t *) priv;
 
+    accel_fifo_close(&et4000->fifo);
+
     svga_close(&et4000->svga);
 
     free(et4000);
@@ -42,6 +42,7 @@
 #include <86box/vid_xga.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_accel_fifo.h>
 #include "cpu.h"
 
 #define ROM_ORCHID_86C911              "roms/video/s3/BIOS.BIN"
@@ -176,19 +177,7 @@ enum {
     VRAM_512KB = 7
 };
 
-#define FIFO_SIZE       65536
-#define FIFO_MASK       (FIFO_SIZE - 1)
-#define FIFO_ENTRY_SIZE (1 << 31)
-
-#define FIFO_ENTRIES    (s3->fifo_write_idx - s3->fifo_read_idx)
-#define FIFO_FULL       ((s3->fifo_write_idx - s3->fifo_read_idx) >= (FIFO_SIZE - 4))
-#define FIFO_EMPTY      (s3->fifo_read_idx == s3->fifo_write_idx)
-
-#define FIFO_TYPE       0xff000000
-#define FIFO_ADDR       0x00ffffff
-
 enum {
-    FIFO_INVALID     = (0x00 << 24),
     FIFO_WRITE_BYTE  = (0x01 << 24),
     FIFO_WRITE_WORD  = (0x02 << 24),
     FIFO_WRITE_DWORD = (0x03 << 24),
@@ -209,11 +198,6 @@ typedef enum {
     TVP3026
 } s3_ramdac_type;
 
-typedef struct {
-    uint32_t addr_type;
-    uint32_t val;
-} fifo_entry_t;
-
 typedef struct s3_t {
     char nvr_path[128];
     mem_mapping_t linear_mapping;
@@ -389,17 +373,8 @@ typedef struct s3_t {
         int sec_x, sec_y, sec_w, sec_h;
     } streams;
 
-    fifo_entry_t fifo[FIFO_SIZE];
-    ATOMIC_INT   fifo_read_idx, fifo_write_idx;
-
-    uint8_t fifo_thread_run;
-
-    thread_t *fifo_thread;
-    event_t  *wake_fifo_thread;
-    event_t  *fifo_not_full_event;
+    accel_fifo_t fifo;
 
-    ATOMIC_INT blitter_busy;
-    uint64_t blitter_time;
     uint64_t status_time;
 
     uint8_t subsys_cntl, subsys_stat;
@@ -506,40 +481,16 @@ dword_remap_l(svga_t *svga, uint32_t in_addr)
     return ((in_addr << 2) & 0xfffc) | ((in_addr >> 14) & 0x3) | (in_addr & ~0xffff);
 }
 
-static __inline void
-wake_fifo_thread(s3_t *s3)
-{
-    thread_set_event(s3->wake_fifo_thread); /*Wake up FIFO thread if moving from idle*/
-}
-
 static void
 s3_wait_fifo_idle(s3_t *s3)
 {
-    while (!FIFO_EMPTY) {
-        wake_fifo_thread(s3);
-        thread_wait_event(s3->fifo_not_full_event, 1);
-    }
+    accel_fifo_wait_idle(&s3->fifo);
 }
 
 static void
 s3_queue(s3_t *s3, uint32_t addr, uint32_t val, uint32_t type)
 {
-    fifo_entry_t *fifo = &s3->fifo[s3->fifo_write_idx & FIFO_MASK];
-
-    if (FIFO_FULL) {
-        thread_reset_event(s3->fifo_not_full_event);
-        if (FIFO_FULL) {
-            thread_wait_event(s3->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
-        }
-    }
-
-    fifo->val       = val;
-    fifo->addr_type = (addr & FIFO_ADDR) | type;
-
-    s3->fifo_write_idx++;
-
-    if (FIFO_ENTRIES > 0xe000 || FIFO_ENTRIES < 8)
-        wake_fifo_thread(s3);
+    accel_fifo_queue(&s3->fifo, addr, val, type, 0);
 }
 
 static void
@@ -5336,9 +5287,9 @@ s3_accel_in(uint16_t port, void *priv)
         case 0x9ae8:
             temp = 0; /* FIFO empty */
             if (s3_enable_fifo(s3)) {
-                if (!s3->blitter_busy)
-                    wake_fifo_thread(s3);
-                if (FIFO_FULL)
+                if (!s3->fifo.busy)
+                    accel_fifo_wake(&s3->fifo);
+                if (ACCEL_FIFO_FULL(&s3->fifo))
                     temp = 0xff;
             }
             s3_log("Read port=%04x, val=%02x.\n", port, temp);
@@ -5349,10 +5300,10 @@ s3_accel_in(uint16_t port, void *priv)
             temp = 0;
             s3_log("FIFO=%x, cmd=%d, sy=%d.\n", s3_enable_fifo(s3), s3->accel.cmd >> 13, s3->accel.sy);
             if (s3_enable_fifo(s3)) {
-                if (!s3->blitter_busy)
-                    wake_fifo_thread(s3);
+                if (!s3->fifo.busy)
+                    accel_fifo_wake(&s3->fifo);
 
-                if (!FIFO_EMPTY || s3->force_busy)
+                if (accel_fifo_busy(&s3->fifo) || s3->force_busy)
                     temp |= 0x02; /*Hardware busy*/
                 else
                     temp |= 0x04; /*FIFO empty*/
@@ -5360,7 +5311,7 @@ s3_accel_in(uint16_t port, void *priv)
                 s3->force_busy = 0;
 
                 if (s3->chip >= S3_VISION964) {
-                    if (FIFO_FULL)
+                    if (ACCEL_FIFO_FULL(&s3->fifo))
                         temp |= 0xf8; /*FIFO full*/
                 }
 
@@ -11175,58 +11126,42 @@ s3_pci_write(UNUSED(int func), int addr, UNUSED(int len), uint8_t val, void *pri
 }
 
 static void
-fifo_thread(void *param)
+s3_fifo_process(void *priv, uint32_t addr, uint32_t val, uint32_t type)
 {
-    s3_t    *s3 = (s3_t *) param;
-    uint64_t start_time;
-    uint64_t end_time;
-
-    while (s3->fifo_thread_run) {
-        thread_set_event(s3->fifo_not_full_event);
-        thread_wait_event(s3->wake_fifo_thread, -1);
-        thread_reset_event(s3->wake_fifo_thread);
-        s3->blitter_busy = 1;
-        while (!FIFO_EMPTY) {
-            start_time         = plat_timer_read();
-            fifo_entry_t *fifo = &s3->fifo[s3->fifo_read_idx & FIFO_MASK];
-
-            switch (fifo->addr_type & FIFO_TYPE) {
-                case FIFO_WRITE_BYTE:
-                    s3_accel_write_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
-                case FIFO_WRITE_WORD:
-                    s3_accel_write_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
-                case FIFO_WRITE_DWORD:
-                    s3_accel_write_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
-                case FIFO_OUT_BYTE:
-                    s3_accel_out_fifo(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
-                case FIFO_OUT_WORD:
-                    s3_accel_out_fifo_w(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
-                case FIFO_OUT_DWORD:
-                    s3_accel_out_fifo_l(s3, fifo->addr_type & FIFO_ADDR, fifo->val);
-                    break;
+    s3_t *s3 = (s3_t *) priv;
 
-                default:
-                    break;
-            }
+    switch (type) {
+        case FIFO_WRITE_BYTE:
+            s3_accel_write_fifo(s3, addr, val);
+            break;
+        case FIFO_WRITE_WORD:
+            s3_accel_write_fifo_w(s3, addr, val);
+            break;
+        case FIFO_WRITE_DWORD:
+            s3_accel_write_fifo_l(s3, addr, val);
+            break;
+        case FIFO_OUT_BYTE:
+            s3_accel_out_fifo(s3, addr, val);
+            break;
+        case FIFO_OUT_WORD:
+            s3_accel_out_fifo_w(s3, addr, val);
+            break;
+        case FIFO_OUT_DWORD:
+            s3_accel_out_fifo_l(s3, addr, val);
+            break;
 
-            s3->fifo_read_idx++;
-            fifo->addr_type = FIFO_INVALID;
+        default:
+            break;
+    }
+}
 
-            if (FIFO_ENTRIES > 0xe000)
-                thread_set_event(s3->fifo_not_full_event);
+static void
+s3_fifo_drained(void *priv)
+{
+    s3_t *s3 = (s3_t *) priv;
 
-            end_time = plat_timer_read();
-            s3->blitter_time += (end_time - start_time);
-        }
-        s3->blitter_busy = 0;
-        s3->subsys_stat |= INT_FIFO_EMP;
-        s3_update_irqs(s3);
-    }
+    s3->subsys_stat |= INT_FIFO_EMP;
+    s3_update_irqs(s3);
 }
 
 static int vram_sizes[] = {
@@ -11278,9 +11213,7 @@ s3_reset(void *priv)
         s3->accel.multifunc[0xe] = 0xe000;
         s3_log("S3 reset done.\n");
         s3->force_busy = 0;
-        s3->blitter_busy = 0;
-        s3->fifo_read_idx = 0;
-        s3->fifo_write_idx = 0;
+        accel_fifo_reset(&s3->fifo);
         if (s3->pci)
             reset_state->pci_slot = s3->pci_slot;
 
@@ -12247,10 +12180,7 @@ s3_init(const device_t *info)
     s3->accel.multifunc[0xd] = 0xd000;
     s3->accel.multifunc[0xe] = 0xe000;
 
-    s3->wake_fifo_thread    = thread_create_event();
-    s3->fifo_not_full_event = thread_create_event();
-    s3->fifo_thread_run     = 1;
-    s3->fifo_thread         = thread_create(fifo_thread, s3);
+    accel_fifo_init(&s3->fifo, info->name, s3_fifo_process, s3_fifo_drained, s3);
 
     *reset_state = *s3;
 
@@ -12496,11 +12426,7 @@ s3_close(void *priv)
 {
     s3_t *s3 = (s3_t *) priv;
 
-    s3->fifo_thread_run = 0;
-    thread_set_event(s3->wake_fifo_thread);
-    thread_wait(s3->fifo_thread);
-    thread_destroy_event(s3->fifo_not_full_event);
-    thread_destroy_event(s3->wake_fifo_thread);
+    accel_fifo_close(&s3->fifo);
 
     svga_close(&s3->svga);
 
@@ -40,6 +40,7 @@
 #include <86box/vid_xga.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_accel_fifo.h>
 
 #ifdef MIN
     #undef MIN
@@ -79,17 +80,6 @@ static int dither[4][4] = {
 #define RB_FULL (RB_ENTRIES == RB_SIZE)
 #define RB_EMPTY (!RB_ENTRIES)
 
-#define FIFO_SIZE 65536
-#define FIFO_MASK (FIFO_SIZE - 1)
-#define FIFO_ENTRY_SIZE (1 << 31)
-
-#define FIFO_ENTRIES (virge->fifo_write_idx - virge->fifo_read_idx)
-#define FIFO_FULL ((virge->fifo_write_idx - virge->fifo_read_idx) >= FIFO_SIZE)
-#define FIFO_EMPTY (virge->fifo_read_idx == virge->fifo_write_idx)
-
-#define FIFO_TYPE 0xff000000
-#define FIFO_ADDR 0x00ffffff
-
 enum {
     S3_VIRGE_325,
     S3_DIAMOND_STEALTH3D_2000,
@@ -113,17 +103,11 @@ enum {
 };
 
 enum {
-    FIFO_INVALID     = (0x00 << 24),
     FIFO_WRITE_BYTE  = (0x01 << 24),
     FIFO_WRITE_WORD  = (0x02 << 24),
     FIFO_WRITE_DWORD = (0x03 << 24)
 };
 
-typedef struct {
-    uint32_t addr_type;
-    uint32_t val;
-} fifo_entry_t;
-
 typedef struct s3d_t {
     uint32_t cmd_set;
     int      clip_l;
@@ -332,15 +316,9 @@ typedef struct virge_t {
         int sec_h;
     } streams;
 
-    fifo_entry_t fifo[FIFO_SIZE];
-    ATOMIC_INT   fifo_read_idx, fifo_write_idx;
-    ATOMIC_INT   fifo_thread_run, render_thread_run;
-
-    thread_t *fifo_thread;
-    event_t  *wake_fifo_thread;
-    event_t  *fifo_not_full_event;
+    accel_fifo_t fifo;
+    ATOMIC_INT   render_thread_run;
 
-    ATOMIC_INT   virge_busy;
     ATOMIC_UINT  irq_pending;
 
     uint8_t subsys_stat;
@@ -385,13 +363,6 @@ typedef struct virge_t {
     pc_timer_t irq_timer;
 } virge_t;
 
-static __inline void
-wake_fifo_thread(virge_t *virge)
-{
-    /* Wake up FIFO thread if moving from idle */
-    thread_set_event(virge->wake_fifo_thread);
-}
-
 static virge_t *reset_state = NULL;
 
 static video_timings_t timing_diamond_stealth3d_2000_pci = { .type = VIDEO_PCI, .write_b = 2, .write_w = 2, .write_l = 3, .read_b = 28, .read_w = 28, .read_l = 45 };
@@ -1180,10 +1151,7 @@ s3_virge_vblank_start(svga_t *svga)
 static void
 s3_virge_wait_fifo_idle(virge_t *virge)
 {
-    while (!FIFO_EMPTY) {
-        wake_fifo_thread(virge);
-        thread_wait_event(virge->fifo_not_full_event, 1);
-    }
+    accel_fifo_wait_idle(&virge->fifo);
 }
 
 static uint8_t
@@ -1197,20 +1165,20 @@ s3_virge_mmio_read(uint32_t addr, void *priv)
 
     switch (addr & 0xffff) {
         case 0x8504:
-            if (!virge->virge_busy)
-                wake_fifo_thread(virge);
+            if (!virge->fifo.busy)
+                accel_fifo_wake(&virge->fifo);
 
             ret = virge->subsys_stat;
             return ret;
         case 0x8505:
             ret = 0xc0;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (virge->s3d_busy || accel_fifo_busy(&virge->fifo))
                 ret |= 0x10;
             else
                 ret |= 0x30;
 
-            if (!virge->virge_busy)
-                wake_fifo_thread(virge);
+            if (!virge->fifo.busy)
+                accel_fifo_wake(&virge->fifo);
             return ret;
 
         case 0x850c:
@@ -1252,14 +1220,14 @@ s3_virge_mmio_read_w(uint32_t addr, void *priv)
     switch (addr & 0xfffe) {
         case 0x8504:
             ret = 0xc000;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (virge->s3d_busy || accel_fifo_busy(&virge->fifo))
                 ret |= 0x1000;
             else
                 ret |= 0x3000;
 
             ret |= virge->subsys_stat;
-            if (!virge->virge_busy)
-                wake_fifo_thread(virge);
+            if (!virge->fifo.busy)
+                accel_fifo_wake(&virge->fifo);
             return ret;
 
         case 0x850c:
@@ -1355,14 +1323,14 @@ s3_virge_mmio_read_l(uint32_t addr, void *priv)
 
         case 0x8504:
             ret = 0x0000c000;
-            if (virge->s3d_busy || virge->virge_busy || !FIFO_EMPTY)
+            if (virge->s3d_busy || accel_fifo_busy(&virge->fifo))
                 ret |= 0x00001000;
             else
                 ret |= 0x00003000;
 
             ret |= virge->subsys_stat;
-            if (!virge->virge_busy)
-                wake_fifo_thread(virge);
+            if (!virge->fifo.busy)
+                accel_fifo_wake(&virge->fifo);
             break;
 
         case 0x850c:
@@ -1819,70 +1787,53 @@ s3_virge_mmio_write_fifo_l(virge_t *virge, uint32_t addr, uint32_t val)
 }
 
 static void
-fifo_thread(void *param)
+s3_virge_fifo_process(void *priv, uint32_t addr, uint32_t val, uint32_t type)
 {
-    virge_t *virge = (virge_t *) param;
+    virge_t *virge = (virge_t *) priv;
 
-    while (virge->fifo_thread_run) {
-        thread_set_event(virge->fifo_not_full_event);
-        thread_wait_event(virge->wake_fifo_thread, -1);
-        thread_reset_event(virge->wake_fifo_thread);
-        virge->virge_busy = 1;
-        while (!FIFO_EMPTY) {
-            uint64_t      start_time = plat_timer_read();
-            uint64_t      end_time;
-            fifo_entry_t *fifo = &virge->fifo[virge->fifo_read_idx & FIFO_MASK];
-            uint32_t      val  = fifo->val;
-
-            switch (fifo->addr_type & FIFO_TYPE) {
-                case FIFO_WRITE_BYTE:
-                    if (((fifo->addr_type & FIFO_ADDR) & 0xffff) < 0x8000)
-                        s3_virge_bitblt(virge, 8, val);
-                    break;
-                case FIFO_WRITE_WORD:
-                    if (((fifo->addr_type & FIFO_ADDR) & 0xfffe) < 0x8000) {
-                        if (virge->s3d.cmd_set & CMD_SET_MS)
-                            s3_virge_bitblt(virge, 16, ((val >> 8) | (val << 8)) << 16);
-                        else
-                            s3_virge_bitblt(virge, 16, val);
-                    }
-                    break;
-                case FIFO_WRITE_DWORD:
-                    if (((fifo->addr_type & FIFO_ADDR) & 0xfffc) < 0x8000) {
-                        if (virge->s3d.cmd_set & CMD_SET_MS)
-                            s3_virge_bitblt(virge, 32,
-                                            ((val & 0xff000000) >> 24) | ((val & 0x00ff0000) >> 8) |
-                                            ((val & 0x0000ff00) << 8) | ((val & 0x000000ff) << 24));
-                        else
-                            s3_virge_bitblt(virge, 32, val);
-                    } else
-                        s3_virge_mmio_write_fifo_l(virge, (fifo->addr_type & FIFO_ADDR) & 0xfffc, val);
-                    break;
+    switch (type) {
+        case FIFO_WRITE_BYTE:
+            if ((addr & 0xffff) < 0x8000)
+                s3_virge_bitblt(virge, 8, val);
+            break;
+        case FIFO_WRITE_WORD:
+            if ((addr & 0xfffe) < 0x8000) {
+                if (virge->s3d.cmd_set & CMD_SET_MS)
+                    s3_virge_bitblt(virge, 16, ((val >> 8) | (val << 8)) << 16);
+                else
+                    s3_virge_bitblt(virge, 16, val);
             }
+            break;
+        case FIFO_WRITE_DWORD:
+            if ((addr & 0xfffc) < 0x8000) {
+                if (virge->s3d.cmd_set & CMD_SET_MS)
+                    s3_virge_bitblt(virge, 32,
+                                    ((val & 0xff000000) >> 24) | ((val & 0x00ff0000) >> 8) |
+                                    ((val & 0x0000ff00) << 8) | ((val & 0x000000ff) << 24));
+                else
+                    s3_virge_bitblt(virge, 32, val);
+            } else
+                s3_virge_mmio_write_fifo_l(virge, addr & 0xfffc, val);
+            break;
+    }
+}
 
-            virge->fifo_read_idx++;
-            fifo->addr_type = FIFO_INVALID;
-
-            if (FIFO_ENTRIES > 0xe000)
-                thread_set_event(virge->fifo_not_full_event);
+static void
+s3_virge_fifo_drained(void *priv)
+{
+    virge_t *virge = (virge_t *) priv;
 
-            end_time = plat_timer_read();
-            virge_time += end_time - start_time;
-        }
-        virge->virge_busy = 0;
-        virge->subsys_stat |= (INT_FIFO_EMP | INT_3DF_EMP);
-        if (virge->cmd_dma)
-            virge->subsys_stat |= (INT_HOST_DONE | INT_CMD_DONE);
+    virge->subsys_stat |= (INT_FIFO_EMP | INT_3DF_EMP);
+    if (virge->cmd_dma)
+        virge->subsys_stat |= (INT_HOST_DONE | INT_CMD_DONE);
 
-        virge->irq_pending++;
-    }
+    virge->irq_pending++;
 }
 
 static void
 s3_virge_queue(virge_t *virge, uint32_t addr, uint32_t val, uint32_t type)
 {
-    fifo_entry_t *fifo  = &virge->fifo[virge->fifo_write_idx & FIFO_MASK];
-    int           limit = 0;
+    int limit = 0;
 
     if (type == FIFO_WRITE_DWORD) {
         switch (addr & 0xfffc) {
@@ -1895,29 +1846,8 @@ s3_virge_queue(virge_t *virge, uint32_t addr, uint32_t val, uint32_t type)
         }
     }
 
-    if (limit) {
-        if (FIFO_ENTRIES >= 16) {
-            thread_reset_event(virge->fifo_not_full_event);
-            if (FIFO_ENTRIES >= 16)
-                thread_wait_event(virge->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
-        }
-    } else {
-        if (FIFO_FULL) {
-            thread_reset_event(virge->fifo_not_full_event);
-            if (FIFO_FULL)
-                thread_wait_event(virge->fifo_not_full_event, -1); /*Wait for room in ringbuffer*/
-        }
-    }
-
-    fifo->val       = val;
-    fifo->addr_type = (addr & FIFO_ADDR) | type;
-
-    virge->fifo_write_idx++;
-
-    if (FIFO_ENTRIES > 0xe000)
-        wake_fifo_thread(virge);
-    if (FIFO_ENTRIES > 0xe000 || FIFO_ENTRIES < 8)
-        wake_fifo_thread(virge);
+    /* Triangles that start drawing are only queued behind a few other writes. */
+    accel_fifo_queue(&virge->fifo, addr, val, type, limit ? 16 : 0);
 }
 
 static void
@@ -5311,9 +5241,7 @@ s3_virge_reset(void *priv)
 
     if (reset_state != NULL) {
         s3_virge_disable_handlers(dev);
-        dev->virge_busy       = 0;
-        dev->fifo_write_idx   = 0;
-        dev->fifo_read_idx    = 0;
+        accel_fifo_reset(&dev->fifo);
         dev->s3d_busy         = 0;
         dev->s3d_write_idx    = 0;
         dev->s3d_read_idx     = 0;
@@ -5573,10 +5501,7 @@ s3_virge_init(const device_t *info)
     virge->not_full_event     = thread_create_event();
     virge->render_thread      = thread_create(render_thread, virge);
 
-    virge->fifo_thread_run     = 1;
-    virge->wake_fifo_thread    = thread_create_event();
-    virge->fifo_not_full_event = thread_create_event();
-    virge->fifo_thread         = thread_create(fifo_thread, virge);
+    accel_fifo_init(&virge->fifo, info->name, s3_virge_fifo_process, s3_virge_fifo_drained, virge);
 
     timer_add(&virge->irq_timer, s3_virge_update_irq_timer, virge, 1);
 
@@ -5599,11 +5524,7 @@ s3_virge_close(void *priv)
     thread_destroy_event(virge->wake_main_thread);
     thread_destroy_event(virge->wake_render_thread);
 
-    virge->fifo_thread_run = 0;
-    thread_set_event(virge->wake_fifo_thread);
-    thread_wait(virge->fifo_thread);
-    thread_destroy_event(virge->fifo_not_full_event);
-    thread_destroy_event(virge->wake_fifo_thread);
+    accel_fifo_close(&virge->fifo);
 
     svga_close(&virge->svga);
 
@@ -0,0 +1,297 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Per-frame timing statistics of the video pipeline.
+ *
+ *          Each stage of the pipeline, from the SVGA and Voodoo emulation
+ *          through the blit ring to the frontend renderer, is timed while
+ *          statistics are being collected. The time spent in a stage is
+ *          summed over a frame and added to a histogram, which can be read
+ *          at runtime or dumped as JSON to tell which stage limits the
+ *          frame rate. Stages that run once per frame are also reported
+ *          to minitrace.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <stdatomic.h>
+#ifdef _WIN32
+#    include <windows.h>
+#else
+#    include <time.h>
+#endif
+#define HAVE_STDARG_H
+#include <86box/86box.h>
+#include <86box/plat.h>
+#include <86box/thread.h>
+#include <86box/vid_stats.h>
+#include <minitrace/minitrace.h>
+
+#ifdef ENABLE_VIDEO_STATS_LOG
+int video_stats_do_log = ENABLE_VIDEO_STATS_LOG;
+
+static void
+video_stats_log(const char *fmt, ...)
+{
+    va_list ap;
+
+    if (video_stats_do_log) {
+        va_start(ap, fmt);
+        pclog_ex(fmt, ap);
+        va_end(ap);
+    }
+}
+#else
+#    define video_stats_log(fmt, ...)
+#endif
+
+static const struct {
+    const char *name;
+    int         trace; /* begun and ended on the same thread, at most a few times per frame */
+} stages[VIDEO_STAT_MAX] = {
+    [VIDEO_STAT_SVGA_POLL]     = { "svga_poll",     0 },
+    [VIDEO_STAT_SVGA_RENDER]   = { "svga_render",   0 },
+    [VIDEO_STAT_SVGA_BLIT]     = { "svga_doblit",   1 },
+    [VIDEO_STAT_BLIT_WAIT]     = { "blit_wait",     0 },
+    [VIDEO_STAT_BLIT]          = { "blit",          0 },
+    [VIDEO_STAT_PRESENT]       = { "present",       1 },
+    [VIDEO_STAT_VOODOO_FIFO]   = { "voodoo_fifo",   1 },
+    [VIDEO_STAT_VOODOO_RENDER] = { "voodoo_render", 1 },
+    [VIDEO_STAT_VOODOO_SWAP]   = { "voodoo_swap",   0 }
+};
+
+volatile int video_stats_enabled = 0;
+
+/* Time spent in each stage during the current frame, from any thread. */
+static atomic_uint frame_us[VIDEO_STAT_MAX];
+static atomic_uint frame_hits[VIDEO_STAT_MAX];
+
+static mutex_t     *stats_lock = NULL;
+static uint64_t     stats_frames;
+static video_stat_t stats[VIDEO_STAT_MAX];
+
+#ifdef _WIN32
+static LARGE_INTEGER performance_frequency;
+#endif
+
+static uint64_t
+video_stats_now_us(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER now;
+
+    QueryPerformanceCounter(&now);
+
+    return (uint64_t) ((now.QuadPart * 1000000) / performance_frequency.QuadPart);
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t) now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+#endif
+}
+
+uint64_t
+video_stats_begin(int stage)
+{
+    if (stages[stage].trace)
+        MTR_BEGIN("video", stages[stage].name);
+
+    if (!video_stats_enabled)
+        return 0;
+
+    /* 0 is reserved for "not collecting". */
+    return video_stats_now_us() | 1;
+}
+
+void
+video_stats_end(int stage, uint64_t start)
+{
+    uint64_t now;
+
+    if (stages[stage].trace)
+        MTR_END("video", stages[stage].name);
+
+    if (!start || !video_stats_enabled)
+        return;
+
+    now = video_stats_now_us();
+    if (now > start) {
+        atomic_fetch_add(&frame_us[stage], (uint32_t) (now - start));
+        atomic_fetch_add(&frame_hits[stage], 1);
+    }
+}
+
+void
+video_stats_frame_end(int monitor_index)
+{
+    if (!video_stats_enabled || (monitor_index != 0) || (stats_lock == NULL))
+        return;
+
+    thread_wait_mutex(stats_lock);
+    stats_frames++;
+    for (int i = 0; i < VIDEO_STAT_MAX; i++) {
+        uint32_t us;
+        uint32_t bucket;
+
+        if (!atomic_exchange(&frame_hits[i], 0))
+            continue;
+        us = atomic_exchange(&frame_us[i], 0);
+
+        bucket = us / VIDEO_STATS_BUCKET_US;
+        if (bucket >= VIDEO_STATS_BUCKETS)
+            bucket = VIDEO_STATS_BUCKETS - 1;
+
+        stats[i].frames++;
+        stats[i].total_us += us;
+        if (us > stats[i].max_us)
+            stats[i].max_us = us;
+        stats[i].hist[bucket]++;
+    }
+    thread_release_mutex(stats_lock);
+}
+
+void
+video_stats_start(void)
+{
+    if (stats_lock == NULL)
+        return;
+
+    thread_wait_mutex(stats_lock);
+    stats_frames = 0;
+    memset(stats, 0, sizeof(stats));
+    for (int i = 0; i < VIDEO_STAT_MAX; i++) {
+        atomic_store(&frame_us[i], 0);
+        atomic_store(&frame_hits[i], 0);
+    }
+    thread_release_mutex(stats_lock);
+
+    video_stats_enabled = 1;
+}
+
+void
+video_stats_stop(void)
+{
+    video_stats_enabled = 0;
+}
+
+const char *
+video_stats_name(int stage)
+{
+    return stages[stage].name;
+}
+
+uint64_t
+video_stats_frames(void)
+{
+    return stats_frames;
+}
+
+void
+video_stats_get(int stage, video_stat_t *stat)
+{
+    if (stats_lock == NULL) {
+        memset(stat, 0, sizeof(video_stat_t));
+        return;
+    }
+
+    thread_wait_mutex(stats_lock);
+    *stat = stats[stage];
+    thread_release_mutex(stats_lock);
+}
+
+uint32_t
+video_stats_percentile(const video_stat_t *stat, int percent)
+{
+    uint64_t target = (stat->frames * percent + 99) / 100;
+    uint64_t count  = 0;
+
+    if (!stat->frames)
+        return 0;
+
+    for (int i = 0; i < VIDEO_STATS_BUCKETS - 1; i++) {
+        count += stat->hist[i];
+        if (count >= target)
+            return (i + 1) * VIDEO_STATS_BUCKET_US;
+    }
+
+    return stat->max_us;
+}
+
+int
+video_stats_dump(const char *fn)
+{
+    FILE        *fp;
+    video_stat_t stat;
+    int          last;
+
+    fp = plat_fopen(fn, "w");
+    if (fp == NULL) {
+        video_stats_log("Video stats: unable to open %s\n", fn);
+        return 0;
+    }
+
+    fprintf(fp, "{\n  \"frames\": %" PRIu64 ",\n  \"bucket_us\": %i,\n  \"stages\": {", video_stats_frames(), VIDEO_STATS_BUCKET_US);
+    for (int i = 0; i < VIDEO_STAT_MAX; i++) {
+        video_stats_get(i, &stat);
+
+        fprintf(fp, "%s\n    \"%s\": {\n", i ? "," : "", stages[i].name);
+        fprintf(fp, "      \"frames\": %" PRIu64 ",\n", stat.frames);
+        fprintf(fp, "      \"mean_ms\": %.3f,\n", stat.frames ? ((double) stat.total_us / stat.frames) / 1000.0 : 0.0);
+        fprintf(fp, "      \"p50_ms\": %.3f,\n", video_stats_percentile(&stat, 50) / 1000.0);
+        fprintf(fp, "      \"p95_ms\": %.3f,\n", video_stats_percentile(&stat, 95) / 1000.0);
+        fprintf(fp, "      \"p99_ms\": %.3f,\n", video_stats_percentile(&stat, 99) / 1000.0);
+        fprintf(fp, "      \"max_ms\": %.3f,\n", stat.max_us / 1000.0);
+
+        /* Trailing empty buckets are left out. */
+        for (last = VIDEO_STATS_BUCKETS - 1; (last >= 0) && !stat.hist[last]; last--)
+            ;
+        fprintf(fp, "      \"histogram\": [");
+        for (int b = 0; b <= last; b++)
+            fprintf(fp, "%s%u", b ? ", " : "", stat.hist[b]);
+        fprintf(fp, "]\n    }");
+    }
+    fprintf(fp, "\n  }\n}\n");
+
+    fclose(fp);
+
+    video_stats_log("Video stats: %" PRIu64 " frames dumped to %s\n", video_stats_frames(), fn);
+
+    return 1;
+}
+
+void
+video_stats_init(void)
+{
+#ifdef _WIN32
+    QueryPerformanceFrequency(&performance_frequency);
+#endif
+
+    if (stats_lock == NULL)
+        stats_lock = thread_create_mutex();
+}
+
+void
+video_stats_close(void)
+{
+    video_stats_enabled = 0;
+
+    if (stats_lock != NULL) {
+        thread_close_mutex(stats_lock);
+        stats_lock = NULL;
+    }
+}
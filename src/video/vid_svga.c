@@ -41,6 +41,7 @@
 #include <86box/vid_xga.h>
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_xga_device.h>
 
 void svga_doblit(int wx, int wy, svga_t *svga);
@@ -1216,6 +1217,7 @@ svga_recalctimings(svga_t *svga)
             int x_start = enable_overscan ? 0 : (svga->monitor->mon_overscan_x >> 1);
             video_wait_for_buffer_monitor(svga->monitor_index);
             memset(svga->monitor->target_buffer->dat, 0, (size_t) svga->monitor->target_buffer->w * svga->monitor->target_buffer->h * 4);
+            memset(svga->line_hash_valid, 0, sizeof(svga->line_hash_valid));
             video_blit_memtoscreen_monitor(x_start, y_start, svga->monitor->mon_xsize + x_add, svga->monitor->mon_ysize + y_add, svga->monitor_index);
             video_wait_for_buffer_monitor(svga->monitor_index);
             svga->dpms_ui = 1;
@@ -1281,20 +1283,76 @@ svga_recalctimings(svga_t *svga)
     }
 }
 
+/*
+   Lines under an overlay or hardware cursor are redrawn on every frame, as
+   the cursor is drawn over the rendered line. Whether such a line actually
+   changed since the last blit is told by a hash of its pixels, which also
+   covers cursor patterns and colors kept outside of VRAM, in the RAMDAC or
+   in the registers of the card.
+ */
+static void
+svga_line_hash_check(svga_t *svga, int line, int first_before, int last_before)
+{
+    const uint32_t *p;
+    uint64_t        hash = 0xcbf29ce484222325ULL;
+    int             x_start;
+    int             x_end;
+
+    if (!video_dirty_scanout || (line < 0) || (line >= 2048) || (line >= svga->monitor->target_buffer->h))
+        return;
+
+    x_start = MAX(svga->x_add, 0);
+    x_end   = MIN(svga->x_add + svga->hdisp, svga->monitor->target_buffer->w);
+    p       = svga->monitor->target_buffer->line[line];
+    for (int x = x_start; x < x_end; x++)
+        hash = (hash ^ p[x]) * 0x100000001b3ULL;
+
+    if (svga->line_hash_valid[line] && (svga->line_hash[line] == hash)) {
+        /* Redrawn, but identical to what was last handed to the blitter. */
+        svga->firstline_draw = first_before;
+        svga->lastline_draw  = last_before;
+        return;
+    }
+
+    svga->line_hash[line]       = hash;
+    svga->line_hash_valid[line] = 1;
+
+    /* Also counts lines the renderer skipped, but a cursor was drawn on. */
+    if (svga->firstline_draw == 2000)
+        svga->firstline_draw = svga->displine;
+    svga->lastline_draw = svga->displine;
+}
+
 static void
 svga_do_render(svga_t *svga)
 {
+    int line         = svga->displine + svga->y_add;
+    int covered      = !svga->override && (svga->overlay_on || svga->dac_hwcursor_on || svga->hwcursor_on);
+    int first_before = svga->firstline_draw;
+    int last_before  = svga->lastline_draw;
+
     /* Always render a blank screen and nothing else while in DPMS mode. */
     if (svga->dpms) {
+        if ((line >= 0) && (line < 2048))
+            svga->line_hash_valid[line] = 0;
         svga_render_blank(svga);
         return;
     }
 
     if (!svga->override) {
+        uint64_t start = video_stats_begin(VIDEO_STAT_SVGA_RENDER);
+
         svga->render_line_offset = svga->start_retrace_latch - svga->crtc[0x4];
         svga->render(svga);
+
+        video_stats_end(VIDEO_STAT_SVGA_RENDER, start);
     }
 
+    /* The hash of a line no longer describes it once it is redrawn without
+       a cursor or overlay over it, or by another device driving the monitor. */
+    if (!covered && (line >= 0) && (line < 2048) && (svga->override || (svga->lastline_draw != last_before)))
+        svga->line_hash_valid[line] = 0;
+
     if (svga->overlay_on) {
         if (!svga->override && svga->overlay_draw)
             svga->overlay_draw(svga, svga->displine + svga->y_add);
@@ -1320,6 +1378,9 @@ svga_do_render(svga_t *svga)
             svga->hwcursor_on--;
     }
 
+    if (covered)
+        svga_line_hash_check(svga, line, first_before, last_before);
+
     if (!svga->override) {
         svga->x_add = svga->left_overscan;
         svga_render_overscan_left(svga);
@@ -1328,10 +1389,39 @@ svga_do_render(svga_t *svga)
     }
 }
 
-void
-svga_poll(void *priv)
+/*
+   With dirty scanout enabled, a frame in which no scanline was redrawn is
+   not handed to the blitter again. The renderers already skip lines whose
+   VRAM pages are unchanged, palette, timing and cursor changes mark lines
+   or the whole screen as changed, and lines under an overlay or hardware
+   cursor are marked when their pixels differ from the last blit (see
+   svga_line_hash_check()), so the target buffer still holds exactly what
+   was last blitted.
+ */
+static int
+svga_frame_unchanged(svga_t *svga, int wx, int wy)
+{
+    const monitor_t *monitor = svga->monitor;
+
+    /* svga_doblit() rescales the line doubled geometry on every blit. */
+    if (!video_dirty_scanout || !svga->blit_valid || svga->vertical_linedbl)
+        return 0;
+
+    if ((svga->firstline_draw != 2000) || (wx != svga->blit_wx) || (wy != svga->blit_wy) ||
+        (svga->dpms != svga->blit_dpms) || (svga->overscan_color != svga->blit_overscan_color))
+        return 0;
+
+    /* Resizes and screenshots are done by the frontend on the next blit. */
+    if (monitor->mon_screenshots || monitor->mon_screenshots_clipboard || monitor->mon_screenshots_raw ||
+        monitor->mon_screenshots_raw_clipboard || video_force_resize_get_monitor(svga->monitor_index))
+        return 0;
+
+    return 1;
+}
+
+static void
+svga_do_poll(svga_t *svga)
 {
-    svga_t    *svga = (svga_t *) priv;
     uint32_t   x;
     uint32_t   blink_delay;
     int        wx;
@@ -1561,14 +1651,24 @@ svga_poll(void *priv)
             wx = x;
 
             if (!svga->override) {
-                if (svga->vertical_linedbl) {
+                if (svga->vertical_linedbl)
                     wy = (svga->lastline - svga->firstline) << 1;
-                    svga->vdisp = wy + 1;
-                    svga_doblit(wx, wy, svga);
-                } else {
+                else
                     wy = svga->lastline - svga->firstline;
-                    svga->vdisp = wy + 1;
+                svga->vdisp = wy + 1;
+
+                if (svga_frame_unchanged(svga, wx, wy)) {
+                    /* Still a displayed frame as far as the refresh rate goes. */
+                    svga->monitor->mon_renderedframes++;
+                    video_stats_frame_end(svga->monitor_index);
+                } else {
                     svga_doblit(wx, wy, svga);
+
+                    svga->blit_valid          = 1;
+                    svga->blit_wx             = wx;
+                    svga->blit_wy             = wy;
+                    svga->blit_dpms           = svga->dpms;
+                    svga->blit_overscan_color = svga->overscan_color;
                 }
             }
 
@@ -1658,6 +1758,16 @@ svga_poll(void *priv)
     }
 }
 
+void
+svga_poll(void *priv)
+{
+    uint64_t start = video_stats_begin(VIDEO_STAT_SVGA_POLL);
+
+    svga_do_poll((svga_t *) priv);
+
+    video_stats_end(VIDEO_STAT_SVGA_POLL, start);
+}
+
 uint32_t
 svga_conv_16to32(UNUSED(struct svga_t *svga), uint16_t color, uint8_t bpp)
 {
@@ -2124,8 +2234,8 @@ svga_read_linear(uint32_t addr, void *priv)
     return svga_read_common(addr, 1, priv);
 }
 
-void
-svga_doblit(int wx, int wy, svga_t *svga)
+static void
+svga_do_blit(int wx, int wy, svga_t *svga)
 {
     int       y_add;
     int       x_add;
@@ -2138,6 +2248,9 @@ svga_doblit(int wx, int wy, svga_t *svga)
     int       xs_temp;
     int       ys_temp;
 
+    /* Other devices driving the monitor blit through here as well. */
+    svga->blit_valid = 0;
+
     y_add   = enable_overscan ? svga->monitor->mon_overscan_y : 0;
     x_add   = enable_overscan ? svga->monitor->mon_overscan_x : 0;
 #ifdef USE_OLD_CALCULATION
@@ -2217,6 +2330,16 @@ svga_doblit(int wx, int wy, svga_t *svga)
         svga->vertical_linedbl >>= 1;
 }
 
+void
+svga_doblit(int wx, int wy, svga_t *svga)
+{
+    uint64_t start = video_stats_begin(VIDEO_STAT_SVGA_BLIT);
+
+    svga_do_blit(wx, wy, svga);
+
+    video_stats_end(VIDEO_STAT_SVGA_BLIT, start);
+}
+
 void
 svga_writeb_linear(uint32_t addr, uint8_t val, void *priv)
 {
@@ -27,6 +27,7 @@
 #include <86box/vid_svga.h>
 #include <86box/vid_svga_render.h>
 #include <86box/vid_svga_render_remap.h>
+#include <86box/vid_svga_render_simd.h>
 
 uint32_t
 svga_lookup_lut_ram(svga_t* svga, uint32_t val)
@@ -42,6 +43,97 @@ svga_lookup_lut_ram(svga_t* svga, uint32_t val)
 
 #define lookup_lut(val) svga_lookup_lut_ram(svga, val)
 
+/*
+   Returns the VRAM at addr if len bytes can be read from there without
+   wrapping around the display mask, so the conversion kernels can take the
+   whole span in one go. Otherwise the renderers fall back to masking every
+   dword they read.
+ */
+static inline const uint8_t *
+svga_vram_span(svga_t *svga, uint32_t addr, uint32_t len)
+{
+    const uint64_t size = (uint64_t) svga->vram_display_mask + 1;
+
+    if ((size & (size - 1)) || (((addr & svga->vram_display_mask) + (uint64_t) len) > size))
+        return NULL;
+
+    return &svga->vram[addr & svga->vram_display_mask];
+}
+
+/*
+   Converts a whole 15/16 bpp scanline of step-pixel groups, as the loops of
+   the renderers below do, and advances memaddr past it. Only the standard
+   conversion is vectorised; RAMDACs with their own conv_16to32 keep using it.
+ */
+static int
+svga_render_16bpp_line(svga_t *svga, uint32_t *p, int step, int bpp, int dbl)
+{
+    const uint8_t *src;
+    int            count;
+
+    if ((svga->conv_16to32 != svga_conv_16to32) || ((svga->hdisp + svga->scrollcache) < 0))
+        return 0;
+
+    count = ((svga->hdisp + svga->scrollcache) / step + 1) * step;
+    src   = svga_vram_span(svga, svga->memaddr, count << 1);
+    if (src == NULL)
+        return 0;
+
+    if (bpp == 15)
+        svga_render_kernels.rgb555(p, src, count, dbl);
+    else
+        svga_render_kernels.rgb565(p, src, count, dbl);
+
+    svga->memaddr += count << 1;
+    return 1;
+}
+
+/*
+   Plain packed 8 bpp, which nearly every 256 colour mode ends up as, is a
+   palette lookup of consecutive VRAM bytes. Returns the number of pixels
+   written, or 0 if the span has to go through the generic loop.
+ */
+static int
+svga_render_8bpp_line(svga_t *svga, uint32_t *p, int charwidth, int dbl)
+{
+    const uint8_t *src;
+    int            count;
+
+    if ((svga->hdisp + svga->scrollcache) < 0)
+        return 0;
+
+    count = ((svga->hdisp + svga->scrollcache) / charwidth + 1) * 4;
+    src   = svga_vram_span(svga, svga->memaddr, count);
+    if (src == NULL)
+        return 0;
+
+    svga_render_kernels.pal8(p, src, svga->map8, svga->dac_mask, count, dbl);
+
+    svga->memaddr = (svga->memaddr + count) & svga->vram_display_mask;
+    return count << dbl;
+}
+
+/*Same for 24 bpp, which is only vectorised when the LUT is bypassed.*/
+static int
+svga_render_24bpp_line(svga_t *svga, uint32_t *p, int step, int dbl)
+{
+    const uint8_t *src;
+    int            count;
+
+    if (svga->lut_map || ((svga->hdisp + svga->scrollcache) < 0))
+        return 0;
+
+    count = ((svga->hdisp + svga->scrollcache) / step + 1) * step;
+    src   = svga_vram_span(svga, svga->memaddr, count * 3);
+    if (src == NULL)
+        return 0;
+
+    svga_render_kernels.rgb888(p, src, count, dbl);
+
+    svga->memaddr += count * 3;
+    return 1;
+}
+
 void
 svga_render_null(svga_t *svga)
 {
@@ -812,6 +904,22 @@ svga_render_indexed_gfx(svga_t *svga, bool highres, bool combine8bits)
     uint32_t edat         = 0;
     static uint32_t col          = 0;
     static uint32_t col2         = 0;
+
+    /*
+       Bytes straight out of VRAM with no plane masking or blinking,
+       one load and one address increment per character.
+     */
+    if (combine8bits && shift4bit && !svga->ati_4color && !svga->packed_4bpp && !svga->half_pixel &&
+        !svga->force_old_addr && !svga->remap_required && !svga->render_line_offset &&
+        (loadevery == 1) && (incevery == 1) && (planemask == 0xffffffff) && !blinkmask) {
+        const int written = svga_render_8bpp_line(svga, p, charwidth, !highres);
+
+        if (written) {
+            col = p[written - 1];
+            return;
+        }
+    }
+
     for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += charwidth) {
         if (load_counter == 0) {
             /* Find our address */
@@ -1513,18 +1621,20 @@ svga_render_15bpp_lowres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+            if (!svga_render_16bpp_line(svga, p, 4, 15, 1)) {
+                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
 
-                p[x << 1] = p[(x << 1) + 1] = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[(x << 1) + 2] = p[(x << 1) + 3] = svga->conv_16to32(svga, dat >> 16, 15);
+                    p[x << 1] = p[(x << 1) + 1] = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[(x << 1) + 2] = p[(x << 1) + 3] = svga->conv_16to32(svga, dat >> 16, 15);
 
-                dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
 
-                p[(x << 1) + 4] = p[(x << 1) + 5] = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[(x << 1) + 6] = p[(x << 1) + 7] = svga->conv_16to32(svga, dat >> 16, 15);
+                    p[(x << 1) + 4] = p[(x << 1) + 5] = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[(x << 1) + 6] = p[(x << 1) + 7] = svga->conv_16to32(svga, dat >> 16, 15);
+                }
+                svga->memaddr += x << 1;
             }
-            svga->memaddr += x << 1;
             svga->memaddr &= svga->vram_display_mask;
         }
     } else {
@@ -1538,18 +1648,20 @@ svga_render_15bpp_lowres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                if (!svga_render_16bpp_line(svga, p, 4, 15, 0)) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                        dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
 
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
 
-                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
 
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                    }
+                    svga->memaddr += x << 1;
                 }
-                svga->memaddr += x << 1;
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 2) {
                     addr = svga->remap_func(svga, svga->memaddr);
@@ -1585,24 +1697,26 @@ svga_render_15bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                p[x]     = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[x + 1] = svga->conv_16to32(svga, dat >> 16, 15);
+            if (!svga_render_16bpp_line(svga, p, 8, 15, 0)) {
+                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                    p[x]     = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[x + 1] = svga->conv_16to32(svga, dat >> 16, 15);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                p[x + 2] = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[x + 3] = svga->conv_16to32(svga, dat >> 16, 15);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                    p[x + 2] = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[x + 3] = svga->conv_16to32(svga, dat >> 16, 15);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                p[x + 4] = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[x + 5] = svga->conv_16to32(svga, dat >> 16, 15);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                    p[x + 4] = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[x + 5] = svga->conv_16to32(svga, dat >> 16, 15);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                p[x + 6] = svga->conv_16to32(svga, dat & 0xffff, 15);
-                p[x + 7] = svga->conv_16to32(svga, dat >> 16, 15);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                    p[x + 6] = svga->conv_16to32(svga, dat & 0xffff, 15);
+                    p[x + 7] = svga->conv_16to32(svga, dat >> 16, 15);
+                }
+                svga->memaddr += x << 1;
             }
-            svga->memaddr += x << 1;
             svga->memaddr &= svga->vram_display_mask;
         }
     } else {
@@ -1616,24 +1730,26 @@ svga_render_15bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                if (!svga_render_16bpp_line(svga, p, 8, 15, 0)) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 15);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 15);
+                    }
+                    svga->memaddr += x << 1;
                 }
-                svga->memaddr += x << 1;
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 2) {
                     addr = svga->remap_func(svga, svga->memaddr);
@@ -1747,16 +1863,18 @@ svga_render_16bpp_lowres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                dat       = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                p[x << 1] = p[(x << 1) + 1] = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[(x << 1) + 2] = p[(x << 1) + 3] = svga->conv_16to32(svga, dat >> 16, 16);
+            if (!svga_render_16bpp_line(svga, p, 4, 16, 1)) {
+                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                    dat       = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                    p[x << 1] = p[(x << 1) + 1] = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[(x << 1) + 2] = p[(x << 1) + 3] = svga->conv_16to32(svga, dat >> 16, 16);
 
-                dat             = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                p[(x << 1) + 4] = p[(x << 1) + 5] = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[(x << 1) + 6] = p[(x << 1) + 7] = svga->conv_16to32(svga, dat >> 16, 16);
+                    dat             = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                    p[(x << 1) + 4] = p[(x << 1) + 5] = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[(x << 1) + 6] = p[(x << 1) + 7] = svga->conv_16to32(svga, dat >> 16, 16);
+                }
+                svga->memaddr += x << 1;
             }
-            svga->memaddr += x << 1;
             svga->memaddr &= svga->vram_display_mask;
         }
     } else {
@@ -1770,18 +1888,20 @@ svga_render_16bpp_lowres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                if (!svga_render_16bpp_line(svga, p, 4, 16, 0)) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                        dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
 
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
 
-                    dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
 
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                    }
+                    svga->memaddr += x << 1;
                 }
-                svga->memaddr += x << 1;
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 2) {
                     addr = svga->remap_func(svga, svga->memaddr);
@@ -1817,24 +1937,26 @@ svga_render_16bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                uint32_t dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                p[x]         = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[x + 1]     = svga->conv_16to32(svga, dat >> 16, 16);
+            if (!svga_render_16bpp_line(svga, p, 8, 16, 0)) {
+                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                    uint32_t dat = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                    p[x]         = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[x + 1]     = svga->conv_16to32(svga, dat >> 16, 16);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                p[x + 2] = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[x + 3] = svga->conv_16to32(svga, dat >> 16, 16);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                    p[x + 2] = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[x + 3] = svga->conv_16to32(svga, dat >> 16, 16);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                p[x + 4] = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[x + 5] = svga->conv_16to32(svga, dat >> 16, 16);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                    p[x + 4] = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[x + 5] = svga->conv_16to32(svga, dat >> 16, 16);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                p[x + 6] = svga->conv_16to32(svga, dat & 0xffff, 16);
-                p[x + 7] = svga->conv_16to32(svga, dat >> 16, 16);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                    p[x + 6] = svga->conv_16to32(svga, dat & 0xffff, 16);
+                    p[x + 7] = svga->conv_16to32(svga, dat >> 16, 16);
+                }
+                svga->memaddr += x << 1;
             }
-            svga->memaddr += x << 1;
             svga->memaddr &= svga->vram_display_mask;
         }
     } else {
@@ -1848,24 +1970,26 @@ svga_render_16bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
-
-                    dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
-                    *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
-                    *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                if (!svga_render_16bpp_line(svga, p, 8, 16, 0)) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 8) {
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1)) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 4) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 8) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+
+                        dat  = *(uint32_t *) (&svga->vram[(svga->memaddr + (x << 1) + 12) & svga->vram_display_mask]);
+                        *p++ = svga->conv_16to32(svga, dat & 0xffff, 16);
+                        *p++ = svga->conv_16to32(svga, dat >> 16, 16);
+                    }
+                    svga->memaddr += x << 1;
                 }
-                svga->memaddr += x << 1;
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 2) {
                     addr = svga->remap_func(svga, svga->memaddr);
@@ -1981,20 +2105,22 @@ svga_render_24bpp_highres(svga_t *svga)
                 svga->firstline_draw = svga->displine;
             svga->lastline_draw = svga->displine;
 
-            for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                dat  = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
-                p[x] = lookup_lut(dat & 0xffffff);
+            if (!svga_render_24bpp_line(svga, p, 4, 0)) {
+                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                    dat  = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
+                    p[x] = lookup_lut(dat & 0xffffff);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 3) & svga->vram_display_mask]);
-                p[x + 1] = lookup_lut(dat & 0xffffff);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 3) & svga->vram_display_mask]);
+                    p[x + 1] = lookup_lut(dat & 0xffffff);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 6) & svga->vram_display_mask]);
-                p[x + 2] = lookup_lut(dat & 0xffffff);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 6) & svga->vram_display_mask]);
+                    p[x + 2] = lookup_lut(dat & 0xffffff);
 
-                dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 9) & svga->vram_display_mask]);
-                p[x + 3] = lookup_lut(dat & 0xffffff);
+                    dat      = *(uint32_t *) (&svga->vram[(svga->memaddr + 9) & svga->vram_display_mask]);
+                    p[x + 3] = lookup_lut(dat & 0xffffff);
 
-                svga->memaddr += 12;
+                    svga->memaddr += 12;
+                }
             }
             svga->memaddr &= svga->vram_display_mask;
         }
@@ -2009,17 +2135,19 @@ svga_render_24bpp_highres(svga_t *svga)
             svga->lastline_draw = svga->displine;
 
             if (!svga->remap_required) {
-                for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
-                    dat0 = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
-                    dat1 = *(uint32_t *) (&svga->vram[(svga->memaddr + 4) & svga->vram_display_mask]);
-                    dat2 = *(uint32_t *) (&svga->vram[(svga->memaddr + 8) & svga->vram_display_mask]);
-
-                    *p++ = lookup_lut(dat0 & 0xffffff);
-                    *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
-                    *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
-                    *p++ = lookup_lut(dat2 >> 8);
-
-                    svga->memaddr += 12;
+                if (!svga_render_24bpp_line(svga, p, 4, 0)) {
+                    for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
+                        dat0 = *(uint32_t *) (&svga->vram[svga->memaddr & svga->vram_display_mask]);
+                        dat1 = *(uint32_t *) (&svga->vram[(svga->memaddr + 4) & svga->vram_display_mask]);
+                        dat2 = *(uint32_t *) (&svga->vram[(svga->memaddr + 8) & svga->vram_display_mask]);
+
+                        *p++ = lookup_lut(dat0 & 0xffffff);
+                        *p++ = lookup_lut((dat0 >> 24) | ((dat1 & 0xffff) << 8));
+                        *p++ = lookup_lut((dat1 >> 16) | ((dat2 & 0xff) << 16));
+                        *p++ = lookup_lut(dat2 >> 8);
+
+                        svga->memaddr += 12;
+                    }
                 }
             } else {
                 for (x = 0; x <= (svga->hdisp + svga->scrollcache); x += 4) {
@@ -0,0 +1,334 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorised scanline conversion kernels for the SVGA renderers.
+ *
+ *          The portable kernels are always available; SSE2 is used on
+ *          every x86-64 host, SSSE3 and AVX2 are picked at runtime when
+ *          the host supports them, and NEON is used on ARM64.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <86box/86box.h>
+#include <86box/vid_svga_render_simd.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define SVGA_SIMD_SSE2
+#    include <immintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define SVGA_SIMD_X86_RUNTIME
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define SVGA_SIMD_NEON
+#    include <arm_neon.h>
+#endif
+
+/*
+   The 5 and 6 bit expansions of calc_15to32() and calc_16to32() are
+   (c * 255) / 31 and (c * 255) / 63 rounded down, which is exactly
+   (c * 1053) >> 7 and (c * 4145) >> 10 over the whole input range.
+ */
+static inline uint32_t
+conv_555(uint16_t c)
+{
+    uint32_t b = ((c & 0x1f) * 1053) >> 7;
+    uint32_t g = (((c >> 5) & 0x1f) * 1053) >> 7;
+    uint32_t r = (((c >> 10) & 0x1f) * 1053) >> 7;
+
+    return b | (g << 8) | (r << 16) | 0xff000000;
+}
+
+static inline uint32_t
+conv_565(uint16_t c)
+{
+    uint32_t b = ((c & 0x1f) * 1053) >> 7;
+    uint32_t g = (((c >> 5) & 0x3f) * 4145) >> 10;
+    uint32_t r = (((c >> 11) & 0x1f) * 1053) >> 7;
+
+    return b | (g << 8) | (r << 16) | 0xff000000;
+}
+
+static inline void
+put_pixel(uint32_t **p, uint32_t val, int dbl)
+{
+    *(*p)++ = val;
+    if (dbl)
+        *(*p)++ = val;
+}
+
+static void
+pal8_c(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count, int dbl)
+{
+    for (int x = 0; x < count; x++)
+        put_pixel(&p, pal[src[x] & mask], dbl);
+}
+
+static void
+rgb555_c(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    for (int x = 0; x < count; x++)
+        put_pixel(&p, conv_555(src[x << 1] | (src[(x << 1) + 1] << 8)), dbl);
+}
+
+static void
+rgb565_c(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    for (int x = 0; x < count; x++)
+        put_pixel(&p, conv_565(src[x << 1] | (src[(x << 1) + 1] << 8)), dbl);
+}
+
+static void
+rgb888_c(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    for (int x = 0; x < count; x++)
+        put_pixel(&p, src[x * 3] | (src[x * 3 + 1] << 8) | (src[x * 3 + 2] << 16), dbl);
+}
+
+#ifdef SVGA_SIMD_SSE2
+static inline void
+store_sse2(uint32_t **p, __m128i val, int dbl)
+{
+    if (dbl) {
+        _mm_storeu_si128((__m128i *) *p, _mm_unpacklo_epi32(val, val));
+        _mm_storeu_si128((__m128i *) (*p + 4), _mm_unpackhi_epi32(val, val));
+        *p += 8;
+    } else {
+        _mm_storeu_si128((__m128i *) *p, val);
+        *p += 4;
+    }
+}
+
+/*Expands 8 RGB555/565 pixels, with each channel already shifted up so that
+  a high multiply by the 1053 and 4145 factors above yields 0..255*/
+static inline void
+rgb16_sse2(uint32_t **p, __m128i b, __m128i g, __m128i r, __m128i gmul, int dbl)
+{
+    const __m128i mul5  = _mm_set1_epi16(1053);
+    const __m128i alpha = _mm_set1_epi16((short) 0xff00);
+    __m128i       bg;
+    __m128i       ra;
+
+    b  = _mm_mulhi_epu16(b, mul5);
+    g  = _mm_mulhi_epu16(g, gmul);
+    r  = _mm_mulhi_epu16(r, mul5);
+    bg = _mm_or_si128(b, _mm_slli_epi16(g, 8));
+    ra = _mm_or_si128(r, alpha);
+
+    store_sse2(p, _mm_unpacklo_epi16(bg, ra), dbl);
+    store_sse2(p, _mm_unpackhi_epi16(bg, ra), dbl);
+}
+
+static void
+rgb555_sse2(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    const __m128i mul5 = _mm_set1_epi16(1053);
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *) &src[x << 1]);
+
+        rgb16_sse2(&p,
+                   _mm_slli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x001f)), 9),
+                   _mm_slli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x03e0)), 4),
+                   _mm_srli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x7c00)), 1),
+                   mul5, dbl);
+    }
+
+    rgb555_c(p, &src[x << 1], count - x, dbl);
+}
+
+static void
+rgb565_sse2(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    const __m128i mul6 = _mm_set1_epi16(4145);
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *) &src[x << 1]);
+
+        rgb16_sse2(&p,
+                   _mm_slli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x001f)), 9),
+                   _mm_slli_epi16(_mm_and_si128(c, _mm_set1_epi16(0x07e0)), 1),
+                   _mm_srli_epi16(_mm_and_si128(c, _mm_set1_epi16((short) 0xf800)), 2),
+                   mul6, dbl);
+    }
+
+    rgb565_c(p, &src[x << 1], count - x, dbl);
+}
+#endif
+
+#ifdef SVGA_SIMD_X86_RUNTIME
+__attribute__((target("ssse3"))) static void
+rgb888_ssse3(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    const __m128i shuf = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    int           x;
+
+    /*Each 16 byte load only uses 12 bytes; stop early enough not to read
+      past the end of the span*/
+    for (x = 0; x <= (count - 6); x += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i *) &src[x * 3]);
+
+        store_sse2(&p, _mm_shuffle_epi8(c, shuf), dbl);
+    }
+
+    rgb888_c(p, &src[x * 3], count - x, dbl);
+}
+
+__attribute__((target("avx2"))) static void
+pal8_avx2(uint32_t *p, const uint8_t *src, const uint32_t *pal, uint8_t mask, int count, int dbl)
+{
+    const __m256i vmask = _mm256_set1_epi32(mask);
+    int           x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        __m128i idx = _mm_loadl_epi64((const __m128i *) &src[x]);
+        __m256i val = _mm256_i32gather_epi32((const int *) pal, _mm256_and_si256(_mm256_cvtepu8_epi32(idx), vmask), 4);
+
+        if (dbl) {
+            __m256i lo = _mm256_unpacklo_epi32(val, val);
+            __m256i hi = _mm256_unpackhi_epi32(val, val);
+
+            _mm256_storeu_si256((__m256i *) p, _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256((__m256i *) (p + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+            p += 16;
+        } else {
+            _mm256_storeu_si256((__m256i *) p, val);
+            p += 8;
+        }
+    }
+
+    pal8_c(p, &src[x], pal, mask, count - x, dbl);
+}
+#endif
+
+#ifdef SVGA_SIMD_NEON
+static inline void
+store_neon(uint32_t **p, uint32x4_t val, int dbl)
+{
+    if (dbl) {
+        uint32x4x2_t d = { { val, val } };
+
+        vst2q_u32(*p, d);
+        *p += 8;
+    } else {
+        vst1q_u32(*p, val);
+        *p += 4;
+    }
+}
+
+/*vqdmulh doubles the product, so channels are shifted up one bit less
+  than in the SSE2 version*/
+static inline void
+rgb16_neon(uint32_t **p, int16x8_t b, int16x8_t g, int16x8_t r, int16_t gmul, int dbl)
+{
+    uint16x8_t bg;
+    uint16x8_t ra;
+
+    b  = vqdmulhq_n_s16(b, 1053);
+    g  = vqdmulhq_n_s16(g, gmul);
+    r  = vqdmulhq_n_s16(r, 1053);
+    bg = vorrq_u16(vreinterpretq_u16_s16(b), vshlq_n_u16(vreinterpretq_u16_s16(g), 8));
+    ra = vorrq_u16(vreinterpretq_u16_s16(r), vdupq_n_u16(0xff00));
+
+    store_neon(p, vreinterpretq_u32_u16(vzip1q_u16(bg, ra)), dbl);
+    store_neon(p, vreinterpretq_u32_u16(vzip2q_u16(bg, ra)), dbl);
+}
+
+static void
+rgb555_neon(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    int x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        uint16x8_t c = vld1q_u16((const uint16_t *) &src[x << 1]);
+
+        rgb16_neon(&p,
+                   vreinterpretq_s16_u16(vshlq_n_u16(vandq_u16(c, vdupq_n_u16(0x001f)), 8)),
+                   vreinterpretq_s16_u16(vshlq_n_u16(vandq_u16(c, vdupq_n_u16(0x03e0)), 3)),
+                   vreinterpretq_s16_u16(vshrq_n_u16(vandq_u16(c, vdupq_n_u16(0x7c00)), 2)),
+                   1053, dbl);
+    }
+
+    rgb555_c(p, &src[x << 1], count - x, dbl);
+}
+
+static void
+rgb565_neon(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    int x;
+
+    for (x = 0; x <= (count - 8); x += 8) {
+        uint16x8_t c = vld1q_u16((const uint16_t *) &src[x << 1]);
+
+        rgb16_neon(&p,
+                   vreinterpretq_s16_u16(vshlq_n_u16(vandq_u16(c, vdupq_n_u16(0x001f)), 8)),
+                   vreinterpretq_s16_u16(vandq_u16(c, vdupq_n_u16(0x07e0))),
+                   vreinterpretq_s16_u16(vshrq_n_u16(vandq_u16(c, vdupq_n_u16(0xf800)), 3)),
+                   4145, dbl);
+    }
+
+    rgb565_c(p, &src[x << 1], count - x, dbl);
+}
+
+static void
+rgb888_neon(uint32_t *p, const uint8_t *src, int count, int dbl)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    int              x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        uint8x16x3_t c  = vld3q_u8(&src[x * 3]);
+        uint16x8_t   bg = vreinterpretq_u16_u8(vzip1q_u8(c.val[0], c.val[1]));
+        uint16x8_t   ra = vreinterpretq_u16_u8(vzip1q_u8(c.val[2], zero));
+
+        store_neon(&p, vreinterpretq_u32_u16(vzip1q_u16(bg, ra)), dbl);
+        store_neon(&p, vreinterpretq_u32_u16(vzip2q_u16(bg, ra)), dbl);
+
+        bg = vreinterpretq_u16_u8(vzip2q_u8(c.val[0], c.val[1]));
+        ra = vreinterpretq_u16_u8(vzip2q_u8(c.val[2], zero));
+
+        store_neon(&p, vreinterpretq_u32_u16(vzip1q_u16(bg, ra)), dbl);
+        store_neon(&p, vreinterpretq_u32_u16(vzip2q_u16(bg, ra)), dbl);
+    }
+
+    rgb888_c(p, &src[x * 3], count - x, dbl);
+}
+#endif
+
+svga_render_kernels_t svga_render_kernels = {
+    .pal8   = pal8_c,
+    .rgb555 = rgb555_c,
+    .rgb565 = rgb565_c,
+    .rgb888 = rgb888_c
+};
+
+void
+svga_render_kernels_init(void)
+{
+#if defined(SVGA_SIMD_SSE2)
+    svga_render_kernels.rgb555 = rgb555_sse2;
+    svga_render_kernels.rgb565 = rgb565_sse2;
+#    ifdef SVGA_SIMD_X86_RUNTIME
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        svga_render_kernels.rgb888 = rgb888_ssse3;
+    if (__builtin_cpu_supports("avx2"))
+        svga_render_kernels.pal8 = pal8_avx2;
+#    endif
+#elif defined(SVGA_SIMD_NEON)
+    svga_render_kernels.rgb555 = rgb555_neon;
+    svga_render_kernels.rgb565 = rgb565_neon;
+    svga_render_kernels.rgb888 = rgb888_neon;
+#endif
+}
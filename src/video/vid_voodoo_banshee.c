@@ -41,6 +41,7 @@
 #include <86box/vid_ddc.h>
 #include <86box/vid_xga.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_svga_render.h>
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_display.h>
@@ -1128,7 +1129,7 @@ banshee_status(banshee_t *banshee)
     int           fifo_entries = FIFO_ENTRIES;
     int           swap_count   = voodoo->swap_count;
     int           written      = voodoo->cmd_written + voodoo->cmd_written_fifo;
-    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || (voodoo->cmdfifo_depth_rd_2 != voodoo->cmdfifo_depth_wr_2) || voodoo->render_voodoo_busy[0] || voodoo->render_voodoo_busy[1] || voodoo->render_voodoo_busy[2] || voodoo->render_voodoo_busy[3] || voodoo->voodoo_busy;
+    int           busy         = (written - voodoo->cmd_read) || (voodoo->cmdfifo_depth_rd != voodoo->cmdfifo_depth_wr) || (voodoo->cmdfifo_depth_rd_2 != voodoo->cmdfifo_depth_wr_2) || voodoo_render_active(voodoo) || voodoo->voodoo_busy;
     uint32_t      ret          = 0;
 
     if (fifo_entries < 0x20)
@@ -3051,6 +3052,7 @@ banshee_vsync_callback(svga_t *svga)
             voodoo->swap_count--;
         voodoo->swap_pending = 0;
         thread_release_mutex(voodoo->swap_mutex);
+        video_stats_end(VIDEO_STAT_VOODOO_SWAP, voodoo->swap_stats_start);
 
         memset(voodoo->dirty_line, 1, sizeof(voodoo->dirty_line));
         voodoo->retrace_count = 0;
@@ -3506,6 +3508,7 @@ banshee_init_common(const device_t *info, char *fn, int has_sgram, int type, int
     banshee->voodoo->cmd_status   = (1 << 28);
     banshee->voodoo->cmd_status_2 = (1 << 28);
     voodoo_generate_filter_v1(banshee->voodoo);
+    voodoo_texture_cache_init(banshee->voodoo);
 
     banshee->vidSerialParallelPort = VIDSERIAL_DDC_DCK_W | VIDSERIAL_DDC_DDA_W;
 
@@ -3884,14 +3887,17 @@ static const device_config_t banshee_sgram_config[] = {
         .description    = "Render threads",
         .type           = CONFIG_SELECTION,
         .default_string = NULL,
-        .default_int    = 2,
+        .default_int    = 0,
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "Auto", .value = 0 },
+            { .description = "1",    .value = 1 },
+            { .description = "2",    .value = 2 },
+            { .description = "4",    .value = 4 },
+            { .description = "8",    .value = 8 },
+            { .description = "16",   .value = 16 },
+            { .description = ""                 }
         },
         .bios           = { { 0 } }
     },
@@ -3961,14 +3967,17 @@ static const device_config_t banshee_sgram_16mbonly_config[] = {
         .description    = "Render threads",
         .type           = CONFIG_SELECTION,
         .default_string = NULL,
-        .default_int    = 2,
+        .default_int    = 0,
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "Auto", .value = 0 },
+            { .description = "1",    .value = 1 },
+            { .description = "2",    .value = 2 },
+            { .description = "4",    .value = 4 },
+            { .description = "8",    .value = 8 },
+            { .description = "16",   .value = 16 },
+            { .description = ""                 }
         },
         .bios           = { { 0 } }
     },
@@ -4038,14 +4047,17 @@ static const device_config_t banshee_sdram_config[] = {
         .description    = "Render threads",
         .type           = CONFIG_SELECTION,
         .default_string = NULL,
-        .default_int    = 2,
+        .default_int    = 0,
         .file_filter    = NULL,
         .spinner        = { 0 },
         .selection      = {
-            { .description = "1", .value = 1 },
-            { .description = "2", .value = 2 },
-            { .description = "4", .value = 4 },
-            { .description = ""              }
+            { .description = "Auto", .value = 0 },
+            { .description = "1",    .value = 1 },
+            { .description = "2",    .value = 2 },
+            { .description = "4",    .value = 4 },
+            { .description = "8",    .value = 8 },
+            { .description = "16",   .value = 16 },
+            { .description = ""                 }
         },
         .bios           = { { 0 } }
     },
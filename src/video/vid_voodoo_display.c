@@ -33,8 +33,10 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_display.h>
+#include <86box/vid_voodoo_display_simd.h>
 #include <86box/vid_voodoo_regs.h>
 #include <86box/vid_voodoo_render.h>
 
@@ -135,17 +137,12 @@ voodoo_calc_clutData(voodoo_t *voodoo)
         voodoo->clutData256[c].b = (voodoo->clutData[c >> 3].b * (8 - (c & 7)) + voodoo->clutData[(c >> 3) + 1].b * (c & 7)) >> 3;
     }
 
-    for (c = 0; c < 65536; c++) {
-        int r = (c >> 8) & 0xf8;
-        int g = (c >> 3) & 0xfc;
-        int b = (c << 3) & 0xf8;
-#if 0
-        r |= (r >> 5);
-        g |= (g >> 6);
-        b |= (b >> 5);
-#endif
-        voodoo->video_16to32[c] = (voodoo->clutData256[r].r << 16) | (voodoo->clutData256[g].g << 8) | voodoo->clutData256[b].b;
+    for (c = 0; c < 32; c++) {
+        voodoo->clut_r5[c] = voodoo->clutData256[c << 3].r;
+        voodoo->clut_b5[c] = voodoo->clutData256[c << 3].b;
     }
+    for (c = 0; c < 64; c++)
+        voodoo->clut_g6[c] = voodoo->clutData256[c << 2].g;
 }
 
 #define FILTDIV 256
@@ -172,6 +169,10 @@ voodoo_generate_filter_v1(voodoo_t *voodoo)
     fcg = FILTCAPG * 6;
     fcb = FILTCAPB * 5;
 
+    voodoo->filter_cap[0] = FILTCAP;
+    voodoo->filter_cap[1] = FILTCAPG;
+    voodoo->filter_cap[2] = FILTCAPB;
+
     for (uint16_t g = 0; g < FILTDIV; g++) // pixel 1
     {
         for (uint16_t h = 0; h < FILTDIV; h++) // pixel 2
@@ -384,66 +385,40 @@ voodoo_threshold_check(voodoo_t *voodoo)
     }
 }
 
+/* The v1 tables reduce to thefilter[g][h] = g + (clamp(h - g, -cap, cap) >> 1),
+   so the passes run on planar channels through the display kernels rather
+   than through the 64 KB tables. */
 static void
-voodoo_filterline_v1(voodoo_t *voodoo, uint8_t *fil, int column, uint16_t *src, int line)
+voodoo_filterline_v1(voodoo_t *voodoo, uint32_t *p, int column, uint16_t *src, int line)
 {
+    uint8_t fil[3][4096];
     // Scratchpad for avoiding feedback streaks
-    uint8_t fil3[4096 * 3];
+    uint8_t fil3[3][4096];
 
     assert(voodoo->h_disp <= 4096);
-    /* 16 to 32-bit */
-    for (int x = 0; x < column; x++) {
-        fil[x * 3]     = ((src[x] & 31) << 3);
-        fil[x * 3 + 1] = (((src[x] >> 5) & 63) << 2);
-        fil[x * 3 + 2] = (((src[x] >> 11) & 31) << 3);
-
-        // Copy to our scratchpads
-        fil3[x * 3 + 0] = fil[x * 3 + 0];
-        fil3[x * 3 + 1] = fil[x * 3 + 1];
-        fil3[x * 3 + 2] = fil[x * 3 + 2];
-    }
-
-    /* lines */
-
-    if (line & 1) {
-        for (int x = 0; x < column; x++) {
-            fil[x * 3]     = voodoo->purpleline[fil[x * 3]][0];
-            fil[x * 3 + 1] = voodoo->purpleline[fil[x * 3 + 1]][1];
-            fil[x * 3 + 2] = voodoo->purpleline[fil[x * 3 + 2]][2];
-        }
-    }
+    /* 16 to 32-bit, with the purple line offset applied on odd lines */
+    voodoo_display_kernels.rgb565_planar(fil3[0], fil3[1], fil3[2], src, 0, column);
+    voodoo_display_kernels.rgb565_planar(fil[0], fil[1], fil[2], src, (line & 1) ? 4 : 0, column);
 
     /* filtering time */
+    for (int c = 0; c < 3; c++) {
+        int cap = voodoo->filter_cap[c];
 
-    for (int x = 1; x < column; x++) {
-        fil3[x * 3]     = voodoo->thefilterb[fil[x * 3]][fil[(x - 1) * 3]];
-        fil3[x * 3 + 1] = voodoo->thefilterg[fil[x * 3 + 1]][fil[(x - 1) * 3 + 1]];
-        fil3[x * 3 + 2] = voodoo->thefilter[fil[x * 3 + 2]][fil[(x - 1) * 3 + 2]];
+        voodoo_display_kernels.filter(fil3[c] + 1, fil[c] + 1, fil[c], cap, column - 1);
+        voodoo_display_kernels.filter(fil[c] + 1, fil3[c] + 1, fil3[c], cap, column - 1);
+        voodoo_display_kernels.filter(fil3[c] + 1, fil[c] + 1, fil[c], cap, column - 1);
+        voodoo_display_kernels.filter(fil[c], fil3[c], fil3[c] + 1, cap, column - 1);
     }
 
-    for (int x = 1; x < column; x++) {
-        fil[x * 3]     = voodoo->thefilterb[fil3[x * 3]][fil3[(x - 1) * 3]];
-        fil[x * 3 + 1] = voodoo->thefilterg[fil3[x * 3 + 1]][fil3[(x - 1) * 3 + 1]];
-        fil[x * 3 + 2] = voodoo->thefilter[fil3[x * 3 + 2]][fil3[(x - 1) * 3 + 2]];
-    }
-
-    for (int x = 1; x < column; x++) {
-        fil3[x * 3]     = voodoo->thefilterb[fil[x * 3]][fil[(x - 1) * 3]];
-        fil3[x * 3 + 1] = voodoo->thefilterg[fil[x * 3 + 1]][fil[(x - 1) * 3 + 1]];
-        fil3[x * 3 + 2] = voodoo->thefilter[fil[x * 3 + 2]][fil[(x - 1) * 3 + 2]];
-    }
-
-    for (int x = 0; x < column - 1; x++) {
-        fil[x * 3]     = voodoo->thefilterb[fil3[x * 3]][fil3[(x + 1) * 3]];
-        fil[x * 3 + 1] = voodoo->thefilterg[fil3[x * 3 + 1]][fil3[(x + 1) * 3 + 1]];
-        fil[x * 3 + 2] = voodoo->thefilter[fil3[x * 3 + 2]][fil3[(x + 1) * 3 + 2]];
-    }
+    for (int x = 0; x < column; x++)
+        p[x] = (voodoo->clutData256[fil[2][x]].b << 0 | voodoo->clutData256[fil[1][x]].g << 8 | voodoo->clutData256[fil[0][x]].r << 16);
 }
 
 static void
-voodoo_filterline_v2(voodoo_t *voodoo, uint8_t *fil, int column, uint16_t *src, UNUSED(int line))
+voodoo_filterline_v2(voodoo_t *voodoo, uint32_t *p, int column, uint16_t *src, UNUSED(int line))
 {
-    int x;
+    int     x;
+    uint8_t fil[4096 * 3]; /* interleaved 24-bit RGB */
 
     // Scratchpad for blending filter
     uint8_t fil3[4096 * 3];
@@ -502,6 +477,9 @@ voodoo_filterline_v2(voodoo_t *voodoo, uint8_t *fil, int column, uint16_t *src,
     fil3[(column - 1) * 3]     = voodoo->thefilterb[fil[(column - 1) * 3]][(src[column] & 31) << 3];
     fil3[(column - 1) * 3 + 1] = voodoo->thefilterg[fil[(column - 1) * 3 + 1]][((src[column] >> 5) & 63) << 2];
     fil3[(column - 1) * 3 + 2] = voodoo->thefilter[fil[(column - 1) * 3 + 2]][((src[column] >> 11) & 31) << 3];
+
+    for (x = 0; x < column; x++)
+        p[x] = (voodoo->clutData256[fil[x * 3]].b << 0 | voodoo->clutData256[fil[x * 3 + 1]].g << 8 | voodoo->clutData256[fil[x * 3 + 2]].r << 16);
 }
 
 void
@@ -552,22 +530,13 @@ voodoo_callback(void *priv)
                     monitor->target_buffer->line[voodoo->line + v_y_add][x] = 0x00000000;
 
                 if (voodoo->scrfilter && voodoo->scrfilterEnabled) {
-                    uint8_t fil[4096 * 3]; /* interleaved 24-bit RGB */
-
-                    assert(voodoo->h_disp <= 4096);
                     if (voodoo->type == VOODOO_2)
-                        voodoo_filterline_v2(voodoo, fil, voodoo->h_disp, src, voodoo->line);
+                        voodoo_filterline_v2(voodoo, p, voodoo->h_disp, src, voodoo->line);
                     else
-                        voodoo_filterline_v1(voodoo, fil, voodoo->h_disp, src, voodoo->line);
-
-                    for (x = 0; x < voodoo->h_disp; x++) {
-                        p[x] = (voodoo->clutData256[fil[x * 3]].b << 0 | voodoo->clutData256[fil[x * 3 + 1]].g << 8 | voodoo->clutData256[fil[x * 3 + 2]].r << 16);
-                    }
-                } else {
-                    for (x = 0; x < voodoo->h_disp; x++) {
-                        p[x] = draw_voodoo->video_16to32[src[x]];
-                    }
-                }
+                        voodoo_filterline_v1(voodoo, p, voodoo->h_disp, src, voodoo->line);
+                } else
+                    voodoo_display_kernels.rgb565_clut(p, src, draw_voodoo->clut_r5, draw_voodoo->clut_g6,
+                                                       draw_voodoo->clut_b5, voodoo->h_disp);
 
                 /* Draw right overscan. */
                 for (x = 0; x < v_x_add; x++)
@@ -595,6 +564,7 @@ skip_draw:
                     if (voodoo->swap_count > 0)
                         voodoo->swap_count--;
                     voodoo->swap_pending = 0;
+                    video_stats_end(VIDEO_STAT_VOODOO_SWAP, voodoo->swap_stats_start);
 
                     memset(voodoo_1->dirty_line, 1, 1024);
                     voodoo_1->retrace_count = 0;
@@ -620,6 +590,7 @@ skip_draw:
                     voodoo->swap_count--;
                 voodoo->swap_pending = 0;
                 thread_release_mutex(voodoo->swap_mutex);
+                video_stats_end(VIDEO_STAT_VOODOO_SWAP, voodoo->swap_stats_start);
 
                 memset(voodoo->dirty_line, 1, 1024);
                 voodoo->retrace_count = 0;
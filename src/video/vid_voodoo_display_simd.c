@@ -0,0 +1,325 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Vectorised scanout kernels for the Voodoo display.
+ *
+ *          The portable kernels are always available; SSE2 is used on
+ *          every x86-64 host, SSSE3 is picked at runtime when the host
+ *          supports it, and NEON is used on ARM64.
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <86box/86box.h>
+#include <86box/vid_voodoo_display_simd.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define VOODOO_SIMD_SSE2
+#    include <immintrin.h>
+#    if defined(__GNUC__) || defined(__clang__)
+#        define VOODOO_SIMD_X86_RUNTIME
+#    endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#    define VOODOO_SIMD_NEON
+#    include <arm_neon.h>
+#endif
+
+static void
+rgb565_clut_c(uint32_t *p, const uint16_t *src, const uint8_t *clut_r,
+              const uint8_t *clut_g, const uint8_t *clut_b, int count)
+{
+    for (int x = 0; x < count; x++) {
+        uint16_t c = src[x];
+
+        p[x] = (clut_r[c >> 11] << 16) | (clut_g[(c >> 5) & 0x3f] << 8) | clut_b[c & 0x1f];
+    }
+}
+
+static void
+rgb565_planar_c(uint8_t *r, uint8_t *g, uint8_t *b, const uint16_t *src, uint8_t add_rb, int count)
+{
+    /*Red and blue top out at 0xf8, so adding the purple line offset can
+      not overflow*/
+    for (int x = 0; x < count; x++) {
+        uint16_t c = src[x];
+
+        b[x] = ((c & 0x1f) << 3) + add_rb;
+        g[x] = ((c >> 5) & 0x3f) << 2;
+        r[x] = ((c >> 11) << 3) + add_rb;
+    }
+}
+
+static void
+filter_c(uint8_t *dst, const uint8_t *src, const uint8_t *nb, int cap, int count)
+{
+    for (int x = 0; x < count; x++) {
+        int diff = nb[x] - src[x];
+
+        if (diff > cap)
+            diff = cap;
+        else if (diff < -cap)
+            diff = -cap;
+
+        dst[x] = src[x] + (diff >> 1);
+    }
+}
+
+#ifdef VOODOO_SIMD_SSE2
+static void
+rgb565_planar_sse2(uint8_t *r, uint8_t *g, uint8_t *b, const uint16_t *src, uint8_t add_rb, int count)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i add   = _mm_set1_epi8(add_rb);
+    int           x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        __m128i c0 = _mm_loadu_si128((const __m128i *) &src[x]);
+        __m128i c1 = _mm_loadu_si128((const __m128i *) &src[x + 8]);
+        __m128i vb = _mm_packus_epi16(_mm_slli_epi16(_mm_and_si128(c0, mask5), 3),
+                                      _mm_slli_epi16(_mm_and_si128(c1, mask5), 3));
+        __m128i vg = _mm_packus_epi16(_mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(c0, 5), mask6), 2),
+                                      _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(c1, 5), mask6), 2));
+        __m128i vr = _mm_packus_epi16(_mm_slli_epi16(_mm_srli_epi16(c0, 11), 3),
+                                      _mm_slli_epi16(_mm_srli_epi16(c1, 11), 3));
+
+        _mm_storeu_si128((__m128i *) &b[x], _mm_add_epi8(vb, add));
+        _mm_storeu_si128((__m128i *) &g[x], vg);
+        _mm_storeu_si128((__m128i *) &r[x], _mm_add_epi8(vr, add));
+    }
+
+    rgb565_planar_c(&r[x], &g[x], &b[x], &src[x], add_rb, count - x);
+}
+
+/*Filters 8 pixels widened to 16 bits; the result always fits in 0..255*/
+static inline __m128i
+filter8_sse2(__m128i s, __m128i n, __m128i cap, __m128i ncap)
+{
+    __m128i diff = _mm_sub_epi16(n, s);
+
+    diff = _mm_min_epi16(_mm_max_epi16(diff, ncap), cap);
+
+    return _mm_add_epi16(s, _mm_srai_epi16(diff, 1));
+}
+
+static void
+filter_sse2(uint8_t *dst, const uint8_t *src, const uint8_t *nb, int cap, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vcap = _mm_set1_epi16(cap);
+    const __m128i ncap = _mm_set1_epi16(-cap);
+    int           x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        __m128i s  = _mm_loadu_si128((const __m128i *) &src[x]);
+        __m128i n  = _mm_loadu_si128((const __m128i *) &nb[x]);
+        __m128i lo = filter8_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(n, zero), vcap, ncap);
+        __m128i hi = filter8_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(n, zero), vcap, ncap);
+
+        _mm_storeu_si128((__m128i *) &dst[x], _mm_packus_epi16(lo, hi));
+    }
+
+    filter_c(&dst[x], &src[x], &nb[x], cap, count - x);
+}
+#endif
+
+#ifdef VOODOO_SIMD_X86_RUNTIME
+__attribute__((target("ssse3"))) static inline __m128i
+select_ssse3(__m128i a, __m128i b, __m128i mask)
+{
+    return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b));
+}
+
+/*Looks up 16 indices below 32 in a 32 byte table. pshufb only uses the low
+  four bits of each index, so both halves are looked up and bit 4 picks one*/
+__attribute__((target("ssse3"))) static inline __m128i
+lut32_ssse3(const __m128i *tab, __m128i idx)
+{
+    const __m128i bit4 = _mm_set1_epi8(0x10);
+
+    return select_ssse3(_mm_shuffle_epi8(tab[0], idx), _mm_shuffle_epi8(tab[1], idx),
+                        _mm_cmpeq_epi8(_mm_and_si128(idx, bit4), bit4));
+}
+
+__attribute__((target("ssse3"))) static inline __m128i
+lut64_ssse3(const __m128i *tab, __m128i idx)
+{
+    const __m128i bit5 = _mm_set1_epi8(0x20);
+
+    return select_ssse3(lut32_ssse3(&tab[0], idx), lut32_ssse3(&tab[2], idx),
+                        _mm_cmpeq_epi8(_mm_and_si128(idx, bit5), bit5));
+}
+
+__attribute__((target("ssse3"))) static void
+rgb565_clut_ssse3(uint32_t *p, const uint16_t *src, const uint8_t *clut_r,
+                  const uint8_t *clut_g, const uint8_t *clut_b, int count)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1f);
+    const __m128i mask6 = _mm_set1_epi16(0x3f);
+    const __m128i zero  = _mm_setzero_si128();
+    __m128i       tab_r[2];
+    __m128i       tab_g[4];
+    __m128i       tab_b[2];
+    int           x;
+
+    for (int k = 0; k < 2; k++) {
+        tab_r[k] = _mm_loadu_si128((const __m128i *) &clut_r[k << 4]);
+        tab_b[k] = _mm_loadu_si128((const __m128i *) &clut_b[k << 4]);
+    }
+    for (int k = 0; k < 4; k++)
+        tab_g[k] = _mm_loadu_si128((const __m128i *) &clut_g[k << 4]);
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        __m128i c0 = _mm_loadu_si128((const __m128i *) &src[x]);
+        __m128i c1 = _mm_loadu_si128((const __m128i *) &src[x + 8]);
+        __m128i vb = _mm_packus_epi16(_mm_and_si128(c0, mask5), _mm_and_si128(c1, mask5));
+        __m128i vg = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(c0, 5), mask6),
+                                      _mm_and_si128(_mm_srli_epi16(c1, 5), mask6));
+        __m128i vr = _mm_packus_epi16(_mm_srli_epi16(c0, 11), _mm_srli_epi16(c1, 11));
+        __m128i bg;
+        __m128i r0;
+
+        vb = lut32_ssse3(tab_b, vb);
+        vg = lut64_ssse3(tab_g, vg);
+        vr = lut32_ssse3(tab_r, vr);
+
+        bg = _mm_unpacklo_epi8(vb, vg);
+        r0 = _mm_unpacklo_epi8(vr, zero);
+        _mm_storeu_si128((__m128i *) &p[x], _mm_unpacklo_epi16(bg, r0));
+        _mm_storeu_si128((__m128i *) &p[x + 4], _mm_unpackhi_epi16(bg, r0));
+
+        bg = _mm_unpackhi_epi8(vb, vg);
+        r0 = _mm_unpackhi_epi8(vr, zero);
+        _mm_storeu_si128((__m128i *) &p[x + 8], _mm_unpacklo_epi16(bg, r0));
+        _mm_storeu_si128((__m128i *) &p[x + 12], _mm_unpackhi_epi16(bg, r0));
+    }
+
+    rgb565_clut_c(&p[x], &src[x], clut_r, clut_g, clut_b, count - x);
+}
+#endif
+
+#ifdef VOODOO_SIMD_NEON
+static void
+rgb565_clut_neon(uint32_t *p, const uint16_t *src, const uint8_t *clut_r,
+                 const uint8_t *clut_g, const uint8_t *clut_b, int count)
+{
+    const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+    uint8x16x2_t     tab_r;
+    uint8x16x4_t     tab_g;
+    uint8x16x2_t     tab_b;
+    int              x;
+
+    for (int k = 0; k < 2; k++) {
+        tab_r.val[k] = vld1q_u8(&clut_r[k << 4]);
+        tab_b.val[k] = vld1q_u8(&clut_b[k << 4]);
+    }
+    for (int k = 0; k < 4; k++)
+        tab_g.val[k] = vld1q_u8(&clut_g[k << 4]);
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        uint16x8_t  c0 = vld1q_u16(&src[x]);
+        uint16x8_t  c1 = vld1q_u16(&src[x + 8]);
+        uint8x16x4_t px;
+
+        px.val[0] = vqtbl2q_u8(tab_b, vcombine_u8(vmovn_u16(vandq_u16(c0, mask5)),
+                                                  vmovn_u16(vandq_u16(c1, mask5))));
+        px.val[1] = vqtbl4q_u8(tab_g, vcombine_u8(vmovn_u16(vandq_u16(vshrq_n_u16(c0, 5), mask6)),
+                                                  vmovn_u16(vandq_u16(vshrq_n_u16(c1, 5), mask6))));
+        px.val[2] = vqtbl2q_u8(tab_r, vcombine_u8(vmovn_u16(vshrq_n_u16(c0, 11)),
+                                                  vmovn_u16(vshrq_n_u16(c1, 11))));
+        px.val[3] = vdupq_n_u8(0);
+
+        vst4q_u8((uint8_t *) &p[x], px);
+    }
+
+    rgb565_clut_c(&p[x], &src[x], clut_r, clut_g, clut_b, count - x);
+}
+
+static void
+rgb565_planar_neon(uint8_t *r, uint8_t *g, uint8_t *b, const uint16_t *src, uint8_t add_rb, int count)
+{
+    const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+    const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+    const uint8x16_t add   = vdupq_n_u8(add_rb);
+    int              x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        uint16x8_t c0 = vld1q_u16(&src[x]);
+        uint16x8_t c1 = vld1q_u16(&src[x + 8]);
+        uint8x16_t vb = vcombine_u8(vmovn_u16(vshlq_n_u16(vandq_u16(c0, mask5), 3)),
+                                    vmovn_u16(vshlq_n_u16(vandq_u16(c1, mask5), 3)));
+        uint8x16_t vg = vcombine_u8(vmovn_u16(vshlq_n_u16(vandq_u16(vshrq_n_u16(c0, 5), mask6), 2)),
+                                    vmovn_u16(vshlq_n_u16(vandq_u16(vshrq_n_u16(c1, 5), mask6), 2)));
+        uint8x16_t vr = vcombine_u8(vmovn_u16(vshlq_n_u16(vshrq_n_u16(c0, 11), 3)),
+                                    vmovn_u16(vshlq_n_u16(vshrq_n_u16(c1, 11), 3)));
+
+        vst1q_u8(&b[x], vaddq_u8(vb, add));
+        vst1q_u8(&g[x], vg);
+        vst1q_u8(&r[x], vaddq_u8(vr, add));
+    }
+
+    rgb565_planar_c(&r[x], &g[x], &b[x], &src[x], add_rb, count - x);
+}
+
+static inline uint8x8_t
+filter8_neon(uint8x8_t s, uint8x8_t n, int16x8_t cap, int16x8_t ncap)
+{
+    int16x8_t diff = vreinterpretq_s16_u16(vsubl_u8(n, s));
+
+    diff = vminq_s16(vmaxq_s16(diff, ncap), cap);
+
+    return vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(s)), vshrq_n_s16(diff, 1)));
+}
+
+static void
+filter_neon(uint8_t *dst, const uint8_t *src, const uint8_t *nb, int cap, int count)
+{
+    const int16x8_t vcap = vdupq_n_s16(cap);
+    const int16x8_t ncap = vdupq_n_s16(-cap);
+    int             x;
+
+    for (x = 0; x <= (count - 16); x += 16) {
+        uint8x16_t s = vld1q_u8(&src[x]);
+        uint8x16_t n = vld1q_u8(&nb[x]);
+
+        vst1q_u8(&dst[x], vcombine_u8(filter8_neon(vget_low_u8(s), vget_low_u8(n), vcap, ncap),
+                                      filter8_neon(vget_high_u8(s), vget_high_u8(n), vcap, ncap)));
+    }
+
+    filter_c(&dst[x], &src[x], &nb[x], cap, count - x);
+}
+#endif
+
+voodoo_display_kernels_t voodoo_display_kernels = {
+    .rgb565_clut   = rgb565_clut_c,
+    .rgb565_planar = rgb565_planar_c,
+    .filter        = filter_c
+};
+
+void
+voodoo_display_kernels_init(void)
+{
+#if defined(VOODOO_SIMD_SSE2)
+    voodoo_display_kernels.rgb565_planar = rgb565_planar_sse2;
+    voodoo_display_kernels.filter        = filter_sse2;
+#    ifdef VOODOO_SIMD_X86_RUNTIME
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        voodoo_display_kernels.rgb565_clut = rgb565_clut_ssse3;
+#    endif
+#elif defined(VOODOO_SIMD_NEON)
+    voodoo_display_kernels.rgb565_clut   = rgb565_clut_neon;
+    voodoo_display_kernels.rgb565_planar = rgb565_planar_neon;
+    voodoo_display_kernels.filter        = filter_neon;
+#endif
+}
@@ -32,6 +32,7 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_banshee.h>
 #include <86box/vid_voodoo_banshee_blitter.h>
@@ -278,6 +279,7 @@ voodoo_wait_for_swap_complete(voodoo_t *voodoo)
                 voodoo->swap_count--;
             voodoo->swap_pending = 0;
             thread_release_mutex(voodoo->swap_mutex);
+            video_stats_end(VIDEO_STAT_VOODOO_SWAP, voodoo->swap_stats_start);
             break;
         } else
             thread_release_mutex(voodoo->swap_mutex);
@@ -388,6 +390,9 @@ voodoo_fifo_thread(void *param)
         thread_wait_event(voodoo->wake_fifo_thread, -1);
         thread_reset_event(voodoo->wake_fifo_thread);
         voodoo->voodoo_busy = 1;
+
+        uint64_t stats_start = video_stats_begin(VIDEO_STAT_VOODOO_FIFO);
+
         while (!FIFO_EMPTY) {
             uint64_t      start_time = plat_timer_read();
             uint64_t      end_time;
@@ -1062,6 +1067,7 @@ voodoo_fifo_thread(void *param)
             voodoo->time += end_time - start_time;
         }
 
+        video_stats_end(VIDEO_STAT_VOODOO_FIFO, stats_start);
         voodoo->voodoo_busy = 0;
     }
 }
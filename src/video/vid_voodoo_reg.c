@@ -32,6 +32,7 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_banshee.h>
 #include <86box/vid_voodoo_blitter.h>
@@ -112,13 +113,15 @@ voodoo_reg_writel(uint32_t addr, uint32_t val, void *priv)
                 } else if (TRIPLE_BUFFER) {
                     if (voodoo->swap_pending)
                         voodoo_wait_for_swap_complete(voodoo);
-                    voodoo->swap_interval = (val >> 1) & 0xff;
-                    voodoo->swap_offset   = voodoo->leftOverlayBuf;
-                    voodoo->swap_pending  = 1;
+                    voodoo->swap_interval    = (val >> 1) & 0xff;
+                    voodoo->swap_offset      = voodoo->leftOverlayBuf;
+                    voodoo->swap_stats_start = video_stats_begin(VIDEO_STAT_VOODOO_SWAP);
+                    voodoo->swap_pending     = 1;
                 } else {
-                    voodoo->swap_interval = (val >> 1) & 0xff;
-                    voodoo->swap_offset   = voodoo->leftOverlayBuf;
-                    voodoo->swap_pending  = 1;
+                    voodoo->swap_interval    = (val >> 1) & 0xff;
+                    voodoo->swap_offset      = voodoo->leftOverlayBuf;
+                    voodoo->swap_stats_start = video_stats_begin(VIDEO_STAT_VOODOO_SWAP);
+                    voodoo->swap_pending     = 1;
 
                     voodoo_wait_for_swap_complete(voodoo);
                 }
@@ -154,13 +157,15 @@ voodoo_reg_writel(uint32_t addr, uint32_t val, void *priv)
                 if (voodoo->swap_pending)
                     voodoo_wait_for_swap_complete(voodoo);
 
-                voodoo->swap_interval = (val >> 1) & 0xff;
-                voodoo->swap_offset   = voodoo->params.front_offset;
-                voodoo->swap_pending  = 1;
+                voodoo->swap_interval    = (val >> 1) & 0xff;
+                voodoo->swap_offset      = voodoo->params.front_offset;
+                voodoo->swap_stats_start = video_stats_begin(VIDEO_STAT_VOODOO_SWAP);
+                voodoo->swap_pending     = 1;
             } else {
-                voodoo->swap_interval = (val >> 1) & 0xff;
-                voodoo->swap_offset   = voodoo->params.front_offset;
-                voodoo->swap_pending  = 1;
+                voodoo->swap_interval    = (val >> 1) & 0xff;
+                voodoo->swap_offset      = voodoo->params.front_offset;
+                voodoo->swap_stats_start = video_stats_begin(VIDEO_STAT_VOODOO_SWAP);
+                voodoo->swap_pending     = 1;
 
                 voodoo_wait_for_swap_complete(voodoo);
             }
@@ -32,6 +32,7 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
 #include <86box/vid_voodoo_common.h>
 #include <86box/vid_voodoo_dither.h>
 #include <86box/vid_voodoo_regs.h>
@@ -657,8 +658,16 @@ voodoo_tmu_fetch_and_blend(voodoo_t *voodoo, voodoo_params_t *params, voodoo_sta
 
 #if (defined __amd64__ || defined _M_X64)
 #    include <86box/vid_voodoo_codegen_x86-64.h>
+#elif (defined __aarch64__ || defined _M_ARM64)
+#    include <86box/vid_voodoo_codegen_arm64.h>
 #else
-int voodoo_recomp = 0;
+void
+voodoo_codegen_stats(UNUSED(voodoo_t *voodoo), int *recomp, uint64_t *hits, int *evict)
+{
+    *recomp = 0;
+    *hits   = 0;
+    *evict  = 0;
+}
 #endif
 
 static void
@@ -827,11 +836,13 @@ voodoo_half_triangle(voodoo_t *voodoo, voodoo_params_t *params, voodoo_state_t *
         else
             real_y >>= 4;
 
+        /*Lines are interleaved between render threads, so each pixel is
+          always drawn by the same thread and triangle order is kept*/
         if (SLI_ENABLED) {
-            if (((real_y >> 1) & voodoo->odd_even_mask) != odd_even)
+            if (((uint32_t) (real_y >> 1) % voodoo->render_threads) != odd_even)
                 goto next_line;
         } else {
-            if ((real_y & voodoo->odd_even_mask) != odd_even)
+            if (((uint32_t) real_y % voodoo->render_threads) != odd_even)
                 goto next_line;
         }
 
@@ -1583,17 +1594,24 @@ voodoo_render_log("voodoo_triangle %i %i %i : vA %f, %f  vB %f, %f  vC %f, %f f
     voodoo_half_triangle(voodoo, params, &state, vertexAy_adjusted, vertexCy_adjusted, odd_even);
 }
 
-static void
-render_thread(void *param, int odd_even)
+void
+voodoo_render_thread(void *param)
 {
-    voodoo_t *voodoo = (voodoo_t *) param;
+    voodoo_render_thread_param_t *thread_param = (voodoo_render_thread_param_t *) param;
+    voodoo_t                     *voodoo       = thread_param->voodoo;
+    int                           odd_even     = thread_param->odd_even;
 
     while (voodoo->render_thread_run[odd_even]) {
+        uint64_t idle_start = plat_timer_read();
+
         thread_set_event(voodoo->render_not_full_event[odd_even]);
         thread_wait_event(voodoo->wake_render_thread[odd_even], -1);
         thread_reset_event(voodoo->wake_render_thread[odd_even]);
+        voodoo->render_idle_time[odd_even] += plat_timer_read() - idle_start;
         voodoo->render_voodoo_busy[odd_even] = 1;
 
+        uint64_t stats_start = video_stats_begin(VIDEO_STAT_VOODOO_RENDER);
+
         while (!PARAM_EMPTY(odd_even)) {
             uint64_t         start_time = plat_timer_read();
             uint64_t         end_time;
@@ -1610,52 +1628,22 @@ render_thread(void *param, int odd_even)
             voodoo->render_time[odd_even] += end_time - start_time;
         }
 
+        video_stats_end(VIDEO_STAT_VOODOO_RENDER, stats_start);
         voodoo->render_voodoo_busy[odd_even] = 0;
     }
 }
 
-void
-voodoo_render_thread_1(void *param)
-{
-    render_thread(param, 0);
-}
-void
-voodoo_render_thread_2(void *param)
-{
-    render_thread(param, 1);
-}
-void
-voodoo_render_thread_3(void *param)
-{
-    render_thread(param, 2);
-}
-void
-voodoo_render_thread_4(void *param)
-{
-    render_thread(param, 3);
-}
-
 void
 voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 {
     voodoo_params_t *params_new = &voodoo->params_buffer[voodoo->params_write_idx & PARAM_MASK];
 
-    while (PARAM_FULL(0) || (voodoo->render_threads >= 2 && PARAM_FULL(1)) || (voodoo->render_threads == 4 && (PARAM_FULL(2) || PARAM_FULL(3)))) {
-        thread_reset_event(voodoo->render_not_full_event[0]);
-        if (voodoo->render_threads >= 2)
-            thread_reset_event(voodoo->render_not_full_event[1]);
-        if (voodoo->render_threads == 4) {
-            thread_reset_event(voodoo->render_not_full_event[2]);
-            thread_reset_event(voodoo->render_not_full_event[3]);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        while (PARAM_FULL(c)) {
+            thread_reset_event(voodoo->render_not_full_event[c]);
+            if (PARAM_FULL(c))
+                thread_wait_event(voodoo->render_not_full_event[c], -1); /*Wait for room in ringbuffer*/
         }
-        if (PARAM_FULL(0))
-            thread_wait_event(voodoo->render_not_full_event[0], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads >= 2 && PARAM_FULL(1))
-            thread_wait_event(voodoo->render_not_full_event[1], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(2))
-            thread_wait_event(voodoo->render_not_full_event[2], -1); /*Wait for room in ringbuffer*/
-        if (voodoo->render_threads == 4 && PARAM_FULL(3))
-            thread_wait_event(voodoo->render_not_full_event[3], -1); /*Wait for room in ringbuffer*/
     }
 
     voodoo_use_texture(voodoo, params, 0);
@@ -1666,6 +1654,10 @@ voodoo_queue_triangle(voodoo_t *voodoo, voodoo_params_t *params)
 
     voodoo->params_write_idx++;
 
-    if (PARAM_ENTRIES(0) < 4 || (voodoo->render_threads >= 2 && PARAM_ENTRIES(1) < 4) || (voodoo->render_threads == 4 && (PARAM_ENTRIES(2) < 4 || PARAM_ENTRIES(3) < 4)))
-        voodoo_wake_render_thread(voodoo);
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (PARAM_ENTRIES(c) < 4) {
+            voodoo_wake_render_thread(voodoo);
+            break;
+        }
+    }
 }
@@ -237,306 +237,445 @@ voodoo_recalc_tex3(voodoo_t *voodoo, int tmu)
 
 #define makergba(r, g, b, a) ((b) | ((g) << 8) | ((r) << 16) | ((a) << 24))
 
-void
-voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+/*A texture is in use until every render thread has finished the triangles
+  that reference it*/
+static int
+voodoo_texture_in_use(voodoo_t *voodoo, texture_t *texture)
 {
-    int      c;
-    int      lod_min;
-    int      lod_max;
-    uint32_t addr = 0;
-    uint32_t addr_end;
-    uint32_t palette_checksum;
+    for (int c = 0; c < voodoo->render_threads; c++) {
+        if (texture->refcount != texture->refcount_r[c])
+            return 1;
+    }
 
-    lod_min = (params->tLOD[tmu] >> 2) & 15;
-    lod_max = (params->tLOD[tmu] >> 8) & 15;
+    return 0;
+}
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88) {
-        if (voodoo->palette_dirty[tmu]) {
-            palette_checksum = 0;
+static int
+voodoo_texture_hash(uint32_t base, uint32_t tLOD, uint32_t palette_checksum)
+{
+    uint32_t hash = (base >> 3) ^ (tLOD * 0x9e3779b1) ^ palette_checksum;
 
-            for (c = 0; c < 256; c++)
-                palette_checksum ^= voodoo->palette[tmu][c].u;
+    return (hash ^ (hash >> 9) ^ (hash >> 18)) & TEX_HASH_MASK;
+}
 
-            voodoo->palette_checksum[tmu] = palette_checksum;
-            voodoo->palette_dirty[tmu]    = 0;
-        } else
-            palette_checksum = voodoo->palette_checksum[tmu];
-    } else
-        palette_checksum = 0;
+static int
+voodoo_texture_find(voodoo_t *voodoo, int tmu, uint32_t base, uint32_t tLOD, int tformat, uint32_t palette_checksum)
+{
+    int c = voodoo->texture_hash[tmu][voodoo_texture_hash(base, tLOD, palette_checksum)];
 
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        addr = params->texBaseAddr1[tmu];
-    else
-        addr = params->texBaseAddr[tmu];
+    for (; c != -1; c = voodoo->texture_cache[tmu][c].hash_next) {
+        const texture_t *texture = &voodoo->texture_cache[tmu][c];
 
-    /*Try to find texture in cache*/
-    for (c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base == addr && voodoo->texture_cache[tmu][c].tLOD == (params->tLOD[tmu] & 0xf00fff) && voodoo->texture_cache[tmu][c].palette_checksum == palette_checksum) {
-            params->tex_entry[tmu] = c;
-            voodoo->texture_cache[tmu][c].refcount++;
-            return;
-        }
+        if (texture->base == base && texture->tLOD == tLOD && texture->tformat == tformat && texture->palette_checksum == palette_checksum)
+            return c;
     }
 
-    /*Texture not found, search for unused texture*/
-    do {
-        for (c = 0; c < TEX_CACHE_MAX; c++) {
-            voodoo->texture_last_removed++;
-            voodoo->texture_last_removed &= (TEX_CACHE_MAX - 1);
-            if (voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[0] && (voodoo->render_threads == 1 || voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount == voodoo->texture_cache[tmu][voodoo->texture_last_removed].refcount_r[1]))
-                break;
-        }
-        if (c == TEX_CACHE_MAX)
-            voodoo_wait_for_render_thread_idle(voodoo);
-    } while (c == TEX_CACHE_MAX);
-    if (c == TEX_CACHE_MAX)
-        fatal("Texture cache full!\n");
+    return -1;
+}
 
-    c = voodoo->texture_last_removed;
+static void
+voodoo_texture_unlink(voodoo_t *voodoo, int tmu, int c)
+{
+    texture_t *texture = &voodoo->texture_cache[tmu][c];
+    int16_t   *prev    = &voodoo->texture_hash[tmu][voodoo_texture_hash(texture->base, texture->tLOD, texture->palette_checksum)];
 
-    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr1[tmu];
-    else
-        voodoo->texture_cache[tmu][c].base = params->texBaseAddr[tmu];
-    voodoo->texture_cache[tmu][c].tLOD = params->tLOD[tmu] & 0xf00fff;
+    while (*prev != c)
+        prev = &voodoo->texture_cache[tmu][*prev].hash_next;
+    *prev = texture->hash_next;
 
-    lod_min = (params->tLOD[tmu] >> 2) & 15;
-    lod_max = (params->tLOD[tmu] >> 8) & 15;
-#if 0
-    voodoo_texture_log("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
-#endif
-    lod_min = MIN(lod_min, 8);
-    lod_max = MIN(lod_max, 8);
-    for (int lod = lod_min; lod <= lod_max; lod++) {
-        uint32_t     *base     = &voodoo->texture_cache[tmu][c].data[texture_offset[lod]];
-        uint32_t      tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
-        int           x;
-        int           y;
-        int           shift = 8 - params->tex_lod[tmu][lod];
-        const rgba_u *pal;
+    texture->base = -1;
+}
+
+void
+voodoo_texture_cache_init(voodoo_t *voodoo)
+{
+    /*Roughly one entry per 32 kB of texture memory*/
+    voodoo->texture_cache_size = (voodoo->texture_mask + 1) >> 15;
+    if (voodoo->texture_cache_size < TEX_CACHE_MIN)
+        voodoo->texture_cache_size = TEX_CACHE_MIN;
+    if (voodoo->texture_cache_size > TEX_CACHE_MAX)
+        voodoo->texture_cache_size = TEX_CACHE_MAX;
+
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < TEX_CACHE_MAX; c++) {
+            voodoo->texture_cache[tmu][c].base     = -1; /*invalid*/
+            voodoo->texture_cache[tmu][c].refcount = 0;
+        }
+        memset(voodoo->texture_hash[tmu], 0xff, sizeof(voodoo->texture_hash[tmu]));
+    }
+}
+
+void
+voodoo_texture_cache_close(voodoo_t *voodoo)
+{
+    for (uint8_t tmu = 0; tmu < 2; tmu++) {
+        for (int c = 0; c < TEX_CACHE_MAX; c++) {
+            free(voodoo->texture_cache[tmu][c].data);
+            voodoo->texture_cache[tmu][c].data = NULL;
+        }
+    }
+}
+
+static void
+voodoo_decode_texture_lod(voodoo_t *voodoo, voodoo_params_t *params, int tmu, texture_t *texture, int lod)
+{
+    uint32_t     *base     = &texture->data[texture_offset[lod]];
+    uint32_t      tex_addr = params->tex_base[tmu][lod] & voodoo->texture_mask;
+    int           x;
+    int           y;
+    int           shift = 8 - params->tex_lod[tmu][lod];
+    const rgba_u *pal;
 
 #if 0
-        voodoo_texture_log("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, voodoo->params.tformat[tmu], voodoo->params.tex_w_mask[tmu][lod],voodoo->params.tex_h_mask[tmu][lod]);
+    voodoo_texture_log("  LOD %i : %08x - %08x %i %i,%i\n", lod, params->tex_base[tmu][lod] & voodoo->texture_mask, addr, voodoo->params.tformat[tmu], voodoo->params.tex_w_mask[tmu][lod],voodoo->params.tex_h_mask[tmu][lod]);
 #endif
 
-        switch (params->tformat[tmu]) {
-            case TEX_RGB332:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+    switch (params->tformat[tmu]) {
+        case TEX_RGB332:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba(rgb332[dat].r, rgb332[dat].g, rgb332[dat].b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(rgb332[dat].r, rgb332[dat].g, rgb332[dat].b, 0xff);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_Y4I2Q2:
-                pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_Y4I2Q2:
+            pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_A8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_A8:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba(dat, dat, dat, dat);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(dat, dat, dat, dat);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_I8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_I8:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba(dat, dat, dat, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(dat, dat, dat, 0xff);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_AI8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_AI8:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba((dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0xf0) | ((dat >> 4) & 0x0f));
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba((dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0x0f) | ((dat << 4) & 0xf0), (dat & 0xf0) | ((dat >> 4) & 0x0f));
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_PAL8:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_PAL8:
+            pal = voodoo->palette[tmu];
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(pal[dat].rgba.r, pal[dat].rgba.g, pal[dat].rgba.b, 0xff);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_APAL8:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
+        case TEX_APAL8:
+            pal = voodoo->palette[tmu];
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint8_t dat = voodoo->tex_mem[tmu][(tex_addr + x) & voodoo->texture_mask];
 
-                        int r = ((pal[dat].rgba.r & 3) << 6) | ((pal[dat].rgba.g & 0xf0) >> 2) | (pal[dat].rgba.r & 3);
-                        int g = ((pal[dat].rgba.g & 0xf) << 4) | ((pal[dat].rgba.b & 0xc0) >> 4) | ((pal[dat].rgba.g & 0xf) >> 2);
-                        int b = ((pal[dat].rgba.b & 0x3f) << 2) | ((pal[dat].rgba.b & 0x30) >> 4);
-                        int a = (pal[dat].rgba.r & 0xfc) | ((pal[dat].rgba.r & 0xc0) >> 6);
+                    int r = ((pal[dat].rgba.r & 3) << 6) | ((pal[dat].rgba.g & 0xf0) >> 2) | (pal[dat].rgba.r & 3);
+                    int g = ((pal[dat].rgba.g & 0xf) << 4) | ((pal[dat].rgba.b & 0xc0) >> 4) | ((pal[dat].rgba.g & 0xf) >> 2);
+                    int b = ((pal[dat].rgba.b & 0x3f) << 2) | ((pal[dat].rgba.b & 0x30) >> 4);
+                    int a = (pal[dat].rgba.r & 0xfc) | ((pal[dat].rgba.r & 0xc0) >> 6);
 
-                        base[x] = makergba(r, g, b, a);
-                    }
-                    tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
-                    base += (1 << shift);
+                    base[x] = makergba(r, g, b, a);
                 }
-                break;
+                tex_addr += (1 << voodoo->params.tex_shift[tmu][lod]);
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_ARGB8332:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_ARGB8332:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(rgb332[dat & 0xff].r, rgb332[dat & 0xff].g, rgb332[dat & 0xff].b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(rgb332[dat & 0xff].r, rgb332[dat & 0xff].g, rgb332[dat & 0xff].b, dat >> 8);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_A8Y4I2Q2:
-                pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_A8Y4I2Q2:
+            pal = voodoo->ncc_lookup[tmu][(voodoo->params.textureMode[tmu] & TEXTUREMODE_NCC_SEL) ? 1 : 0];
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_R5G6B5:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_R5G6B5:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(rgb565[dat].r, rgb565[dat].g, rgb565[dat].b, 0xff);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(rgb565[dat].r, rgb565[dat].g, rgb565[dat].b, 0xff);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_ARGB1555:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_ARGB1555:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(argb1555[dat].r, argb1555[dat].g, argb1555[dat].b, argb1555[dat].a);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(argb1555[dat].r, argb1555[dat].g, argb1555[dat].b, argb1555[dat].a);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_ARGB4444:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_ARGB4444:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(argb4444[dat].r, argb4444[dat].g, argb4444[dat].b, argb4444[dat].a);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(argb4444[dat].r, argb4444[dat].g, argb4444[dat].b, argb4444[dat].a);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_A8I8:
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_A8I8:
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(dat & 0xff, dat & 0xff, dat & 0xff, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(dat & 0xff, dat & 0xff, dat & 0xff, dat >> 8);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            case TEX_APAL88:
-                pal = voodoo->palette[tmu];
-                for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
-                    for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
-                        uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
+        case TEX_APAL88:
+            pal = voodoo->palette[tmu];
+            for (y = 0; y < voodoo->params.tex_h_mask[tmu][lod] + 1; y++) {
+                for (x = 0; x < voodoo->params.tex_w_mask[tmu][lod] + 1; x++) {
+                    uint16_t dat = *(uint16_t *) &voodoo->tex_mem[tmu][(tex_addr + x * 2) & voodoo->texture_mask];
 
-                        base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
-                    }
-                    tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
-                    base += (1 << shift);
+                    base[x] = makergba(pal[dat & 0xff].rgba.r, pal[dat & 0xff].rgba.g, pal[dat & 0xff].rgba.b, dat >> 8);
                 }
-                break;
+                tex_addr += (1 << (voodoo->params.tex_shift[tmu][lod] + 1));
+                base += (1 << shift);
+            }
+            break;
 
-            default:
-                fatal("Unknown texture format %i\n", params->tformat[tmu]);
-        }
+        default:
+            fatal("Unknown texture format %i\n", params->tformat[tmu]);
     }
+}
 
-    voodoo->texture_cache[tmu][c].is16 = voodoo->params.tformat[tmu] & 8;
+/*Copies the decoded mip levels of the other TMU's copy of a texture. Only
+  used when both TMUs share texture memory.*/
+static void
+voodoo_copy_texture(voodoo_t *voodoo, voodoo_params_t *params, texture_t *dst, const texture_t *src, int tmu, int lod_min, int lod_max)
+{
+    for (int lod = lod_min; lod <= lod_max; lod++) {
+        int shift = 8 - params->tex_lod[tmu][lod];
+        int size  = (voodoo->params.tex_h_mask[tmu][lod] << shift) + voodoo->params.tex_w_mask[tmu][lod] + 1;
 
-    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88)
-        voodoo->texture_cache[tmu][c].palette_checksum = palette_checksum;
-    else
-        voodoo->texture_cache[tmu][c].palette_checksum = 0;
+        memcpy(&dst->data[texture_offset[lod]], &src->data[texture_offset[lod]], size * sizeof(uint32_t));
+    }
+}
 
-    if (lod_min == 0) {
-        voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->params.tex_base[tmu][0];
-        voodoo->texture_cache[tmu][c].addr_end[0]   = voodoo->params.tex_end[tmu][0];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[0] = voodoo->texture_cache[tmu][c].addr_end[0] = 0;
+void
+voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
+{
+    texture_t *texture;
+    int        c;
+    int        lod_min;
+    int        lod_max;
+    int        hash;
+    int        other;
+    uint32_t   addr = 0;
+    uint32_t   addr_end;
+    uint32_t   tLOD = params->tLOD[tmu] & 0xf00fff;
+    uint32_t   palette_checksum;
+    uint64_t   start_time;
 
-    if (lod_min <= 1 && lod_max >= 1) {
-        voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->params.tex_base[tmu][1];
-        voodoo->texture_cache[tmu][c].addr_end[1]   = voodoo->params.tex_end[tmu][1];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[1] = voodoo->texture_cache[tmu][c].addr_end[1] = 0;
+    lod_min = (params->tLOD[tmu] >> 2) & 15;
+    lod_max = (params->tLOD[tmu] >> 8) & 15;
 
-    if (lod_min <= 2 && lod_max >= 2) {
-        voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->params.tex_base[tmu][2];
-        voodoo->texture_cache[tmu][c].addr_end[2]   = voodoo->params.tex_end[tmu][2];
-    } else
-        voodoo->texture_cache[tmu][c].addr_start[2] = voodoo->texture_cache[tmu][c].addr_end[2] = 0;
+    if (params->tformat[tmu] == TEX_PAL8 || params->tformat[tmu] == TEX_APAL8 || params->tformat[tmu] == TEX_APAL88) {
+        if (voodoo->palette_dirty[tmu]) {
+            palette_checksum = 0;
+
+            for (c = 0; c < 256; c++)
+                palette_checksum ^= voodoo->palette[tmu][c].u;
 
-    if (lod_max >= 3) {
-        voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->params.tex_base[tmu][(lod_min > 3) ? lod_min : 3];
-        voodoo->texture_cache[tmu][c].addr_end[3]   = voodoo->params.tex_end[tmu][(lod_max < 8) ? lod_max : 8];
+            voodoo->palette_checksum[tmu] = palette_checksum;
+            voodoo->palette_dirty[tmu]    = 0;
+        } else
+            palette_checksum = voodoo->palette_checksum[tmu];
     } else
-        voodoo->texture_cache[tmu][c].addr_start[3] = voodoo->texture_cache[tmu][c].addr_end[3] = 0;
+        palette_checksum = 0;
 
-    for (uint8_t d = 0; d < 4; d++) {
-        addr     = voodoo->texture_cache[tmu][c].addr_start[d];
-        addr_end = voodoo->texture_cache[tmu][c].addr_end[d];
+    if ((voodoo->params.tLOD[tmu] & LOD_SPLIT) && (voodoo->params.tLOD[tmu] & LOD_ODD) && (voodoo->params.tLOD[tmu] & LOD_TMULTIBASEADDR))
+        addr = params->texBaseAddr1[tmu];
+    else
+        addr = params->texBaseAddr[tmu];
+
+    /*Try to find texture in cache*/
+    c = voodoo_texture_find(voodoo, tmu, addr, tLOD, params->tformat[tmu], palette_checksum);
+    if (c != -1) {
+        texture = &voodoo->texture_cache[tmu][c];
+
+        if (texture->lod_dirty) {
+            /*Part of the texture has been overwritten. flush_texture_cache()
+              has already waited for any triangles still using it.*/
+            start_time = plat_timer_read();
+            for (int lod = MIN(lod_min, 8); lod <= MIN(lod_max, 8); lod++) {
+                if (!(texture->lod_dirty & (1 << lod)))
+                    continue;
+
+                voodoo_decode_texture_lod(voodoo, params, tmu, texture, lod);
+
+                /*flush_texture_cache() only re-marks the clean levels, watch
+                  this one again so that the next upload is caught.*/
+                addr     = texture->addr_start[lod];
+                addr_end = texture->addr_end[lod];
+                if (addr_end != 0) {
+                    for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
+                        voodoo->texture_present[tmu][(addr & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
+                }
+            }
+            texture->lod_dirty = 0;
+            voodoo->texture_decode_time += plat_timer_read() - start_time;
+            voodoo->texture_redecodes++;
+        }
+
+        texture->last_used = ++voodoo->texture_use_count;
+        params->tex_entry[tmu] = c;
+        texture->refcount++;
+        voodoo->texture_hits++;
+        return;
+    }
+    voodoo->texture_misses++;
+
+    /*Texture not found, replace the least recently used texture that no
+      queued triangle refers to*/
+    do {
+        c = -1;
+        for (int d = 0; d < voodoo->texture_cache_size; d++) {
+            texture = &voodoo->texture_cache[tmu][d];
+
+            if (texture->base == -1 && !voodoo_texture_in_use(voodoo, texture)) {
+                c = d;
+                break;
+            }
+            if (!voodoo_texture_in_use(voodoo, texture) && (c == -1 || texture->last_used < voodoo->texture_cache[tmu][c].last_used))
+                c = d;
+        }
+        if (c == -1)
+            voodoo_wait_for_render_thread_idle(voodoo);
+    } while (c == -1);
+
+    texture = &voodoo->texture_cache[tmu][c];
+    if (texture->base != -1)
+        voodoo_texture_unlink(voodoo, tmu, c);
+    if (!texture->data) {
+        texture->data = malloc((256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2) * 4);
+        if (!texture->data)
+            fatal("voodoo_use_texture : unable to allocate texture\n");
+    }
+
+    texture->base             = addr;
+    texture->tLOD             = tLOD;
+    texture->tformat          = params->tformat[tmu];
+    texture->palette_checksum = palette_checksum;
+    texture->lod_dirty        = 0;
+    texture->last_used        = ++voodoo->texture_use_count;
+
+    hash                            = voodoo_texture_hash(addr, tLOD, palette_checksum);
+    texture->hash_next              = voodoo->texture_hash[tmu][hash];
+    voodoo->texture_hash[tmu][hash] = c;
+
+#if 0
+    voodoo_texture_log("  add new texture to %i tformat=%i %08x LOD=%i-%i tmu=%i\n", c, voodoo->params.tformat[tmu], params->texBaseAddr[tmu], lod_min, lod_max, tmu);
+#endif
+    lod_min = MIN(lod_min, 8);
+    lod_max = MIN(lod_max, 8);
+
+    /*NCC tables are per TMU, so those textures can not be shared*/
+    other = -1;
+    if (voodoo->dual_tmus && voodoo->tex_mem[0] == voodoo->tex_mem[1] && params->tformat[tmu] != TEX_Y4I2Q2 && params->tformat[tmu] != TEX_A8Y4I2Q2) {
+        other = voodoo_texture_find(voodoo, tmu ^ 1, addr, tLOD, params->tformat[tmu], palette_checksum);
+        if (other != -1 && voodoo->texture_cache[tmu ^ 1][other].lod_dirty)
+            other = -1;
+    }
+
+    start_time = plat_timer_read();
+    if (other != -1) {
+        voodoo_copy_texture(voodoo, params, texture, &voodoo->texture_cache[tmu ^ 1][other], tmu, lod_min, lod_max);
+        voodoo->texture_shared++;
+    } else {
+        for (int lod = lod_min; lod <= lod_max; lod++)
+            voodoo_decode_texture_lod(voodoo, params, tmu, texture, lod);
+    }
+    voodoo->texture_decode_time += plat_timer_read() - start_time;
+
+    texture->is16 = voodoo->params.tformat[tmu] & 8;
+
+    for (int lod = 0; lod <= LOD_MAX; lod++) {
+        if (lod >= lod_min && lod <= lod_max) {
+            texture->addr_start[lod] = voodoo->params.tex_base[tmu][lod];
+            texture->addr_end[lod]   = voodoo->params.tex_end[tmu][lod];
+        } else
+            texture->addr_start[lod] = texture->addr_end[lod] = 0;
+    }
+
+    for (int lod = lod_min; lod <= lod_max; lod++) {
+        addr     = texture->addr_start[lod];
+        addr_end = texture->addr_end[lod];
 
         if (addr_end != 0) {
             for (; addr <= addr_end; addr += (1 << TEX_DIRTY_SHIFT))
@@ -545,9 +684,11 @@ voodoo_use_texture(voodoo_t *voodoo, voodoo_params_t *params, int tmu)
     }
 
     params->tex_entry[tmu] = c;
-    voodoo->texture_cache[tmu][c].refcount++;
+    texture->refcount++;
 }
 
+/*Called when texture memory covered by texture_present[] is written. Only
+  the mip levels overlapping the written page are marked for re-decoding.*/
 void
 flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 {
@@ -557,32 +698,36 @@ flush_texture_cache(voodoo_t *voodoo, uint32_t dirty_addr, int tmu)
 #if 0
     voodoo_texture_log("Evict %08x %i\n", dirty_addr, sizeof(voodoo->texture_present));
 #endif
-    for (uint8_t c = 0; c < TEX_CACHE_MAX; c++) {
-        if (voodoo->texture_cache[tmu][c].base != -1) {
-            for (uint8_t d = 0; d < 4; d++) {
-                int addr_start = voodoo->texture_cache[tmu][c].addr_start[d];
-                int addr_end   = voodoo->texture_cache[tmu][c].addr_end[d];
+    for (int c = 0; c < voodoo->texture_cache_size; c++) {
+        texture_t *texture = &voodoo->texture_cache[tmu][c];
 
-                if (addr_end != 0) {
-                    int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
-                    int addr_end_masked   = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
+        if (texture->base == -1)
+            continue;
 
-                    if (addr_end_masked < addr_start_masked)
-                        addr_end_masked = voodoo->texture_mask + 1;
-                    if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked) {
+        for (uint8_t lod = 0; lod <= LOD_MAX; lod++) {
+            int addr_start = texture->addr_start[lod];
+            int addr_end   = texture->addr_end[lod];
+
+            if (addr_end == 0 || (texture->lod_dirty & (1 << lod)))
+                continue;
+
+            int addr_start_masked = addr_start & voodoo->texture_mask & ~0x3ff;
+            int addr_end_masked   = ((addr_end & voodoo->texture_mask) + 0x3ff) & ~0x3ff;
+
+            if (addr_end_masked < addr_start_masked)
+                addr_end_masked = voodoo->texture_mask + 1;
+            if (dirty_addr >= addr_start_masked && dirty_addr < addr_end_masked) {
 #if 0
-                        voodoo_texture_log("  Evict texture %i %08x\n", c, voodoo->texture_cache[tmu][c].base);
+                voodoo_texture_log("  Evict texture %i %08x LOD %i\n", c, texture->base, lod);
 #endif
 
-                        if (voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[0] || (voodoo->render_threads == 2 && voodoo->texture_cache[tmu][c].refcount != voodoo->texture_cache[tmu][c].refcount_r[1]))
-                            wait_for_idle = 1;
+                if (voodoo_texture_in_use(voodoo, texture))
+                    wait_for_idle = 1;
 
-                        voodoo->texture_cache[tmu][c].base = -1;
-                    } else {
-                        for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
-                            voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
-                    }
-                }
+                texture->lod_dirty |= (1 << lod);
+            } else {
+                for (; addr_start <= addr_end; addr_start += (1 << TEX_DIRTY_SHIFT))
+                    voodoo->texture_present[tmu][(addr_start & voodoo->texture_mask) >> TEX_DIRTY_SHIFT] = 1;
             }
         }
     }
@@ -42,6 +42,9 @@
 #include <86box/thread.h>
 #include <86box/video.h>
 #include <86box/vid_svga.h>
+#include <86box/vid_svga_render_simd.h>
+#include <86box/vid_stats.h>
+#include <86box/vid_voodoo_display_simd.h>
 
 #include <minitrace/minitrace.h>
 
@@ -201,17 +204,35 @@ const uint32_t shade[5][256] = {
     }
 };
 
+/*
+   Frames are handed to the blit thread through a ring of three buffers, so
+   there is always one the emulation thread can fill while another waits to
+   be blitted and the third is being read by the renderer. A frame that is
+   still waiting when the next one completes is dropped.
+ */
+#define BLIT_BUFFERS 3
+
+typedef struct blit_buffer_t {
+    bitmap_t *bitmap;
+    size_t    size;
+    int       x, y, w, h;
+    uint64_t  published; /* video_stats_begin() time of publishing the frame */
+} blit_buffer_t;
+
 typedef struct blit_data_struct {
     int x, y, w, h;
-    int busy;
-    int buffer_in_use;
     int thread_run;
     int monitor_index;
 
+    blit_buffer_t buffers[BLIT_BUFFERS];
+    int           latest;  /* Newest frame not yet taken by the blit thread, -1 if none. */
+    int           reading; /* Frame the renderer is reading, -1 if none. */
+    uint32_t      dropped;
+    uint64_t      blit_start; /* video_stats_begin() time of the renderer taking the frame */
+
     thread_t *blit_thread;
     event_t  *wake_blit_thread;
-    event_t  *blit_complete;
-    event_t  *buffer_not_in_use;
+    mutex_t  *lock;
 } blit_data_t;
 
 static uint32_t cga_2_table[16];
@@ -242,33 +263,29 @@ video_setblit(void (*blit)(int, int, int, int, int))
     blit_func = blit;
 }
 
+/* Called by the renderer once it no longer reads mon_blit_buffer. */
 void
 video_blit_complete_monitor(int monitor_index)
 {
-    blit_data_t *blit_data_ptr   = monitors[monitor_index].mon_blit_data_ptr;
-    blit_data_ptr->buffer_in_use = 0;
+    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
 
-    thread_set_event(blit_data_ptr->buffer_not_in_use);
+    thread_wait_mutex(blit_data_ptr->lock);
+    blit_data_ptr->reading = -1;
+    video_stats_end(VIDEO_STAT_BLIT, blit_data_ptr->blit_start);
+    blit_data_ptr->blit_start = 0;
+    thread_release_mutex(blit_data_ptr->lock);
 }
 
 void
-video_wait_for_blit_monitor(int monitor_index)
+video_wait_for_blit_monitor(UNUSED(int monitor_index))
 {
-    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
-
-    while (blit_data_ptr->busy)
-        thread_wait_event(blit_data_ptr->blit_complete, -1);
-    thread_reset_event(blit_data_ptr->blit_complete);
+    /* Nothing to wait for, the blit thread only reads the blit buffer ring. */
 }
 
 void
-video_wait_for_buffer_monitor(int monitor_index)
+video_wait_for_buffer_monitor(UNUSED(int monitor_index))
 {
-    blit_data_t *blit_data_ptr = monitors[monitor_index].mon_blit_data_ptr;
-
-    while (blit_data_ptr->buffer_in_use)
-        thread_wait_event(blit_data_ptr->buffer_not_in_use, -1);
-    thread_reset_event(blit_data_ptr->buffer_not_in_use);
+    /* Nothing to wait for, the target buffer is copied into the ring on blit. */
 }
 
 static png_structp png_ptr[MONITORS_NUM];
@@ -411,41 +428,109 @@ video_transform_copy(void *__restrict _Dst, const void *__restrict _Src, size_t
 static void
 blit_thread(void *param)
 {
-    blit_data_t *data = param;
+    blit_data_t   *data = param;
+    blit_buffer_t *buf;
+    int            b;
+
     while (data->thread_run) {
         thread_wait_event(data->wake_blit_thread, -1);
         thread_reset_event(data->wake_blit_thread);
+
+        thread_wait_mutex(data->lock);
+        b            = data->latest;
+        data->latest = -1;
+        if (b != -1) {
+            data->reading = b;
+            video_stats_end(VIDEO_STAT_BLIT_WAIT, data->buffers[b].published);
+            data->blit_start = video_stats_begin(VIDEO_STAT_BLIT);
+        }
+        thread_release_mutex(data->lock);
+
+        if (b == -1)
+            continue;
+
         MTR_BEGIN("video", "blit_thread");
 
+        buf     = &data->buffers[b];
+        data->x = buf->x;
+        data->y = buf->y;
+        data->w = buf->w;
+        data->h = buf->h;
+
+        monitors[data->monitor_index].mon_blit_buffer = buf->bitmap;
+
         if (blit_func)
             blit_func(data->x, data->y, data->w, data->h, data->monitor_index);
-
-        data->busy = 0;
+        else
+            video_blit_complete_monitor(data->monitor_index);
 
         MTR_END("video", "blit_thread");
-        thread_set_event(data->blit_complete);
     }
 }
 
+/*
+   Copies the visible part of the target buffer into a blit buffer. Lines
+   are laid out so that consumers can index them exactly like the target
+   buffer, line[y][x], without the blit buffer covering all 2048x2048.
+ */
+static void
+blit_buffer_fill(blit_buffer_t *buf, const bitmap_t *src, int x, int y, int w, int h)
+{
+    const size_t stride = (size_t) x + w;
+
+    if ((stride * h) > buf->size) {
+        buf->size        = stride * h;
+        buf->bitmap->dat = realloc(buf->bitmap->dat, buf->size * sizeof(uint32_t));
+        if (buf->bitmap->dat == NULL)
+            fatal("video_blit_memtoscreen: unable to allocate a %ix%i blit buffer\n", w, h);
+    }
+
+    memset(buf->bitmap->line, 0, sizeof(buf->bitmap->line));
+    for (int row = 0; row < h; row++) {
+        buf->bitmap->line[y + row] = &buf->bitmap->dat[row * stride];
+        memcpy(&buf->bitmap->line[y + row][x], &src->line[y + row][x], w * sizeof(uint32_t));
+    }
+
+    buf->bitmap->w = x + w;
+    buf->bitmap->h = y + h;
+    buf->x         = x;
+    buf->y         = y;
+    buf->w         = w;
+    buf->h         = h;
+}
+
 void
 video_blit_memtoscreen_monitor(int x, int y, int w, int h, int monitor_index)
 {
-    MTR_BEGIN("video", "video_blit_memtoscreen");
+    blit_data_t *data = monitors[monitor_index].mon_blit_data_ptr;
+    int          b;
 
-    if ((w <= 0) || (h <= 0))
+    if ((w <= 0) || (h <= 0) || (x < 0) || (y < 0) || ((x + w) > 2048) || ((y + h) > 2048))
         return;
 
-    video_wait_for_blit_monitor(monitor_index);
+    MTR_BEGIN("video", "video_blit_memtoscreen");
+
+    /* Neither the waiting frame nor the one being read can be overwritten;
+       the blit thread only ever moves a frame from the former to the latter,
+       so the buffer picked here stays free until it is published. */
+    thread_wait_mutex(data->lock);
+    for (b = 0; (b == data->latest) || (b == data->reading); b++)
+        ;
+    thread_release_mutex(data->lock);
+
+    blit_buffer_fill(&data->buffers[b], monitors[monitor_index].target_buffer, x, y, w, h);
+
+    thread_wait_mutex(data->lock);
+    if (data->latest != -1)
+        data->dropped++;
+    data->latest               = b;
+    data->buffers[b].published = video_stats_begin(VIDEO_STAT_BLIT_WAIT);
+    thread_release_mutex(data->lock);
 
-    monitors[monitor_index].mon_blit_data_ptr->busy          = 1;
-    monitors[monitor_index].mon_blit_data_ptr->buffer_in_use = 1;
-    monitors[monitor_index].mon_blit_data_ptr->x             = x;
-    monitors[monitor_index].mon_blit_data_ptr->y             = y;
-    monitors[monitor_index].mon_blit_data_ptr->w             = w;
-    monitors[monitor_index].mon_blit_data_ptr->h             = h;
     monitors[monitor_index].mon_renderedframes++;
+    video_stats_frame_end(monitor_index);
 
-    thread_set_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
+    thread_set_event(data->wake_blit_thread);
     MTR_END("video", "video_blit_memtoscreen");
 }
 
@@ -804,10 +889,14 @@ video_monitor_init(int index)
     monitors[index].target_buffer                        = create_bitmap(2048, 2048);
     monitors[index].mon_blit_data_ptr                    = calloc(1, sizeof(blit_data_t));
     monitors[index].mon_blit_data_ptr->wake_blit_thread  = thread_create_event();
-    monitors[index].mon_blit_data_ptr->blit_complete     = thread_create_event();
-    monitors[index].mon_blit_data_ptr->buffer_not_in_use = thread_create_event();
+    monitors[index].mon_blit_data_ptr->lock              = thread_create_mutex();
+    monitors[index].mon_blit_data_ptr->latest            = -1;
+    monitors[index].mon_blit_data_ptr->reading           = -1;
     monitors[index].mon_blit_data_ptr->thread_run        = 1;
     monitors[index].mon_blit_data_ptr->monitor_index     = index;
+    for (int b = 0; b < BLIT_BUFFERS; b++)
+        monitors[index].mon_blit_data_ptr->buffers[b].bitmap = calloc(1, sizeof(bitmap_t));
+    monitors[index].mon_blit_buffer                      = monitors[index].mon_blit_data_ptr->buffers[0].bitmap;
     monitors[index].mon_pal_lookup                       = calloc(sizeof(uint32_t), 256);
     monitors[index].mon_cga_palette                      = calloc(1, sizeof(int));
     monitors[index].mon_force_resize                     = 1;
@@ -833,10 +922,13 @@ video_monitor_close(int monitor_index)
     thread_wait(monitors[monitor_index].mon_blit_data_ptr->blit_thread);
     if (monitor_index >= 1)
         ui_deinit_monitor(monitor_index);
-    thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->buffer_not_in_use);
-    thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->blit_complete);
+    video_log("Monitor %i: %u frames dropped by the renderer\n", monitor_index, monitors[monitor_index].mon_blit_data_ptr->dropped);
+    for (int b = 0; b < BLIT_BUFFERS; b++)
+        destroy_bitmap(monitors[monitor_index].mon_blit_data_ptr->buffers[b].bitmap);
+    thread_close_mutex(monitors[monitor_index].mon_blit_data_ptr->lock);
     thread_destroy_event(monitors[monitor_index].mon_blit_data_ptr->wake_blit_thread);
     free(monitors[monitor_index].mon_blit_data_ptr);
+    monitors[monitor_index].mon_blit_buffer = NULL;
     if (!monitors[monitor_index].mon_pal_lookup_static)
         free(monitors[monitor_index].mon_pal_lookup);
     if (!monitors[monitor_index].mon_cga_palette_static)
@@ -914,6 +1006,10 @@ video_init(void)
     for (uint32_t c = 0; c < 65536; c++)
         video_16to32[c] = calc_16to32(c);
 
+    svga_render_kernels_init();
+    voodoo_display_kernels_init();
+    video_stats_init();
+
     memset(monitors, 0, sizeof(monitors));
     video_monitor_init(0);
 }
@@ -923,6 +1019,8 @@ video_close(void)
 {
     video_monitor_close(0);
 
+    video_stats_close();
+
     free(video_16to32);
     free(video_15to32);
     free(video_8to32);
@@ -180,7 +180,7 @@ vnc_blit(int x, int y, int w, int h, int monitor_index)
     }
 
     for (int row = 0; row < h; ++row)
-        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(buffer32->line[y + row][x]), w * sizeof(uint32_t));
+        video_copy(&(((uint8_t *) rfb->frameBuffer)[row * 2048 * sizeof(uint32_t)]), &(monitors[monitor_index].mon_blit_buffer->line[y + row][x]), w * sizeof(uint32_t));
 
     if (screenshots)
         video_screenshot((uint32_t *) rfb->frameBuffer, 0, 0, VNC_MAX_X);
@@ -0,0 +1,188 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Microbenchmark of the SVGA scanline conversion kernels.
+ *
+ *          A 1600x1200 frame is converted at 8, 15, 16 and 24 bpp with
+ *          the portable kernels and with the ones picked for the host,
+ *          and the time per frame of each is reported. The outputs of
+ *          both must be identical. The frame is taken from a raw VRAM
+ *          dump when one is given (it is repeated if it is too short),
+ *          otherwise a desktop-like pattern is generated.
+ *
+ *          Usage: svga_render_bench [frames [vram dump]]
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <86box/86box.h>
+#include <86box/vid_svga_render_simd.h>
+
+#define FRAME_WIDTH  1600
+#define FRAME_HEIGHT 1200
+
+typedef enum {
+    KERNEL_PAL8 = 0,
+    KERNEL_RGB555,
+    KERNEL_RGB565,
+    KERNEL_RGB888
+} kernel_t;
+
+static const struct {
+    const char *name;
+    int         bpp;
+} kernel_info[] = {
+    { "8 bpp palette", 1 },
+    { "RGB555",        2 },
+    { "RGB565",        2 },
+    { "RGB888",        3 }
+};
+
+static uint32_t pal[256];
+
+static double
+time_now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+}
+
+static void
+render_frame(const svga_render_kernels_t *k, kernel_t kernel, uint32_t *out, const uint8_t *vram)
+{
+    int pitch = FRAME_WIDTH * kernel_info[kernel].bpp;
+
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        uint32_t      *p   = &out[y * FRAME_WIDTH];
+        const uint8_t *src = &vram[y * pitch];
+
+        switch (kernel) {
+            case KERNEL_PAL8:
+                k->pal8(p, src, pal, 0xff, FRAME_WIDTH, 0);
+                break;
+            case KERNEL_RGB555:
+                k->rgb555(p, src, FRAME_WIDTH, 0);
+                break;
+            case KERNEL_RGB565:
+                k->rgb565(p, src, FRAME_WIDTH, 0);
+                break;
+            case KERNEL_RGB888:
+                k->rgb888(p, src, FRAME_WIDTH, 0);
+                break;
+        }
+    }
+}
+
+static double
+bench(const svga_render_kernels_t *k, kernel_t kernel, uint32_t *out, const uint8_t *vram, int frames)
+{
+    double start = time_now();
+
+    for (int c = 0; c < frames; c++)
+        render_frame(k, kernel, out, vram);
+
+    return (time_now() - start) * 1000000.0 / frames;
+}
+
+/*Mostly flat areas with some text-like detail, which is what a desktop
+  looks like to the renderer*/
+static void
+generate_vram(uint8_t *vram, size_t size)
+{
+    uint32_t seed = 0x86b0;
+
+    for (size_t c = 0; c < size; c++) {
+        seed = seed * 1103515245 + 12345;
+        vram[c] = ((c / 4096) & 1) ? (seed >> 16) : (uint8_t) (c >> 12);
+    }
+}
+
+static int
+load_vram(uint8_t *vram, size_t size, const char *fn)
+{
+    FILE  *fp = fopen(fn, "rb");
+    size_t len;
+
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", fn);
+        return 0;
+    }
+    len = fread(vram, 1, size, fp);
+    fclose(fp);
+    if (len == 0) {
+        fprintf(stderr, "%s is empty\n", fn);
+        return 0;
+    }
+
+    for (size_t c = len; c < size; c++)
+        vram[c] = vram[c % len];
+
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    svga_render_kernels_t portable;
+    size_t                size   = FRAME_WIDTH * FRAME_HEIGHT * 3;
+    int                   frames = (argc > 1) ? atoi(argv[1]) : 100;
+    int                   failed = 0;
+    uint8_t              *vram   = malloc(size);
+    uint32_t             *out_c  = malloc(FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t));
+    uint32_t             *out_k  = malloc(FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t));
+
+    if (frames < 1)
+        frames = 1;
+
+    if (argc > 2) {
+        if (!load_vram(vram, size, argv[2]))
+            return 2;
+    } else
+        generate_vram(vram, size);
+
+    for (int c = 0; c < 256; c++)
+        pal[c] = (c * 0x010203) & 0xffffff;
+
+    portable = svga_render_kernels;
+    svga_render_kernels_init();
+
+    printf("%ix%i, %i frames\n", FRAME_WIDTH, FRAME_HEIGHT, frames);
+    for (kernel_t kernel = KERNEL_PAL8; kernel <= KERNEL_RGB888; kernel++) {
+        double t_c;
+        double t_k;
+
+        t_c = bench(&portable, kernel, out_c, vram, frames);
+        t_k = bench(&svga_render_kernels, kernel, out_k, vram, frames);
+
+        if (memcmp(out_c, out_k, FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint32_t))) {
+            printf("%-14s: output differs from the portable kernel\n", kernel_info[kernel].name);
+            failed++;
+            continue;
+        }
+
+        printf("%-14s: portable %8.1f us/frame, host %8.1f us/frame (%.2fx)\n",
+               kernel_info[kernel].name, t_c, t_k, t_c / t_k);
+    }
+
+    free(out_k);
+    free(out_c);
+    free(vram);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,349 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Trace replay benchmark of the timer queue.
+ *
+ *          A timer trace is replayed against the heap based queue of
+ *          timer.c and against the sorted linked list it replaced, and
+ *          the time per queue operation (arm, disarm or expiry) of each
+ *          is reported. Both must fire the timers in the same order.
+ *
+ *          The trace is read from a text file when one is given, with
+ *          one event per line:
+ *
+ *            e <timer> <delay> [<period>]
+ *                      arm (or re-arm) a timer <delay> ticks from now;
+ *                      with a period, its callback re-arms it every
+ *                      <period> ticks, as timer_advance_u64() does
+ *            d <timer> disarm a timer
+ *            p <ticks> advance time and process expired timers
+ *
+ *          Timers are numbered from 0 to 1023. Without a file, a trace
+ *          modelled on a heavily loaded machine (PIT, RTC, sound cards,
+ *          IDE, network and 3D cards) is generated.
+ *
+ *          Usage: timer_bench [events [trace file]]
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <86box/86box.h>
+#include <86box/timer.h>
+#include <86box/nv/vid_nv_rivatimer.h>
+#include "timer_list.h"
+
+#define MAX_TIMERS 1024
+
+typedef struct trace_event_t {
+    uint8_t  op;
+    uint16_t id;
+    uint32_t period;
+    uint64_t value;
+} trace_event_t;
+
+uint64_t tsc;
+
+static pc_timer_t    timers[MAX_TIMERS];
+static uint32_t      periods[MAX_TIMERS];
+static list_timer_t  list_timers[MAX_TIMERS];
+static uint32_t      fire_hash;
+static uint64_t      fire_count;
+
+/*Stubs for the parts of the emulator timer.c links against*/
+void
+fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    exit(2);
+}
+
+void
+pclog_ex(const char *fmt, va_list ap)
+{
+    vprintf(fmt, ap);
+}
+
+void
+rivatimer_init(void)
+{
+    //
+}
+
+static void
+fired(int id)
+{
+    fire_hash = (fire_hash ^ id) * 16777619;
+    fire_count++;
+}
+
+static void
+timer_callback(void *priv)
+{
+    int id = (int) (intptr_t) priv;
+
+    fired(id);
+    if (periods[id])
+        timer_advance_u64(&timers[id], (uint64_t) periods[id] << 32);
+}
+
+static void
+list_callback(void *priv)
+{
+    int id = (int) (intptr_t) priv;
+
+    fired(id);
+    if (periods[id]) {
+        list_timers[id].ts += periods[id];
+        list_timer_enable(&list_timers[id]);
+    }
+}
+
+static void
+replay_list(const trace_event_t *trace, int events)
+{
+    list_timer_init();
+    memset(list_timers, 0, sizeof(list_timers));
+    memset(periods, 0, sizeof(periods));
+    for (int c = 0; c < MAX_TIMERS; c++) {
+        list_timers[c].callback = list_callback;
+        list_timers[c].priv     = (void *) (intptr_t) c;
+    }
+
+    for (int c = 0; c < events; c++) {
+        list_timer_t *timer = &list_timers[trace[c].id];
+
+        switch (trace[c].op) {
+            case 'e':
+                periods[trace[c].id] = trace[c].period;
+                timer->ts            = list_tsc + trace[c].value;
+                list_timer_enable(timer);
+                break;
+            case 'd':
+                list_timer_disable(timer);
+                break;
+            case 'p':
+                list_tsc += trace[c].value;
+                list_timer_process();
+                break;
+        }
+    }
+}
+
+static void
+replay_heap(const trace_event_t *trace, int events)
+{
+    timer_init();
+    memset(periods, 0, sizeof(periods));
+    for (int c = 0; c < MAX_TIMERS; c++)
+        timer_add(&timers[c], timer_callback, (void *) (intptr_t) c, 0);
+
+    for (int c = 0; c < events; c++) {
+        pc_timer_t *timer = &timers[trace[c].id];
+
+        switch (trace[c].op) {
+            case 'e':
+                periods[trace[c].id] = trace[c].period;
+                timer_set_delay_u64(timer, trace[c].value << 32);
+                break;
+            case 'd':
+                timer_disable(timer);
+                break;
+            case 'p':
+                tsc += trace[c].value;
+                timer_process();
+                break;
+        }
+    }
+
+    timer_close();
+}
+
+static double
+time_now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1000000000.0;
+}
+
+/*Timer periods, in ticks of a 200 MHz CPU, of the devices of a heavily
+  loaded machine*/
+static const uint32_t device_periods[] = {
+    168,     /*PIT channel 0 at its fastest*/
+    168,     /*PIT channel 2, PC speaker*/
+    200000,  /*RTC periodic interrupt, 1 ms*/
+    4535,    /*SB16 DSP, 44.1 kHz*/
+    4535,    /*SB16 OPL3*/
+    4535,    /*GUS sample timer*/
+    16000,   /*GUS timer 1*/
+    64000,   /*GUS timer 2*/
+    2200,    /*IDE primary channel, per sector*/
+    2200,    /*IDE secondary channel, per sector*/
+    1600,    /*NE2000, per byte*/
+    1600,    /*RTL8139, per byte*/
+    3333333, /*Voodoo 2 retrace, 60 Hz*/
+    3333333, /*Voodoo 2 SLI slave retrace*/
+    12700,   /*Voodoo 2 wake timer*/
+    12700,   /*Voodoo 2 SLI slave wake timer*/
+    3333333, /*SVGA retrace*/
+    15873,   /*SVGA scanline*/
+    715,     /*ACPI PM timer*/
+    20000,   /*Keyboard controller*/
+    40000,   /*Mouse*/
+    200000,  /*Floppy controller*/
+    1000000, /*Serial ports*/
+    1000000, /*Parallel port*/
+    50000    /*Sound mixer*/
+};
+
+static int
+generate_trace(trace_event_t *trace, int events, int *timer_count)
+{
+    int      num  = 0;
+    int      n    = sizeof(device_periods) / sizeof(device_periods[0]);
+    uint32_t seed = 0x86b0;
+
+#define RAND() (seed = seed * 1103515245 + 12345, seed >> 8)
+    /*Every device gets two timers, as the heavier ones do, and they re-arm
+      themselves from their callbacks*/
+    *timer_count = n * 2;
+    for (int c = 0; c < *timer_count; c++) {
+        uint32_t period = device_periods[c % n];
+
+        trace[num++] = (trace_event_t) { 'e', c, period, 1 + (RAND() % period) };
+    }
+
+    while (num < (events - 1)) {
+        int      id     = RAND() % *timer_count;
+        uint32_t period = device_periods[id % n];
+
+        /*Devices re-arm or stop their timers from register writes*/
+        if ((RAND() % 4) == 0) {
+            if ((RAND() % 8) == 0)
+                trace[num++] = (trace_event_t) { 'd', id, 0, 0 };
+            else
+                trace[num++] = (trace_event_t) { 'e', id, period, 1 + (RAND() % period) };
+        }
+
+        trace[num++] = (trace_event_t) { 'p', 0, 0, 1 + (RAND() % 400) };
+    }
+#undef RAND
+
+    return num;
+}
+
+static int
+load_trace(trace_event_t *trace, int events, int *timer_count, const char *fn)
+{
+    FILE *fp = fopen(fn, "r");
+    char  line[256];
+    int   num = 0;
+
+    if (fp == NULL) {
+        fprintf(stderr, "Can't open %s\n", fn);
+        return -1;
+    }
+
+    *timer_count = 0;
+    while ((num < events) && fgets(line, sizeof(line), fp)) {
+        char               op;
+        unsigned int       id     = 0;
+        unsigned int       period = 0;
+        unsigned long long value  = 0;
+
+        if ((sscanf(line, " %c", &op) != 1) || (op == '#'))
+            continue;
+        if (((op == 'e') && (sscanf(line, " e %u %llu %u", &id, &value, &period) < 2)) ||
+            ((op == 'd') && (sscanf(line, " d %u", &id) != 1)) ||
+            ((op == 'p') && (sscanf(line, " p %llu", &value) != 1)) ||
+            ((op != 'e') && (op != 'd') && (op != 'p')) || (id >= MAX_TIMERS) || (value >= (1ULL << 31)) || (period >= (1U << 31))) {
+            fprintf(stderr, "%s: bad trace event: %s", fn, line);
+            fclose(fp);
+            return -1;
+        }
+
+        trace[num++] = (trace_event_t) { op, id, period, value };
+        if ((int) id >= *timer_count)
+            *timer_count = id + 1;
+    }
+
+    fclose(fp);
+
+    return num;
+}
+
+int
+main(int argc, char **argv)
+{
+    trace_event_t *trace;
+    int            events = (argc > 1) ? atoi(argv[1]) : 10000000;
+    int            timer_count;
+    uint64_t       ops = 0;
+    uint32_t       list_hash;
+    uint32_t       heap_hash;
+    double         t_list;
+    double         t_heap;
+
+    if (events < 1024)
+        events = 1024;
+    trace = malloc(events * sizeof(trace_event_t));
+
+    if (argc > 2)
+        events = load_trace(trace, events, &timer_count, argv[2]);
+    else
+        events = generate_trace(trace, events, &timer_count);
+    if (events <= 0)
+        return 2;
+
+    for (int c = 0; c < events; c++)
+        ops += (trace[c].op != 'p');
+
+    fire_hash  = 2166136261;
+    fire_count = 0;
+    t_list     = time_now();
+    replay_list(trace, events);
+    t_list     = time_now() - t_list;
+    list_hash  = fire_hash;
+    ops += fire_count;
+
+    fire_hash = 2166136261;
+    t_heap    = time_now();
+    replay_heap(trace, events);
+    t_heap    = time_now() - t_heap;
+    heap_hash = fire_hash;
+
+    printf("%i events, %i timers, %" PRIu64 " queue operations\n", events, timer_count, ops);
+    printf("List: %6.1f ns/operation\n", (t_list * 1000000000.0) / ops);
+    printf("Heap: %6.1f ns/operation (%.2fx)\n", (t_heap * 1000000000.0) / ops, t_list / t_heap);
+
+    free(trace);
+
+    if (list_hash != heap_hash) {
+        printf("Timers fired in a different order\n");
+        return 1;
+    }
+
+    return 0;
+}
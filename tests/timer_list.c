@@ -0,0 +1,87 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Sorted list timer queue, as timer.c implemented it before the
+ *          heap, kept in its own file so the benchmark calls it the way
+ *          the emulator called timer.c.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include "timer_list.h"
+
+uint64_t list_tsc;
+
+static list_timer_t *list_head;
+
+void
+list_timer_disable(list_timer_t *timer)
+{
+    if (!timer->enabled)
+        return;
+
+    if (timer->prev)
+        timer->prev->next = timer->next;
+    else
+        list_head = timer->next;
+    if (timer->next)
+        timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+    timer->enabled            = 0;
+}
+
+/*Inserts in front of the first timer expiring at the same time or later, so
+  equal timestamps fire most recently enabled first*/
+void
+list_timer_enable(list_timer_t *timer)
+{
+    list_timer_t *node;
+    list_timer_t *prev = NULL;
+
+    list_timer_disable(timer);
+    timer->enabled = 1;
+
+    node = list_head;
+    while (node && ((int64_t) (node->ts - timer->ts) < 0)) {
+        prev = node;
+        node = node->next;
+    }
+
+    timer->prev = prev;
+    timer->next = node;
+    if (node)
+        node->prev = timer;
+    if (prev)
+        prev->next = timer;
+    else
+        list_head = timer;
+}
+
+void
+list_timer_process(void)
+{
+    while (list_head && ((int64_t) (list_head->ts - list_tsc) <= 0)) {
+        list_timer_t *timer = list_head;
+
+        list_timer_disable(timer);
+        if (timer->callback != NULL)
+            timer->callback(timer->priv);
+    }
+}
+
+void
+list_timer_init(void)
+{
+    list_head = NULL;
+    list_tsc  = 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Definitions for the sorted list timer queue, used by the timer
+ *          queue benchmark for comparison.
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#ifndef TESTS_TIMER_LIST_H
+#define TESTS_TIMER_LIST_H
+
+typedef struct list_timer_t {
+    uint64_t ts;
+    int      enabled;
+
+    void (*callback)(void *priv);
+    void *priv;
+
+    struct list_timer_t *prev;
+    struct list_timer_t *next;
+} list_timer_t;
+
+extern uint64_t list_tsc;
+
+extern void list_timer_enable(list_timer_t *timer);
+extern void list_timer_disable(list_timer_t *timer);
+extern void list_timer_process(void);
+extern void list_timer_init(void);
+
+#endif /*TESTS_TIMER_LIST_H*/
@@ -0,0 +1,410 @@
+/*
+ * 86Box    A hypervisor and IBM PC system emulator that specializes in
+ *          running old operating systems and software designed for IBM
+ *          PC systems and compatibles from 1981 through fairly recent
+ *          system designs based on the PCI bus.
+ *
+ *          This file is part of the 86Box distribution.
+ *
+ *          Comparison test of the Voodoo span code generator.
+ *
+ *          Random pipeline states are rendered once through the C span
+ *          renderer and once through the code generator of the host
+ *          (x86-64 or AArch64), starting from the same framebuffer, and
+ *          the resulting framebuffers must be identical. States the C
+ *          renderer rejects with fatal() are skipped.
+ *
+ *          Usage: voodoo_render_test [states [seed]]
+ *
+ *
+ *
+ * Authors: The 86Box contributors.
+ *
+ *          Copyright 2026 The 86Box contributors.
+ */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <sys/mman.h>
+#include <86box/86box.h>
+#include <86box/device.h>
+#include <86box/mem.h>
+#include <86box/timer.h>
+#include <86box/plat.h>
+#include <86box/thread.h>
+#include <86box/video.h>
+#include <86box/vid_svga.h>
+#include <86box/vid_stats.h>
+#include <86box/vid_voodoo_common.h>
+#include <86box/vid_voodoo_regs.h>
+#include <86box/vid_voodoo_render.h>
+#include <86box/vid_voodoo_texture.h>
+
+#define FB_WIDTH   256
+#define FB_HEIGHT  256
+#define FB_SIZE    (FB_WIDTH * FB_HEIGHT * 2 * 2)
+#define TRIANGLES  4
+
+extern void voodoo_triangle(voodoo_t *voodoo, voodoo_params_t *params, int odd_even);
+
+rgba8_t rgb565[0x10000];
+int     tris;
+
+static jmp_buf  fatal_jmp;
+static uint64_t rng_state;
+
+/*Stubs for the parts of the emulator the renderer links against*/
+void
+fatal(const char *fmt, ...)
+{
+    (void) fmt;
+    longjmp(fatal_jmp, 1);
+}
+
+void *
+plat_mmap(size_t size, uint8_t executable)
+{
+    void *ret = mmap(0, size, PROT_READ | PROT_WRITE | (executable ? PROT_EXEC : 0), MAP_ANON | MAP_PRIVATE, -1, 0);
+
+    return (ret == MAP_FAILED) ? NULL : ret;
+}
+
+void
+plat_munmap(void *ptr, size_t size)
+{
+    munmap(ptr, size);
+}
+
+uint64_t
+plat_timer_read(void)
+{
+    return 0;
+}
+
+uint64_t
+video_stats_begin(UNUSED(int stage))
+{
+    return 0;
+}
+
+void
+video_stats_end(UNUSED(int stage), UNUSED(uint64_t start))
+{
+    //
+}
+
+void
+voodoo_use_texture(UNUSED(voodoo_t *voodoo), UNUSED(voodoo_params_t *params), UNUSED(int tmu))
+{
+    //
+}
+
+void
+thread_set_event(UNUSED(event_t *arg))
+{
+    //
+}
+
+void
+thread_reset_event(UNUSED(event_t *arg))
+{
+    //
+}
+
+int
+thread_wait_event(UNUSED(event_t *arg), UNUSED(int timeout))
+{
+    return 0;
+}
+
+static uint32_t
+rnd(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+
+    return (uint32_t) (rng_state >> 16);
+}
+
+static int32_t
+rnd_range(int32_t min, int32_t max)
+{
+    return min + (int32_t) (rnd() % (uint32_t) (max - min));
+}
+
+static void
+random_params(voodoo_t *voodoo, voodoo_params_t *params)
+{
+    int32_t ax;
+    int32_t ay;
+    int32_t bx;
+    int32_t by;
+    int32_t cx;
+    int32_t cy;
+    int32_t t;
+
+    memset(params, 0, sizeof(voodoo_params_t));
+
+    /*Vertices are 12.4 fixed point and sorted by Y, as triangle setup does*/
+    ax = rnd_range(-16 << 4, (FB_WIDTH + 16) << 4);
+    bx = rnd_range(-16 << 4, (FB_WIDTH + 16) << 4);
+    cx = rnd_range(-16 << 4, (FB_WIDTH + 16) << 4);
+    ay = rnd_range(-16 << 4, (FB_HEIGHT + 16) << 4);
+    by = rnd_range(-16 << 4, (FB_HEIGHT + 16) << 4);
+    cy = rnd_range(-16 << 4, (FB_HEIGHT + 16) << 4);
+    if (ay > by) {
+        t = ay; ay = by; by = t;
+        t = ax; ax = bx; bx = t;
+    }
+    if (by > cy) {
+        t = by; by = cy; cy = t;
+        t = bx; bx = cx; cx = t;
+    }
+    if (ay > by) {
+        t = ay; ay = by; by = t;
+        t = ax; ax = bx; bx = t;
+    }
+    params->vertexAx = ax;
+    params->vertexAy = ay;
+    params->vertexBx = bx;
+    params->vertexBy = by;
+    params->vertexCx = cx;
+    params->vertexCy = cy;
+    params->sign     = ((int64_t) (ax - bx) * (by - cy) - (int64_t) (bx - cx) * (ay - by)) < 0;
+
+    /*Colours are 12.12, allowed to run out of range to exercise clamping*/
+    params->startR = rnd_range(-32 << 12, 288 << 12);
+    params->startG = rnd_range(-32 << 12, 288 << 12);
+    params->startB = rnd_range(-32 << 12, 288 << 12);
+    params->startA = rnd_range(-32 << 12, 288 << 12);
+    params->startZ = rnd();
+    params->dRdX   = rnd_range(-4 << 12, 4 << 12);
+    params->dGdX   = rnd_range(-4 << 12, 4 << 12);
+    params->dBdX   = rnd_range(-4 << 12, 4 << 12);
+    params->dAdX   = rnd_range(-4 << 12, 4 << 12);
+    params->dZdX   = rnd_range(-1 << 22, 1 << 22);
+    params->dRdY   = rnd_range(-4 << 12, 4 << 12);
+    params->dGdY   = rnd_range(-4 << 12, 4 << 12);
+    params->dBdY   = rnd_range(-4 << 12, 4 << 12);
+    params->dAdY   = rnd_range(-4 << 12, 4 << 12);
+    params->dZdY   = rnd_range(-1 << 22, 1 << 22);
+    params->startW = ((int64_t) rnd_range(1 << 12, 1 << 20)) << 12;
+    params->dWdX   = rnd_range(-1 << 20, 1 << 20);
+    params->dWdY   = rnd_range(-1 << 20, 1 << 20);
+
+    /*Texture coordinates are in texels << 32, W is 1.0 == 1 << 32*/
+    for (uint8_t c = 0; c < 2; c++) {
+        params->tmu[c].startS = ((int64_t) rnd_range(-64 << 4, 512 << 4)) << 28;
+        params->tmu[c].startT = ((int64_t) rnd_range(-64 << 4, 512 << 4)) << 28;
+        params->tmu[c].startW = ((int64_t) rnd_range(1 << 11, 1 << 13)) << 20;
+        params->tmu[c].dSdX   = ((int64_t) rnd_range(-64, 64)) << 26;
+        params->tmu[c].dTdX   = ((int64_t) rnd_range(-64, 64)) << 26;
+        params->tmu[c].dWdX   = ((int64_t) rnd_range(-64, 64)) << 18;
+        params->tmu[c].dSdY   = ((int64_t) rnd_range(-64, 64)) << 26;
+        params->tmu[c].dTdY   = ((int64_t) rnd_range(-64, 64)) << 26;
+        params->tmu[c].dWdY   = ((int64_t) rnd_range(-64, 64)) << 18;
+
+        params->textureMode[c] = rnd();
+        params->tformat[c]     = (params->textureMode[c] >> 8) & 0xf;
+        /*LOD min and max are 4.2 fixed point and at most 8.0 on real hardware*/
+        params->tLOD[c]        = (rnd() & 0xfff000) | ((rnd() % 33) << 6) | (rnd() % 33);
+        params->tex_entry[c]   = 0;
+        params->detail_max[c]  = rnd() & 0xff;
+        params->detail_bias[c] = rnd_range(-64, 64);
+        params->detail_scale[c] = rnd() & 7;
+
+        for (uint8_t lod = 0; lod <= LOD_MAX + 1; lod++) {
+            int size = (lod > LOD_MAX) ? 1 : (256 >> lod);
+
+            params->tex_w_mask[c][lod]  = size - 1;
+            params->tex_w_nmask[c][lod] = ~(size - 1);
+            params->tex_h_mask[c][lod]  = size - 1;
+            params->tex_shift[c][lod]   = (lod > LOD_MAX) ? 0 : (8 - lod);
+            params->tex_lod[c][lod]     = (lod > LOD_MAX) ? LOD_MAX : lod;
+        }
+    }
+
+    params->color0       = rnd();
+    params->color1       = rnd();
+    /*Keep clear of the colour path selections the C renderer rejects*/
+    params->fbzColorPath = rnd();
+    if (((params->fbzColorPath >> 2) & 3) == A_SEL_LFB)
+        params->fbzColorPath &= ~(3 << 2);
+    if (((params->fbzColorPath >> 5) & 3) == 3)
+        params->fbzColorPath &= ~(3 << 5);
+    if (((params->fbzColorPath >> 10) & 7) > CC_MSELECT_TEXRGB)
+        params->fbzColorPath &= ~(7 << 10);
+    if (((params->fbzColorPath >> 14) & 3) == 3)
+        params->fbzColorPath &= ~(3 << 14);
+    if (((params->fbzColorPath >> 19) & 7) > CCA_MSELECT_TEX)
+        params->fbzColorPath &= ~(7 << 19);
+    params->alphaMode    = rnd();
+    params->fogMode      = rnd();
+    params->zaColor      = rnd();
+    params->stipple      = rnd();
+    params->chromaKey    = rnd() & 0xffffff;
+    params->chromaKey_r  = (params->chromaKey >> 16) & 0xff;
+    params->chromaKey_g  = (params->chromaKey >> 8) & 0xff;
+    params->chromaKey_b  = params->chromaKey & 0xff;
+    params->fogColor.r   = rnd() & 0xff;
+    params->fogColor.g   = rnd() & 0xff;
+    params->fogColor.b   = rnd() & 0xff;
+    for (uint8_t c = 0; c < 64; c++) {
+        params->fogTable[c].fog  = rnd() & 0xff;
+        params->fogTable[c].dfog = rnd() & 0xff;
+    }
+
+    /*Clipping keeps every access inside the test framebuffer*/
+    params->fbzMode   = rnd() | 1;
+    params->clipLeft  = rnd_range(0, FB_WIDTH / 4);
+    params->clipRight = rnd_range(FB_WIDTH - FB_WIDTH / 4, FB_WIDTH + 1);
+    params->clipLowY  = rnd_range(0, FB_HEIGHT / 4);
+    params->clipHighY = rnd_range(FB_HEIGHT - FB_HEIGHT / 4, FB_HEIGHT + 1);
+
+    params->draw_offset   = 0;
+    params->aux_offset    = FB_SIZE / 2;
+    params->row_width     = FB_WIDTH * 2;
+    params->aux_row_width = FB_WIDTH * 2;
+
+    voodoo->dual_tmus    = rnd() & 1;
+    voodoo->trexInit1[0] = (rnd() & 7) ? 0 : (1 << 18);
+    voodoo->tmuConfig    = rnd();
+    voodoo->params       = *params;
+}
+
+/*Renders the triangles of one state into fb, returns 0 if the C renderer
+  rejected the state*/
+static int
+render(voodoo_t *voodoo, voodoo_params_t *params, int use_recompiler, const uint8_t *fb_init, uint8_t *fb)
+{
+    memcpy(voodoo->fb_mem, fb_init, FB_SIZE);
+    voodoo->use_recompiler = use_recompiler;
+
+    if (setjmp(fatal_jmp))
+        return 0;
+
+    for (uint8_t c = 0; c < TRIANGLES; c++) {
+        voodoo_triangle(voodoo, &params[c], 0);
+    }
+
+    memcpy(fb, voodoo->fb_mem, FB_SIZE);
+
+    return 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    static voodoo_params_t params[TRIANGLES];
+    voodoo_t              *voodoo;
+    uint8_t               *fb_init;
+    uint8_t               *fb_c;
+    uint8_t               *fb_jit;
+    int                    states   = (argc > 1) ? atoi(argv[1]) : 1000;
+    int                    tested   = 0;
+    int                    skipped  = 0;
+    int                    failed   = 0;
+    uint64_t               seed     = (argc > 2) ? strtoull(argv[2], NULL, 0) : 0x86b0c5eedULL;
+
+    rng_state = seed;
+
+#ifdef NO_CODEGEN
+    printf("No Voodoo code generator on this host, nothing to compare\n");
+    return 0;
+#endif
+
+    for (uint32_t c = 0; c < 0x10000; c++) {
+        rgb565[c].r = (c >> 8) & 0xf8;
+        rgb565[c].g = (c >> 3) & 0xfc;
+        rgb565[c].b = (c << 3) & 0xf8;
+        rgb565[c].r |= (rgb565[c].r >> 5);
+        rgb565[c].g |= (rgb565[c].g >> 6);
+        rgb565[c].b |= (rgb565[c].b >> 5);
+        rgb565[c].a = 0xff;
+    }
+
+    voodoo                 = calloc(1, sizeof(voodoo_t));
+    voodoo->type           = VOODOO_2;
+    voodoo->render_threads = 1;
+    voodoo->v_disp         = FB_HEIGHT;
+    voodoo->fb_mask        = FB_SIZE - 1;
+    voodoo->fb_mem         = malloc(FB_SIZE);
+    voodoo->bilinear_enabled = 1;
+    for (uint8_t c = 0; c < 2; c++) {
+        /*Same size as the texture cache allocates*/
+        uint32_t  size = 256 * 256 + 256 * 256 + 128 * 128 + 64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2;
+        uint32_t *data = malloc(size * 4);
+
+        for (uint32_t d = 0; d < size; d++)
+            data[d] = rnd();
+        voodoo->texture_cache[c][0].data = data;
+    }
+    voodoo_codegen_init(voodoo);
+
+    fb_init = malloc(FB_SIZE);
+    fb_c    = malloc(FB_SIZE);
+    fb_jit  = malloc(FB_SIZE);
+
+    for (int state = 0; state < states; state++) {
+        /*Every state has its own sequence, so a failing one can be rerun alone*/
+        rng_state = seed ^ ((uint64_t) (state + 1) * 0x9e3779b97f4a7c15ULL);
+
+        for (uint32_t c = 0; c < FB_SIZE; c++)
+            fb_init[c] = rnd();
+
+        random_params(voodoo, &params[0]);
+        for (uint8_t c = 1; c < TRIANGLES; c++) {
+            voodoo_params_t base = params[0];
+
+            random_params(voodoo, &params[c]);
+            /*Only the geometry and iterators change within a state*/
+            params[c].fbzColorPath   = base.fbzColorPath;
+            params[c].fbzMode        = base.fbzMode;
+            params[c].alphaMode      = base.alphaMode;
+            params[c].fogMode        = base.fogMode;
+            params[c].textureMode[0] = base.textureMode[0];
+            params[c].textureMode[1] = base.textureMode[1];
+            params[c].tformat[0]     = base.tformat[0];
+            params[c].tformat[1]     = base.tformat[1];
+            params[c].tLOD[0]        = base.tLOD[0];
+            params[c].tLOD[1]        = base.tLOD[1];
+            params[c].clipLeft       = base.clipLeft;
+            params[c].clipRight      = base.clipRight;
+            params[c].clipLowY       = base.clipLowY;
+            params[c].clipHighY      = base.clipHighY;
+        }
+        voodoo->params = params[0];
+
+        if (!render(voodoo, params, 0, fb_init, fb_c)) {
+            skipped++;
+            continue;
+        }
+        render(voodoo, params, 1, fb_init, fb_jit);
+        tested++;
+
+        if (memcmp(fb_c, fb_jit, FB_SIZE)) {
+            for (uint32_t c = 0; c < FB_SIZE; c += 2) {
+                if (*(uint16_t *) &fb_c[c] != *(uint16_t *) &fb_jit[c]) {
+                    printf("State %i: %s (%i,%i) C %04x JIT %04x, fbzColorPath=%08x fbzMode=%08x alphaMode=%08x fogMode=%08x textureMode=%08x,%08x\n",
+                           state, (c < FB_SIZE / 2) ? "colour" : "aux", (c % (FB_WIDTH * 2)) / 2, (c % (FB_SIZE / 2)) / (FB_WIDTH * 2),
+                           *(uint16_t *) &fb_c[c], *(uint16_t *) &fb_jit[c],
+                           params[0].fbzColorPath, params[0].fbzMode, params[0].alphaMode, params[0].fogMode,
+                           params[0].textureMode[0], params[0].textureMode[1]);
+                    break;
+                }
+            }
+            failed++;
+        }
+    }
+
+    printf("%i states compared, %i rejected by the C renderer, %i mismatched\n", tested, skipped, failed);
+
+    voodoo_codegen_close(voodoo);
+
+    return failed ? 1 : 0;
+}